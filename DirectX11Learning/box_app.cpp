@@ -67,7 +67,7 @@ void lea::BoxApp::Init()
 	UINT stride = sizeof(Vertex3);
 	UINT offset1 = 0;
 	device_.Context()->IASetVertexBuffers(0, 1, mVertexBuffer_.GetAddressOf(), &stride, &offset1);
-	device_.Context()->IASetIndexBuffer(mIndexBuffer_.Get(), DXGI_FORMAT_R32_UINT, 0);
+	device_.Context()->IASetIndexBuffer(mIndexBuffer_.Get(), mIndexFormat_, 0);
 
 	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * XM_PI,
 		window_.AspectRatio(), 1.0f, 1000.0f);
@@ -183,18 +183,11 @@ void lea::BoxApp::CreateGeometryBuffers()
 
 	GeometryGenerator geoGen;
 
-	GeometryGenerator::MeshData boxMeshData;
+	GeometryGenerator::BasicMeshData<Vertex3> boxMeshData;
 
 	geoGen.CreateBox(1.0f, 1.0f, 1.0f, boxMeshData);
 
-	std::vector<Vertex3> vertices(boxMeshData.Vertices.size());
-
-	for (UINT i = 0; i < boxMeshData.Vertices.size(); ++i)
-	{
-		vertices[i].pos = boxMeshData.Vertices[i].Position;
-		vertices[i].norm = boxMeshData.Vertices[i].Normal;
-		vertices[i].tex = boxMeshData.Vertices[i].TexC;
-	}
+	const std::vector<Vertex3>& vertices = boxMeshData.Vertices;
 
 	D3D11_BUFFER_DESC vertexBufferDesc{};
 	vertexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
@@ -208,15 +201,9 @@ void lea::BoxApp::CreateGeometryBuffers()
 
 	mBoxIndexCount = boxMeshData.Indices.size();
 
-	D3D11_BUFFER_DESC indexBufferDesc{};
-	indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-	indexBufferDesc.ByteWidth = sizeof(UINT) * mBoxIndexCount;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-
-	D3D11_SUBRESOURCE_DATA indexSubData{};
-	indexSubData.pSysMem = boxMeshData.Indices.data();
-	DX::ThrowIfFailed(device_.Device()->CreateBuffer(&indexBufferDesc, &indexSubData, mIndexBuffer_.GetAddressOf()));
+	lea::utils::IndexBufferData indices;
+	indices.Append(boxMeshData.Indices);
+	mIndexFormat_ = device_.CreateIndexBuffer(indices, mIndexBuffer_.GetAddressOf());
 }
 
 void lea::BoxApp::CreateInputLayout()
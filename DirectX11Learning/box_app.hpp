@@ -31,6 +31,7 @@ namespace lea {
 
 		ComPtr<ID3D11Buffer> mVertexBuffer_;
 		ComPtr<ID3D11Buffer> mIndexBuffer_;
+		DXGI_FORMAT mIndexFormat_ = DXGI_FORMAT_R32_UINT;
 		ComPtr<ID3D11InputLayout> mIputLayout_;
 		ComPtr<ID3D11RasterizerState> mRastState_;
 
@@ -272,6 +272,21 @@ ID3D11ShaderResourceView* lea::LeaDevice::CreateTexture(std::wstring_view textur
     return shaderResourceView;
 }
 
+DXGI_FORMAT lea::LeaDevice::CreateIndexBuffer(const utils::IndexBufferData& indices, ID3D11Buffer** buffer)
+{
+    D3D11_BUFFER_DESC ibd{};
+    ibd.Usage = D3D11_USAGE_IMMUTABLE;
+    ibd.ByteWidth = indices.ByteWidth();
+    ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    ibd.CPUAccessFlags = 0;
+    ibd.MiscFlags = 0;
+    D3D11_SUBRESOURCE_DATA iinitData{};
+    iinitData.pSysMem = indices.Data();
+    DX::ThrowIfFailed(device_->CreateBuffer(&ibd, &iinitData, buffer));
+
+    return indices.Is16Bit() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+}
+
 ID3DX11Effect* lea::LeaDevice::CreateEffect(const WCHAR* szFileName)
 {
     DWORD dwShaderFlags = D3DCOMPILE_ENABLE_STRICTNESS;
@@ -48,6 +48,10 @@ namespace lea {
 		ID3DX11Effect* CreateEffect(const WCHAR* szFileName);
 
 		ID3D11ShaderResourceView* CreateTexture(std::wstring_view texture_file_name);
+
+		// Creates an immutable index buffer holding `indices` and returns the
+		// format to bind it with, DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT.
+		DXGI_FORMAT CreateIndexBuffer(const utils::IndexBufferData& indices, ID3D11Buffer** buffer);
 		void Clean();
 	private:
 		std::vector<ComPtr<IDXGIAdapter>> GetAdapters();
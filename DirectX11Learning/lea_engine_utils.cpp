@@ -1,575 +1,299 @@
 #include "lea_engine_utils.hpp"
 
+#include "lea_thread_pool.hpp"
+
 #include <algorithm>
+#include <stdexcept>
+
+namespace {
+	using namespace DirectX;
+
+	// Icosahedron the geospheres are tessellated from.
+	const float IcosahedronX = 0.525731f;
+	const float IcosahedronZ = 0.850651f;
+
+	// Writes count vertices at start + s * step, s = 0, 1, ..., projected onto
+	// the sphere, with the texture coordinates and tangent CreateGeosphere
+	// derives from spherical coordinates.  Four vertices at a time, one per
+	// lane; the tangent (-sin theta, 0, cos theta) comes straight from x and z.
+	void ProjectRow(lea::utils::GeometryGenerator::Vertex* dst, const XMFLOAT3& start, const XMFLOAT3& step,
+		UINT count, float radius)
+	{
+		const XMVECTOR Lanes = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+		const XMVECTOR Zero = XMVectorZero();
+		const XMVECTOR One = XMVectorReplicate(1.0f);
+		const XMVECTOR Radius = XMVectorReplicate(radius);
+
+		for (UINT s = 0; s < count; s += 4)
+		{
+			XMVECTOR k = XMVectorAdd(XMVectorReplicate(float(s)), Lanes);
+			XMVECTOR x = XMVectorAdd(XMVectorReplicate(start.x), XMVectorMultiply(k, XMVectorReplicate(step.x)));
+			XMVECTOR y = XMVectorAdd(XMVectorReplicate(start.y), XMVectorMultiply(k, XMVectorReplicate(step.y)));
+			XMVECTOR z = XMVectorAdd(XMVectorReplicate(start.z), XMVectorMultiply(k, XMVectorReplicate(step.z)));
+
+			XMVECTOR xz = XMVectorAdd(XMVectorMultiply(x, x), XMVectorMultiply(z, z));
+			XMVECTOR invLength = XMVectorDivide(One, XMVectorSqrt(XMVectorAdd(xz, XMVectorMultiply(y, y))));
+			XMVECTOR nx = XMVectorMultiply(x, invLength);
+			XMVECTOR ny = XMVectorMultiply(y, invLength);
+			XMVECTOR nz = XMVectorMultiply(z, invLength);
+
+			// theta in [0, 2pi) around y from +x towards +z, phi from +y down.
+			XMVECTOR theta = XMVectorATan2(nz, nx);
+			theta = XMVectorSelect(theta, XMVectorAdd(theta, XMVectorReplicate(XM_2PI)), XMVectorLess(theta, Zero));
+			XMVECTOR phi = XMVectorACos(XMVectorMax(XMVectorMin(ny, One), XMVectorNegate(One)));
+
+			// The poles have no theta; atan2 gives 0 there, so the tangent is +z.
+			XMVECTOR invRing = XMVectorDivide(One, XMVectorSqrt(xz));
+			XMVECTOR pole = XMVectorLess(xz, XMVectorReplicate(1e-12f));
+			XMVECTOR tx = XMVectorSelect(XMVectorNegate(XMVectorMultiply(z, invRing)), Zero, pole);
+			XMVECTOR tz = XMVectorSelect(XMVectorMultiply(x, invRing), One, pole);
+
+			XMFLOAT4A out[10];
+			XMStoreFloat4A(&out[0], XMVectorMultiply(nx, Radius));
+			XMStoreFloat4A(&out[1], XMVectorMultiply(ny, Radius));
+			XMStoreFloat4A(&out[2], XMVectorMultiply(nz, Radius));
+			XMStoreFloat4A(&out[3], nx);
+			XMStoreFloat4A(&out[4], ny);
+			XMStoreFloat4A(&out[5], nz);
+			XMStoreFloat4A(&out[6], tx);
+			XMStoreFloat4A(&out[7], tz);
+			XMStoreFloat4A(&out[8], XMVectorMultiply(theta, XMVectorReplicate(1.0f / XM_2PI)));
+			XMStoreFloat4A(&out[9], XMVectorMultiply(phi, XMVectorReplicate(1.0f / XM_PI)));
+
+			const float* lanes = &out[0].x;
+			for (UINT l = 0; l < 4 && s + l < count; ++l)
+			{
+				auto lane = [lanes, l](UINT row) { return lanes[row * 4 + l]; };
+				dst[s + l] = lea::utils::GeometryGenerator::Vertex(
+					lane(0), lane(1), lane(2),
+					lane(3), lane(4), lane(5),
+					lane(6), 0.0f, lane(7),
+					lane(8), lane(9));
+			}
+		}
+	}
+}
 
 namespace lea{
 
 	namespace utils {
-		void GeometryGenerator::CreateBox(float width, float height, float depth, MeshData& meshData)
+		const XMFLOAT3 GeometryGenerator::IcosahedronPositions[12] =
 		{
-			//
-			// Create the vertices.
-			//
-
-			Vertex v[24];
-
-			float w2 = 0.5f * width;
-			float h2 = 0.5f * height;
-			float d2 = 0.5f * depth;
-
-			// Fill in the front face vertex data.
-			v[0] = Vertex(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-			v[1] = Vertex(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-			v[2] = Vertex(+w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-			v[3] = Vertex(+w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-
-			// Fill in the back face vertex data.
-			v[4] = Vertex(-w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-			v[5] = Vertex(+w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-			v[6] = Vertex(+w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-			v[7] = Vertex(-w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-
-			// Fill in the top face vertex data.
-			v[8] = Vertex(-w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-			v[9] = Vertex(-w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-			v[10] = Vertex(+w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-			v[11] = Vertex(+w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-
-			// Fill in the bottom face vertex data.
-			v[12] = Vertex(-w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-			v[13] = Vertex(+w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-			v[14] = Vertex(+w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-			v[15] = Vertex(-w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-
-			// Fill in the left face vertex data.
-			v[16] = Vertex(-w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
-			v[17] = Vertex(-w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
-			v[18] = Vertex(-w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
-			v[19] = Vertex(-w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
-
-			// Fill in the right face vertex data.
-			v[20] = Vertex(+w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
-			v[21] = Vertex(+w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
-			v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
-			v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
-
-			meshData.Vertices.assign(&v[0], &v[24]);
-
-			//
-			// Create the indices.
-			//
-
-			UINT i[36];
-
-			// Fill in the front face index data
-			i[0] = 0; i[1] = 1; i[2] = 2;
-			i[3] = 0; i[4] = 2; i[5] = 3;
-
-			// Fill in the back face index data
-			i[6] = 4; i[7] = 5; i[8] = 6;
-			i[9] = 4; i[10] = 6; i[11] = 7;
-
-			// Fill in the top face index data
-			i[12] = 8; i[13] = 9; i[14] = 10;
-			i[15] = 8; i[16] = 10; i[17] = 11;
-
-			// Fill in the bottom face index data
-			i[18] = 12; i[19] = 13; i[20] = 14;
-			i[21] = 12; i[22] = 14; i[23] = 15;
-
-			// Fill in the left face index data
-			i[24] = 16; i[25] = 17; i[26] = 18;
-			i[27] = 16; i[28] = 18; i[29] = 19;
-
-			// Fill in the right face index data
-			i[30] = 20; i[31] = 21; i[32] = 22;
-			i[33] = 20; i[34] = 22; i[35] = 23;
-
-			meshData.Indices.assign(&i[0], &i[36]);
-		}
-
-
-		void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData)
+			XMFLOAT3(-IcosahedronX, 0.0f, IcosahedronZ),  XMFLOAT3(IcosahedronX, 0.0f, IcosahedronZ),
+			XMFLOAT3(-IcosahedronX, 0.0f, -IcosahedronZ), XMFLOAT3(IcosahedronX, 0.0f, -IcosahedronZ),
+			XMFLOAT3(0.0f, IcosahedronZ, IcosahedronX),   XMFLOAT3(0.0f, IcosahedronZ, -IcosahedronX),
+			XMFLOAT3(0.0f, -IcosahedronZ, IcosahedronX),  XMFLOAT3(0.0f, -IcosahedronZ, -IcosahedronX),
+			XMFLOAT3(IcosahedronZ, IcosahedronX, 0.0f),   XMFLOAT3(-IcosahedronZ, IcosahedronX, 0.0f),
+			XMFLOAT3(IcosahedronZ, -IcosahedronX, 0.0f),  XMFLOAT3(-IcosahedronZ, -IcosahedronX, 0.0f)
+		};
+
+		const uint32_t GeometryGenerator::IcosahedronIndices[60] =
 		{
-			meshData.Vertices.clear();
-			meshData.Indices.clear();
-
-			//
-			// Compute the vertices stating at the top pole and moving down the stacks.
-			//
-
-			// Poles: note that there will be texture coordinate distortion as there is
-			// not a unique point on the texture map to assign to the pole when mapping
-			// a rectangular texture onto a sphere.
-			Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-			Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-
-			meshData.Vertices.push_back(topVertex);
-
-			float phiStep = XM_PI / stackCount;
-			float thetaStep = 2.0f * XM_PI / sliceCount;
-
-			// Compute vertices for each stack ring (do not count the poles as rings).
-			for (UINT i = 1; i <= stackCount - 1; ++i)
-			{
-				float phi = i * phiStep;
-
-				// Vertices of ring.
-				for (UINT j = 0; j <= sliceCount; ++j)
-				{
-					float theta = j * thetaStep;
-
-					Vertex v;
-
-					// spherical to cartesian
-					v.Position.x = radius * sinf(phi) * cosf(theta);
-					v.Position.y = radius * cosf(phi);
-					v.Position.z = radius * sinf(phi) * sinf(theta);
-
-					// Partial derivative of P with respect to theta
-					v.TangentU.x = -radius * sinf(phi) * sinf(theta);
-					v.TangentU.y = 0.0f;
-					v.TangentU.z = +radius * sinf(phi) * cosf(theta);
-
-					XMVECTOR T = XMLoadFloat3(&v.TangentU);
-					XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
-
-					XMVECTOR p = XMLoadFloat3(&v.Position);
-					XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
-
-					v.TexC.x = theta / XM_2PI;
-					v.TexC.y = phi / XM_PI;
-
-					meshData.Vertices.push_back(v);
-				}
-			}
-
-			meshData.Vertices.push_back(bottomVertex);
-
-			//
-			// Compute indices for top stack.  The top stack was written first to the vertex buffer
-			// and connects the top pole to the first ring.
-			//
-
-			for (UINT i = 1; i <= sliceCount; ++i)
-			{
-				meshData.Indices.push_back(0);
-				meshData.Indices.push_back(i + 1);
-				meshData.Indices.push_back(i);
-			}
-
-			//
-			// Compute indices for inner stacks (not connected to poles).
-			//
-
-			// Offset the indices to the index of the first vertex in the first ring.
-			// This is just skipping the top pole vertex.
-			UINT baseIndex = 1;
-			UINT ringVertexCount = sliceCount + 1;
-			for (UINT i = 0; i < stackCount - 2; ++i)
-			{
-				for (UINT j = 0; j < sliceCount; ++j)
-				{
-					meshData.Indices.push_back(baseIndex + i * ringVertexCount + j);
-					meshData.Indices.push_back(baseIndex + i * ringVertexCount + j + 1);
-					meshData.Indices.push_back(baseIndex + (i + 1) * ringVertexCount + j);
-
-					meshData.Indices.push_back(baseIndex + (i + 1) * ringVertexCount + j);
-					meshData.Indices.push_back(baseIndex + i * ringVertexCount + j + 1);
-					meshData.Indices.push_back(baseIndex + (i + 1) * ringVertexCount + j + 1);
-				}
-			}
-
-			//
-			// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
-			// and connects the bottom pole to the bottom ring.
-			//
-
-			// South pole vertex was added last.
-			UINT southPoleIndex = (UINT)meshData.Vertices.size() - 1;
-
-			// Offset the indices to the index of the first vertex in the last ring.
-			baseIndex = southPoleIndex - ringVertexCount;
-
-			for (UINT i = 0; i < sliceCount; ++i)
-			{
-				meshData.Indices.push_back(southPoleIndex);
-				meshData.Indices.push_back(baseIndex + i);
-				meshData.Indices.push_back(baseIndex + i + 1);
-			}
-		}
+			1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,
+			1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,
+			3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0,
+			10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
+		};
 
 		void GeometryGenerator::Subdivide(MeshData& meshData)
 		{
-			// Save a copy of the input geometry.
-			MeshData inputCopy = meshData;
-
-
-			meshData.Vertices.resize(0);
-			meshData.Indices.resize(0);
-
-			//       v1
-			//       *
-			//      / \
-			//     /   \
-			//  m0*-----*m1
-			//   / \   / \
-			//  /   \ /   \
-			// *-----*-----*
-			// v0    m2     v2
-
-			UINT numTris = inputCopy.Indices.size() / 3;
-			for (UINT i = 0; i < numTris; ++i)
-			{
-				Vertex v0 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 0]];
-				Vertex v1 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 1]];
-				Vertex v2 = inputCopy.Vertices[inputCopy.Indices[i * 3 + 2]];
-
-				//
-				// Generate the midpoints.
-				//
-
-				Vertex m0, m1, m2;
-
-				// For subdivision, we just care about the position component.  We derive the other
-				// vertex components in CreateGeosphere.
-
-				m0.Position = XMFLOAT3(
-					0.5f * (v0.Position.x + v1.Position.x),
-					0.5f * (v0.Position.y + v1.Position.y),
-					0.5f * (v0.Position.z + v1.Position.z));
-
-				m1.Position = XMFLOAT3(
-					0.5f * (v1.Position.x + v2.Position.x),
-					0.5f * (v1.Position.y + v2.Position.y),
-					0.5f * (v1.Position.z + v2.Position.z));
-
-				m2.Position = XMFLOAT3(
-					0.5f * (v0.Position.x + v2.Position.x),
-					0.5f * (v0.Position.y + v2.Position.y),
-					0.5f * (v0.Position.z + v2.Position.z));
-
-				//
-				// Add new geometry.
-				//
-
-				meshData.Vertices.push_back(v0); // 0
-				meshData.Vertices.push_back(v1); // 1
-				meshData.Vertices.push_back(v2); // 2
-				meshData.Vertices.push_back(m0); // 3
-				meshData.Vertices.push_back(m1); // 4
-				meshData.Vertices.push_back(m2); // 5
-
-				meshData.Indices.push_back(i * 6 + 0);
-				meshData.Indices.push_back(i * 6 + 3);
-				meshData.Indices.push_back(i * 6 + 5);
-
-				meshData.Indices.push_back(i * 6 + 3);
-				meshData.Indices.push_back(i * 6 + 4);
-				meshData.Indices.push_back(i * 6 + 5);
-
-				meshData.Indices.push_back(i * 6 + 5);
-				meshData.Indices.push_back(i * 6 + 4);
-				meshData.Indices.push_back(i * 6 + 2);
-
-				meshData.Indices.push_back(i * 6 + 3);
-				meshData.Indices.push_back(i * 6 + 1);
-				meshData.Indices.push_back(i * 6 + 4);
-			}
+			SubdivideIndexed(meshData.Vertices, meshData.Indices, MidPoint);
 		}
 
-		void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
+		GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1)
 		{
-			// Put a cap on the number of subdivisions.
-			numSubdivisions = std::min(numSubdivisions, 5u);
-
-			// Approximate a sphere by tessellating an icosahedron.
-
-			const float X = 0.525731f;
-			const float Z = 0.850651f;
-
-			XMFLOAT3 pos[12] =
-			{
-				XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),
-				XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),
-				XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X),
-				XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),
-				XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f),
-				XMFLOAT3(Z, -X, 0.0f),  XMFLOAT3(-Z, -X, 0.0f)
-			};
-
-			int32_t k[60] =
-			{
-				1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,
-				1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,
-				3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0,
-				10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
-			};
-
-			meshData.Vertices.resize(12);
-			meshData.Indices.resize(60);
-
-			for (UINT i = 0; i < 12; ++i)
-				meshData.Vertices[i].Position = pos[i];
-
-			for (UINT i = 0; i < 60; ++i)
-				meshData.Indices[i] = k[i];
-
-			for (UINT i = 0; i < numSubdivisions; ++i)
-				Subdivide(meshData);
-
-			// Project vertices onto sphere and scale.
-			for (UINT i = 0; i < meshData.Vertices.size(); ++i)
-			{
-				// Project onto unit sphere.
-				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
-
-				// Project onto sphere.
-				XMVECTOR p = radius * n;
-
-				XMStoreFloat3(&meshData.Vertices[i].Position, p);
-				XMStoreFloat3(&meshData.Vertices[i].Normal, n);
-
-				// Derive texture coordinates from spherical coordinates.
-				float theta = MathHelper::AngleFromXY(
-					meshData.Vertices[i].Position.x,
-					meshData.Vertices[i].Position.z);
-
-				float phi = acosf(meshData.Vertices[i].Position.y / radius);
-
-				meshData.Vertices[i].TexC.x = theta / XM_2PI;
-				meshData.Vertices[i].TexC.y = phi / XM_PI;
-
-				// Partial derivative of P with respect to theta
-				meshData.Vertices[i].TangentU.x = -radius * sinf(phi) * sinf(theta);
-				meshData.Vertices[i].TangentU.y = 0.0f;
-				meshData.Vertices[i].TangentU.z = +radius * sinf(phi) * cosf(theta);
-
-				XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-				XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-			}
+			// Every attribute is averaged; CreateGeosphere re-derives them from the
+			// position anyway.
+			XMVECTOR p = 0.5f * (XMLoadFloat3(&v0.Position) + XMLoadFloat3(&v1.Position));
+			XMVECTOR n = 0.5f * (XMLoadFloat3(&v0.Normal) + XMLoadFloat3(&v1.Normal));
+			XMVECTOR t = 0.5f * (XMLoadFloat3(&v0.TangentU) + XMLoadFloat3(&v1.TangentU));
+			XMVECTOR uv = 0.5f * (XMLoadFloat2(&v0.TexC) + XMLoadFloat2(&v1.TexC));
+
+			Vertex m;
+			XMStoreFloat3(&m.Position, p);
+			XMStoreFloat3(&m.Normal, n);
+			XMStoreFloat3(&m.TangentU, t);
+			XMStoreFloat2(&m.TexC, uv);
+			return m;
 		}
 
-
-		void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
+		void GeometryGenerator::CreateGeosphereLattice(float radius, UINT numSubdivisions, MeshData& meshData, ThreadPool* threadPool)
 		{
-			meshData.Vertices.clear();
-			meshData.Indices.clear();
-
-			//
-			// Build Stacks.
-			// 
-
-			float stackHeight = height / stackCount;
-
-			// Amount to increment radius as we move up each stack level from bottom to top.
-			float radiusStep = (topRadius - bottomRadius) / stackCount;
-
-			UINT ringCount = stackCount + 1;
-
-			// Compute vertices for each stack ring starting at the bottom and moving up.
-			for (UINT i = 0; i < ringCount; ++i)
+			// Level 12 already takes 168M vertices and 1G indices, 11 GB in all.
+			numSubdivisions = std::min(numSubdivisions, 12u);
+
+			// Each face is the lattice p(i, j) = v0 + i / n (v1 - v0) + j / n (v2 - v0),
+			// i + j <= n, of the subdivided icosahedron.  Corners and edge points are
+			// shared with the neighboring faces, so every vertex gets a fixed place
+			// up front: the 12 corners, then the n - 1 inner points of each of the 30
+			// edges, then the inner points of each face row by row.  Any face row
+			// can then be built without looking at the others.
+			const UINT n = 1u << numSubdivisions;
+			const UINT* k = IcosahedronIndices;
+			const XMFLOAT3* pos = IcosahedronPositions;
+
+			struct Edge
 			{
-				float y = -0.5f * height + i * stackHeight;
-				float r = bottomRadius + i * radiusStep;
-
-				// vertices of ring
-				float dTheta = 2.0f * XM_PI / sliceCount;
-				for (UINT j = 0; j <= sliceCount; ++j)
-				{
-					Vertex vertex;
-
-					float c = cosf(j * dTheta);
-					float s = sinf(j * dTheta);
-
-					vertex.Position = XMFLOAT3(r * c, y, r * s);
-
-					vertex.TexC.x = (float)j / sliceCount;
-					vertex.TexC.y = 1.0f - (float)i / stackCount;
-
-					// Cylinder can be parameterized as follows, where we introduce v
-					// parameter that goes in the same direction as the v tex-coord
-					// so that the bitangent goes in the same direction as the v tex-coord.
-					//   Let r0 be the bottom radius and let r1 be the top radius.
-					//   y(v) = h - hv for v in [0,1].
-					//   r(v) = r1 + (r0-r1)v
-					//
-					//   x(t, v) = r(v)*cos(t)
-					//   y(t, v) = h - hv
-					//   z(t, v) = r(v)*sin(t)
-					// 
-					//  dx/dt = -r(v)*sin(t)
-					//  dy/dt = 0
-					//  dz/dt = +r(v)*cos(t)
-					//
-					//  dx/dv = (r0-r1)*cos(t)
-					//  dy/dv = -h
-					//  dz/dv = (r0-r1)*sin(t)
-
-					// This is unit length.
-					vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-					float dr = bottomRadius - topRadius;
-					XMFLOAT3 bitangent(dr * c, -height, dr * s);
-
-					XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-					XMVECTOR B = XMLoadFloat3(&bitangent);
-					XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-					XMStoreFloat3(&vertex.Normal, N);
-
-					meshData.Vertices.push_back(vertex);
-				}
-			}
-
-			// Add one because we duplicate the first and last vertex per ring
-			// since the texture coordinates are different.
-			UINT ringVertexCount = sliceCount + 1;
-
-			// Compute indices for each stack.
-			for (UINT i = 0; i < stackCount; ++i)
+				uint32_t a;
+				uint32_t b;
+			};
+			Edge edges[30];
+			UINT edgeCount = 0;
+			// Edges v0-v1, v1-v2 and v2-v0 of every face.
+			UINT faceEdges[20][3];
+			for (UINT f = 0; f < 20; ++f)
 			{
-				for (UINT j = 0; j < sliceCount; ++j)
+				for (UINT e = 0; e < 3; ++e)
 				{
-					meshData.Indices.push_back(i * ringVertexCount + j);
-					meshData.Indices.push_back((i + 1) * ringVertexCount + j);
-					meshData.Indices.push_back((i + 1) * ringVertexCount + j + 1);
-
-					meshData.Indices.push_back(i * ringVertexCount + j);
-					meshData.Indices.push_back((i + 1) * ringVertexCount + j + 1);
-					meshData.Indices.push_back(i * ringVertexCount + j + 1);
+					uint32_t a = std::min(k[f * 3 + e], k[f * 3 + (e + 1) % 3]);
+					uint32_t b = std::max(k[f * 3 + e], k[f * 3 + (e + 1) % 3]);
+					UINT found = 0;
+					while (found < edgeCount && (edges[found].a != a || edges[found].b != b))
+						++found;
+					if (found == edgeCount)
+						edges[edgeCount++] = { a, b };
+					faceEdges[f][e] = found;
 				}
 			}
 
-			BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-			BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-		}
+			const size_t edgeBase = 12;
+			const size_t faceBase = edgeBase + size_t(30) * (n - 1);
+			const size_t faceInner = n > 1 ? size_t(n - 1) * (n - 2) / 2 : 0;
 
-		void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-			UINT sliceCount, UINT stackCount, MeshData& meshData)
-		{
-			UINT baseIndex = (UINT)meshData.Vertices.size();
+			// Counted in 64 bits, a 32-bit size_t can't even hold the index count
+			// of the larger levels.
+			const uint64_t vertexCount = 10 * uint64_t(n) * n + 2;
+			const uint64_t indexCount = 60 * uint64_t(n) * n;
+			if (vertexCount > meshData.Vertices.max_size() || indexCount > meshData.Indices.max_size())
+				throw std::length_error("CreateGeosphereLattice: mesh too large for the address space");
 
-			float y = 0.5f * height;
-			float dTheta = 2.0f * XM_PI / sliceCount;
+			meshData.Vertices.resize(size_t(vertexCount));
+			meshData.Indices.resize(size_t(indexCount));
 
-			// Duplicate cap ring vertices because the texture coordinates and normals differ.
-			for (UINT i = 0; i <= sliceCount; ++i)
-			{
-				float x = topRadius * cosf(i * dTheta);
-				float z = topRadius * sinf(i * dTheta);
-
-				// Scale down by the height to try and make top cap texture coord area
-				// proportional to base.
-				float u = x / height + 0.5f;
-				float v = z / height + 0.5f;
-
-				meshData.Vertices.push_back(Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
-			}
-
-			// Cap center vertex.
-			meshData.Vertices.push_back(Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+			// Inner point `along` n-ths of the way from `from` on edge e.
+			auto edgeVertex = [&edges, n, edgeBase](UINT e, uint32_t from, UINT along)
+				{
+					if (edges[e].a != from)
+						along = n - along;
+					return uint32_t(edgeBase + size_t(e) * (n - 1) + along - 1);
+				};
+			// First inner point of face row j, 1 <= j <= n - 2, within the face.
+			auto rowStart = [n](UINT j)
+				{
+					return size_t(j - 1) * (n - 1) - size_t(j - 1) * j / 2;
+				};
+			auto latticeVertex = [&](UINT f, UINT i, UINT j)
+				{
+					const uint32_t* v = &k[f * 3];
+					if (j == 0)
+						return i == 0 ? v[0] : i == n ? v[1] : edgeVertex(faceEdges[f][0], v[0], i);
+					if (i == 0)
+						return j == n ? v[2] : edgeVertex(faceEdges[f][2], v[0], j);
+					if (i + j == n)
+						return edgeVertex(faceEdges[f][1], v[1], j);
+					return uint32_t(faceBase + f * faceInner + rowStart(j) + i - 1);
+				};
+
+			auto sub = [](const XMFLOAT3& a, const XMFLOAT3& b, float scale)
+				{
+					return XMFLOAT3((a.x - b.x) * scale, (a.y - b.y) * scale, (a.z - b.z) * scale);
+				};
 
-			// Index of center vertex.
-			UINT centerIndex = (UINT)meshData.Vertices.size() - 1;
+			// Work items: every row of every face, then every edge, then the corners.
+			const UINT rowItems = 20 * n;
+			const UINT itemCount = rowItems + 30 + 1;
+			const float invN = 1.0f / n;
 
-			for (UINT i = 0; i < sliceCount; ++i)
-			{
-				meshData.Indices.push_back(centerIndex);
-				meshData.Indices.push_back(baseIndex + i + 1);
-				meshData.Indices.push_back(baseIndex + i);
-			}
+			auto build = [&](UINT index, UINT count)
+				{
+					UINT itemBegin, itemEnd;
+					ThreadPool::SplitRange(0, itemCount, index, count, itemBegin, itemEnd);
+
+					for (UINT item = itemBegin; item < itemEnd; ++item)
+					{
+						if (item == itemCount - 1)
+						{
+							const XMFLOAT3 none(0.0f, 0.0f, 0.0f);
+							for (UINT c = 0; c < 12; ++c)
+								ProjectRow(&meshData.Vertices[c], pos[c], none, 1, radius);
+							continue;
+						}
+
+						if (item >= rowItems)
+						{
+							UINT e = item - rowItems;
+							const XMFLOAT3& a = pos[edges[e].a];
+							XMFLOAT3 step = sub(pos[edges[e].b], a, invN);
+							XMFLOAT3 start(a.x + step.x, a.y + step.y, a.z + step.z);
+							ProjectRow(&meshData.Vertices[edgeBase + size_t(e) * (n - 1)], start, step, n - 1, radius);
+							continue;
+						}
+
+						const UINT f = item / n;
+						const UINT j = item % n;
+
+						if (j >= 1 && j + 2 <= n)
+						{
+							const XMFLOAT3& v0 = pos[k[f * 3 + 0]];
+							XMFLOAT3 step = sub(pos[k[f * 3 + 1]], v0, invN);
+							XMFLOAT3 up = sub(pos[k[f * 3 + 2]], v0, j * invN);
+							XMFLOAT3 start(v0.x + step.x + up.x, v0.y + step.y + up.y, v0.z + step.z + up.z);
+							ProjectRow(&meshData.Vertices[faceBase + f * faceInner + rowStart(j)], start, step, n - 1 - j, radius);
+						}
+
+						// Triangles between lattice rows j and j + 1, each row 2 (n - j) - 1
+						// of them, wound like the face.
+						uint32_t* tri = &meshData.Indices[3 * (size_t(f) * n * n + size_t(2 * n - j) * j)];
+						for (UINT i = 0; i + j < n; ++i)
+						{
+							uint32_t a = latticeVertex(f, i, j);
+							uint32_t b = latticeVertex(f, i + 1, j);
+							uint32_t c = latticeVertex(f, i, j + 1);
+							*tri++ = a; *tri++ = b; *tri++ = c;
+
+							if (i + j + 1 < n)
+							{
+								*tri++ = b;
+								*tri++ = latticeVertex(f, i + 1, j + 1);
+								*tri++ = c;
+							}
+						}
+					}
+				};
+
+			if (threadPool)
+				threadPool->Run(build);
+			else
+				build(0, 1);
 		}
 
-		void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-			UINT sliceCount, UINT stackCount, MeshData& meshData)
+		UINT IndexBufferData::Append(const uint32_t* indices, size_t count)
 		{
-			// 
-			// Build bottom cap.
-			//
+			const UINT start = IndexCount();
 
-			UINT baseIndex = (UINT)meshData.Vertices.size();
-			float y = -0.5f * height;
-
-			// vertices of ring
-			float dTheta = 2.0f * XM_PI / sliceCount;
-			for (UINT i = 0; i <= sliceCount; ++i)
+			if (!wide_)
 			{
-				float x = bottomRadius * cosf(i * dTheta);
-				float z = bottomRadius * sinf(i * dTheta);
-
-				// Scale down by the height to try and make top cap texture coord area
-				// proportional to base.
-				float u = x / height + 0.5f;
-				float v = z / height + 0.5f;
+				// 0xFFFF is left out, it is the strip cut value.
+				if (std::all_of(indices, indices + count, [](uint32_t i) { return i < 0xFFFF; }))
+				{
+					indices16_.reserve(indices16_.size() + count);
+					for (size_t i = 0; i < count; ++i)
+						indices16_.push_back(static_cast<uint16_t>(indices[i]));
+					return start;
+				}
 
-				meshData.Vertices.push_back(Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+				indices32_.assign(indices16_.begin(), indices16_.end());
+				indices16_ = std::vector<uint16_t>();
+				wide_ = true;
 			}
 
-			// Cap center vertex.
-			meshData.Vertices.push_back(Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
-
-			// Cache the index of center vertex.
-			UINT centerIndex = (UINT)meshData.Vertices.size() - 1;
-
-			for (UINT i = 0; i < sliceCount; ++i)
-			{
-				meshData.Indices.push_back(centerIndex);
-				meshData.Indices.push_back(baseIndex + i);
-				meshData.Indices.push_back(baseIndex + i + 1);
-			}
+			indices32_.insert(indices32_.end(), indices, indices + count);
+			return start;
 		}
 
-
-
-		void GeometryGenerator::CreateGrid(float width, float depth, uint32_t m, uint32_t n, MeshData& meshData)
+		const void* IndexBufferData::Data() const
 		{
-			uint32_t vertexCount = m * n;
-
-			// Total number of triangles in grid
-			uint32_t faceCount = (m - 1) * (n - 1) * 2;
-
-			float halfWidth = 0.5f * width;
-			float halfDepth = 0.5f * depth;
-			float dx = width / (n - 1);
-			float dz = depth / (m - 1);
-			float du = 1.0f / (n - 1);
-			float dv = 1.0f / (m - 1);
-			meshData.Vertices.resize(vertexCount);
-			for (uint32_t i = 0; i < m; ++i)
-			{
-				float z = halfDepth - i * dz;
-				for (uint32_t j = 0; j < n; ++j)
-				{
-					float x = -halfWidth + j * dx;
-					meshData.Vertices[i * n + j].Position = XMFLOAT3(x, 0.0f, z);
-					// Ignore for now, used for lighting.
-					meshData.Vertices[i * n + j].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-					meshData.Vertices[i * n + j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-					// Ignore for now, used for texturing.
-					meshData.Vertices[i * n + j].TexC.x = j * du;
-					meshData.Vertices[i * n + j].TexC.y = i * dv;
-				}
-			}
-
-			meshData.Indices.resize(faceCount * 3); // 3 indices per face
-
-			// Iterate over each quad and compute indices.
-			uint32_t k = 0;
-			for (uint32_t i = 0; i < m - 1; ++i)
-			{
-				for (uint32_t j = 0; j < n - 1; ++j)
-				{
-					meshData.Indices[k] = i * n + j;
-					meshData.Indices[k + 1] = i * n + j + 1;
-					meshData.Indices[k + 2] = (i + 1) * n + j;
-
-					meshData.Indices[k + 3] = (i + 1) * n + j;
-					meshData.Indices[k + 4] = i * n + j + 1;
-					meshData.Indices[k + 5] = (i + 1) * n + j + 1;
-
-					k += 6; // next quad
-				}
-			}
+			return wide_ ? static_cast<const void*>(indices32_.data()) : static_cast<const void*>(indices16_.data());
 		}
 	}
-}
\ No newline at end of file
+}
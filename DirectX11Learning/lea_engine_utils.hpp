@@ -4,7 +4,10 @@
 
 #include <vector>
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <unordered_map>
 
 #include <DirectXMath.h>
 #include <DirectXPackedVector.h>
@@ -13,6 +16,8 @@ using UINT = uint32_t;
 namespace lea {
 	using namespace DirectX;
 
+	class ThreadPool;
+
 	namespace utils {
 		struct Vertex0 {
 			XMFLOAT3 pos;
@@ -67,24 +72,62 @@ namespace lea {
 				DirectX::XMFLOAT3 TangentU;
 				DirectX::XMFLOAT2 TexC;
 			};
-			struct MeshData
+			// Vertices of any layout VertexAttributes knows; the generators below
+			// write straight into it.
+			template<typename V>
+			struct BasicMeshData
 			{
-				std::vector<Vertex> Vertices;
+				std::vector<V> Vertices;
 				std::vector<uint32_t> Indices;
 			};
-
-			void CreateBox(float width, float height, float depth, MeshData& meshData);
-			void CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData);
+			using MeshData = BasicMeshData<Vertex>;
+
+			// The generators fill only the attributes VertexAttributes<V> maps, and
+			// the others are never computed.  For example, the trig behind sphere
+			// tangents is compiled out for Vertex3.
+			template<typename V>
+			void CreateBox(float width, float height, float depth, BasicMeshData<V>& meshData);
+			template<typename V>
+			void CreateGeosphere(float radius, UINT numSubdivisions, BasicMeshData<V>& meshData);
+			// Splits every triangle into four, in place.  Neighboring triangles share
+			// their edge midpoints, so an indexed, watertight mesh stays that way.
 			void Subdivide(MeshData& meshData);
-			void CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData);
-			void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+			// Same sphere as CreateGeosphere, but built straight at the target level
+			// instead of subdividing level by level: every icosahedron face is a
+			// triangular lattice with 2^numSubdivisions segments per edge, and its
+			// rows are filled in parallel on threadPool, if given.  Points on the
+			// shared edges and corners exist once, so the mesh is watertight.
+			// Projection and texture coordinates run four vertices at a time.
+			// numSubdivisions is capped at 12, 168M vertices and 335M triangles;
+			// throws std::length_error if the mesh is too large for the address
+			// space, e.g. level 12 in a 32-bit build.
+			void CreateGeosphereLattice(float radius, UINT numSubdivisions, MeshData& meshData, ThreadPool* threadPool = nullptr);
+			template<typename V>
+			void CreateSphere(float radius, UINT sliceCount, UINT stackCount, BasicMeshData<V>& meshData);
+			template<typename V>
+			void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, BasicMeshData<V>& meshData);
 			
-			void CreateGrid(float width, float depth, uint32_t m, uint32_t n, MeshData& meshData);
+			template<typename V>
+			void CreateGrid(float width, float depth, uint32_t m, uint32_t n, BasicMeshData<V>& meshData);
 		private:
+			static const XMFLOAT3 IcosahedronPositions[12];
+			static const uint32_t IcosahedronIndices[60];
+
+			template<typename V>
+			static V MakeVertex(
+				float px, float py, float pz,
+				float nx, float ny, float nz,
+				float tx, float ty, float tz,
+				float u, float v);
+			template<typename T, typename MidPointFn>
+			static void SubdivideIndexed(std::vector<T>& vertices, std::vector<uint32_t>& indices, MidPointFn midPoint);
+			static Vertex MidPoint(const Vertex& v0, const Vertex& v1);
+			template<typename V>
 			void BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-				UINT sliceCount, UINT stackCount, MeshData& meshData);
+				UINT sliceCount, UINT stackCount, BasicMeshData<V>& meshData);
+			template<typename V>
 			void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-				UINT sliceCount, UINT stackCount, MeshData& meshData);
+				UINT sliceCount, UINT stackCount, BasicMeshData<V>& meshData);
 		};
 
 		class MathHelper {
@@ -178,6 +221,696 @@ namespace lea {
 			}
 		};
 
+		// Which GeometryGenerator attributes a vertex layout stores, and where.
+		// Position is required; Has* flags switch the rest on, and only the
+		// setters of attributes that are switched on need to exist.  Specialize
+		// it to let the generators write a new layout.
+		template<typename V>
+		struct VertexAttributes;
+
+		template<>
+		struct VertexAttributes<Vertex0>
+		{
+			static constexpr bool HasNormal = false;
+			static constexpr bool HasTangentU = false;
+			static constexpr bool HasTexC = false;
+			static void SetPosition(Vertex0& v, const XMFLOAT3& p) { v.pos = p; }
+		};
+
+		template<>
+		struct VertexAttributes<Vertex1>
+		{
+			static constexpr bool HasNormal = false;
+			static constexpr bool HasTangentU = false;
+			static constexpr bool HasTexC = false;
+			static void SetPosition(Vertex1& v, const XMFLOAT3& p) { v.pos = p; }
+		};
+
+		template<>
+		struct VertexAttributes<Vertex2>
+		{
+			static constexpr bool HasNormal = true;
+			static constexpr bool HasTangentU = false;
+			static constexpr bool HasTexC = false;
+			static void SetPosition(Vertex2& v, const XMFLOAT3& p) { v.pos = p; }
+			static void SetNormal(Vertex2& v, const XMFLOAT3& n) { v.norm = n; }
+		};
+
+		template<>
+		struct VertexAttributes<Vertex3>
+		{
+			static constexpr bool HasNormal = true;
+			static constexpr bool HasTangentU = false;
+			static constexpr bool HasTexC = true;
+			static void SetPosition(Vertex3& v, const XMFLOAT3& p) { v.pos = p; }
+			static void SetNormal(Vertex3& v, const XMFLOAT3& n) { v.norm = n; }
+			static void SetTexC(Vertex3& v, const XMFLOAT2& uv) { v.tex = uv; }
+		};
+
+		template<>
+		struct VertexAttributes<Vertex4>
+		{
+			static constexpr bool HasNormal = true;
+			static constexpr bool HasTangentU = false;
+			static constexpr bool HasTexC = true;
+			static void SetPosition(Vertex4& v, const XMFLOAT3& p) { v.pos = p; }
+			static void SetNormal(Vertex4& v, const XMFLOAT3& n) { v.normal = n; }
+			static void SetTexC(Vertex4& v, const XMFLOAT2& uv) { v.tex0 = uv; }
+		};
+
+		template<>
+		struct VertexAttributes<GeometryGenerator::Vertex>
+		{
+			static constexpr bool HasNormal = true;
+			static constexpr bool HasTangentU = true;
+			static constexpr bool HasTexC = true;
+			static void SetPosition(GeometryGenerator::Vertex& v, const XMFLOAT3& p) { v.Position = p; }
+			static void SetNormal(GeometryGenerator::Vertex& v, const XMFLOAT3& n) { v.Normal = n; }
+			static void SetTangentU(GeometryGenerator::Vertex& v, const XMFLOAT3& t) { v.TangentU = t; }
+			static void SetTexC(GeometryGenerator::Vertex& v, const XMFLOAT2& uv) { v.TexC = uv; }
+		};
+
+		template<typename V>
+		V GeometryGenerator::MakeVertex(
+			float px, float py, float pz,
+			float nx, float ny, float nz,
+			float tx, float ty, float tz,
+			float u, float v)
+		{
+			using Attributes = VertexAttributes<V>;
+
+			V vertex{};
+			Attributes::SetPosition(vertex, XMFLOAT3(px, py, pz));
+			if constexpr (Attributes::HasNormal)
+				Attributes::SetNormal(vertex, XMFLOAT3(nx, ny, nz));
+			if constexpr (Attributes::HasTangentU)
+				Attributes::SetTangentU(vertex, XMFLOAT3(tx, ty, tz));
+			if constexpr (Attributes::HasTexC)
+				Attributes::SetTexC(vertex, XMFLOAT2(u, v));
+			return vertex;
+		}
+
+		template<typename V>
+		void GeometryGenerator::CreateBox(float width, float height, float depth, BasicMeshData<V>& meshData)
+		{
+			//
+			// Create the vertices.
+			//
+
+			V v[24];
+
+			float w2 = 0.5f * width;
+			float h2 = 0.5f * height;
+			float d2 = 0.5f * depth;
+
+			// Fill in the front face vertex data.
+			v[0] = MakeVertex<V>(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+			v[1] = MakeVertex<V>(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+			v[2] = MakeVertex<V>(+w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+			v[3] = MakeVertex<V>(+w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+			// Fill in the back face vertex data.
+			v[4] = MakeVertex<V>(-w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+			v[5] = MakeVertex<V>(+w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+			v[6] = MakeVertex<V>(+w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+			v[7] = MakeVertex<V>(-w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+			// Fill in the top face vertex data.
+			v[8] = MakeVertex<V>(-w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+			v[9] = MakeVertex<V>(-w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+			v[10] = MakeVertex<V>(+w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+			v[11] = MakeVertex<V>(+w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+			// Fill in the bottom face vertex data.
+			v[12] = MakeVertex<V>(-w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+			v[13] = MakeVertex<V>(+w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+			v[14] = MakeVertex<V>(+w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+			v[15] = MakeVertex<V>(-w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+			// Fill in the left face vertex data.
+			v[16] = MakeVertex<V>(-w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
+			v[17] = MakeVertex<V>(-w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
+			v[18] = MakeVertex<V>(-w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
+			v[19] = MakeVertex<V>(-w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
+
+			// Fill in the right face vertex data.
+			v[20] = MakeVertex<V>(+w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
+			v[21] = MakeVertex<V>(+w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+			v[22] = MakeVertex<V>(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+			v[23] = MakeVertex<V>(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
+
+			meshData.Vertices.assign(&v[0], &v[24]);
+
+			//
+			// Create the indices.
+			//
+
+			UINT i[36];
+
+			// Fill in the front face index data
+			i[0] = 0; i[1] = 1; i[2] = 2;
+			i[3] = 0; i[4] = 2; i[5] = 3;
+
+			// Fill in the back face index data
+			i[6] = 4; i[7] = 5; i[8] = 6;
+			i[9] = 4; i[10] = 6; i[11] = 7;
+
+			// Fill in the top face index data
+			i[12] = 8; i[13] = 9; i[14] = 10;
+			i[15] = 8; i[16] = 10; i[17] = 11;
+
+			// Fill in the bottom face index data
+			i[18] = 12; i[19] = 13; i[20] = 14;
+			i[21] = 12; i[22] = 14; i[23] = 15;
+
+			// Fill in the left face index data
+			i[24] = 16; i[25] = 17; i[26] = 18;
+			i[27] = 16; i[28] = 18; i[29] = 19;
+
+			// Fill in the right face index data
+			i[30] = 20; i[31] = 21; i[32] = 22;
+			i[33] = 20; i[34] = 22; i[35] = 23;
+
+			meshData.Indices.assign(&i[0], &i[36]);
+		}
+
+		template<typename V>
+		void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, BasicMeshData<V>& meshData)
+		{
+			using Attributes = VertexAttributes<V>;
+
+			meshData.Vertices.clear();
+			meshData.Indices.clear();
+
+			//
+			// Compute the vertices stating at the top pole and moving down the stacks.
+			//
+
+			// Poles: note that there will be texture coordinate distortion as there is
+			// not a unique point on the texture map to assign to the pole when mapping
+			// a rectangular texture onto a sphere.
+			V topVertex = MakeVertex<V>(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+			V bottomVertex = MakeVertex<V>(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+			meshData.Vertices.reserve(size_t(stackCount - 1) * (sliceCount + 1) + 2);
+			meshData.Vertices.push_back(topVertex);
+
+			float phiStep = XM_PI / stackCount;
+			float thetaStep = 2.0f * XM_PI / sliceCount;
+
+			// Compute vertices for each stack ring (do not count the poles as rings).
+			for (UINT i = 1; i <= stackCount - 1; ++i)
+			{
+				float phi = i * phiStep;
+
+				// Vertices of ring.
+				for (UINT j = 0; j <= sliceCount; ++j)
+				{
+					float theta = j * thetaStep;
+
+					V v{};
+
+					// spherical to cartesian
+					XMFLOAT3 position(
+						radius * sinf(phi) * cosf(theta),
+						radius * cosf(phi),
+						radius * sinf(phi) * sinf(theta));
+					Attributes::SetPosition(v, position);
+
+					if constexpr (Attributes::HasTangentU)
+					{
+						// Partial derivative of P with respect to theta
+						XMFLOAT3 tangent(
+							-radius * sinf(phi) * sinf(theta),
+							0.0f,
+							+radius * sinf(phi) * cosf(theta));
+
+						XMVECTOR T = XMLoadFloat3(&tangent);
+						XMStoreFloat3(&tangent, XMVector3Normalize(T));
+						Attributes::SetTangentU(v, tangent);
+					}
+
+					if constexpr (Attributes::HasNormal)
+					{
+						XMFLOAT3 normal;
+						XMVECTOR p = XMLoadFloat3(&position);
+						XMStoreFloat3(&normal, XMVector3Normalize(p));
+						Attributes::SetNormal(v, normal);
+					}
+
+					if constexpr (Attributes::HasTexC)
+						Attributes::SetTexC(v, XMFLOAT2(theta / XM_2PI, phi / XM_PI));
+
+					meshData.Vertices.push_back(v);
+				}
+			}
+
+			meshData.Vertices.push_back(bottomVertex);
+
+			//
+			// Compute indices for top stack.  The top stack was written first to the vertex buffer
+			// and connects the top pole to the first ring.
+			//
+
+			for (UINT i = 1; i <= sliceCount; ++i)
+			{
+				meshData.Indices.push_back(0);
+				meshData.Indices.push_back(i + 1);
+				meshData.Indices.push_back(i);
+			}
+
+			//
+			// Compute indices for inner stacks (not connected to poles).
+			//
+
+			// Offset the indices to the index of the first vertex in the first ring.
+			// This is just skipping the top pole vertex.
+			UINT baseIndex = 1;
+			UINT ringVertexCount = sliceCount + 1;
+			for (UINT i = 0; i < stackCount - 2; ++i)
+			{
+				for (UINT j = 0; j < sliceCount; ++j)
+				{
+					meshData.Indices.push_back(baseIndex + i * ringVertexCount + j);
+					meshData.Indices.push_back(baseIndex + i * ringVertexCount + j + 1);
+					meshData.Indices.push_back(baseIndex + (i + 1) * ringVertexCount + j);
+
+					meshData.Indices.push_back(baseIndex + (i + 1) * ringVertexCount + j);
+					meshData.Indices.push_back(baseIndex + i * ringVertexCount + j + 1);
+					meshData.Indices.push_back(baseIndex + (i + 1) * ringVertexCount + j + 1);
+				}
+			}
+
+			//
+			// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+			// and connects the bottom pole to the bottom ring.
+			//
+
+			// South pole vertex was added last.
+			UINT southPoleIndex = (UINT)meshData.Vertices.size() - 1;
+
+			// Offset the indices to the index of the first vertex in the last ring.
+			baseIndex = southPoleIndex - ringVertexCount;
+
+			for (UINT i = 0; i < sliceCount; ++i)
+			{
+				meshData.Indices.push_back(southPoleIndex);
+				meshData.Indices.push_back(baseIndex + i);
+				meshData.Indices.push_back(baseIndex + i + 1);
+			}
+		}
+
+		template<typename T, typename MidPointFn>
+		void GeometryGenerator::SubdivideIndexed(std::vector<T>& vertices, std::vector<uint32_t>& indices, MidPointFn midPoint)
+		{
+			/*
+			       v1
+			       *
+			      / \
+			     /   \
+			  m0*-----*m1
+			   / \   / \
+			  /   \ /   \
+			 *-----*-----*
+			 v0    m2     v2
+			*/
+
+			// Every edge gets one midpoint, shared by the triangles on both sides of
+			// it, so the mesh stays watertight.  The old vertices keep their indices
+			// and the midpoints are appended, found again through a table keyed by
+			// the two end indices of their edge.
+			const UINT numTris = (UINT)indices.size() / 3;
+
+			std::unordered_map<uint64_t, uint32_t> midpoints;
+			midpoints.reserve(numTris * 3 / 2);
+			vertices.reserve(vertices.size() + numTris * 3 / 2);
+
+			auto midpoint = [&vertices, &midpoints, &midPoint](uint32_t a, uint32_t b)
+				{
+					uint64_t key = a < b ? (uint64_t(a) << 32 | b) : (uint64_t(b) << 32 | a);
+					auto [it, inserted] = midpoints.try_emplace(key, (uint32_t)vertices.size());
+					if (inserted)
+						vertices.push_back(midPoint(vertices[a], vertices[b]));
+					return it->second;
+				};
+
+			// Each triangle becomes four in place: triangle i is written to
+			// [12 * i, 12 * i + 12), so going from the last one down nothing is
+			// overwritten before it is read.
+			indices.resize(size_t(numTris) * 12);
+			for (UINT i = numTris; i-- > 0;)
+			{
+				uint32_t v0 = indices[i * 3 + 0];
+				uint32_t v1 = indices[i * 3 + 1];
+				uint32_t v2 = indices[i * 3 + 2];
+
+				uint32_t m0 = midpoint(v0, v1);
+				uint32_t m1 = midpoint(v1, v2);
+				uint32_t m2 = midpoint(v0, v2);
+
+				uint32_t* tri = &indices[size_t(i) * 12];
+				tri[0] = v0; tri[1] = m0; tri[2] = m2;
+				tri[3] = m0; tri[4] = m1; tri[5] = m2;
+				tri[6] = m2; tri[7] = m1; tri[8] = v2;
+				tri[9] = m0; tri[10] = v1; tri[11] = m1;
+			}
+		}
+
+		template<typename V>
+		void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, BasicMeshData<V>& meshData)
+		{
+			using Attributes = VertexAttributes<V>;
+
+			// Put a cap on the number of subdivisions.
+			numSubdivisions = std::min(numSubdivisions, 5u);
+
+			// Approximate a sphere by tessellating an icosahedron.  Only the positions
+			// are subdivided; everything else is derived from them afterwards.
+
+			std::vector<XMFLOAT3> positions(&IcosahedronPositions[0], &IcosahedronPositions[12]);
+			meshData.Indices.assign(&IcosahedronIndices[0], &IcosahedronIndices[60]);
+
+			for (UINT i = 0; i < numSubdivisions; ++i)
+			{
+				SubdivideIndexed(positions, meshData.Indices, [](const XMFLOAT3& p0, const XMFLOAT3& p1)
+					{
+						XMFLOAT3 m;
+						XMStoreFloat3(&m, 0.5f * (XMLoadFloat3(&p0) + XMLoadFloat3(&p1)));
+						return m;
+					});
+			}
+
+			// Project vertices onto sphere and scale.
+			meshData.Vertices.resize(positions.size());
+			for (UINT i = 0; i < positions.size(); ++i)
+			{
+				V& v = meshData.Vertices[i];
+
+				// Project onto unit sphere.
+				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&positions[i]));
+
+				// Project onto sphere.
+				XMVECTOR p = radius * n;
+
+				XMFLOAT3 position;
+				XMStoreFloat3(&position, p);
+				Attributes::SetPosition(v, position);
+
+				if constexpr (Attributes::HasNormal)
+				{
+					XMFLOAT3 normal;
+					XMStoreFloat3(&normal, n);
+					Attributes::SetNormal(v, normal);
+				}
+
+				if constexpr (Attributes::HasTexC || Attributes::HasTangentU)
+				{
+					// Derive texture coordinates from spherical coordinates.
+					float theta = MathHelper::AngleFromXY(position.x, position.z);
+
+					float phi = acosf(position.y / radius);
+
+					if constexpr (Attributes::HasTexC)
+						Attributes::SetTexC(v, XMFLOAT2(theta / XM_2PI, phi / XM_PI));
+
+					if constexpr (Attributes::HasTangentU)
+					{
+						// Partial derivative of P with respect to theta
+						XMFLOAT3 tangent(
+							-radius * sinf(phi) * sinf(theta),
+							0.0f,
+							+radius * sinf(phi) * cosf(theta));
+
+						XMVECTOR T = XMLoadFloat3(&tangent);
+						XMStoreFloat3(&tangent, XMVector3Normalize(T));
+						Attributes::SetTangentU(v, tangent);
+					}
+				}
+			}
+		}
+
+		template<typename V>
+		void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, BasicMeshData<V>& meshData)
+		{
+			using Attributes = VertexAttributes<V>;
+
+			meshData.Vertices.clear();
+			meshData.Indices.clear();
+
+			//
+			// Build Stacks.
+			// 
+
+			float stackHeight = height / stackCount;
+
+			// Amount to increment radius as we move up each stack level from bottom to top.
+			float radiusStep = (topRadius - bottomRadius) / stackCount;
+
+			UINT ringCount = stackCount + 1;
+
+			// Side rings plus the two caps, each a ring and a center.
+			meshData.Vertices.reserve(size_t(ringCount + 2) * (sliceCount + 1) + 2);
+
+			// Compute vertices for each stack ring starting at the bottom and moving up.
+			for (UINT i = 0; i < ringCount; ++i)
+			{
+				float y = -0.5f * height + i * stackHeight;
+				float r = bottomRadius + i * radiusStep;
+
+				// vertices of ring
+				float dTheta = 2.0f * XM_PI / sliceCount;
+				for (UINT j = 0; j <= sliceCount; ++j)
+				{
+					V vertex{};
+
+					float c = cosf(j * dTheta);
+					float s = sinf(j * dTheta);
+
+					Attributes::SetPosition(vertex, XMFLOAT3(r * c, y, r * s));
+
+					if constexpr (Attributes::HasTexC)
+						Attributes::SetTexC(vertex, XMFLOAT2((float)j / sliceCount, 1.0f - (float)i / stackCount));
+
+					// Cylinder can be parameterized as follows, where we introduce v
+					// parameter that goes in the same direction as the v tex-coord
+					// so that the bitangent goes in the same direction as the v tex-coord.
+					//   Let r0 be the bottom radius and let r1 be the top radius.
+					//   y(v) = h - hv for v in [0,1].
+					//   r(v) = r1 + (r0-r1)v
+					//
+					//   x(t, v) = r(v)*cos(t)
+					//   y(t, v) = h - hv
+					//   z(t, v) = r(v)*sin(t)
+					// 
+					//  dx/dt = -r(v)*sin(t)
+					//  dy/dt = 0
+					//  dz/dt = +r(v)*cos(t)
+					//
+					//  dx/dv = (r0-r1)*cos(t)
+					//  dy/dv = -h
+					//  dz/dv = (r0-r1)*sin(t)
+
+					// This is unit length.
+					XMFLOAT3 tangent(-s, 0.0f, c);
+					if constexpr (Attributes::HasTangentU)
+						Attributes::SetTangentU(vertex, tangent);
+
+					if constexpr (Attributes::HasNormal)
+					{
+						float dr = bottomRadius - topRadius;
+						XMFLOAT3 bitangent(dr * c, -height, dr * s);
+
+						XMVECTOR T = XMLoadFloat3(&tangent);
+						XMVECTOR B = XMLoadFloat3(&bitangent);
+						XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+						XMFLOAT3 normal;
+						XMStoreFloat3(&normal, N);
+						Attributes::SetNormal(vertex, normal);
+					}
+
+					meshData.Vertices.push_back(vertex);
+				}
+			}
+
+			// Add one because we duplicate the first and last vertex per ring
+			// since the texture coordinates are different.
+			UINT ringVertexCount = sliceCount + 1;
+
+			// Compute indices for each stack.
+			for (UINT i = 0; i < stackCount; ++i)
+			{
+				for (UINT j = 0; j < sliceCount; ++j)
+				{
+					meshData.Indices.push_back(i * ringVertexCount + j);
+					meshData.Indices.push_back((i + 1) * ringVertexCount + j);
+					meshData.Indices.push_back((i + 1) * ringVertexCount + j + 1);
+
+					meshData.Indices.push_back(i * ringVertexCount + j);
+					meshData.Indices.push_back((i + 1) * ringVertexCount + j + 1);
+					meshData.Indices.push_back(i * ringVertexCount + j + 1);
+				}
+			}
+
+			BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+			BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+		}
+
+		template<typename V>
+		void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
+			UINT sliceCount, UINT stackCount, BasicMeshData<V>& meshData)
+		{
+			UINT baseIndex = (UINT)meshData.Vertices.size();
+
+			float y = 0.5f * height;
+			float dTheta = 2.0f * XM_PI / sliceCount;
+
+			// Duplicate cap ring vertices because the texture coordinates and normals differ.
+			for (UINT i = 0; i <= sliceCount; ++i)
+			{
+				float x = topRadius * cosf(i * dTheta);
+				float z = topRadius * sinf(i * dTheta);
+
+				// Scale down by the height to try and make top cap texture coord area
+				// proportional to base.
+				float u = x / height + 0.5f;
+				float v = z / height + 0.5f;
+
+				meshData.Vertices.push_back(MakeVertex<V>(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+			}
+
+			// Cap center vertex.
+			meshData.Vertices.push_back(MakeVertex<V>(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+
+			// Index of center vertex.
+			UINT centerIndex = (UINT)meshData.Vertices.size() - 1;
+
+			for (UINT i = 0; i < sliceCount; ++i)
+			{
+				meshData.Indices.push_back(centerIndex);
+				meshData.Indices.push_back(baseIndex + i + 1);
+				meshData.Indices.push_back(baseIndex + i);
+			}
+		}
+
+		template<typename V>
+		void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
+			UINT sliceCount, UINT stackCount, BasicMeshData<V>& meshData)
+		{
+			// 
+			// Build bottom cap.
+			//
+
+			UINT baseIndex = (UINT)meshData.Vertices.size();
+			float y = -0.5f * height;
+
+			// vertices of ring
+			float dTheta = 2.0f * XM_PI / sliceCount;
+			for (UINT i = 0; i <= sliceCount; ++i)
+			{
+				float x = bottomRadius * cosf(i * dTheta);
+				float z = bottomRadius * sinf(i * dTheta);
+
+				// Scale down by the height to try and make top cap texture coord area
+				// proportional to base.
+				float u = x / height + 0.5f;
+				float v = z / height + 0.5f;
+
+				meshData.Vertices.push_back(MakeVertex<V>(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+			}
+
+			// Cap center vertex.
+			meshData.Vertices.push_back(MakeVertex<V>(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+
+			// Cache the index of center vertex.
+			UINT centerIndex = (UINT)meshData.Vertices.size() - 1;
+
+			for (UINT i = 0; i < sliceCount; ++i)
+			{
+				meshData.Indices.push_back(centerIndex);
+				meshData.Indices.push_back(baseIndex + i);
+				meshData.Indices.push_back(baseIndex + i + 1);
+			}
+		}
+
+		template<typename V>
+		void GeometryGenerator::CreateGrid(float width, float depth, uint32_t m, uint32_t n, BasicMeshData<V>& meshData)
+		{
+			using Attributes = VertexAttributes<V>;
+
+			uint32_t vertexCount = m * n;
+
+			// Total number of triangles in grid
+			uint32_t faceCount = (m - 1) * (n - 1) * 2;
+
+			float halfWidth = 0.5f * width;
+			float halfDepth = 0.5f * depth;
+			float dx = width / (n - 1);
+			float dz = depth / (m - 1);
+			float du = 1.0f / (n - 1);
+			float dv = 1.0f / (m - 1);
+			meshData.Vertices.resize(vertexCount);
+			for (uint32_t i = 0; i < m; ++i)
+			{
+				float z = halfDepth - i * dz;
+				for (uint32_t j = 0; j < n; ++j)
+				{
+					V& v = meshData.Vertices[i * n + j];
+					float x = -halfWidth + j * dx;
+					Attributes::SetPosition(v, XMFLOAT3(x, 0.0f, z));
+					// Ignore for now, used for lighting.
+					if constexpr (Attributes::HasNormal)
+						Attributes::SetNormal(v, XMFLOAT3(0.0f, 1.0f, 0.0f));
+					if constexpr (Attributes::HasTangentU)
+						Attributes::SetTangentU(v, XMFLOAT3(1.0f, 0.0f, 0.0f));
+					// Ignore for now, used for texturing.
+					if constexpr (Attributes::HasTexC)
+						Attributes::SetTexC(v, XMFLOAT2(j * du, i * dv));
+				}
+			}
+
+			meshData.Indices.resize(faceCount * 3); // 3 indices per face
+
+			// Iterate over each quad and compute indices.
+			uint32_t k = 0;
+			for (uint32_t i = 0; i < m - 1; ++i)
+			{
+				for (uint32_t j = 0; j < n - 1; ++j)
+				{
+					meshData.Indices[k] = i * n + j;
+					meshData.Indices[k + 1] = i * n + j + 1;
+					meshData.Indices[k + 2] = (i + 1) * n + j;
+
+					meshData.Indices[k + 3] = (i + 1) * n + j;
+					meshData.Indices[k + 4] = i * n + j + 1;
+					meshData.Indices[k + 5] = (i + 1) * n + j + 1;
+
+					k += 6; // next quad
+				}
+			}
+		}
+
+		// Index data of one or more meshes, kept 16 bits wide while every index
+		// fits and widened to 32 bits once one doesn't.  Meshes merged into one
+		// buffer and drawn with a base vertex keep their own, local indices, so
+		// it is the largest of those that decides, not the merged vertex count.
+		class IndexBufferData {
+		public:
+			// Appends indices and returns where they start, the StartIndexLocation
+			// to draw them with.
+			UINT Append(const uint32_t* indices, size_t count);
+			UINT Append(const std::vector<uint32_t>& indices) { return Append(indices.data(), indices.size()); }
+
+			bool Is16Bit() const { return !wide_; }
+			UINT IndexCount() const { return (UINT)(wide_ ? indices32_.size() : indices16_.size()); }
+			UINT ByteWidth() const { return IndexCount() * (wide_ ? sizeof(uint32_t) : sizeof(uint16_t)); }
+			const void* Data() const;
+
+		private:
+			std::vector<uint16_t> indices16_;
+			std::vector<uint32_t> indices32_;
+			bool wide_ = false;
+		};
+
 		namespace light {
 			struct Material {
 				Material() { std::memset(this, 0, sizeof(*this)); }
@@ -0,0 +1,284 @@
+#include "lea_fft.hpp"
+
+#include "DirectXMath.h"
+
+#include "waves_kernels.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#if defined(LEA_WAVES_AVX2)
+#include <immintrin.h>
+#elif defined(_XM_SSE_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
+namespace {
+	using Complex = lea::Fft::Complex;
+
+	// std::complex multiplication checks for NaNs and infinities on some
+	// compilers; the plain formula is all a butterfly needs.
+	inline Complex Mul(Complex a, Complex b)
+	{
+		return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+	}
+
+	// The vector versions below work on interleaved (re, im) pairs and round
+	// exactly like the scalar code: x * w is (xr wr + -(xi wi), xi wr + xr wi).
+
+#if defined(_XM_SSE_INTRINSICS_)
+	// wRe = (wr, wr, ...), wIm = (-wi, wi, ...).
+	inline __m128 MulSSE(__m128 x, __m128 wRe, __m128 wIm)
+	{
+		__m128 swapped = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm_add_ps(_mm_mul_ps(x, wRe), _mm_mul_ps(swapped, wIm));
+	}
+#endif
+
+#if defined(LEA_WAVES_AVX2)
+	LEA_TARGET_AVX2 inline __m256 MulAVX2(__m256 x, __m256 wRe, __m256 wIm)
+	{
+		__m256 swapped = _mm256_permute_ps(x, _MM_SHUFFLE(2, 3, 0, 1));
+		return _mm256_add_ps(_mm256_mul_ps(x, wRe), _mm256_mul_ps(swapped, wIm));
+	}
+
+	// The AVX2 part of Butterfly4(), four sequences at a time.  Returns the
+	// first sequence it left for the narrower loops.
+	LEA_TARGET_AVX2 UINT Butterfly4AVX2(Complex* x0, Complex* x1, Complex* x2, Complex* x3, UINT count, Complex w1, Complex w2, float rotRe)
+	{
+		UINT c = 0;
+		const __m256 w1Re = _mm256_set1_ps(w1.real());
+		const __m256 w1Im = _mm256_setr_ps(-w1.imag(), w1.imag(), -w1.imag(), w1.imag(), -w1.imag(), w1.imag(), -w1.imag(), w1.imag());
+		const __m256 w2Re = _mm256_set1_ps(w2.real());
+		const __m256 w2Im = _mm256_setr_ps(-w2.imag(), w2.imag(), -w2.imag(), w2.imag(), -w2.imag(), w2.imag(), -w2.imag(), w2.imag());
+		const __m256 rot = _mm256_setr_ps(rotRe, -rotRe, rotRe, -rotRe, rotRe, -rotRe, rotRe, -rotRe);
+		for (; c + 4 <= count; c += 4)
+		{
+			__m256 a = _mm256_loadu_ps(reinterpret_cast<const float*>(x0 + c));
+			__m256 b = MulAVX2(_mm256_loadu_ps(reinterpret_cast<const float*>(x1 + c)), w2Re, w2Im);
+			__m256 d = _mm256_loadu_ps(reinterpret_cast<const float*>(x2 + c));
+			__m256 e = MulAVX2(_mm256_loadu_ps(reinterpret_cast<const float*>(x3 + c)), w2Re, w2Im);
+
+			__m256 y0 = _mm256_add_ps(a, b);
+			__m256 y1 = _mm256_sub_ps(a, b);
+			__m256 t2 = MulAVX2(_mm256_add_ps(d, e), w1Re, w1Im);
+			__m256 t3 = MulAVX2(_mm256_sub_ps(d, e), w1Re, w1Im);
+			t3 = _mm256_mul_ps(_mm256_permute_ps(t3, _MM_SHUFFLE(2, 3, 0, 1)), rot);
+
+			_mm256_storeu_ps(reinterpret_cast<float*>(x0 + c), _mm256_add_ps(y0, t2));
+			_mm256_storeu_ps(reinterpret_cast<float*>(x2 + c), _mm256_sub_ps(y0, t2));
+			_mm256_storeu_ps(reinterpret_cast<float*>(x1 + c), _mm256_add_ps(y1, t3));
+			_mm256_storeu_ps(reinterpret_cast<float*>(x3 + c), _mm256_sub_ps(y1, t3));
+		}
+		return c;
+	}
+
+	LEA_TARGET_AVX2 UINT Butterfly2AVX2(Complex* x0, Complex* x1, UINT count, Complex w)
+	{
+		UINT c = 0;
+		const __m256 wRe = _mm256_set1_ps(w.real());
+		const __m256 wIm = _mm256_setr_ps(-w.imag(), w.imag(), -w.imag(), w.imag(), -w.imag(), w.imag(), -w.imag(), w.imag());
+		for (; c + 4 <= count; c += 4)
+		{
+			__m256 a = _mm256_loadu_ps(reinterpret_cast<const float*>(x0 + c));
+			__m256 b = MulAVX2(_mm256_loadu_ps(reinterpret_cast<const float*>(x1 + c)), wRe, wIm);
+			_mm256_storeu_ps(reinterpret_cast<float*>(x0 + c), _mm256_add_ps(a, b));
+			_mm256_storeu_ps(reinterpret_cast<float*>(x1 + c), _mm256_sub_ps(a, b));
+		}
+		return c;
+	}
+#endif
+
+	// One radix-4 butterfly on `count` sequences side by side, see Fft::Run().
+	void Butterfly4(Complex* x0, Complex* x1, Complex* x2, Complex* x3, UINT count, Complex w1, Complex w2, bool inverse, bool avx2)
+	{
+		UINT c = 0;
+		// Multiplying by -i for the forward transform, +i for the inverse, is a
+		// swap of re and im and a sign change.
+		const float rotRe = inverse ? -1.0f : 1.0f;
+#if defined(LEA_WAVES_AVX2)
+		if (avx2)
+			c = Butterfly4AVX2(x0, x1, x2, x3, count, w1, w2, rotRe);
+#endif
+#if defined(_XM_SSE_INTRINSICS_)
+		{
+			const __m128 w1Re = _mm_set1_ps(w1.real());
+			const __m128 w1Im = _mm_setr_ps(-w1.imag(), w1.imag(), -w1.imag(), w1.imag());
+			const __m128 w2Re = _mm_set1_ps(w2.real());
+			const __m128 w2Im = _mm_setr_ps(-w2.imag(), w2.imag(), -w2.imag(), w2.imag());
+			const __m128 rot = _mm_setr_ps(rotRe, -rotRe, rotRe, -rotRe);
+			for (; c + 2 <= count; c += 2)
+			{
+				__m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(x0 + c));
+				__m128 b = MulSSE(_mm_loadu_ps(reinterpret_cast<const float*>(x1 + c)), w2Re, w2Im);
+				__m128 d = _mm_loadu_ps(reinterpret_cast<const float*>(x2 + c));
+				__m128 e = MulSSE(_mm_loadu_ps(reinterpret_cast<const float*>(x3 + c)), w2Re, w2Im);
+
+				__m128 y0 = _mm_add_ps(a, b);
+				__m128 y1 = _mm_sub_ps(a, b);
+				__m128 t2 = MulSSE(_mm_add_ps(d, e), w1Re, w1Im);
+				__m128 t3 = MulSSE(_mm_sub_ps(d, e), w1Re, w1Im);
+				t3 = _mm_mul_ps(_mm_shuffle_ps(t3, t3, _MM_SHUFFLE(2, 3, 0, 1)), rot);
+
+				_mm_storeu_ps(reinterpret_cast<float*>(x0 + c), _mm_add_ps(y0, t2));
+				_mm_storeu_ps(reinterpret_cast<float*>(x2 + c), _mm_sub_ps(y0, t2));
+				_mm_storeu_ps(reinterpret_cast<float*>(x1 + c), _mm_add_ps(y1, t3));
+				_mm_storeu_ps(reinterpret_cast<float*>(x3 + c), _mm_sub_ps(y1, t3));
+			}
+		}
+#endif
+		for (; c < count; ++c)
+		{
+			Complex a = x0[c];
+			Complex b = Mul(x1[c], w2);
+			Complex d = x2[c];
+			Complex e = Mul(x3[c], w2);
+
+			Complex y0 = a + b;
+			Complex y1 = a - b;
+			Complex t2 = Mul(d + e, w1);
+			Complex t3 = Mul(d - e, w1);
+			t3 = Complex(t3.imag() * rotRe, t3.real() * -rotRe);
+
+			x0[c] = y0 + t2;
+			x2[c] = y0 - t2;
+			x1[c] = y1 + t3;
+			x3[c] = y1 - t3;
+		}
+	}
+
+	void Butterfly2(Complex* x0, Complex* x1, UINT count, Complex w, bool avx2)
+	{
+		UINT c = 0;
+#if defined(LEA_WAVES_AVX2)
+		if (avx2)
+			c = Butterfly2AVX2(x0, x1, count, w);
+#endif
+#if defined(_XM_SSE_INTRINSICS_)
+		{
+			const __m128 wRe = _mm_set1_ps(w.real());
+			const __m128 wIm = _mm_setr_ps(-w.imag(), w.imag(), -w.imag(), w.imag());
+			for (; c + 2 <= count; c += 2)
+			{
+				__m128 a = _mm_loadu_ps(reinterpret_cast<const float*>(x0 + c));
+				__m128 b = MulSSE(_mm_loadu_ps(reinterpret_cast<const float*>(x1 + c)), wRe, wIm);
+				_mm_storeu_ps(reinterpret_cast<float*>(x0 + c), _mm_add_ps(a, b));
+				_mm_storeu_ps(reinterpret_cast<float*>(x1 + c), _mm_sub_ps(a, b));
+			}
+		}
+#endif
+		for (; c < count; ++c)
+		{
+			Complex a = x0[c];
+			Complex b = Mul(x1[c], w);
+			x0[c] = a + b;
+			x1[c] = a - b;
+		}
+	}
+}
+
+namespace lea {
+
+	Fft::Fft(UINT n)
+		: n_(n), avx2_(waves_kernels::HasAVX2())
+	{
+		if (n == 0 || (n & (n - 1)) != 0)
+			throw std::invalid_argument("Fft size must be a power of two");
+
+		UINT bits = 0;
+		while ((1u << bits) < n)
+			++bits;
+
+		bitReverse_.resize(n);
+		for (UINT k = 0; k < n; ++k)
+		{
+			UINT r = 0;
+			for (UINT b = 0; b < bits; ++b)
+				r |= ((k >> b) & 1u) << (bits - 1 - b);
+			bitReverse_[k] = r;
+		}
+
+		auto twiddle = [](UINT j, UINT size)
+			{
+				double angle = -2.0 * 3.14159265358979323846 * j / size;
+				return Complex(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+			};
+
+		UINT length = 1;
+		for (; 4 * length <= n; length *= 4)
+		{
+			for (UINT k = 0; k < length; ++k)
+			{
+				twiddles_.push_back(twiddle(k, 4 * length));
+				twiddles_.push_back(twiddle(2 * k, 4 * length));
+			}
+		}
+		if (length < n)
+		{
+			for (UINT k = 0; k < length; ++k)
+				twiddles_.push_back(twiddle(k, 2 * length));
+		}
+	}
+
+	void Fft::Transform(Complex* data, bool inverse) const
+	{
+		Run(data, 1, 1, inverse);
+	}
+
+	void Fft::TransformColumns(Complex* data, size_t pitch, UINT count, bool inverse) const
+	{
+		Run(data, pitch, count, inverse);
+	}
+
+	void Fft::Run(Complex* data, size_t pitch, UINT count, bool inverse) const
+	{
+		auto at = [data, pitch](UINT k) { return data + k * pitch; };
+		const Complex* twiddles = twiddles_.data();
+		auto twiddle = [inverse](Complex w) { return inverse ? std::conj(w) : w; };
+
+		// Decimation in time: bit-reversed input, natural order output.
+		for (UINT k = 0; k < n_; ++k)
+		{
+			UINT r = bitReverse_[k];
+			if (k < r)
+			{
+				Complex* a = at(k);
+				Complex* b = at(r);
+				for (UINT c = 0; c < count; ++c)
+					std::swap(a[c], b[c]);
+			}
+		}
+
+		// Each radix-4 pass merges four transforms of size `length` into one of
+		// size 4 * length.  It does the work of the two radix-2 stages
+		// length -> 2 * length -> 4 * length in a single sweep:
+		//
+		//   y0, y1 = x0 +- W2L^k x1     y2, y3 = x2 +- W2L^k x3
+		//   x0, x2 = y0 +- W4L^k y2     x1, x3 = y1 +- W4L^k (-+i) y3
+		//
+		// with W2L^k = W4L^2k and -i for the forward transform, +i for the inverse.
+		UINT length = 1;
+		for (; 4 * length <= n_; length *= 4)
+		{
+			for (UINT base = 0; base < n_; base += 4 * length)
+			{
+				for (UINT k = 0; k < length; ++k)
+				{
+					const Complex w1 = twiddle(twiddles[2 * k]);
+					const Complex w2 = twiddle(twiddles[2 * k + 1]);
+					Butterfly4(at(base + k), at(base + k + length), at(base + k + 2 * length), at(base + k + 3 * length),
+						count, w1, w2, inverse, avx2_);
+				}
+			}
+			twiddles += 2 * length;
+		}
+
+		// Odd number of stages: one radix-2 pass left.
+		if (length < n_)
+		{
+			for (UINT k = 0; k < length; ++k)
+				Butterfly2(at(k), at(k + length), count, twiddle(twiddles[k]), avx2_);
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cinttypes>
+#include <complex>
+#include <vector>
+
+using UINT = uint32_t;
+
+namespace lea {
+
+	// In-place complex FFT of a power-of-two size.  Pairs of radix-2 stages are
+	// fused into radix-4 passes (radix 2^2), so the data is streamed through
+	// half as often; an odd number of stages ends with one radix-2 pass.
+	// Transforms are unscaled: an inverse after a forward one multiplies by Size().
+	class Fft {
+	public:
+		using Complex = std::complex<float>;
+
+		// Throws std::invalid_argument unless n is a power of two.
+		explicit Fft(UINT n = 1);
+
+		UINT Size() const { return n_; }
+
+		// Transforms Size() consecutive values.  The forward transform uses
+		// e^(-2 pi i j k / n), the inverse one e^(+2 pi i j k / n).
+		void Transform(Complex* data, bool inverse) const;
+
+		// Transforms `count` sequences stored side by side, element k of sequence c
+		// at data[k * pitch + c], e.g. a block of columns of a row-major grid.  The
+		// butterflies run over the whole block at once, so every access is a
+		// contiguous run of count values, which the SSE and AVX2 paths process
+		// two or four at a time; AVX2 when the CPU has it.  Blocks of 4 to 16 sequences keep the working set
+		// in cache.
+		void TransformColumns(Complex* data, size_t pitch, UINT count, bool inverse) const;
+
+	private:
+		void Run(Complex* data, size_t pitch, UINT count, bool inverse) const;
+
+		UINT n_;
+		// Whether the butterflies take the AVX2 path, see waves_kernels::HasAVX2().
+		bool avx2_;
+		std::vector<UINT> bitReverse_;
+		// Forward twiddles in the order the passes read them: for each radix-4
+		// pass the pairs (W4L^k, W4L^2k) for k in [0, length), then W2L^k for a
+		// final radix-2 pass.
+		std::vector<Complex> twiddles_;
+	};
+}
@@ -0,0 +1,122 @@
+#include "lea_large_pages.hpp"
+
+#include <cstdint>
+#include <new>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+	// Precedes every allocation, so FreeLargePages() knows what to release.  It
+	// takes a whole cache line to keep the memory after it 64-byte aligned.
+	struct alignas(64) Header
+	{
+		void* base;
+		size_t length;
+	};
+
+	size_t RoundUp(size_t value, size_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+#if defined(_WIN32)
+	// Large pages need SeLockMemoryPrivilege enabled in the process token.  This
+	// only succeeds when an administrator granted the right to the user.
+	bool EnableLockMemoryPrivilege()
+	{
+		HANDLE token;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			return false;
+
+		TOKEN_PRIVILEGES privileges{};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		bool enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+			AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+			GetLastError() == ERROR_SUCCESS;
+		CloseHandle(token);
+		return enabled;
+	}
+
+	void* MapPages(size_t bytes, size_t& length)
+	{
+		static const bool largePages = GetLargePageMinimum() != 0 && EnableLockMemoryPrivilege();
+		if (largePages)
+		{
+			length = RoundUp(bytes, GetLargePageMinimum());
+			if (void* p = VirtualAlloc(nullptr, length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE))
+				return p;
+		}
+
+		length = bytes;
+		return VirtualAlloc(nullptr, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+
+	void UnmapPages(void* base, size_t)
+	{
+		VirtualFree(base, 0, MEM_RELEASE);
+	}
+#else
+	constexpr size_t HugePageBytes = size_t(2) << 20;
+
+	void* MapPages(size_t bytes, size_t& length)
+	{
+		length = RoundUp(bytes, HugePageBytes);
+		void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED)
+			return p;
+
+		// No hugetlbfs pages reserved: map one huge page more than needed, so the
+		// mapping can start on a huge page boundary, and ask for transparent huge
+		// pages.
+		p = mmap(nullptr, length + HugePageBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			return nullptr;
+
+		uintptr_t begin = reinterpret_cast<uintptr_t>(p);
+		uintptr_t aligned = RoundUp(begin, HugePageBytes);
+		if (aligned > begin)
+			munmap(p, aligned - begin);
+		munmap(reinterpret_cast<void*>(aligned + length), begin + HugePageBytes - aligned);
+
+		madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	void UnmapPages(void* base, size_t length)
+	{
+		munmap(base, length);
+	}
+#endif
+}
+
+namespace lea {
+
+	void* AllocateLargePages(size_t bytes)
+	{
+		size_t length;
+		void* base = MapPages(sizeof(Header) + bytes, length);
+		if (!base)
+			throw std::bad_alloc();
+
+		// Only the header's page gets touched here.
+		Header* header = static_cast<Header*>(base);
+		header->base = base;
+		header->length = length;
+		return header + 1;
+	}
+
+	void FreeLargePages(void* p)
+	{
+		if (!p)
+			return;
+
+		Header* header = static_cast<Header*>(p) - 1;
+		UnmapPages(header->base, header->length);
+	}
+}
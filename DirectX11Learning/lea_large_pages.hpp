@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+namespace lea {
+
+	// Allocates `bytes` of zeroed memory straight from the OS, on huge pages
+	// where the system grants them: Windows large pages (needs the "Lock pages
+	// in memory" right), Linux hugetlbfs pages or, failing that, transparent
+	// huge pages.  Otherwise it falls back to regular pages.  The result is
+	// aligned to at least 64 bytes.  Throws std::bad_alloc.
+	//
+	// Nothing is written to the memory, so on Linux and with regular pages on
+	// Windows each page is placed on the NUMA node of the thread that first
+	// touches it.  Windows large pages are committed right away instead.
+	void* AllocateLargePages(size_t bytes);
+	// Releases memory from AllocateLargePages().  Null is ignored.
+	void FreeLargePages(void* p);
+}
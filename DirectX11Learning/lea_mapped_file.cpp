@@ -0,0 +1,71 @@
+#include "lea_mapped_file.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lea {
+
+#if defined(_WIN32)
+	MappedFile::MappedFile(const char* path)
+	{
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error(std::string("MappedFile: can't open ") + path);
+
+		LARGE_INTEGER size;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		// The view keeps the mapping and the file alive.
+		if (mapping)
+		{
+			data_ = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+
+		if (!data_)
+			throw std::runtime_error(std::string("MappedFile: can't map ") + path);
+		size_ = static_cast<size_t>(size.QuadPart);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		UnmapViewOfFile(data_);
+	}
+#else
+	MappedFile::MappedFile(const char* path)
+	{
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			throw std::runtime_error(std::string("MappedFile: can't open ") + path);
+
+		struct stat status;
+		void* p = MAP_FAILED;
+		if (fstat(fd, &status) == 0 && status.st_size > 0)
+			p = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		// The mapping keeps the file alive.
+		close(fd);
+
+		if (p == MAP_FAILED)
+			throw std::runtime_error(std::string("MappedFile: can't map ") + path);
+		data_ = static_cast<uint8_t*>(p);
+		size_ = static_cast<size_t>(status.st_size);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		munmap(data_, size_);
+	}
+#endif
+}
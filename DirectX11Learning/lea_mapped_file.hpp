@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstddef>
+
+namespace lea {
+
+	// A whole file mapped copy-on-write.  The memory reads as the file and may be
+	// written, but writes land in private copies of the pages, made by the OS on
+	// the first write to each of them, and never reach the file.  Pages are only
+	// read from disk once touched.  The mapping starts on a page boundary.
+	class MappedFile {
+	public:
+		// Throws std::runtime_error if the file can't be opened or mapped.
+		explicit MappedFile(const char* path);
+		~MappedFile();
+
+		MappedFile(const MappedFile& other) = delete;
+		MappedFile& operator=(const MappedFile& other) = delete;
+
+		uint8_t* Data() const { return data_; }
+		size_t Size() const { return size_; }
+
+	private:
+		uint8_t* data_ = nullptr;
+		size_t size_ = 0;
+	};
+}
@@ -0,0 +1,164 @@
+#include "lea_mesh_optimizer.hpp"
+
+#include <cstdio>
+
+namespace lea {
+
+	MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		// A vertex is still in the FIFO if fewer than CacheSize misses happened
+		// since its own, so one timestamp per vertex simulates the whole cache.
+		std::vector<UINT> missedAt(vertexCount, 0);
+		UINT misses = CacheSize + 1;
+		UINT referenced = 0;
+
+		CacheStats stats;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			UINT& last = missedAt[indices[i]];
+			if (last == 0)
+				++referenced;
+			if (misses - last > CacheSize)
+			{
+				last = misses++;
+				++stats.Transforms;
+			}
+		}
+
+		if (indexCount >= 3)
+			stats.Acmr = float(stats.Transforms) / float(indexCount / 3);
+		if (referenced > 0)
+			stats.Atvr = float(stats.Transforms) / float(referenced);
+		return stats;
+	}
+
+	std::string MeshOptimizer::Describe(const Report& report)
+	{
+		char text[96];
+		std::snprintf(text, sizeof(text), "ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+			report.Before.Acmr, report.After.Acmr, report.Before.Atvr, report.After.Atvr);
+		return text;
+	}
+
+	void MeshOptimizer::OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		// Tipsify (Sander, Nehab, Barczak, "Fast triangle reordering for vertex
+		// locality and reduced overdraw").  It emits all remaining triangles
+		// around one vertex, a fan, then moves on to a vertex of that fan which
+		// will still be in the FIFO after its own remaining triangles are
+		// emitted, preferring the one that entered the cache first.  If none
+		// qualifies, it backtracks to the most recently emitted vertex with
+		// triangles left, and failing that takes the next one in input order.
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		const std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+
+		// Triangles around every vertex, adjacency[adjacencyOffset[v]] on, and how
+		// many of them haven't been emitted yet.
+		std::vector<UINT> liveTriangles(vertexCount, 0);
+		for (uint32_t v : source)
+			++liveTriangles[v];
+
+		std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+
+		std::vector<uint32_t> adjacency(source.size());
+		{
+			std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+			for (size_t i = 0; i < source.size(); ++i)
+				adjacency[fill[source[i]]++] = uint32_t(i / 3);
+		}
+
+		// Same timestamps as AnalyzeVertexCache: v is cached while
+		// time - missedAt[v] <= CacheSize.
+		std::vector<UINT> missedAt(vertexCount, 0);
+		UINT time = CacheSize + 1;
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> deadEnds;
+		deadEnds.reserve(source.size());
+		std::vector<uint32_t> candidates;
+		size_t cursor = 0;
+		size_t out = 0;
+
+		constexpr uint32_t None = ~0u;
+		uint32_t fan = source[0];
+		while (fan != None)
+		{
+			candidates.clear();
+			for (size_t a = adjacencyOffset[fan]; a < adjacencyOffset[fan + 1]; ++a)
+			{
+				uint32_t t = adjacency[a];
+				if (emitted[t])
+					continue;
+				emitted[t] = 1;
+
+				for (UINT k = 0; k < 3; ++k)
+				{
+					uint32_t v = source[t * 3 + k];
+					indices[out++] = v;
+					deadEnds.push_back(v);
+					candidates.push_back(v);
+					--liveTriangles[v];
+					if (time - missedAt[v] > CacheSize)
+						missedAt[v] = time++;
+				}
+			}
+
+			// Each of v's remaining triangles adds at most two vertices to the
+			// cache, so v only counts if it survives all of them.
+			fan = None;
+			int64_t bestAge = -1;
+			for (uint32_t v : candidates)
+			{
+				if (liveTriangles[v] == 0)
+					continue;
+				int64_t age = time - missedAt[v];
+				if (age + 2 * int64_t(liveTriangles[v]) > CacheSize)
+					age = 0;
+				if (age > bestAge)
+				{
+					bestAge = age;
+					fan = v;
+				}
+			}
+
+			while (fan == None && !deadEnds.empty())
+			{
+				uint32_t v = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[v] > 0)
+					fan = v;
+			}
+
+			if (fan == None)
+			{
+				while (cursor < vertexCount && liveTriangles[cursor] == 0)
+					++cursor;
+				if (cursor < vertexCount)
+					fan = uint32_t(cursor);
+			}
+		}
+	}
+
+	void MeshOptimizer::OptimizeVertexFetchRemap(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>& remap)
+	{
+		constexpr uint32_t Unused = ~0u;
+		std::vector<uint32_t> newIndex(vertexCount, Unused);
+
+		remap.clear();
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t& v = newIndex[indices[i]];
+			if (v == Unused)
+			{
+				v = uint32_t(remap.size());
+				remap.push_back(indices[i]);
+			}
+			indices[i] = v;
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#include "lea_thread_pool.hpp"
+
+#include <algorithm>
+
+namespace lea {
+
+	ThreadPool::ThreadPool(UINT threadCount)
+		: threadCount_(std::max(threadCount, 1u)), barrier_(std::max(threadCount, 1u))
+	{
+		workers_.reserve(threadCount_ - 1);
+		for (UINT i = 1; i < threadCount_; ++i)
+		{
+			workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			quit_ = true;
+		}
+		wake_.notify_all();
+
+		for (auto& worker : workers_)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::Run(const Task& task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			task_ = &task;
+			pending_ = threadCount_ - 1;
+			++generation_;
+		}
+		wake_.notify_all();
+
+		task(0, threadCount_);
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_.wait(lock, [this] { return pending_ == 0; });
+		task_ = nullptr;
+	}
+
+	void ThreadPool::Barrier()
+	{
+		barrier_.arrive_and_wait();
+	}
+
+	void ThreadPool::SplitRange(UINT begin, UINT end, UINT index, UINT count, UINT& bandBegin, UINT& bandEnd)
+	{
+		UINT size = end > begin ? end - begin : 0;
+		UINT base = size / count;
+		UINT extra = size % count;
+
+		// The first `extra` bands get one more element.
+		bandBegin = begin + index * base + std::min(index, extra);
+		bandEnd = bandBegin + base + (index < extra ? 1 : 0);
+	}
+
+	void ThreadPool::WorkerLoop(UINT index)
+	{
+		uint64_t seenGeneration = 0;
+		while (true)
+		{
+			const Task* task = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait(lock, [&] { return quit_ || generation_ != seenGeneration; });
+				if (quit_)
+					return;
+
+				seenGeneration = generation_;
+				task = task_;
+			}
+
+			(*task)(index, threadCount_);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				--pending_;
+			}
+			done_.notify_one();
+		}
+	}
+}
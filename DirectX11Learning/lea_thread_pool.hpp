@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cinttypes>
+#include <barrier>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using UINT = uint32_t;
+
+namespace lea {
+
+	// Fixed set of threads that all run the same task at once.  The thread calling
+	// Run() takes part as index 0, so a pool of N threads only spawns N - 1 workers.
+	// Since every participant is running at the same time, a task may synchronize
+	// with the others through Barrier().
+	class ThreadPool {
+	public:
+		using Task = std::function<void(UINT index, UINT count)>;
+
+		explicit ThreadPool(UINT threadCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool& other) = delete;
+		ThreadPool& operator=(const ThreadPool& other) = delete;
+
+		UINT ThreadCount() const { return threadCount_; }
+
+		// Runs task(index, ThreadCount()) on every thread and returns once all of them finished.
+		void Run(const Task& task);
+
+		// Blocks until every participant of the current Run() has reached the barrier.
+		void Barrier();
+
+		// Splits [begin, end) into count contiguous bands and returns the bounds of band `index`.
+		static void SplitRange(UINT begin, UINT end, UINT index, UINT count, UINT& bandBegin, UINT& bandEnd);
+
+	private:
+		void WorkerLoop(UINT index);
+
+		UINT threadCount_;
+		std::vector<std::thread> workers_;
+
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		std::condition_variable done_;
+		const Task* task_ = nullptr;
+		uint64_t generation_ = 0;
+		UINT pending_ = 0;
+		bool quit_ = false;
+
+		std::barrier<> barrier_;
+	};
+}
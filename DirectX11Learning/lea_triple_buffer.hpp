@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cinttypes>
+
+using UINT = uint32_t;
+
+namespace lea {
+
+	// Hands values from one producer thread to one consumer thread without either
+	// of them ever waiting.  Of the three buffers, the producer owns one to write
+	// the next value into, the consumer owns one to read, and the third holds the
+	// latest published value.  Publishing and acquiring swap the owned buffer with
+	// the latest one in a single atomic exchange.  Values the consumer didn't get
+	// to before the next Publish() are skipped.
+	template<typename T>
+	class TripleBuffer {
+	public:
+		TripleBuffer() = default;
+
+		TripleBuffer(const TripleBuffer& other) = delete;
+		TripleBuffer& operator=(const TripleBuffer& other) = delete;
+
+		// Sets all three buffers to value.  Neither thread may be using the buffer.
+		void Reset(const T& value)
+		{
+			buffers_.fill(value);
+			writeIndex_ = 0;
+			publishedIndex_ = 2;
+			readIndex_ = 1;
+			latest_.store(2, std::memory_order_relaxed);
+		}
+
+		// Producer side.  The buffer to write the next value into.  It holds whatever
+		// value was last published into it, not the latest one.
+		T& WriteBuffer() { return buffers_[writeIndex_]; }
+		// Which of the three buffers WriteBuffer() is, so the producer can keep
+		// track of what each of them holds.
+		UINT WriteIndex() const { return writeIndex_; }
+		// Makes WriteBuffer() the latest value and hands out another buffer to write.
+		void Publish()
+		{
+			publishedIndex_ = writeIndex_;
+			UINT previous = latest_.exchange(writeIndex_ | FreshBit, std::memory_order_acq_rel);
+			writeIndex_ = previous & IndexMask;
+		}
+		// The value published last.  The consumer may be reading it too, but nobody
+		// writes it before the producer publishes again, so the producer can read
+		// it, e.g. to bring WriteBuffer() up to date.
+		const T& PublishedBuffer() const { return buffers_[publishedIndex_]; }
+
+		// Consumer side.  Switches ReadBuffer() to the latest value if one was
+		// published since the last call, and returns whether it did.
+		bool Acquire()
+		{
+			if (!(latest_.load(std::memory_order_relaxed) & FreshBit))
+				return false;
+
+			UINT previous = latest_.exchange(readIndex_, std::memory_order_acq_rel);
+			readIndex_ = previous & IndexMask;
+			return true;
+		}
+		const T& ReadBuffer() const { return buffers_[readIndex_]; }
+
+	private:
+		static constexpr UINT IndexMask = 3;
+		// Set while the latest buffer wasn't acquired yet.
+		static constexpr UINT FreshBit = 4;
+
+		std::array<T, 3> buffers_;
+		UINT writeIndex_ = 0;
+		UINT publishedIndex_ = 2;
+		UINT readIndex_ = 1;
+		std::atomic<UINT> latest_ = 2;
+	};
+}
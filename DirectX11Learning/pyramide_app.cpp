@@ -45,7 +45,7 @@ namespace lea {
 		UINT offset = 0;
 		context->IASetVertexBuffers(0, 1, mVertexBuffer_.GetAddressOf(), &strides, &offset);
 
-		context->IASetIndexBuffer(mIndexBuffer_.Get(), DXGI_FORMAT_R32_UINT, 0);
+		context->IASetIndexBuffer(mIndexBuffer_.Get(), mIndexFormat_, 0);
 
 		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -142,7 +142,6 @@ namespace lea {
 		mBoxIndexCount = ARRAYSIZE(boxIndexes);
 
 		mBoxVertexOffset = ARRAYSIZE(pyramidVertexes);
-		mBoxIndexOffset = ARRAYSIZE(pyramidIndexes);
 
 		UINT allVertexCount = ARRAYSIZE(pyramidVertexes) + ARRAYSIZE(boxVertexes);
 		std::vector<Vertex1> allVertexes;
@@ -169,30 +168,11 @@ namespace lea {
 		
 		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&vertexBufferDesc, &vertexSubresourceDesc, mVertexBuffer_.GetAddressOf()));
 
-		std::vector<UINT> allIndexes;
-		
-		allIndexes.reserve(mPyramidIndexCount + mBoxIndexCount);
-
-		for (UINT i = 0; i < mPyramidIndexCount; ++i)
-		{
-			allIndexes.push_back(pyramidIndexes[i]);
-		}
-
-		for (UINT i = 0; i < mBoxIndexCount; ++i)
-		{
-			allIndexes.push_back(boxIndexes[i]);
-		}
-		
-		D3D11_BUFFER_DESC indexBufferDesc{};
-		indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-		indexBufferDesc.ByteWidth = sizeof(UINT) * allIndexes.size();
-		indexBufferDesc.CPUAccessFlags = 0;
-		indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-
-		D3D11_SUBRESOURCE_DATA indexSubresourceDesc{};
-		indexSubresourceDesc.pSysMem = allIndexes.data();
+		utils::IndexBufferData allIndexes;
+		mPyramidIndexOffset = allIndexes.Append(pyramidIndexes, mPyramidIndexCount);
+		mBoxIndexOffset = allIndexes.Append(boxIndexes, mBoxIndexCount);
 
-		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&indexBufferDesc, &indexSubresourceDesc, mIndexBuffer_.GetAddressOf()));
+		mIndexFormat_ = device_.CreateIndexBuffer(allIndexes, mIndexBuffer_.GetAddressOf());
 	}
 	
 	void PyramideApp::PollEvents()
@@ -26,6 +26,7 @@ namespace lea {
 
 		ComPtr<ID3D11Buffer> mVertexBuffer_;
 		ComPtr<ID3D11Buffer> mIndexBuffer_;
+		DXGI_FORMAT mIndexFormat_ = DXGI_FORMAT_R32_UINT;
 		ComPtr<ID3D11InputLayout> mInputLayout_;
 
 		std::vector<XMFLOAT4X4> mPyramideTransforms;
@@ -10,6 +10,7 @@
 
 #include "lea_timer.hpp"
 #include "lea_engine_utils.hpp"
+#include "lea_mesh_optimizer.hpp"
 
 #include "imgui_impl_dx11.h"
 #include "imgui_impl_sdl2.h"
@@ -116,7 +117,7 @@ namespace lea {
 		UINT stride = sizeof(Vertex3);
 		UINT offset = 0;
 		device_.Context()->IASetVertexBuffers(0, 1, vertexBuffer_.GetAddressOf(), &stride, &offset);
-		device_.Context()->IASetIndexBuffer(indexBuffer_.Get(), DXGI_FORMAT_R32_UINT, 0);
+		device_.Context()->IASetIndexBuffer(indexBuffer_.Get(), indexFormat_, 0);
 
 		XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * XM_PI,
 			window_.AspectRatio(), 1.0f, 1000.0f);
@@ -189,10 +190,10 @@ namespace lea {
 	void ShapesApp::CreateGeometryBuffers()
 	{
 		using namespace utils;
-		GeometryGenerator::MeshData box;
-		GeometryGenerator::MeshData grid;
-		GeometryGenerator::MeshData sphere;
-		GeometryGenerator::MeshData cylinder;
+		GeometryGenerator::BasicMeshData<Vertex3> box;
+		GeometryGenerator::BasicMeshData<Vertex3> grid;
+		GeometryGenerator::BasicMeshData<Vertex3> sphere;
+		GeometryGenerator::BasicMeshData<Vertex3> cylinder;
 
 		GeometryGenerator geoGen;
 		geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
@@ -203,6 +204,17 @@ namespace lea {
 
 		auto [skullVertices, skullIndexes] = ScanModel(L"Models/skull.txt");
 
+		// Reorder the meshes for the post-transform cache before they are packed.
+		auto optimize = [](const char* name, auto& vertices, auto& indices)
+			{
+				auto report = MeshOptimizer::Optimize(vertices, indices);
+				OutputDebugStringA((std::string(name) + ": " + MeshOptimizer::Describe(report) + "\n").c_str());
+			};
+		optimize("Grid", grid.Vertices, grid.Indices);
+		optimize("Sphere", sphere.Vertices, sphere.Indices);
+		optimize("Cylinder", cylinder.Vertices, cylinder.Indices);
+		optimize("Skull", skullVertices, skullIndexes);
+
 		// Cache the vertex offsets to each object in the concatenated vertex buffer.
 		mBoxVertexOffset = 0;
 		mGridVertexOffset = box.Vertices.size();
@@ -217,13 +229,6 @@ namespace lea {
 		mCylinderIndexCount = cylinder.Indices.size();
 		mSkullIndexCount = skullIndexes.size();
 
-		// Cache the starting index for each object in the concatenated index buffer.
-		mBoxIndexOffset = 0;
-		mGridIndexOffset = mBoxIndexCount;
-		mSphereIndexOffset = mGridIndexOffset + mGridIndexCount;
-		mCylinderIndexOffset = mSphereIndexOffset + mSphereIndexCount;
-		mSkullIndexOffset = mCylinderIndexOffset + mCylinderIndexCount;
-
 		UINT totalVertexCount =
 			box.Vertices.size() +
 			grid.Vertices.size() +
@@ -231,53 +236,18 @@ namespace lea {
 			cylinder.Vertices.size() +
 			skullVertices.size();
 
-		UINT totalIndexCount =
-			mBoxIndexCount +
-			mGridIndexCount +
-			mSphereIndexCount +
-			mCylinderIndexCount +
-			mSkullIndexCount;
-
 		//
-		// Extract the vertex elements we are interested in and pack the
-		// vertices of all the meshes into one vertex buffer.
+		// Pack the vertices of all the meshes into one vertex buffer.  The
+		// generators already wrote Vertex3, so this is a plain copy.
 		//
 
-		std::vector<Vertex3> vertices(totalVertexCount);
-
-		UINT k = 0;
-		for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-		{
-			vertices[k].pos = box.Vertices[i].Position;
-			vertices[k].norm = box.Vertices[i].Normal;
-			vertices[k].tex = box.Vertices[i].TexC;
-		}
-
-		for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-		{
-			vertices[k].pos = grid.Vertices[i].Position;
-			vertices[k].norm = grid.Vertices[i].Normal;
-			vertices[k].tex = grid.Vertices[i].TexC;
-		}
-
-		for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
-		{
-			vertices[k].pos = sphere.Vertices[i].Position;
-			vertices[k].norm = sphere.Vertices[i].Normal;
-			vertices[k].tex = sphere.Vertices[i].TexC;
-		}
-
-		for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
-		{
-			vertices[k].pos = cylinder.Vertices[i].Position;
-			vertices[k].norm = cylinder.Vertices[i].Normal;
-			vertices[k].tex = cylinder.Vertices[i].TexC;
-		}
-
-		for (size_t i = 0; i < skullVertices.size(); ++i, ++k)
-		{
-			vertices[k] = std::move(skullVertices[i]);
-		}
+		std::vector<Vertex3> vertices;
+		vertices.reserve(totalVertexCount);
+		vertices.insert(vertices.end(), box.Vertices.begin(), box.Vertices.end());
+		vertices.insert(vertices.end(), grid.Vertices.begin(), grid.Vertices.end());
+		vertices.insert(vertices.end(), sphere.Vertices.begin(), sphere.Vertices.end());
+		vertices.insert(vertices.end(), cylinder.Vertices.begin(), cylinder.Vertices.end());
+		vertices.insert(vertices.end(), skullVertices.begin(), skullVertices.end());
 
 		D3D11_BUFFER_DESC vbd{};
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -290,25 +260,20 @@ namespace lea {
 		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&vbd, &vinitData, vertexBuffer_.GetAddressOf()));
 
 		//
-		// Pack the indices of all the meshes into one index buffer.
+		// Pack the indices of all the meshes into one index buffer, caching the
+		// starting index of each object.  Every object is drawn with its vertex
+		// offset, so its indices stay local and the buffer stays 16-bit as long
+		// as no single object has more than 65535 vertices.
 		//
 
-		std::vector<UINT> indices;
-		indices.insert(indices.end(), box.Indices.begin(), box.Indices.end());
-		indices.insert(indices.end(), grid.Indices.begin(), grid.Indices.end());
-		indices.insert(indices.end(), sphere.Indices.begin(), sphere.Indices.end());
-		indices.insert(indices.end(), cylinder.Indices.begin(), cylinder.Indices.end());
-		indices.insert(indices.end(), skullIndexes.begin(), skullIndexes.end());
-
-		D3D11_BUFFER_DESC ibd{};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;
-		ibd.ByteWidth = sizeof(UINT) * totalIndexCount;
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		ibd.CPUAccessFlags = 0;
-		ibd.MiscFlags = 0;
-		D3D11_SUBRESOURCE_DATA iinitData{};
-		iinitData.pSysMem = indices.data();
-		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&ibd, &iinitData, indexBuffer_.GetAddressOf()));
+		IndexBufferData indices;
+		mBoxIndexOffset = indices.Append(box.Indices);
+		mGridIndexOffset = indices.Append(grid.Indices);
+		mSphereIndexOffset = indices.Append(sphere.Indices);
+		mCylinderIndexOffset = indices.Append(cylinder.Indices);
+		mSkullIndexOffset = indices.Append(skullIndexes);
+
+		indexFormat_ = device_.CreateIndexBuffer(indices, indexBuffer_.GetAddressOf());
 	}
 
 	void ShapesApp::CreateInputLayout()
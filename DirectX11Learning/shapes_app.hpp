@@ -28,6 +28,7 @@ namespace lea{
 
 		ComPtr<ID3D11Buffer> vertexBuffer_;
 		ComPtr<ID3D11Buffer> indexBuffer_;
+		DXGI_FORMAT indexFormat_ = DXGI_FORMAT_R32_UINT;
 		ComPtr<ID3D11InputLayout> inputLayout_;
 
 		// Define transformations from local spaces to world space.
@@ -8,6 +8,7 @@
 
 #include "DXHelper.hpp"
 #include "lea_engine_utils.hpp"
+#include "lea_mesh_optimizer.hpp"
 
 using namespace DirectX;
 using lea::utils::Vertex1;
@@ -41,7 +42,7 @@ namespace lea {
 		UINT offset = 0;
 		context->IASetVertexBuffers(0, 1, vertexBuffer_.GetAddressOf(), &strides, &offset);
 
-		context->IASetIndexBuffer(indexBuffer_.Get(), DXGI_FORMAT_R32_UINT, 0);
+		context->IASetIndexBuffer(indexBuffer_.Get(), indexFormat_, 0);
 
 		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
@@ -161,6 +162,9 @@ namespace lea {
 
 		fin.close();
 
+		auto report = MeshOptimizer::Optimize(vertices, indices);
+		OutputDebugStringA(("Skull: " + MeshOptimizer::Describe(report) + "\n").c_str());
+
 		D3D11_BUFFER_DESC vbd{};
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;
 		vbd.ByteWidth = sizeof(Vertex1) * vcount;
@@ -175,15 +179,9 @@ namespace lea {
 		// Pack the indices of all the meshes into one index buffer.
 		//
 
-		D3D11_BUFFER_DESC ibd{};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;
-		ibd.ByteWidth = sizeof(UINT) * mSkullIndexCount;
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		ibd.CPUAccessFlags = 0;
-		ibd.MiscFlags = 0;
-		D3D11_SUBRESOURCE_DATA iinitData{};
-		iinitData.pSysMem = indices.data();
-		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&ibd, &iinitData, indexBuffer_.GetAddressOf()));
+		utils::IndexBufferData indexData;
+		indexData.Append(indices);
+		indexFormat_ = device_.CreateIndexBuffer(indexData, indexBuffer_.GetAddressOf());
 	}
 	void SkullApp::CreateInputLayout()
 	{
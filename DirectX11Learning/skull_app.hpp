@@ -21,6 +21,7 @@ namespace lea {
 
 		ComPtr<ID3D11Buffer> vertexBuffer_;
 		ComPtr<ID3D11Buffer> indexBuffer_;
+		DXGI_FORMAT indexFormat_ = DXGI_FORMAT_R32_UINT;
 		ComPtr<ID3D11InputLayout> inputLayout_;
 
 		XMFLOAT4X4 mWorld;
@@ -0,0 +1,392 @@
+#include "spectral_ocean.hpp"
+
+#include "lea_thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+	constexpr float Gravity = 9.81f;
+	constexpr double Pi = 3.14159265358979323846;
+
+	// Phases are recomputed from the time every so many steps, so the rounding
+	// of the per-step rotations never builds up.
+	constexpr uint64_t ResyncSteps = 256;
+
+	// Columns, or rows, transformed together: 16 complex values are two cache
+	// lines per row.
+	constexpr UINT Block = 16;
+
+	// Directional wave number spectra, variance per unit area of (kx, kz).
+	// cosTheta is the cosine between k and the wind.
+
+	// Phillips: the k^-4 saturation range, Phillips' constant 0.0081, cut off
+	// below the peak at the wave length L = V^2 / g, and above it at L / 1000.
+	float PhillipsSpectrum(float k, float cosTheta, float windSpeed)
+	{
+		float L = windSpeed * windSpeed / Gravity;
+		float l = L / 1000.0f;
+		float kL = k * L;
+		float spreading = cosTheta * cosTheta / static_cast<float>(Pi);
+		return 0.5f * 0.0081f / (k * k * k * k) * spreading * std::exp(-1.0f / (kL * kL)) * std::exp(-(k * l) * (k * l));
+	}
+
+	// JONSWAP: the frequency spectrum of Hasselmann et al. for a fetch in meters,
+	// turned into a wave number one through omega^2 = g k, with cos^2 spreading
+	// over the half plane downwind.
+	float JonswapSpectrum(float k, float cosTheta, float windSpeed, float fetch)
+	{
+		if (cosTheta <= 0.0f)
+			return 0.0f;
+
+		float omega = std::sqrt(Gravity * k);
+		float alpha = 0.076f * std::pow(windSpeed * windSpeed / (fetch * Gravity), 0.22f);
+		float omegaPeak = 22.0f * std::pow(Gravity * Gravity / (windSpeed * fetch), 1.0f / 3.0f);
+		float sigma = omega <= omegaPeak ? 0.07f : 0.09f;
+		float r = std::exp(-(omega - omegaPeak) * (omega - omegaPeak) / (2.0f * sigma * sigma * omegaPeak * omegaPeak));
+		float ratio = omegaPeak / omega;
+		float s = alpha * Gravity * Gravity / std::pow(omega, 5.0f) * std::exp(-1.25f * ratio * ratio * ratio * ratio) * std::pow(3.3f, r);
+
+		float dOmegaDk = Gravity / (2.0f * omega);
+		float spreading = 2.0f / static_cast<float>(Pi) * cosTheta * cosTheta;
+		return s * dOmegaDk / k * spreading;
+	}
+}
+
+namespace lea {
+	SpectralOcean::SpectralOcean()
+		: mSpatialStep(0.0f), mHalfWidth(0.0f), mTimeStep(0.0f), mTimeAccum(0.0f), mStepCount(0), mPitch(0), mHalfPitch(0)
+	{
+	}
+
+	SpectralOcean::~SpectralOcean()
+	{
+	}
+
+	UINT SpectralOcean::RowCount()const
+	{
+		return mSize + 1;
+	}
+
+	UINT SpectralOcean::ColumnCount()const
+	{
+		return mSize + 1;
+	}
+
+	size_t SpectralOcean::VertexCount()const
+	{
+		return size_t(mSize + 1) * (mSize + 1);
+	}
+
+	size_t SpectralOcean::TriangleCount()const
+	{
+		return size_t(mSize) * mSize * 2;
+	}
+
+	float SpectralOcean::Width()const
+	{
+		return mSize * mSpatialStep;
+	}
+
+	float SpectralOcean::Depth()const
+	{
+		return mSize * mSpatialStep;
+	}
+
+	float SpectralOcean::TimeStep()const
+	{
+		return mTimeStep;
+	}
+
+	DirectX::XMFLOAT3 SpectralOcean::Normal(size_t i)const
+	{
+		UINT row = static_cast<UINT>(i / (mSize + 1));
+		UINT col = static_cast<UINT>(i - size_t(row) * (mSize + 1));
+		size_t k = Wrap(row, col);
+
+		// Rows run towards -z, so the slope along the rows flips sign.
+		float nx = -mSlopesX[k];
+		float nz = mSlopesZ[k];
+		float nLength = std::sqrt((nx * nx + 1.0f) + nz * nz);
+		return DirectX::XMFLOAT3(nx / nLength, 1.0f / nLength, nz / nLength);
+	}
+
+	DirectX::XMFLOAT3 SpectralOcean::TangentX(size_t i)const
+	{
+		UINT row = static_cast<UINT>(i / (mSize + 1));
+		UINT col = static_cast<UINT>(i - size_t(row) * (mSize + 1));
+		float slope = mSlopesX[Wrap(row, col)];
+		float tLength = std::sqrt(1.0f + slope * slope);
+		return DirectX::XMFLOAT3(1.0f / tLength, slope / tLength, 0.0f);
+	}
+
+	void SpectralOcean::Init(UINT n, float patchSize, float dt, float windSpeed, float windAngle,
+		ESpectrum spectrum, float amplitude, float fetch, uint32_t seed)
+	{
+		mFft = Fft(n);
+
+		mSize = n;
+		mSpatialStep = patchSize / n;
+		mHalfWidth = 0.5f * patchSize;
+		mTimeStep = dt;
+		mTimeAccum = 0.0f;
+		mStepCount = 0;
+
+		const size_t count = size_t(n) * n;
+		mH0.assign(count, Complex());
+		mH0MinusConj.assign(count, Complex());
+		mOmega.assign(count, 0.0f);
+		mPhase.assign(count, Complex(1.0f, 0.0f));
+		mRotation.assign(count, Complex(1.0f, 0.0f));
+		mPitch = n + Block / 2;
+		mHalfPitch = n / 2 + Block / 2;
+		mHeightSlopeX.assign(n * mPitch, Complex());
+		mSlopeZ.assign(n * mHalfPitch, Complex());
+		mHeights.assign(count, 0.0f);
+		mSlopesX.assign(count, 0.0f);
+		mSlopesZ.assign(count, 0.0f);
+
+		// Rows of the FFT grid run towards -z, so in grid coordinates the wind's
+		// z component flips.
+		const float windX = std::cos(windAngle);
+		const float windZ = -std::sin(windAngle);
+		const float dk = static_cast<float>(2.0 * Pi / patchSize);
+
+		std::mt19937 random(seed);
+		std::normal_distribution<float> gaussian;
+
+		for (UINT i = 0; i < n; ++i)
+		{
+			for (UINT j = 0; j < n; ++j)
+			{
+				// Draw for every k, so the sea only depends on the seed and n.
+				float xiRe = gaussian(random);
+				float xiIm = gaussian(random);
+
+				// Wave numbers run over [-n / 2, n / 2).  The Nyquist row and column
+				// stay empty: their slopes would have no conjugate partner, and the
+				// fields would pick up an imaginary part.
+				int si = i < n / 2 ? int(i) : int(i) - int(n);
+				int sj = j < n / 2 ? int(j) : int(j) - int(n);
+				if ((si == 0 && sj == 0) || i == n / 2 || j == n / 2)
+					continue;
+
+				float kx = sj * dk;
+				float kz = si * dk;
+				float k = std::sqrt(kx * kx + kz * kz);
+				float cosTheta = (kx * windX + kz * windZ) / k;
+				float p = spectrum == ESpectrum::JONSWAP ?
+					JonswapSpectrum(k, cosTheta, windSpeed, fetch) : PhillipsSpectrum(k, cosTheta, windSpeed);
+
+				// E|h0|^2 = p dk^2 / 2, since k and -k both contribute to the
+				// variance of the real field.
+				float scale = 0.5f * amplitude * std::sqrt(p) * dk;
+				size_t idx = size_t(i) * n + j;
+				mH0[idx] = Complex(xiRe * scale, xiIm * scale);
+				mOmega[idx] = std::sqrt(Gravity * k);
+				mRotation[idx] = std::polar(1.0f, mOmega[idx] * dt);
+			}
+		}
+
+		for (UINT i = 0; i < n; ++i)
+			for (UINT j = 0; j < n; ++j)
+				mH0MinusConj[size_t(i) * n + j] = std::conj(mH0[size_t((n - i) & (n - 1)) * n + ((n - j) & (n - 1))]);
+
+		Evaluate(true);
+	}
+
+	void SpectralOcean::Update(float dt)
+	{
+		// Accumulate time.
+		mTimeAccum += dt;
+
+		// An evaluation costs the same for any number of steps, so run every
+		// whole step that has accumulated at once and keep the remainder.
+		if (mTimeAccum >= mTimeStep)
+		{
+			UINT steps = static_cast<UINT>(mTimeAccum / mTimeStep);
+			mTimeAccum -= steps * mTimeStep;
+			Advance(steps);
+		}
+	}
+
+	void SpectralOcean::Advance(UINT steps)
+	{
+		if (steps == 0)
+			return;
+
+		uint64_t previous = mStepCount;
+		mStepCount += steps;
+		Evaluate(steps != 1 || mStepCount / ResyncSteps != previous / ResyncSteps);
+	}
+
+	void SpectralOcean::Evaluate(bool resync)
+	{
+		const UINT n = mSize;
+		const UINT half = n / 2;
+		const size_t pitch = mPitch;
+		const size_t halfPitch = mHalfPitch;
+		const float dk = static_cast<float>(2.0 * Pi) / (n * mSpatialStep);
+		const double time = double(mStepCount) * mTimeStep;
+		const UINT blockCount = (n + Block - 1) / Block;
+		const UINT halfBlockCount = (half + Block - 1) / Block;
+
+		if (mScratch.size() < ThreadCount())
+			mScratch.resize(ThreadCount());
+
+		auto task = [this, n, half, pitch, halfPitch, dk, time, resync, blockCount, halfBlockCount](UINT index, UINT count)
+			{
+				UINT blockBegin, blockEnd;
+				ThreadPool::SplitRange(0, blockCount, index, count, blockBegin, blockEnd);
+
+				// Spectrum and FFT along z, a block of columns at a time.
+				for (UINT block = blockBegin; block < blockEnd; ++block)
+				{
+					const UINT colBegin = block * Block;
+					const UINT colEnd = std::min(colBegin + Block, n);
+
+					// h(k, t) = h0(k) e^(i omega t) + conj(h0(-k)) e^(-i omega t), and
+					// the slopes i kx h and i kz h.
+					for (UINT i = 0; i < n; ++i)
+					{
+						int si = i < n / 2 ? int(i) : int(i) - int(n);
+						float kz = si * dk;
+						for (UINT j = colBegin; j < colEnd; ++j)
+						{
+							size_t idx = size_t(i) * n + j;
+
+							Complex p = mPhase[idx];
+							if (resync)
+							{
+								double angle = std::fmod(double(mOmega[idx]) * time, 2.0 * Pi);
+								p = Complex(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+							}
+							else
+							{
+								Complex r = mRotation[idx];
+								p = Complex(p.real() * r.real() - p.imag() * r.imag(), p.real() * r.imag() + p.imag() * r.real());
+							}
+							mPhase[idx] = p;
+
+							Complex a = mH0[idx];
+							Complex b = mH0MinusConj[idx];
+							// a p + b conj(p)
+							float hRe = (a.real() + b.real()) * p.real() - (a.imag() - b.imag()) * p.imag();
+							float hIm = (a.imag() + b.imag()) * p.real() + (a.real() - b.real()) * p.imag();
+
+							int sj = j < n / 2 ? int(j) : int(j) - int(n);
+							float kx = sj * dk;
+							// h + i (i kx h) packs height and x slope into one transform.
+							mHeightSlopeX[i * pitch + j] = Complex(hRe * (1.0f - kx), hIm * (1.0f - kx));
+							if (j < half)
+								mSlopeZ[i * halfPitch + j] = Complex(-kz * hIm, kz * hRe);
+						}
+					}
+
+					mFft.TransformColumns(mHeightSlopeX.data() + colBegin, pitch, colEnd - colBegin, true);
+				}
+
+				// Slope z has no partner field, but it is real: after the FFT along z,
+				// column -kx is the conjugate of column kx, so only the columns left
+				// of the Nyquist one are transformed.  They are shared out on their
+				// own, so every thread gets its part of them.
+				if (mThreadPool)
+					mThreadPool->Barrier();
+
+				UINT halfBlockBegin, halfBlockEnd;
+				ThreadPool::SplitRange(0, halfBlockCount, index, count, halfBlockBegin, halfBlockEnd);
+				for (UINT block = halfBlockBegin; block < halfBlockEnd; ++block)
+				{
+					const UINT colBegin = block * Block;
+					mFft.TransformColumns(mSlopeZ.data() + colBegin, halfPitch, std::min(colBegin + Block, half) - colBegin, true);
+				}
+
+				// The FFT along x reads every column.
+				if (mThreadPool)
+					mThreadPool->Barrier();
+
+				// FFT along x, a block of rows at a time: the rows are copied into
+				// columns of the scratch block, transformed there, and unpacked
+				// into the fields while still in cache.  The rows of slope z go
+				// back to their full length and then in pairs, one as the real and
+				// one as the imaginary part, like height and slope x: every row
+				// transforms to a real one.
+				std::vector<Complex>& scratch = mScratch[index];
+				scratch.resize(size_t(n) * (Block + (Block + 1) / 2));
+				Complex* heightSlopeX = scratch.data();
+				Complex* slopeZ = scratch.data() + size_t(n) * Block;
+
+				for (UINT block = blockBegin; block < blockEnd; ++block)
+				{
+					const UINT rowBegin = block * Block;
+					const UINT rows = std::min(rowBegin + Block, n) - rowBegin;
+					const UINT pairs = (rows + 1) / 2;
+
+					for (UINT r = 0; r < rows; ++r)
+					{
+						const Complex* a = mHeightSlopeX.data() + (rowBegin + r) * pitch;
+						for (UINT k = 0; k < n; ++k)
+							heightSlopeX[size_t(k) * rows + r] = a[k];
+					}
+
+					// Rows r and r + 1 of slope z as a + i b, with a(-k) = conj(a(k)).
+					// rows is even unless n is 1, and then there is nothing to read.
+					for (UINT r = 0; r < rows; r += 2)
+					{
+						const Complex* a = mSlopeZ.data() + (rowBegin + r) * halfPitch;
+						const Complex* b = a + halfPitch;
+						Complex* pair = slopeZ + r / 2;
+						if (half > 0)
+							pair[0] = Complex(a[0].real() - b[0].imag(), a[0].imag() + b[0].real());
+						for (UINT k = 1; k < half; ++k)
+						{
+							pair[size_t(k) * pairs] = Complex(a[k].real() - b[k].imag(), a[k].imag() + b[k].real());
+							pair[size_t(n - k) * pairs] = Complex(a[k].real() + b[k].imag(), b[k].real() - a[k].imag());
+						}
+						pair[size_t(half) * pairs] = Complex();
+					}
+
+					mFft.TransformColumns(heightSlopeX, rows, rows, true);
+					mFft.TransformColumns(slopeZ, pairs, pairs, true);
+
+					for (UINT r = 0; r < rows; ++r)
+					{
+						size_t rowStart = size_t(rowBegin + r) * n;
+						for (UINT j = 0; j < n; ++j)
+						{
+							mHeights[rowStart + j] = heightSlopeX[size_t(j) * rows + r].real();
+							mSlopesX[rowStart + j] = heightSlopeX[size_t(j) * rows + r].imag();
+						}
+					}
+
+					// Even rows are the real parts of the pairs, odd rows the imaginary ones.
+					for (UINT r = 0; r < rows; ++r)
+					{
+						size_t rowStart = size_t(rowBegin + r) * n;
+						const float* pair = reinterpret_cast<const float*>(slopeZ + r / 2) + r % 2;
+						for (UINT j = 0; j < n; ++j)
+							mSlopesZ[rowStart + j] = pair[size_t(j) * pairs * 2];
+					}
+				}
+			};
+
+		if (mThreadPool)
+			mThreadPool->Run(task);
+		else
+			task(0, 1);
+	}
+
+	void SpectralOcean::SetThreadCount(UINT threadCount)
+	{
+		if (threadCount <= 1)
+			mThreadPool.reset();
+		else if (!mThreadPool || mThreadPool->ThreadCount() != threadCount)
+			mThreadPool = std::make_unique<ThreadPool>(threadCount);
+	}
+
+	UINT SpectralOcean::ThreadCount()const
+	{
+		return mThreadPool ? mThreadPool->ThreadCount() : 1;
+	}
+}
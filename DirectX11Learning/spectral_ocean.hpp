@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cinttypes>
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "DirectXMath.h"
+
+#include "lea_fft.hpp"
+
+using UINT = uint32_t;
+
+namespace lea {
+	class ThreadPool;
+
+	// Open-ocean swell after Tessendorf, "Simulating Ocean Water": a random
+	// field of deep-water waves drawn from a wind spectrum, evaluated at any time
+	// with an inverse FFT instead of being integrated step by step.  The patch is
+	// periodic, so copies placed Width() apart tile without seams.
+	//
+	// The accessors mirror those of Waves, so code written against one reads the
+	// other.  The grid has n + 1 points per side whose last row and column repeat
+	// the first ones, which closes the tile.
+	class SpectralOcean
+	{
+	public:
+		enum class ESpectrum {
+			// Tessendorf's Phillips spectrum, fully developed sea.
+			Phillips,
+			// JONSWAP, a sea still growing over the fetch, with a sharper peak.
+			JONSWAP,
+		};
+
+		SpectralOcean();
+		~SpectralOcean();
+
+		UINT RowCount()const;
+		UINT ColumnCount()const;
+		size_t VertexCount()const;
+		size_t TriangleCount()const;
+		float Width()const;
+		float Depth()const;
+		// Seconds of simulated time per step.
+		float TimeStep()const;
+
+		// Returns the surface at the ith grid point.
+		DirectX::XMFLOAT3 operator[](size_t i)const
+		{
+			UINT row = static_cast<UINT>(i / (mSize + 1));
+			UINT col = static_cast<UINT>(i - size_t(row) * (mSize + 1));
+			return DirectX::XMFLOAT3(-mHalfWidth + col * mSpatialStep, Height(row, col), mHalfWidth - row * mSpatialStep);
+		}
+
+		// Returns the height at grid row i, column j.
+		float Height(UINT i, UINT j)const
+		{
+			return mHeights[Wrap(i, j)];
+		}
+
+		// Returns the surface normal at the ith grid point, from the exact slopes
+		// of the spectrum rather than finite differences.
+		DirectX::XMFLOAT3 Normal(size_t i)const;
+
+		// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
+		DirectX::XMFLOAT3 TangentX(size_t i)const;
+
+		// n points per side of the periodic patch, a power of two, covering
+		// patchSize meters.  The wind blows at windSpeed m/s towards windAngle
+		// radians from +x (towards +z at pi / 2).  fetch, the distance in meters
+		// the wind has blown over, only shapes JONSWAP.  The spectra are in
+		// physical units and amplitude scales the heights on top.  The same seed
+		// gives the same sea.  Throws std::invalid_argument unless n is a power of two.
+		void Init(UINT n, float patchSize, float dt, float windSpeed, float windAngle,
+			ESpectrum spectrum = ESpectrum::Phillips, float amplitude = 1.0f, float fetch = 100000.0f, uint32_t seed = 1);
+		void Update(float dt);
+		// Advances the sea by exactly `steps` time steps.
+		void Advance(UINT steps);
+
+		// Spreads the evaluation over threadCount threads (the caller included):
+		// blocks of columns for the spectrum and the FFT along z, blocks of rows
+		// for the FFT along x.  Results are bit-identical at any thread count.
+		// 0 or 1 runs serially.
+		void SetThreadCount(UINT threadCount);
+		UINT ThreadCount()const;
+
+	private:
+		using Complex = Fft::Complex;
+
+		size_t Wrap(UINT i, UINT j)const
+		{
+			return size_t(i & (mSize - 1)) * mSize + (j & (mSize - 1));
+		}
+
+		// Rebuilds the fields for the time mStepCount * mTimeStep.  With resync the
+		// phases are recomputed from scratch, otherwise they are advanced by one step.
+		void Evaluate(bool resync);
+
+		// Points per side of the FFT grid.
+		UINT mSize = 0;
+		float mSpatialStep;
+		float mHalfWidth;
+		float mTimeStep;
+		float mTimeAccum;
+		uint64_t mStepCount;
+
+		// Amplitudes at t = 0 of wave vector k and the conjugate one of -k, and
+		// the angular frequency of k.
+		std::vector<Complex> mH0;
+		std::vector<Complex> mH0MinusConj;
+		std::vector<float> mOmega;
+		// e^(i omega t), advanced every step by the rotation e^(i omega dt).
+		std::vector<Complex> mPhase;
+		std::vector<Complex> mRotation;
+
+		// Height + i slope x, and slope z, in the frequency domain, then after the
+		// inverse FFT along z.  The fields are real, so two of them share one
+		// complex transform, and slope z only keeps the columns kx in [0, n / 2),
+		// the others are their conjugates.  Rows are mPitch and mHalfPitch apart,
+		// padded so the column transforms don't hit the same cache sets on every
+		// row.
+		size_t mPitch;
+		size_t mHalfPitch;
+		std::vector<Complex> mHeightSlopeX;
+		std::vector<Complex> mSlopeZ;
+		// Per thread, a block of rows turned into columns for the FFT along x.
+		std::vector<std::vector<Complex>> mScratch;
+
+		std::vector<float> mHeights;
+		std::vector<float> mSlopesX;
+		std::vector<float> mSlopesZ;
+
+		Fft mFft;
+		std::unique_ptr<ThreadPool> mThreadPool;
+	};
+}
@@ -8,6 +8,7 @@
 
 #include "lea_timer.hpp"
 #include "lea_engine_utils.hpp"
+#include "lea_mesh_optimizer.hpp"
 #include "DXHelper.hpp"
 using lea::utils::Vertex1;
 using namespace DirectX;
@@ -44,7 +45,7 @@ namespace lea {
 		UINT offset = 0;
 		ID3D11Buffer* const buffers[] = { vertexBuffer_.Get() };
 		device_.Context()->IASetVertexBuffers(0, 1, buffers, &stride, &offset);
-		device_.Context()->IASetIndexBuffer(indexBuffer_.Get(), DXGI_FORMAT_R32_UINT, 0);
+		device_.Context()->IASetIndexBuffer(indexBuffer_.Get(), indexFormat_, 0);
 
 		XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * PI,
 			window_.AspectRatio(), 1.0f, 1000.0f);
@@ -124,21 +125,20 @@ namespace lea {
 
 	void TerrainApp::CreateGeometryBuffers()
 	{
-		utils::GeometryGenerator::MeshData grid;
+		utils::GeometryGenerator::BasicMeshData<Vertex1> grid;
 
 		utils::GeometryGenerator geoGen;
 
 		geoGen.CreateGrid(160.f, 160.f, 50, 50, grid);
+		MeshOptimizer::Optimize(grid);
 
-		std::vector<Vertex1> vertices(grid.Vertices.size());
-		for (uint32_t i = 0; i < grid.Vertices.size(); ++i)
+		std::vector<Vertex1>& vertices = grid.Vertices;
+		for (uint32_t i = 0; i < vertices.size(); ++i)
 		{
-			XMFLOAT3 p = grid.Vertices[i].Position;
+			XMFLOAT3& p = vertices[i].pos;
 
 			p.y = GetHeight(p.x, p.z);
 
-			vertices[i].pos = p;
-
 			if (p.y < -10.0f)
 			{
 				// Sandy beach color.
@@ -178,16 +178,9 @@ namespace lea {
 		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&vertexBufferDesc, &vertexSubData, vertexBuffer_.GetAddressOf()));
 
 		mGridIndexCount = static_cast<uint32_t>(grid.Indices.size());
-		D3D11_BUFFER_DESC indexBufferDesc{};
-		indexBufferDesc.ByteWidth = sizeof(uint32_t) * mGridIndexCount;
-		indexBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-		indexBufferDesc.CPUAccessFlags = 0;
-		indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-
-		D3D11_SUBRESOURCE_DATA indexSubData{};
-		indexSubData.pSysMem = grid.Indices.data();
-
-		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&indexBufferDesc, &indexSubData, indexBuffer_.GetAddressOf()));
+		utils::IndexBufferData indices;
+		indices.Append(grid.Indices);
+		indexFormat_ = device_.CreateIndexBuffer(indices, indexBuffer_.GetAddressOf());
 	}
 
 	void TerrainApp::CreateInputLayout()
@@ -1,23 +1,164 @@
 #include "waves.hpp"
 
+#include "lea_large_pages.hpp"
+#include "lea_mapped_file.hpp"
+#include "lea_thread_pool.hpp"
+#include "waves_recording.hpp"
+
 #include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <string>
 
 using DWORD = int32_t;
 
+namespace {
+	constexpr size_t PlaneAlignment = 64;
+	constexpr UINT FloatsPerAlignment = PlaneAlignment / sizeof(float);
+
+	// The memory is not initialized, Waves::Init() clears it band by band.
+	void* AllocateAligned(size_t bytes, bool largePages)
+	{
+		if (largePages)
+			return lea::AllocateLargePages(bytes);
+
+		// aligned_alloc wants whole multiples of the alignment.  Height planes are
+		// whole rows and always are, the normal arrays may not be.
+		bytes = (bytes + PlaneAlignment - 1) / PlaneAlignment * PlaneAlignment;
+#if defined(_MSC_VER)
+		void* p = _aligned_malloc(bytes, PlaneAlignment);
+#else
+		void* p = std::aligned_alloc(PlaneAlignment, bytes);
+#endif
+		if (!p)
+			throw std::bad_alloc();
+		return p;
+	}
+
+	template<typename T>
+	T* AllocatePlane(size_t count, bool largePages)
+	{
+		return static_cast<T*>(AllocateAligned(count * sizeof(T), largePages));
+	}
+
+	// Elements between the starts of two consecutive rows of a height plane of
+	// n columns, so that every row starts on a PlaneAlignment boundary whatever
+	// the element size.
+	UINT PlaneRowPitch(UINT n, size_t elementSize)
+	{
+		const UINT perAlignment = static_cast<UINT>(PlaneAlignment / elementSize);
+		return (n + perAlignment - 1) / perAlignment * perAlignment;
+	}
+
+	int16_t Quantize(float h, float scale)
+	{
+		return static_cast<int16_t>(std::clamp(std::nearbyint(h / scale), -32768.0f, 32767.0f));
+	}
+
+	constexpr char SnapshotMagic[8] = { 'L', 'E', 'A', 'W', 'A', 'V', 'E', 'S' };
+	constexpr uint32_t SnapshotVersion = 3;
+
+	// Start of a snapshot file.  Every section begins at a multiple of
+	// PlaneAlignment from the start, so mapped height planes keep the alignment
+	// the kernels expect.  A mask offset of 0 means there is no obstacle mask.
+	struct SnapshotHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t storage;
+		UINT numRows;
+		UINT numCols;
+		UINT rowPitch;
+		float spatialStep;
+		float timeStep;
+		float k1;
+		float k2;
+		float k3;
+		float adiLaplacian;
+		float adiDamping;
+		float adiBeta;
+		float heightScale;
+		float timeAccum;
+		uint64_t prevOffset;
+		uint64_t currOffset;
+		uint64_t maskOffset;
+		uint64_t tilesOffset;
+		uint64_t disturbancesOffset;
+		uint64_t disturbanceCount;
+		// Ring origin and window position, see Waves::SetScrolling().
+		UINT rowOffset;
+		UINT colOffset;
+		int64_t windowRow;
+		int64_t windowCol;
+	};
+
+	uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + PlaneAlignment - 1) / PlaneAlignment * PlaneAlignment;
+	}
+
+	void FreePlane(void* p, bool largePages)
+	{
+		if (largePages)
+		{
+			lea::FreeLargePages(p);
+			return;
+		}
+
+#if defined(_MSC_VER)
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+}
+
 namespace lea {
 	Waves::Waves()
-		: mNumRows(0), mNumCols(0), mVertexCount(0), mTriangleCount(0),
-		mK1(0.0f), mK2(0.0f), mK3(0.0f), mTimeStep(0.0f), mSpatialStep(0.0f),
-		mPrevSolution(0), mCurrSolution(0), mNormals(0), mTangentX(0)
+		: mNumRows(0), mNumCols(0), mRowPitch(0), mVertexCount(0), mTriangleCount(0),
+		mK1(0.0f), mK2(0.0f), mK3(0.0f), mTimeStep(0.0f), mSpatialStep(0.0f), mTimeAccum(0.0f),
+		mHalfWidth(0.0f), mHalfDepth(0.0f),
+		mStencilRow(waves_kernels::BestStencilRow()), mNormalRow(waves_kernels::BestNormalRow()),
+		mStepsPerSweep(1), mBlockRows(0), mLazyNormals(false), mNormalsDirty(false),
+		mActiveTiles(false), mSleepThreshold(0.0f), mTileCountX(0), mTileCountZ(0),
+		mTrackDirtyRows(false), mDirtyTolerance(0.0f),
+		mSolver(ESolver::Explicit), mTridiagonalColumns(waves_kernels::BestTridiagonalColumns()),
+		mAdiLaplacian(0.0f), mAdiDamping(0.0f), mAdiBeta(0.0f), mAdiPitchT(0),
+		mSplatRow(waves_kernels::BestSplatRow()),
+		mStorage(EStorage::Float), mHeightScale(0.0f), mStencilRowInt16(waves_kernels::BestStencilRowInt16()),
+		mLargeGrid(false), mPlanesOnLargePages(false), mRecording(nullptr),
+		mScrolling(false), mRowOffset(0), mColOffset(0), mWindowRow(0), mWindowCol(0),
+		mAbsorbingWidth(0), mAbsorbingReflection(0.0f),
+		mPrevSolution(0), mCurrSolution(0), mPrevQuantized(0), mCurrQuantized(0), mNormals(0), mTangentX(0)
 	{
 	}
 
 	Waves::~Waves()
 	{
-		delete[] mPrevSolution;
-		delete[] mCurrSolution;
-		delete[] mNormals;
-		delete[] mTangentX;
+		FreePlanes();
+	}
+
+	void Waves::FreePlanes()
+	{
+		if (!mSnapshot)
+		{
+			FreePlane(mPrevSolution, mPlanesOnLargePages);
+			FreePlane(mCurrSolution, mPlanesOnLargePages);
+			FreePlane(mPrevQuantized, mPlanesOnLargePages);
+			FreePlane(mCurrQuantized, mPlanesOnLargePages);
+		}
+		mSnapshot.reset();
+		FreePlane(mNormals, mPlanesOnLargePages);
+		FreePlane(mTangentX, mPlanesOnLargePages);
+		mPrevSolution = mCurrSolution = nullptr;
+		mPrevQuantized = mCurrQuantized = nullptr;
+		mNormals = mTangentX = nullptr;
 	}
 
 	UINT Waves::RowCount()const
@@ -30,12 +171,12 @@ namespace lea {
 		return mNumCols;
 	}
 
-	UINT Waves::VertexCount()const
+	size_t Waves::VertexCount()const
 	{
 		return mVertexCount;
 	}
 
-	UINT Waves::TriangleCount()const
+	size_t Waves::TriangleCount()const
 	{
 		return mTriangleCount;
 	}
@@ -50,13 +191,19 @@ namespace lea {
 		return mNumRows * mSpatialStep;
 	}
 
+	float Waves::TimeStep()const
+	{
+		return mTimeStep;
+	}
+
 	void Waves::Init(UINT m, UINT n, float dx, float dt, float speed, float damping)
 	{
 		mNumRows = m;
 		mNumCols = n;
+		mRowPitch = PlaneRowPitch(n, mStorage == EStorage::Int16 ? sizeof(int16_t) : sizeof(float));
 
-		mVertexCount = m * n;
-		mTriangleCount = (m - 1) * (n - 1) * 2;
+		mVertexCount = size_t(m) * n;
+		mTriangleCount = size_t(m - 1) * (n - 1) * 2;
 
 		mTimeStep = dt;
 		mSpatialStep = dx;
@@ -67,117 +214,1919 @@ namespace lea {
 		mK2 = (4.0f - 8.0f * e) / d;
 		mK3 = (2.0f * e) / d;
 
-		// In case Init() called again.
-		delete[] mPrevSolution;
-		delete[] mCurrSolution;
-		delete[] mNormals;
-		delete[] mTangentX;
+		// The ADI step, divided through by 1 + a with a = damping * dt / 2.
+		float a = 0.5f * damping * dt;
+		mAdiLaplacian = e / (1.0f + a);
+		mAdiDamping = (2.0f * a) / (1.0f + a);
+		mAdiBeta = 0.25f * mAdiLaplacian;
 
-		mPrevSolution = new XMFLOAT3[m * n];
-		mCurrSolution = new XMFLOAT3[m * n];
-		mNormals = new XMFLOAT3[m * n];
-		mTangentX = new XMFLOAT3[m * n];
+		// In case Init() called again.
+		FreePlanes();
+		mPlanesOnLargePages = mLargeGrid;
 
-		// Generate grid vertices in system memory.
+		mHalfWidth = (n - 1) * dx * 0.5f;
+		mHalfDepth = (m - 1) * dx * 0.5f;
 
-		float halfWidth = (n - 1) * dx * 0.5f;
-		float halfDepth = (m - 1) * dx * 0.5f;
-		for (UINT i = 0; i < m; ++i)
+		const size_t planeSize = size_t(m) * mRowPitch;
+		if (mStorage == EStorage::Int16)
+		{
+			mPrevQuantized = AllocatePlane<int16_t>(planeSize, mLargeGrid);
+			mCurrQuantized = AllocatePlane<int16_t>(planeSize, mLargeGrid);
+		}
+		else
 		{
-			float z = halfDepth - i * dx;
-			for (UINT j = 0; j < n; ++j)
+			mPrevSolution = AllocatePlane<float>(planeSize, mLargeGrid);
+			mCurrSolution = AllocatePlane<float>(planeSize, mLargeGrid);
+			mNormals = AllocatePlane<XMFLOAT3>(mVertexCount, mLargeGrid);
+			mTangentX = AllocatePlane<XMFLOAT3>(mVertexCount, mLargeGrid);
+		}
+
+		// The height planes start out flat (zeroed); x and z of a grid point are
+		// derived from its index, see operator[].  Every thread clears the rows it
+		// steps, so the first touch of a fresh page comes from the thread using it.
+		auto clearRows = [this, m, n](UINT index, UINT count)
 			{
-				float x = -halfWidth + j * dx;
+				UINT rowBegin, rowEnd;
+				ThreadPool::SplitRange(1, m - 1, index, count, rowBegin, rowEnd);
+				// The border rows go with the bands next to them.
+				if (index == 0)
+					rowBegin = 0;
+				if (index + 1 == count)
+					rowEnd = m;
 
-				mPrevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-				mCurrSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-				mNormals[i * n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-				mTangentX[i * n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
-			}
-		}
+				const size_t pitchBegin = size_t(rowBegin) * mRowPitch;
+				const size_t pitchCount = size_t(rowEnd - rowBegin) * mRowPitch;
+				if (mCurrQuantized)
+				{
+					std::memset(mPrevQuantized + pitchBegin, 0, pitchCount * sizeof(int16_t));
+					std::memset(mCurrQuantized + pitchBegin, 0, pitchCount * sizeof(int16_t));
+					return;
+				}
+
+				std::memset(mPrevSolution + pitchBegin, 0, pitchCount * sizeof(float));
+				std::memset(mCurrSolution + pitchBegin, 0, pitchCount * sizeof(float));
+				for (size_t k = size_t(rowBegin) * n; k < size_t(rowEnd) * n; ++k)
+				{
+					mNormals[k] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+					mTangentX[k] = XMFLOAT3(1.0f, 0.0f, 0.0f);
+				}
+			};
+
+		if (mThreadPool)
+			mThreadPool->Run(clearRows);
+		else
+			clearRows(0, 1);
+
+		mNormalsDirty = false;
+		mTimeAccum = 0.0f;
+
+		mRowOffset = 0;
+		mColOffset = 0;
+		mWindowRow = 0;
+		mWindowCol = 0;
+
+		mTileCountX = (n + ActiveTileSize - 1) / ActiveTileSize;
+		mTileCountZ = (m + ActiveTileSize - 1) / ActiveTileSize;
+		// Flat water: every tile starts asleep.
+		mTileAwake.assign(mTileCountX * mTileCountZ, 0);
+		mTileUpdate.assign(mTileCountX * mTileCountZ, 0);
+		mTileNormalsDirty.assign(mTileCountX * mTileCountZ, 0);
+
+		mWet.clear();
+		BuildWetSpans();
+		BuildAbsorbingLayer();
+
+		mDisturbances.clear();
+
+		// Nothing was emitted yet.
+		mDirtyRows.assign((m + 63) / 64, ~uint64_t(0));
+		mRowDelta.assign(m, 0.0f);
+		mRowDrift.assign(m, 0.0f);
 	}
 
 	void Waves::Update(float dt)
 	{
-		static float t = 0;
+		if (mRecording)
+			mRecording->Record({ WavesRecording::EEvent::Update, 0, 0, { dt } });
 
 		// Accumulate time.
-		t += dt;
+		mTimeAccum += dt;
 
 		// Only update the simulation at the specified time step.
-		if (t >= mTimeStep)
+		if (mTimeAccum >= mTimeStep)
+		{
+			if (mStepsPerSweep > 1)
+			{
+				// Blocking only pays off when several steps run per call, so keep
+				// the remainder instead of dropping it.
+				UINT steps = static_cast<UINT>(mTimeAccum / mTimeStep);
+				mTimeAccum -= steps * mTimeStep;
+				AdvanceSteps(steps);
+				return;
+			}
+
+			ApplyDisturbances();
+			Step();
+
+			mTimeAccum = 0.0f; // reset time
+		}
+	}
+
+	void Waves::Advance(UINT steps)
+	{
+		if (mRecording)
+			mRecording->Record({ WavesRecording::EEvent::Advance, static_cast<int32_t>(steps), 0, {} });
+
+		AdvanceSteps(steps);
+	}
+
+	void Waves::AdvanceSteps(UINT steps)
+	{
+		ApplyDisturbances();
+
+		while (steps > 0)
+		{
+			UINT depth = mActiveTiles || mCurrQuantized || mScrolling || mSolver == ESolver::ADI ? 1 : std::min(steps, mStepsPerSweep);
+			if (depth > 1)
+				StepBlocked(depth);
+			else
+				Step();
+
+			steps -= depth;
+		}
+	}
+
+	void Waves::Step()
+	{
+		if (mCurrQuantized)
+		{
+			StepQuantized();
+			return;
+		}
+
+		if (mSolver == ESolver::ADI && !mScrolling)
+		{
+			StepImplicit();
+			return;
+		}
+
+		if (mActiveTiles && !mScrolling)
 		{
-			// Only update interior points; we use zero boundary conditions.
-			for (UINT i = 1; i < mNumRows - 1; ++i)
+			StepTiles();
+			return;
+		}
+
+		const bool withNormals = !mLazyNormals;
+
+		auto band = [this, withNormals](UINT index, UINT count)
+			{
+				UINT rowBegin, rowEnd;
+				ThreadPool::SplitRange(1, mNumRows - 1, index, count, rowBegin, rowEnd);
+
+				// Fused sweep: the normals of a row only need the new heights of the
+				// rows around it, so they trail one row behind the height front while
+				// those rows are still in cache.
+				for (UINT i = rowBegin; i < rowEnd; ++i)
+				{
+					UpdateHeights(i, i + 1);
+
+					if (withNormals && i > rowBegin + 1)
+						ComputeNormals(mPrevSolution, i - 1, i);
+				}
+
+				// The normals of the first and last row of a band read the new
+				// heights of the neighboring bands.
+				if (mThreadPool)
+					mThreadPool->Barrier();
+
+				if (withNormals)
+					ComputeBandEdgeNormals(mPrevSolution, rowBegin, rowEnd);
+			};
+
+		if (mThreadPool)
+			mThreadPool->Run(band);
+		else
+			band(0, 1);
+
+		// We just overwrote the previous buffer with the new data, so
+		// this data needs to become the current solution and the old
+		// current solution becomes the new previous solution.
+		std::swap(mPrevSolution, mCurrSolution);
+
+		mNormalsDirty = !withNormals;
+
+		CollectDirtyRows();
+	}
+
+	void Waves::StepQuantized()
+	{
+		auto band = [this](UINT index, UINT count)
 			{
-				for (UINT j = 1; j < mNumCols - 1; ++j)
+				UINT rowBegin, rowEnd;
+				ThreadPool::SplitRange(1, mNumRows - 1, index, count, rowBegin, rowEnd);
+
+				const UINT n = mNumCols;
+				for (UINT i = rowBegin; i < rowEnd; ++i)
 				{
-					// After this update we will be discarding the old previous
-					// buffer, so overwrite that buffer with the new update.
-					// Note how we can do this inplace (read/write to same element) 
-					// because we won't need prev_ij again and the assignment happens last.
+					int16_t* next = mPrevQuantized + size_t(PhysicalRow(i)) * mRowPitch;
+					const int16_t* curr = mCurrQuantized + size_t(PhysicalRow(i)) * mRowPitch;
+					const int16_t* up = mCurrQuantized + size_t(PhysicalRow(i - 1)) * mRowPitch;
+					const int16_t* down = mCurrQuantized + size_t(PhysicalRow(i + 1)) * mRowPitch;
+					ForEachWetSpan(i, 1, n - 1, [&](UINT spanBegin, UINT spanEnd)
+						{
+							ForEachRingSpan(spanBegin, spanEnd, [&](UINT b, UINT e)
+								{
+									mStencilRowInt16(next, curr, up, down, b, e, mK1, mK2, mK3);
+								},
+								[&](UINT c)
+								{
+									int16_t nextPoint[3] = { 0, next[c], 0 };
+									int16_t currPoint[3] = { curr[c == 0 ? n - 1 : c - 1], curr[c], curr[c + 1 == n ? 0 : c + 1] };
+									int16_t upPoint[3] = { 0, up[c], 0 };
+									int16_t downPoint[3] = { 0, down[c], 0 };
+									waves_kernels::StencilRowInt16Scalar(nextPoint, currPoint, upPoint, downPoint, 1, 2, mK1, mK2, mK3);
+									next[c] = nextPoint[1];
+								});
+						});
+					ForEachAbsorbingRun(i, 1, n - 1, [&](UINT b, UINT count, const float* factors, float scale)
+						{
+							waves_kernels::AbsorbRowInt16(next + b, curr + b, factors, scale, count);
+						});
+				}
+			};
+
+		if (mThreadPool)
+			mThreadPool->Run(band);
+		else
+			band(0, 1);
+
+		std::swap(mPrevQuantized, mCurrQuantized);
+	}
+
+	void Waves::StepImplicit()
+	{
+		// With w = u_next - 2 u + u_prev, the damped wave equation with the
+		// Laplacian L taken as L(u_next / 4 + u / 2 + u_prev / 4) becomes
+		//
+		//   (1 - beta L) w = k L u - c (u - u_prev)
+		//
+		// with k = mAdiLaplacian, c = mAdiDamping and beta = k / 4.  The left side
+		// is factored into (1 - beta Lx)(1 - beta Lz), so w takes one tridiagonal
+		// solve along every row and one along every column.
+		const UINT m = mNumRows;
+		const UINT n = mNumCols;
+		const bool withNormals = !mLazyNormals;
+
+		mAdiScratch.resize(ThreadCount());
+
+		auto step = [this, m, n, withNormals](UINT index, UINT count)
+			{
+				std::vector<float>& scratch = mAdiScratch[index];
+				scratch.resize(size_t(std::max(m, n)) * waves_kernels::TridiagonalMaxLanes);
 
-					// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
-					// Moreover, our +z axis goes "down"; this is just to 
-					// keep consistent with our row indices going down.
+				auto barrier = [this]()
+					{
+						if (mThreadPool)
+							mThreadPool->Barrier();
+					};
 
-					mPrevSolution[i * mNumCols + j].y =
-						mK1 * mPrevSolution[i * mNumCols + j].y +
-						mK2 * mCurrSolution[i * mNumCols + j].y +
-						mK3 * (mCurrSolution[(i + 1) * mNumCols + j].y +
-							mCurrSolution[(i - 1) * mNumCols + j].y +
-							mCurrSolution[i * mNumCols + j + 1].y +
-							mCurrSolution[i * mNumCols + j - 1].y);
+				// Threads take whole cache lines of columns.
+				auto solveColumns = [&](float* x, const float* mask, size_t pitch, UINT rows, UINT columns)
+					{
+						UINT blockBegin, blockEnd;
+						ThreadPool::SplitRange(0, (columns + FloatsPerAlignment - 1) / FloatsPerAlignment, index, count, blockBegin, blockEnd);
+						UINT begin = blockBegin * FloatsPerAlignment;
+						UINT end = std::min(blockEnd * FloatsPerAlignment, columns);
+						if (begin < end)
+							mTridiagonalColumns(x, mask, pitch, rows, begin, end, mAdiBeta, scratch.data());
+					};
+
+				UINT rowBegin, rowEnd;
+				ThreadPool::SplitRange(1, m - 1, index, count, rowBegin, rowEnd);
+
+				for (UINT i = rowBegin; i < rowEnd; ++i)
+				{
+					const float* curr = mCurrSolution + size_t(i) * mRowPitch;
+					const float* prev = mPrevSolution + size_t(i) * mRowPitch;
+					const float* up = curr - mRowPitch;
+					const float* down = curr + mRowPitch;
+					float* rhs = mAdiWork.data() + size_t(i) * mRowPitch;
+					ForEachWetSpan(i, 1, n - 1, [&](UINT spanBegin, UINT spanEnd)
+						{
+							for (UINT j = spanBegin; j < spanEnd; ++j)
+							{
+								float laplacian = ((up[j] + down[j]) + (curr[j - 1] + curr[j + 1])) - 4.0f * curr[j];
+								rhs[j] = mAdiLaplacian * laplacian - mAdiDamping * (curr[j] - prev[j]);
+							}
+						});
 				}
-			}
+				barrier();
+
+				// x sweep.  The rows are transposed first, so both sweeps solve along
+				// columns and neighboring systems sit in neighboring lanes.
+				UINT bandBegin, bandEnd;
+				ThreadPool::SplitRange(0, m, index, count, bandBegin, bandEnd);
+				waves_kernels::TransposeRows(mAdiWorkT.data(), mAdiPitchT, mAdiWork.data(), mRowPitch, bandBegin, bandEnd, n);
+				barrier();
+
+				solveColumns(mAdiWorkT.data(), mAdiMaskT.data(), mAdiPitchT, n, m);
+				barrier();
+
+				ThreadPool::SplitRange(0, n, index, count, bandBegin, bandEnd);
+				waves_kernels::TransposeRows(mAdiWork.data(), mRowPitch, mAdiWorkT.data(), mAdiPitchT, bandBegin, bandEnd, m);
+				barrier();
+
+				// z sweep, leaves w in mAdiWork.
+				solveColumns(mAdiWork.data(), mAdiMask.data(), mRowPitch, m, n);
+				barrier();
+
+				// u_next = w + 2 u - u_prev, in place of u_prev.  Normals trail one row
+				// behind like in Step().
+				for (UINT i = rowBegin; i < rowEnd; ++i)
+				{
+					float* next = mPrevSolution + size_t(i) * mRowPitch;
+					const float* curr = mCurrSolution + size_t(i) * mRowPitch;
+					const float* w = mAdiWork.data() + size_t(i) * mRowPitch;
+					ForEachWetSpan(i, 1, n - 1, [&](UINT spanBegin, UINT spanEnd)
+						{
+							for (UINT j = spanBegin; j < spanEnd; ++j)
+								next[j] = (w[j] + (curr[j] + curr[j])) - next[j];
+							if (mTrackDirtyRows)
+								mRowDelta[i] = std::max(mRowDelta[i], waves_kernels::MaxDeltaRow(next, curr, spanBegin, spanEnd));
+						});
+					ForEachAbsorbingRun(i, 1, n - 1, [&](UINT b, UINT count, const float* factors, float scale)
+						{
+							waves_kernels::AbsorbRow(next + b, curr + b, factors, scale, count);
+						});
+
+					if (withNormals && i > rowBegin + 1)
+						ComputeNormals(mPrevSolution, i - 1, i);
+				}
+				barrier();
+
+				if (withNormals)
+					ComputeBandEdgeNormals(mPrevSolution, rowBegin, rowEnd);
+			};
+
+		if (mThreadPool)
+			mThreadPool->Run(step);
+		else
+			step(0, 1);
+
+		std::swap(mPrevSolution, mCurrSolution);
+
+		mNormalsDirty = !withNormals;
+
+		CollectDirtyRows();
+	}
+
+	void Waves::BuildImplicitMasks()
+	{
+		const UINT m = mNumRows;
+		const UINT n = mNumCols;
 
-			// We just overwrote the previous buffer with the new data, so
-			// this data needs to become the current solution and the old
-			// current solution becomes the new previous solution.
-			std::swap(mPrevSolution, mCurrSolution);
+		mAdiPitchT = (m + FloatsPerAlignment - 1) / FloatsPerAlignment * FloatsPerAlignment;
+		mAdiMask.assign(size_t(m) * mRowPitch, 0.0f);
+		mAdiMaskT.assign(size_t(n) * mAdiPitchT, 0.0f);
+		mAdiWork.assign(size_t(m) * mRowPitch, 0.0f);
+		mAdiWorkT.assign(size_t(n) * mAdiPitchT, 0.0f);
 
-			t = 0.0f; // reset time
+		for (UINT i = 1; i + 1 < m; ++i)
+		{
+			ForEachWetSpan(i, 1, n - 1, [&](UINT spanBegin, UINT spanEnd)
+				{
+					for (UINT j = spanBegin; j < spanEnd; ++j)
+						mAdiMask[size_t(i) * mRowPitch + j] = mAdiMaskT[size_t(j) * mAdiPitchT + i] = 1.0f;
+				});
+		}
+	}
+
+	XMFLOAT3 Waves::SampleNormal(size_t i, bool tangent)const
+	{
+		UINT row = static_cast<UINT>(i / mNumCols);
+		UINT col = static_cast<UINT>(i - size_t(row) * mNumCols);
+		if (row == 0 || col == 0 || row + 1 >= mNumRows || col + 1 >= mNumCols || !IsWet(row, col))
+			return tangent ? XMFLOAT3(1.0f, 0.0f, 0.0f) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+
+		float l = Height(row, col - 1);
+		float r = Height(row, col + 1);
+		float t = Height(row - 1, col);
+		float b = Height(row + 1, col);
+		float twoDx = 2.0f * mSpatialStep;
+
+		if (tangent)
+		{
+			float ty = r - l;
+			float tLength = std::sqrt(twoDx * twoDx + ty * ty);
+			return XMFLOAT3(twoDx / tLength, ty / tLength, 0.0f);
+		}
+
+		float nx = l - r;
+		float nz = b - t;
+		float nLength = std::sqrt((nx * nx + twoDx * twoDx) + nz * nz);
+		return XMFLOAT3(nx / nLength, twoDx / nLength, nz / nLength);
+	}
+
+	void Waves::StepBlocked(UINT depth)
+	{
+		const UINT m = mNumRows;
+		const size_t rowBytes = size_t(mRowPitch) * sizeof(float);
+		UINT tileRows = mBlockRows;
+		if (tileRows == 0)
+		{
+			// Aim for both scratch planes of a tile, ghost rows included, to stay
+			// within a typical 1 MB L2.
+			constexpr size_t TileBytes = 1024 * 1024;
+			UINT rows = static_cast<UINT>(TileBytes / (2 * sizeof(float) * mRowPitch));
+			tileRows = rows > 2 * depth ? rows - 2 * depth : 0;
+		}
+		// The ghost rows of a tile must all come from the tile right above it.
+		tileRows = std::max(tileRows, depth);
 
-			//
-			// Compute normals using finite difference scheme.
-			//
-			for (UINT i = 1; i < mNumRows - 1; ++i)
+		mTemporalScratch.resize(ThreadCount());
+
+		const bool withNormals = !mLazyNormals;
+
+		auto band = [this, depth, m, rowBytes, tileRows, withNormals](UINT index, UINT count)
 			{
-				for (UINT j = 1; j < mNumCols - 1; ++j)
+				UINT bandBegin, bandEnd;
+				ThreadPool::SplitRange(1, m - 1, index, count, bandBegin, bandEnd);
+
+				TemporalScratch& scratch = mTemporalScratch[index];
+				scratch.prev.resize(size_t(tileRows + 2 * depth) * mRowPitch);
+				scratch.curr.resize(size_t(tileRows + 2 * depth) * mRowPitch);
+				scratch.above.resize(size_t(2 * depth) * mRowPitch);
+				scratch.below.resize(size_t(2 * depth) * mRowPitch);
+
+				float* abovePrev = scratch.above.data();
+				float* aboveCurr = abovePrev + size_t(depth) * mRowPitch;
+				float* belowPrev = scratch.below.data();
+				float* belowCurr = belowPrev + size_t(depth) * mRowPitch;
+
+				// Snapshot the ghost rows owned by the neighboring bands before anybody
+				// starts writing results back.
+				UINT aboveBegin = bandBegin > depth ? bandBegin - depth : 0;
+				std::memcpy(abovePrev, mPrevSolution + size_t(aboveBegin) * mRowPitch, (bandBegin - aboveBegin) * rowBytes);
+				std::memcpy(aboveCurr, mCurrSolution + size_t(aboveBegin) * mRowPitch, (bandBegin - aboveBegin) * rowBytes);
+
+				UINT belowEnd = std::min(bandEnd + depth, m);
+				std::memcpy(belowPrev, mPrevSolution + size_t(bandEnd) * mRowPitch, (belowEnd - bandEnd) * rowBytes);
+				std::memcpy(belowCurr, mCurrSolution + size_t(bandEnd) * mRowPitch, (belowEnd - bandEnd) * rowBytes);
+
+				if (mThreadPool)
+					mThreadPool->Barrier();
+
+				for (UINT r0 = bandBegin; r0 < bandEnd; r0 += tileRows)
 				{
-					float l = mCurrSolution[i * mNumCols + j - 1].y;
-					float r = mCurrSolution[i * mNumCols + j + 1].y;
-					float t = mCurrSolution[(i - 1) * mNumCols + j].y;
-					float b = mCurrSolution[(i + 1) * mNumCols + j].y;
-					mNormals[i * mNumCols + j].x = -r + l;
-					mNormals[i * mNumCols + j].y = 2.0f * mSpatialStep;
-					mNormals[i * mNumCols + j].z = b - t;
+					UINT r1 = std::min(r0 + tileRows, bandEnd);
+					UINT lo = r0 > depth ? r0 - depth : 0;
+					UINT hi = std::min(r1 + depth, m);
 
-					XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i * mNumCols + j]));
-					XMStoreFloat3(&mNormals[i * mNumCols + j], n);
+					float* sp = scratch.prev.data();
+					float* sc = scratch.curr.data();
 
-					mTangentX[i * mNumCols + j] = XMFLOAT3(2.0f * mSpatialStep, r - l, 0.0f);
-					XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i * mNumCols + j]));
-					XMStoreFloat3(&mTangentX[i * mNumCols + j], T);
+					// Rows above the tile were already advanced by the previous tile, so
+					// their original values come from the snapshot.  Rows below the band
+					// belong to another thread and come from the band snapshot.
+					for (UINT r = lo; r < hi; ++r)
+					{
+						const float* srcPrev;
+						const float* srcCurr;
+						if (r < r0)
+						{
+							srcPrev = abovePrev + size_t(r - aboveBegin) * mRowPitch;
+							srcCurr = aboveCurr + size_t(r - aboveBegin) * mRowPitch;
+						}
+						else if (r >= bandEnd)
+						{
+							srcPrev = belowPrev + size_t(r - bandEnd) * mRowPitch;
+							srcCurr = belowCurr + size_t(r - bandEnd) * mRowPitch;
+						}
+						else
+						{
+							srcPrev = mPrevSolution + size_t(r) * mRowPitch;
+							srcCurr = mCurrSolution + size_t(r) * mRowPitch;
+						}
+						std::memcpy(sp + size_t(r - lo) * mRowPitch, srcPrev, rowBytes);
+						std::memcpy(sc + size_t(r - lo) * mRowPitch, srcCurr, rowBytes);
+					}
+
+					// The last rows of this tile are the ghost rows of the next one.
+					if (r1 < bandEnd)
+					{
+						aboveBegin = r1 - depth;
+						std::memcpy(abovePrev, sp + size_t(aboveBegin - lo) * mRowPitch, depth * rowBytes);
+						std::memcpy(aboveCurr, sc + size_t(aboveBegin - lo) * mRowPitch, depth * rowBytes);
+					}
+
+					// Each substep the valid region shrinks by one row on both sides,
+					// except at the grid boundary which never changes.
+					for (UINT s = 1; s <= depth; ++s)
+					{
+						UINT rowBegin = lo == 0 ? 1 : lo + s;
+						UINT rowEnd = hi == m ? m - 1 : hi - s;
+						for (UINT r = rowBegin; r < rowEnd; ++r)
+						{
+							float* next = sp + size_t(r - lo) * mRowPitch;
+							const float* curr = sc + size_t(r - lo) * mRowPitch;
+							ForEachWetSpan(r, 1, mNumCols - 1, [&](UINT spanBegin, UINT spanEnd)
+								{
+									mStencilRow(next, curr, curr - mRowPitch, curr + mRowPitch, spanBegin, spanEnd, mK1, mK2, mK3);
+								});
+							ForEachAbsorbingRun(r, 1, mNumCols - 1, [&](UINT b, UINT count, const float* factors, float scale)
+								{
+									waves_kernels::AbsorbRow(next + b, curr + b, factors, scale, count);
+								});
+						}
+						std::swap(sp, sc);
+					}
+
+					if (mTrackDirtyRows)
+					{
+						for (UINT r = std::max(r0, 1u); r < std::min(r1, m - 1); ++r)
+						{
+							mRowDelta[r] = waves_kernels::MaxDeltaRow(sc + size_t(r - lo) * mRowPitch,
+								mCurrSolution + size_t(r) * mRowPitch, 1, mNumCols - 1);
+						}
+					}
+
+					std::memcpy(mPrevSolution + size_t(r0) * mRowPitch, sp + size_t(r0 - lo) * mRowPitch, (r1 - r0) * rowBytes);
+					std::memcpy(mCurrSolution + size_t(r0) * mRowPitch, sc + size_t(r0 - lo) * mRowPitch, (r1 - r0) * rowBytes);
+
+					// Normals trail one row behind the finished heights.  The first row
+					// of the band waits for the band above.
+					UINT normalsBegin = std::max(r0 - 1, bandBegin + 1);
+					if (withNormals && normalsBegin < r1 - 1)
+						ComputeNormals(mCurrSolution, normalsBegin, r1 - 1);
 				}
+
+				if (mThreadPool)
+					mThreadPool->Barrier();
+
+				if (withNormals)
+					ComputeBandEdgeNormals(mCurrSolution, bandBegin, bandEnd);
+			};
+
+		if (mThreadPool)
+			mThreadPool->Run(band);
+		else
+			band(0, 1);
+
+		mNormalsDirty = !withNormals;
+
+		CollectDirtyRows();
+	}
+
+	void Waves::StepTiles()
+	{
+		const UINT tilesX = mTileCountX;
+		const UINT tilesZ = mTileCountZ;
+		const bool withNormals = !mLazyNormals;
+
+		// Waves travel at most one cell per step, so a tile has to be stepped when
+		// it or any of its neighbors is awake.  Its normals also depend on the
+		// heights along the neighbors' edges, so they go one ring further out.
+		for (UINT tz = 0; tz < tilesZ; ++tz)
+		{
+			for (UINT tx = 0; tx < tilesX; ++tx)
+			{
+				uint8_t update = 0;
+				for (UINT z = tz > 0 ? tz - 1 : 0; z < std::min(tz + 2, tilesZ); ++z)
+					for (UINT x = tx > 0 ? tx - 1 : 0; x < std::min(tx + 2, tilesX); ++x)
+						update |= mTileAwake[z * tilesX + x];
+				mTileUpdate[tz * tilesX + tx] = update & mTileWet[tz * tilesX + tx];
 			}
 		}
+		for (UINT tz = 0; tz < tilesZ; ++tz)
+			for (UINT tx = 0; tx < tilesX; ++tx)
+				for (UINT z = tz > 0 ? tz - 1 : 0; z < std::min(tz + 2, tilesZ); ++z)
+					for (UINT x = tx > 0 ? tx - 1 : 0; x < std::min(tx + 2, tilesX); ++x)
+						mTileNormalsDirty[tz * tilesX + tx] |= mTileUpdate[z * tilesX + x];
+
+		auto band = [this, tilesX, tilesZ, withNormals](UINT index, UINT count)
+			{
+				UINT tzBegin, tzEnd;
+				ThreadPool::SplitRange(0, tilesZ, index, count, tzBegin, tzEnd);
+
+				for (UINT t = tzBegin * tilesX; t < tzEnd * tilesX; ++t)
+				{
+					if (!mTileUpdate[t])
+						continue;
+
+					UINT r0, r1, c0, c1;
+					TileBounds(t, r0, r1, c0, c1);
+
+					float activity = 0.0f;
+					for (UINT i = r0; i < r1; ++i)
+					{
+						float* next = mPrevSolution + size_t(i) * mRowPitch;
+						const float* curr = mCurrSolution + size_t(i) * mRowPitch;
+						ForEachWetSpan(i, c0, c1, [&](UINT spanBegin, UINT spanEnd)
+							{
+								mStencilRow(next, curr, curr - mRowPitch, curr + mRowPitch, spanBegin, spanEnd, mK1, mK2, mK3);
+								activity = std::max(activity, waves_kernels::ActivityRow(next, curr, spanBegin, spanEnd));
+								if (mTrackDirtyRows)
+									mRowDelta[i] = std::max(mRowDelta[i], waves_kernels::MaxDeltaRow(next, curr, spanBegin, spanEnd));
+							});
+						// After the activity, which then errs on the side of staying awake.
+						ForEachAbsorbingRun(i, c0, c1, [&](UINT b, UINT count, const float* factors, float scale)
+							{
+								waves_kernels::AbsorbRow(next + b, curr + b, factors, scale, count);
+							});
+					}
+					mTileAwake[t] = activity >= mSleepThreshold;
+				}
+
+				// Other bands still read the current solution until here.
+				if (mThreadPool)
+					mThreadPool->Barrier();
+
+				for (UINT t = tzBegin * tilesX; t < tzEnd * tilesX; ++t)
+				{
+					if (!mTileUpdate[t] || mTileAwake[t])
+						continue;
+
+					// Freeze a tile going to sleep: with both time levels equal the
+					// buffer swap leaves it unchanged until it is woken again.
+					UINT r0, r1, c0, c1;
+					TileBounds(t, r0, r1, c0, c1);
+					for (UINT i = r0; i < r1; ++i)
+					{
+						std::memcpy(mCurrSolution + size_t(i) * mRowPitch + c0,
+							mPrevSolution + size_t(i) * mRowPitch + c0, (c1 - c0) * sizeof(float));
+					}
+				}
+
+				if (withNormals)
+					ComputeTileNormals(mPrevSolution, tzBegin * tilesX, tzEnd * tilesX);
+			};
+
+		if (mThreadPool)
+			mThreadPool->Run(band);
+		else
+			band(0, 1);
+
+		std::swap(mPrevSolution, mCurrSolution);
+
+		mNormalsDirty = !withNormals;
+
+		CollectDirtyRows();
 	}
 
-	void Waves::Disturb(UINT i, UINT j, float magnitude)
+	void Waves::ComputeTileNormals(const float* heights, UINT tileBegin, UINT tileEnd)const
 	{
-		// Don't disturb boundaries.
-		assert(i > 1 && i < mNumRows - 2);
-		assert(j > 1 && j < mNumCols - 2);
+		for (UINT t = tileBegin; t < tileEnd; ++t)
+		{
+			if (!mTileNormalsDirty[t])
+				continue;
 
-		float halfMag = 0.5f * magnitude;
+			UINT r0, r1, c0, c1;
+			TileBounds(t, r0, r1, c0, c1);
+			for (UINT i = r0; i < r1; ++i)
+			{
+				const float* row = heights + size_t(i) * mRowPitch;
+				ForEachWetSpan(i, c0, c1, [&](UINT spanBegin, UINT spanEnd)
+					{
+						mNormalRow(mNormals + size_t(i) * mNumCols, mTangentX + size_t(i) * mNumCols,
+							row, row - mRowPitch, row + mRowPitch, spanBegin, spanEnd, 2.0f * mSpatialStep);
+					});
+			}
+			mTileNormalsDirty[t] = 0;
+		}
+	}
 
-		// Disturb the ijth vertex height and its neighbors.
-		mCurrSolution[i * mNumCols + j].y += magnitude;
-		mCurrSolution[i * mNumCols + j + 1].y += halfMag;
-		mCurrSolution[i * mNumCols + j - 1].y += halfMag;
-		mCurrSolution[(i + 1) * mNumCols + j].y += halfMag;
-		mCurrSolution[(i - 1) * mNumCols + j].y += halfMag;
+	void Waves::TileBounds(UINT tile, UINT& r0, UINT& r1, UINT& c0, UINT& c1)const
+	{
+		UINT tz = tile / mTileCountX;
+		UINT tx = tile - tz * mTileCountX;
+
+		r0 = std::max(tz * ActiveTileSize, 1u);
+		r1 = std::min((tz + 1) * ActiveTileSize, mNumRows - 1);
+		c0 = std::max(tx * ActiveTileSize, 1u);
+		c1 = std::min((tx + 1) * ActiveTileSize, mNumCols - 1);
+	}
+
+	void Waves::WakeTileAt(UINT i, UINT j)
+	{
+		mTileAwake[(i / ActiveTileSize) * mTileCountX + j / ActiveTileSize] = 1;
+	}
+
+	void Waves::UpdateHeights(UINT rowBegin, UINT rowEnd)
+	{
+		// Only update interior points; we use zero boundary conditions.
+		for (UINT i = rowBegin; i < rowEnd; ++i)
+		{
+			// After this update we will be discarding the old previous
+			// buffer, so overwrite that buffer with the new update.
+			// Note how we can do this inplace (read/write to same element) 
+			// because we won't need prev_ij again and the assignment happens last.
+
+			// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+			// Moreover, our +z axis goes "down"; this is just to 
+			// keep consistent with our row indices going down.
+
+			const UINT n = mNumCols;
+			float* next = mPrevSolution + size_t(PhysicalRow(i)) * mRowPitch;
+			const float* curr = mCurrSolution + size_t(PhysicalRow(i)) * mRowPitch;
+			const float* up = mCurrSolution + size_t(PhysicalRow(i - 1)) * mRowPitch;
+			const float* down = mCurrSolution + size_t(PhysicalRow(i + 1)) * mRowPitch;
+			ForEachWetSpan(i, 1, n - 1, [&](UINT spanBegin, UINT spanEnd)
+				{
+					ForEachRingSpan(spanBegin, spanEnd, [&](UINT b, UINT e)
+						{
+							mStencilRow(next, curr, up, down, b, e, mK1, mK2, mK3);
+							if (mTrackDirtyRows)
+								mRowDelta[i] = std::max(mRowDelta[i], waves_kernels::MaxDeltaRow(next, curr, b, e));
+						},
+						[&](UINT c)
+						{
+							// The column's neighbors gathered from both ends of the row.
+							float nextPoint[3] = { 0.0f, next[c], 0.0f };
+							float currPoint[3] = { curr[c == 0 ? n - 1 : c - 1], curr[c], curr[c + 1 == n ? 0 : c + 1] };
+							float upPoint[3] = { 0.0f, up[c], 0.0f };
+							float downPoint[3] = { 0.0f, down[c], 0.0f };
+							waves_kernels::StencilRowScalar(nextPoint, currPoint, upPoint, downPoint, 1, 2, mK1, mK2, mK3);
+							if (mTrackDirtyRows)
+								mRowDelta[i] = std::max(mRowDelta[i], waves_kernels::MaxDeltaRow(nextPoint, currPoint, 1, 2));
+							next[c] = nextPoint[1];
+						});
+				});
+
+			// Land stays flat: both of its heights are 0.
+			ForEachAbsorbingRun(i, 1, n - 1, [&](UINT b, UINT count, const float* factors, float scale)
+				{
+					waves_kernels::AbsorbRow(next + b, curr + b, factors, scale, count);
+				});
+		}
+	}
+
+	void Waves::CollectDirtyRows()
+	{
+		if (!mTrackDirtyRows)
+			return;
+
+		for (UINT i = 0; i < mNumRows; ++i)
+		{
+			mRowDrift[i] += mRowDelta[i];
+			mRowDelta[i] = 0.0f;
+			if (mRowDrift[i] > mDirtyTolerance)
+				MarkRowDirty(i);
+		}
+	}
+
+	void Waves::ComputeNormals(const float* heights, UINT rowBegin, UINT rowEnd)const
+	{
+		ComputeNormals(heights, rowBegin, rowEnd, 1, mNumCols - 1);
+	}
+
+	void Waves::ComputeNormals(const float* heights, UINT rowBegin, UINT rowEnd, UINT colBegin, UINT colEnd)const
+	{
+		//
+		// Compute normals using finite difference scheme.
+		//
+		const UINT n = mNumCols;
+		const float twoDx = 2.0f * mSpatialStep;
+		for (UINT i = rowBegin; i < rowEnd; ++i)
+		{
+			XMFLOAT3* normals = mNormals + size_t(PhysicalRow(i)) * n;
+			XMFLOAT3* tangents = mTangentX + size_t(PhysicalRow(i)) * n;
+			const float* row = heights + size_t(PhysicalRow(i)) * mRowPitch;
+			const float* up = heights + size_t(PhysicalRow(i - 1)) * mRowPitch;
+			const float* down = heights + size_t(PhysicalRow(i + 1)) * mRowPitch;
+			ForEachWetSpan(i, colBegin, colEnd, [&](UINT spanBegin, UINT spanEnd)
+				{
+					ForEachRingSpan(spanBegin, spanEnd, [&](UINT b, UINT e)
+						{
+							mNormalRow(normals, tangents, row, up, down, b, e, twoDx);
+						},
+						[&](UINT c)
+						{
+							float rowPoint[3] = { row[c == 0 ? n - 1 : c - 1], row[c], row[c + 1 == n ? 0 : c + 1] };
+							float upPoint[3] = { 0.0f, up[c], 0.0f };
+							float downPoint[3] = { 0.0f, down[c], 0.0f };
+							XMFLOAT3 normal[3];
+							XMFLOAT3 tangent[3];
+							waves_kernels::NormalRowScalar(normal, tangent, rowPoint, upPoint, downPoint, 1, 2, twoDx);
+							normals[c] = normal[1];
+							tangents[c] = tangent[1];
+						});
+				});
+		}
+	}
+
+	void Waves::ComputeBandEdgeNormals(const float* heights, UINT rowBegin, UINT rowEnd)const
+	{
+		if (rowBegin >= rowEnd)
+			return;
+
+		ComputeNormals(heights, rowBegin, rowBegin + 1);
+		if (rowEnd - 1 > rowBegin)
+			ComputeNormals(heights, rowEnd - 1, rowEnd);
+	}
+
+	void Waves::EnsureNormals()const
+	{
+		// Quantized storage has no normal cache.
+		if (!mNormalsDirty || mCurrQuantized)
+			return;
+
+		if (mActiveTiles && !mScrolling)
+		{
+			// Only the tiles stepped since the last time.
+			auto band = [this](UINT index, UINT count)
+				{
+					UINT tzBegin, tzEnd;
+					ThreadPool::SplitRange(0, mTileCountZ, index, count, tzBegin, tzEnd);
+					ComputeTileNormals(mCurrSolution, tzBegin * mTileCountX, tzEnd * mTileCountX);
+				};
+
+			if (mThreadPool)
+				mThreadPool->Run(band);
+			else
+				band(0, 1);
+		}
+		else if (mThreadPool)
+		{
+			mThreadPool->Run([this](UINT index, UINT count)
+				{
+					UINT rowBegin, rowEnd;
+					ThreadPool::SplitRange(1, mNumRows - 1, index, count, rowBegin, rowEnd);
+					ComputeNormals(mCurrSolution, rowBegin, rowEnd);
+				});
+		}
+		else
+		{
+			ComputeNormals(mCurrSolution, 1, mNumRows - 1);
+		}
+
+		std::fill(mTileNormalsDirty.begin(), mTileNormalsDirty.end(), 0);
+		mNormalsDirty = false;
+	}
+
+	void Waves::EmitVertices(void* dst, UINT stride, EVertexLayout layout)const
+	{
+		EnsureNormals();
+		EmitRows(static_cast<uint8_t*>(dst), stride, layout, 0, mNumRows);
+	}
+
+	void Waves::EmitVertices(void* dst, UINT stride, EVertexLayout layout, const std::vector<RowRange>& rows)const
+	{
+		EnsureNormals();
+		for (const RowRange& range : rows)
+			EmitRows(static_cast<uint8_t*>(dst), stride, layout, range.begin, range.end);
+	}
+
+	void Waves::EmitRows(uint8_t* dst, UINT stride, EVertexLayout layout, UINT rowBegin, UINT rowEnd)const
+	{
+		const float du = 1.0f / Width();
+		const float dv = 1.0f / Depth();
+
+		auto rows = [this, dst, stride, layout, du, dv](UINT rowBegin, UINT rowEnd)
+			{
+				// Quantized storage: the heights of a row and the rows around it are
+				// widened into scratch rows and its normals computed right here.  Rows
+				// that wrap around the rings are put in column order there too.
+				std::vector<float> window;
+				std::vector<XMFLOAT3> normalRow;
+				std::vector<XMFLOAT3> tangentRow;
+				if (mCurrQuantized || mColOffset != 0)
+				{
+					window.resize(3 * size_t(mRowPitch));
+					normalRow.resize(mNumCols);
+					tangentRow.resize(mNumCols);
+				}
+
+				for (UINT i = rowBegin; i < rowEnd; ++i)
+				{
+					uint8_t* row = dst + size_t(i) * mNumCols * stride;
+					const float* heights;
+					const XMFLOAT3* normals;
+					if (mCurrQuantized)
+					{
+						float* up = window.data();
+						float* mid = up + mRowPitch;
+						float* down = mid + mRowPitch;
+						ReadRow(mid, i);
+
+						std::fill(normalRow.begin(), normalRow.end(), XMFLOAT3(0.0f, 1.0f, 0.0f));
+						if (i > 0 && i + 1 < mNumRows)
+						{
+							ReadRow(up, i - 1);
+							ReadRow(down, i + 1);
+							ForEachWetSpan(i, 1, mNumCols - 1, [&](UINT spanBegin, UINT spanEnd)
+								{
+									mNormalRow(normalRow.data(), tangentRow.data(), mid, up, down, spanBegin, spanEnd, 2.0f * mSpatialStep);
+								});
+						}
+						heights = mid;
+						normals = normalRow.data();
+					}
+					else if (mColOffset != 0)
+					{
+						const XMFLOAT3* src = mNormals + size_t(PhysicalRow(i)) * mNumCols;
+						ReadRow(window.data(), i);
+						ForEachRingRun(0, mNumCols, [&](UINT b, UINT e, UINT j)
+							{
+								std::copy(src + b, src + e, normalRow.begin() + j);
+							});
+						heights = window.data();
+						normals = normalRow.data();
+					}
+					else
+					{
+						heights = mCurrSolution + size_t(PhysicalRow(i)) * mRowPitch;
+						normals = mNormals + size_t(PhysicalRow(i)) * mNumCols;
+					}
+					if (layout == EVertexLayout::Split)
+					{
+						waves_kernels::EmitDynamicRow(row, stride, heights, normals, mNumCols);
+					}
+					else
+					{
+						float z = mHalfDepth - i * mSpatialStep;
+						waves_kernels::EmitInterleavedRow(row, stride, heights, normals, mNumCols,
+							-mHalfWidth, mSpatialStep, z, 0.5f, du, 0.5f - z * dv);
+					}
+				}
+			};
+
+		if (mThreadPool)
+		{
+			mThreadPool->Run([rowBegin, rowEnd, &rows](UINT index, UINT count)
+				{
+					UINT bandBegin, bandEnd;
+					ThreadPool::SplitRange(rowBegin, rowEnd, index, count, bandBegin, bandEnd);
+					rows(bandBegin, bandEnd);
+				});
+		}
+		else
+		{
+			rows(rowBegin, rowEnd);
+		}
+	}
+
+	void Waves::EmitStaticVertices(void* dst, UINT stride)const
+	{
+		uint8_t* vertices = static_cast<uint8_t*>(dst);
+		const float du = 1.0f / Width();
+		const float dv = 1.0f / Depth();
+		for (UINT i = 0; i < mNumRows; ++i)
+		{
+			for (UINT j = 0; j < mNumCols; ++j)
+			{
+				StaticVertex v;
+				v.x = -mHalfWidth + j * mSpatialStep;
+				v.z = mHalfDepth - i * mSpatialStep;
+				v.u = 0.5f + v.x * du;
+				v.v = 0.5f - v.z * dv;
+				std::memcpy(vertices + (size_t(i) * mNumCols + j) * stride, &v, sizeof(v));
+			}
+		}
+	}
+
+	void Waves::SetDirtyRowTracking(bool enabled, float tolerance)
+	{
+		// Whatever was taken before tracking started may be stale.
+		if (enabled && !mTrackDirtyRows)
+			std::fill(mDirtyRows.begin(), mDirtyRows.end(), ~uint64_t(0));
+
+		mTrackDirtyRows = enabled;
+		mDirtyTolerance = tolerance;
+	}
+
+	std::vector<Waves::RowRange> Waves::TakeDirtyRows()
+	{
+		std::vector<RowRange> ranges;
+		if (!mTrackDirtyRows || mCurrQuantized)
+		{
+			ranges.push_back({ 0, mNumRows });
+			return ranges;
+		}
+
+		for (UINT i = 0; i < mNumRows; ++i)
+		{
+			if (!(mDirtyRows[i / 64] >> (i % 64) & 1))
+				continue;
+
+			UINT begin = i > 0 ? i - 1 : 0;
+			UINT end = std::min(i + 2, mNumRows);
+			if (!ranges.empty() && ranges.back().end >= begin)
+				ranges.back().end = end;
+			else
+				ranges.push_back({ begin, end });
+		}
+
+		std::fill(mDirtyRows.begin(), mDirtyRows.end(), 0);
+		for (const RowRange& range : ranges)
+			std::fill(mRowDrift.begin() + range.begin, mRowDrift.begin() + range.end, 0.0f);
+
+		return ranges;
+	}
+
+	void Waves::SerializeRows(const std::vector<RowRange>& rows, std::vector<uint8_t>& packet)const
+	{
+		// Layout: column count, range count, then per range its begin and end row
+		// followed by the heights of those rows.  Native endianness.
+		auto append = [&packet](const void* data, size_t bytes)
+			{
+				const uint8_t* p = static_cast<const uint8_t*>(data);
+				packet.insert(packet.end(), p, p + bytes);
+			};
+
+		UINT header[] = { mNumCols, static_cast<UINT>(rows.size()) };
+		append(header, sizeof(header));
+		std::vector<float> heights(mNumCols);
+		for (const RowRange& range : rows)
+		{
+			append(&range, sizeof(range));
+			for (UINT i = range.begin; i < range.end; ++i)
+			{
+				ReadRow(heights.data(), i);
+				append(heights.data(), mNumCols * sizeof(float));
+			}
+		}
+	}
+
+	void Waves::ApplyRows(const uint8_t* packet, size_t size)
+	{
+		size_t offset = 0;
+		auto read = [packet, size, &offset](void* data, size_t bytes)
+			{
+				if (size - offset < bytes)
+					throw std::runtime_error("Waves::ApplyRows: truncated packet");
+				std::memcpy(data, packet + offset, bytes);
+				offset += bytes;
+			};
+
+		UINT header[2];
+		read(header, sizeof(header));
+		if (header[0] != mNumCols)
+			throw std::runtime_error("Waves::ApplyRows: packet is for a different grid");
+
+		std::vector<float> heights(mNumCols);
+		for (UINT r = 0; r < header[1]; ++r)
+		{
+			RowRange range;
+			read(&range, sizeof(range));
+			if (range.begin > range.end || range.end > mNumRows)
+				throw std::runtime_error("Waves::ApplyRows: row range out of bounds");
+
+			for (UINT i = range.begin; i < range.end; ++i)
+			{
+				read(heights.data(), mNumCols * sizeof(float));
+				WriteRow(i, heights.data());
+				MarkRowDirty(i);
+			}
+
+			// The normals along the edges of the range read the rows next to it.
+			if (!mNormalsDirty && !mCurrQuantized)
+				ComputeNormals(mCurrSolution, std::max(range.begin, 2u) - 1, std::min(range.end + 1, mNumRows - 1));
+		}
+	}
+
+	void Waves::SaveSnapshot(const char* path)const
+	{
+		const bool quantized = mCurrQuantized != nullptr;
+		const uint64_t planeBytes = uint64_t(mNumRows) * mRowPitch * (quantized ? sizeof(int16_t) : sizeof(float));
+
+		SnapshotHeader header{};
+		std::memcpy(header.magic, SnapshotMagic, sizeof(header.magic));
+		header.version = SnapshotVersion;
+		header.storage = static_cast<uint32_t>(quantized ? EStorage::Int16 : EStorage::Float);
+		header.numRows = mNumRows;
+		header.numCols = mNumCols;
+		header.rowPitch = mRowPitch;
+		header.spatialStep = mSpatialStep;
+		header.timeStep = mTimeStep;
+		header.k1 = mK1;
+		header.k2 = mK2;
+		header.k3 = mK3;
+		header.adiLaplacian = mAdiLaplacian;
+		header.adiDamping = mAdiDamping;
+		header.adiBeta = mAdiBeta;
+		header.heightScale = mHeightScale;
+		header.timeAccum = mTimeAccum;
+		header.prevOffset = AlignOffset(sizeof(header));
+		header.currOffset = AlignOffset(header.prevOffset + planeBytes);
+		uint64_t offset = header.currOffset + planeBytes;
+		if (!mWet.empty())
+		{
+			header.maskOffset = AlignOffset(offset);
+			offset = header.maskOffset + mWet.size();
+		}
+		header.tilesOffset = AlignOffset(offset);
+		header.disturbancesOffset = AlignOffset(header.tilesOffset + mTileAwake.size());
+		header.disturbanceCount = mDisturbances.size();
+		header.rowOffset = mRowOffset;
+		header.colOffset = mColOffset;
+		header.windowRow = mWindowRow;
+		header.windowCol = mWindowCol;
+
+		std::ofstream fout(path, std::ios::binary);
+		if (!fout)
+			throw std::runtime_error(std::string("Waves::SaveSnapshot: can't create ") + path);
+
+		uint64_t written = 0;
+		auto writeAt = [&fout, &written](uint64_t offset, const void* data, uint64_t bytes)
+			{
+				static const char zeros[PlaneAlignment] = {};
+				fout.write(zeros, static_cast<std::streamsize>(offset - written));
+				fout.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+				written = offset + bytes;
+			};
+
+		writeAt(0, &header, sizeof(header));
+		writeAt(header.prevOffset, quantized ? static_cast<const void*>(mPrevQuantized) : mPrevSolution, planeBytes);
+		writeAt(header.currOffset, quantized ? static_cast<const void*>(mCurrQuantized) : mCurrSolution, planeBytes);
+		if (header.maskOffset)
+			writeAt(header.maskOffset, mWet.data(), mWet.size());
+		writeAt(header.tilesOffset, mTileAwake.data(), mTileAwake.size());
+		writeAt(header.disturbancesOffset, mDisturbances.data(), mDisturbances.size() * sizeof(QueuedDisturbance));
+
+		if (!fout)
+			throw std::runtime_error(std::string("Waves::SaveSnapshot: can't write ") + path);
+	}
+
+	void Waves::LoadSnapshot(const char* path)
+	{
+		auto snapshot = std::make_unique<MappedFile>(path);
+		const uint8_t* data = snapshot->Data();
+		const uint64_t size = snapshot->Size();
+
+		auto invalid = [path](const char* what)
+			{
+				return std::runtime_error(std::string("Waves::LoadSnapshot: ") + what + ": " + path);
+			};
+
+		SnapshotHeader header;
+		if (size < sizeof(header))
+			throw invalid("not a snapshot");
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, SnapshotMagic, sizeof(header.magic)) != 0)
+			throw invalid("not a snapshot");
+		if (header.version != SnapshotVersion)
+			throw invalid("unsupported snapshot version");
+
+		const UINT m = header.numRows;
+		const UINT n = header.numCols;
+		const bool quantized = header.storage == static_cast<uint32_t>(EStorage::Int16);
+		if (header.storage > static_cast<uint32_t>(EStorage::Int16) || m < 3 || n < 3 ||
+			header.rowPitch != PlaneRowPitch(n, quantized ? sizeof(int16_t) : sizeof(float)) ||
+			header.rowOffset >= m || header.colOffset >= n)
+			throw invalid("bad grid layout");
+
+		const uint64_t planeBytes = uint64_t(m) * header.rowPitch * (quantized ? sizeof(int16_t) : sizeof(float));
+		const uint64_t tileCount = uint64_t((n + ActiveTileSize - 1) / ActiveTileSize) * ((m + ActiveTileSize - 1) / ActiveTileSize);
+		// Offsets and sizes are checked one at a time, so none of the sums can overflow.
+		auto fits = [size](uint64_t offset, uint64_t bytes)
+			{
+				return offset % PlaneAlignment == 0 && offset <= size && bytes <= size - offset;
+			};
+		if (!fits(header.prevOffset, planeBytes) || !fits(header.currOffset, planeBytes) ||
+			(header.maskOffset && !fits(header.maskOffset, uint64_t(m) * n)) ||
+			!fits(header.tilesOffset, tileCount) ||
+			header.disturbanceCount > size / sizeof(QueuedDisturbance) ||
+			!fits(header.disturbancesOffset, header.disturbanceCount * sizeof(QueuedDisturbance)))
+			throw invalid("truncated snapshot");
+
+		std::vector<QueuedDisturbance> disturbances(static_cast<size_t>(header.disturbanceCount));
+		if (!disturbances.empty())
+			std::memcpy(disturbances.data(), data + header.disturbancesOffset, disturbances.size() * sizeof(QueuedDisturbance));
+		for (const QueuedDisturbance& d : disturbances)
+		{
+			if (d.tile >= tileCount || d.r0 == 0 || d.r0 >= d.r1 || d.r1 > m - 1 || d.c0 == 0 || d.c0 >= d.c1 || d.c1 > n - 1)
+				throw invalid("bad queued disturbance");
+		}
+
+		FreePlanes();
+		mPlanesOnLargePages = mLargeGrid;
+		mSnapshot = std::move(snapshot);
+		uint8_t* base = mSnapshot->Data();
+
+		mNumRows = m;
+		mNumCols = n;
+		mRowPitch = header.rowPitch;
+		mVertexCount = size_t(m) * n;
+		mTriangleCount = size_t(m - 1) * (n - 1) * 2;
+		mSpatialStep = header.spatialStep;
+		mTimeStep = header.timeStep;
+		mK1 = header.k1;
+		mK2 = header.k2;
+		mK3 = header.k3;
+		mAdiLaplacian = header.adiLaplacian;
+		mAdiDamping = header.adiDamping;
+		mAdiBeta = header.adiBeta;
+		mTimeAccum = header.timeAccum;
+		mRowOffset = header.rowOffset;
+		mColOffset = header.colOffset;
+		mWindowRow = header.windowRow;
+		mWindowCol = header.windowCol;
+		mHalfWidth = (n - 1) * mSpatialStep * 0.5f;
+		mHalfDepth = (m - 1) * mSpatialStep * 0.5f;
+
+		if (quantized)
+		{
+			mStorage = EStorage::Int16;
+			mHeightScale = header.heightScale;
+			mPrevQuantized = reinterpret_cast<int16_t*>(base + header.prevOffset);
+			mCurrQuantized = reinterpret_cast<int16_t*>(base + header.currOffset);
+		}
+		else
+		{
+			mStorage = EStorage::Float;
+			mPrevSolution = reinterpret_cast<float*>(base + header.prevOffset);
+			mCurrSolution = reinterpret_cast<float*>(base + header.currOffset);
+			mNormals = AllocatePlane<XMFLOAT3>(mVertexCount, mLargeGrid);
+			mTangentX = AllocatePlane<XMFLOAT3>(mVertexCount, mLargeGrid);
+			// The border keeps these, the rest is recomputed.
+			std::fill(mNormals, mNormals + mVertexCount, XMFLOAT3(0.0f, 1.0f, 0.0f));
+			std::fill(mTangentX, mTangentX + mVertexCount, XMFLOAT3(1.0f, 0.0f, 0.0f));
+		}
+
+		mTileCountX = (n + ActiveTileSize - 1) / ActiveTileSize;
+		mTileCountZ = (m + ActiveTileSize - 1) / ActiveTileSize;
+		mTileAwake.assign(base + header.tilesOffset, base + header.tilesOffset + tileCount);
+		mTileUpdate.assign(tileCount, 0);
+		mTileNormalsDirty.assign(tileCount, 1);
+		mNormalsDirty = !quantized;
+
+		if (header.maskOffset)
+			mWet.assign(base + header.maskOffset, base + header.maskOffset + size_t(m) * n);
+		else
+			mWet.clear();
+		BuildWetSpans();
+		BuildAbsorbingLayer();
+
+		mDisturbances = std::move(disturbances);
+
+		mDirtyRows.assign((m + 63) / 64, ~uint64_t(0));
+		mRowDelta.assign(m, 0.0f);
+		mRowDrift.assign(m, 0.0f);
+
+		// A scrolling grid's rings go back in order here unless this one scrolls too.
+		if (!mScrolling)
+			UnrollRings();
+	}
+
+	void Waves::SetRecording(WavesRecording* recording)
+	{
+		mRecording = recording;
+	}
+
+	WavesRecording* Waves::Recording()const
+	{
+		return mRecording;
+	}
+
+	void Waves::SetLazyNormals(bool lazy)
+	{
+		mLazyNormals = lazy;
+	}
+
+	void Waves::AddHeight(UINT i, UINT j, float magnitude)
+	{
+		if (!IsWet(i, j))
+			return;
+
+		size_t k = PlaneIndex(i, j);
+		if (mCurrQuantized)
+			mCurrQuantized[k] = Quantize(mCurrQuantized[k] * mHeightScale + magnitude, mHeightScale);
+		else
+			mCurrSolution[k] += magnitude;
+	}
+
+	void Waves::Disturb(UINT i, UINT j, float magnitude)
+	{
+		if (mRecording)
+			mRecording->Record({ WavesRecording::EEvent::Disturb, static_cast<int32_t>(i), static_cast<int32_t>(j), { magnitude } });
+
+		float halfMag = 0.5f * magnitude;
+
+		// Don't disturb boundaries.  Off the grid, i - 1 or j - 1 wraps around and
+		// is left out as well.
+		auto disturb = [this](UINT i, UINT j, float magnitude)
+			{
+				if (i == 0 || j == 0 || i >= mNumRows - 1 || j >= mNumCols - 1)
+					return;
+
+				AddHeight(i, j, magnitude);
+				WakeTileAt(i, j);
+				MarkRowDirty(i);
+			};
+
+		// Disturb the ijth vertex height and its neighbors.
+		disturb(i, j, magnitude);
+		disturb(i, j + 1, halfMag);
+		disturb(i, j - 1, halfMag);
+		disturb(i + 1, j, halfMag);
+		disturb(i - 1, j, halfMag);
+	}
+
+	void Waves::QueueDisturbance(float row, float col, float magnitude, float radius)
+	{
+		if (mRecording)
+			mRecording->Record({ WavesRecording::EEvent::QueueDisturbance, 0, 0, { row, col, magnitude, radius } });
+
+		QueuedDisturbance d;
+		d.row = row;
+		d.col = col;
+		d.magnitude = magnitude;
+		d.radius = std::max(radius, 0.0f);
+
+		// Interior points covered, clipped in double so that impulses far off the
+		// grid don't overflow.
+		auto cover = [](float center, float radius, UINT count, UINT& begin, UINT& end)
+			{
+				double lo, hi;
+				if (radius == 0.0f)
+				{
+					double nearest = std::floor(double(center) + 0.5);
+					lo = nearest - 1.0;
+					hi = nearest + 2.0;
+				}
+				else
+				{
+					lo = std::ceil(double(center) - 3.0 * radius);
+					hi = std::floor(double(center) + 3.0 * radius) + 1.0;
+				}
+				begin = UINT(std::clamp(lo, 1.0, double(count - 1)));
+				end = UINT(std::clamp(hi, 1.0, double(count - 1)));
+				return begin < end;
+			};
+		if (!cover(row, d.radius, mNumRows, d.r0, d.r1) || !cover(col, d.radius, mNumCols, d.c0, d.c1))
+			return;
+
+		UINT centerRow = (d.r0 + d.r1) / 2;
+		UINT centerCol = (d.c0 + d.c1) / 2;
+		d.tile = (centerRow / ActiveTileSize) * mTileCountX + centerCol / ActiveTileSize;
+		mDisturbances.push_back(d);
+	}
+
+	size_t Waves::QueuedDisturbanceCount()const
+	{
+		return mDisturbances.size();
+	}
+
+	void Waves::ApplyDisturbances()
+	{
+		if (mDisturbances.empty())
+			return;
+
+		// Impulses in the same tile go next to each other and otherwise keep the
+		// order they were queued in, so every point sums its impulses in the same
+		// order at any thread count.
+		std::stable_sort(mDisturbances.begin(), mDisturbances.end(),
+			[](const QueuedDisturbance& a, const QueuedDisturbance& b) { return a.tile < b.tile; });
+
+		auto band = [this](UINT index, UINT count)
+			{
+				UINT rowBegin, rowEnd;
+				ThreadPool::SplitRange(1, mNumRows - 1, index, count, rowBegin, rowEnd);
+
+				std::vector<float> weights;
+				for (const QueuedDisturbance& d : mDisturbances)
+				{
+					UINT r0 = std::max(d.r0, rowBegin);
+					UINT r1 = std::min(d.r1, rowEnd);
+					if (r0 >= r1)
+						continue;
+
+					if (d.radius == 0.0f)
+					{
+						// The Disturb() stencil; its box is already clipped to the interior.
+						UINT i = static_cast<UINT>(std::floor(d.row + 0.5f));
+						UINT j = static_cast<UINT>(std::floor(d.col + 0.5f));
+						float halfMag = 0.5f * d.magnitude;
+						for (UINT r = r0; r < r1; ++r)
+						{
+							if (r == i)
+							{
+								for (UINT c = d.c0; c < d.c1; ++c)
+									AddHeight(r, c, c == j ? d.magnitude : halfMag);
+							}
+							else if (j >= d.c0 && j < d.c1)
+							{
+								AddHeight(r, j, halfMag);
+							}
+						}
+						continue;
+					}
+
+					// The Gaussian is separable: one weight per column, scaled by the
+					// weight of each row.
+					const float k = -0.5f / (d.radius * d.radius);
+					weights.resize(d.c1 - d.c0);
+					for (UINT c = d.c0; c < d.c1; ++c)
+					{
+						float x = float(c) - d.col;
+						weights[c - d.c0] = std::exp(k * x * x);
+					}
+
+					for (UINT r = r0; r < r1; ++r)
+					{
+						float z = float(r) - d.row;
+						float scale = d.magnitude * std::exp(k * z * z);
+						const size_t row = size_t(PhysicalRow(r)) * mRowPitch;
+						ForEachWetSpan(r, d.c0, d.c1, [&](UINT spanBegin, UINT spanEnd)
+							{
+								ForEachRingRun(spanBegin, spanEnd, [&](UINT b, UINT e, UINT c)
+									{
+										const float* w = weights.data() + (c - d.c0);
+										if (mCurrQuantized)
+										{
+											int16_t* q = mCurrQuantized + row + b;
+											for (UINT k = 0; k < e - b; ++k)
+												q[k] = Quantize(q[k] * mHeightScale + scale * w[k], mHeightScale);
+										}
+										else
+										{
+											mSplatRow(mCurrSolution + row + b, w, scale, e - b);
+										}
+									});
+							});
+					}
+				}
+			};
+
+		if (mThreadPool)
+			mThreadPool->Run(band);
+		else
+			band(0, 1);
+
+		// Bookkeeping shared between bands.
+		for (const QueuedDisturbance& d : mDisturbances)
+		{
+			for (UINT r = d.r0; r < d.r1; ++r)
+				MarkRowDirty(r);
+			for (UINT tz = d.r0 / ActiveTileSize; tz <= (d.r1 - 1) / ActiveTileSize; ++tz)
+				for (UINT tx = d.c0 / ActiveTileSize; tx <= (d.c1 - 1) / ActiveTileSize; ++tx)
+					mTileAwake[tz * mTileCountX + tx] = 1;
+		}
+
+		mDisturbances.clear();
+	}
+
+	void Waves::SetHeight(UINT i, UINT j, float height, float previousHeight)
+	{
+		if (mRecording)
+			mRecording->Record({ WavesRecording::EEvent::SetHeight, static_cast<int32_t>(i), static_cast<int32_t>(j), { height, previousHeight } });
+
+		if (!IsWet(i, j))
+			return;
+
+		size_t k = PlaneIndex(i, j);
+		if (mCurrQuantized)
+		{
+			mCurrQuantized[k] = Quantize(height, mHeightScale);
+			mPrevQuantized[k] = Quantize(previousHeight, mHeightScale);
+		}
+		else
+		{
+			mCurrSolution[k] = height;
+			mPrevSolution[k] = previousHeight;
+		}
+
+		WakeTileAt(i, j);
+		mTileNormalsDirty[(i / ActiveTileSize) * mTileCountX + j / ActiveTileSize] = 1;
+		mNormalsDirty = true;
+		MarkRowDirty(i);
+	}
+
+	void Waves::Shift(int rows, int cols)
+	{
+		if (mRecording)
+			mRecording->Record({ WavesRecording::EEvent::Shift, rows, cols, {} });
+
+		assert(mWet.empty());
+
+		if (rows == 0 && cols == 0)
+			return;
+
+		if (mScrolling)
+		{
+			const int m = int(mNumRows);
+			const int n = int(mNumCols);
+			rows = std::clamp(rows, -m, m);
+			cols = std::clamp(cols, -n, n);
+
+			// Point (i, j) now reads what was stored for (i + rows, j + cols).
+			mRowOffset = UINT((int(mRowOffset) + rows + m) % m);
+			mColOffset = UINT((int(mColOffset) + cols + n) % n);
+
+			// Clear the rows and columns shifted in, nothing else is written.
+			const UINT rowBegin = rows > 0 ? UINT(m - rows) : 0;
+			const UINT rowEnd = rows > 0 ? UINT(m) : UINT(-rows);
+			const UINT colBegin = cols > 0 ? UINT(n - cols) : 0;
+			const UINT colEnd = cols > 0 ? UINT(n) : UINT(-cols);
+			auto clearPlane = [&](auto* plane)
+				{
+					for (UINT i = rowBegin; i < rowEnd; ++i)
+						std::memset(plane + size_t(PhysicalRow(i)) * mRowPitch, 0, mNumCols * sizeof(*plane));
+
+					for (UINT i = 0; i < mNumRows && colBegin < colEnd; ++i)
+					{
+						auto* row = plane + size_t(PhysicalRow(i)) * mRowPitch;
+						ForEachRingRun(colBegin, colEnd, [row](UINT b, UINT e, UINT)
+							{
+								std::memset(row + b, 0, (e - b) * sizeof(*row));
+							});
+					}
+				};
+
+			if (mCurrQuantized)
+			{
+				clearPlane(mPrevQuantized);
+				clearPlane(mCurrQuantized);
+			}
+			else
+			{
+				clearPlane(mPrevSolution);
+				clearPlane(mCurrSolution);
+				RefreshShiftedNormals(rows, cols);
+			}
+
+			for (UINT i = 0; i < mNumRows; ++i)
+				MarkRowDirty(i);
+			mTileAwake = mTileWet;
+			return;
+		}
+
+		// Row i takes row i + rows, so walk the rows in the direction the data
+		// comes from, and the same within a row.
+		auto shiftPlane = [this, rows, cols](auto* plane)
+			{
+				const int m = int(mNumRows);
+				const int n = int(mNumCols);
+				const size_t rowBytes = mNumCols * sizeof(*plane);
+				for (int step = 0; step < m; ++step)
+				{
+					int i = rows > 0 ? step : m - 1 - step;
+					int source = i + rows;
+					auto* dst = plane + size_t(i) * mRowPitch;
+					if (source < 0 || source >= m || std::abs(cols) >= n)
+					{
+						std::memset(dst, 0, rowBytes);
+						continue;
+					}
+
+					const auto* src = plane + size_t(source) * mRowPitch;
+					if (cols >= 0)
+					{
+						std::memmove(dst, src + cols, (n - cols) * sizeof(*plane));
+						std::memset(dst + (n - cols), 0, cols * sizeof(*plane));
+					}
+					else
+					{
+						std::memmove(dst - cols, src, (n + cols) * sizeof(*plane));
+						std::memset(dst, 0, -cols * sizeof(*plane));
+					}
+				}
+			};
+
+		if (mCurrQuantized)
+		{
+			shiftPlane(mPrevQuantized);
+			shiftPlane(mCurrQuantized);
+		}
+		else
+		{
+			shiftPlane(mPrevSolution);
+			shiftPlane(mCurrSolution);
+		}
+
+		// Everything moved: every row is dirty, every tile may be awake and needs
+		// its normals again.
+		for (UINT i = 0; i < mNumRows; ++i)
+			MarkRowDirty(i);
+		mTileAwake = mTileWet;
+		std::fill(mTileNormalsDirty.begin(), mTileNormalsDirty.end(), 1);
+		mNormalsDirty = true;
+	}
+
+	void Waves::RefreshShiftedNormals(int rows, int cols)
+	{
+		const int m = int(mNumRows);
+		const int n = int(mNumCols);
+
+		// The border is never computed and keeps the flat normals Init() gave it.
+		auto flatten = [this](UINT i, UINT j)
+			{
+				size_t k = size_t(PhysicalRow(i)) * mNumCols + PhysicalColumn(j);
+				mNormals[k] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				mTangentX[k] = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			};
+		for (UINT j = 0; j < mNumCols; ++j)
+		{
+			flatten(0, j);
+			flatten(mNumRows - 1, j);
+		}
+		for (UINT i = 1; i + 1 < mNumRows; ++i)
+		{
+			flatten(i, 0);
+			flatten(i, mNumCols - 1);
+		}
+
+		// Stale normals get recomputed anyway.
+		if (mNormalsDirty)
+			return;
+
+		// Otherwise only the interior points next to the cells shifted in, or on
+		// the old border, changed neighbors.
+		const UINT top = UINT(std::min(1 + std::max(-rows, 0), m - 1));
+		const UINT bottom = UINT(std::max(m - 1 - std::max(rows, 0), int(top)));
+		const UINT left = UINT(std::min(1 + std::max(-cols, 0), n - 1));
+		const UINT right = UINT(std::max(n - 1 - std::max(cols, 0), int(left)));
+		ComputeNormals(mCurrSolution, 1, top);
+		ComputeNormals(mCurrSolution, bottom, mNumRows - 1);
+		ComputeNormals(mCurrSolution, top, bottom, 1, left);
+		ComputeNormals(mCurrSolution, top, bottom, right, mNumCols - 1);
+	}
+
+	void Waves::SetScrolling(bool enabled)
+	{
+		if (!enabled)
+			UnrollRings();
+		mScrolling = enabled;
+	}
+
+	void Waves::UnrollRings()
+	{
+		if (mRowOffset == 0 && mColOffset == 0)
+			return;
+
+		auto unroll = [this](auto* plane, size_t pitch)
+			{
+				std::rotate(plane, plane + mRowOffset * pitch, plane + mNumRows * pitch);
+				for (UINT i = 0; i < mNumRows; ++i)
+					std::rotate(plane + i * pitch, plane + i * pitch + mColOffset, plane + i * pitch + mNumCols);
+			};
+
+		if (mCurrQuantized)
+		{
+			unroll(mPrevQuantized, mRowPitch);
+			unroll(mCurrQuantized, mRowPitch);
+		}
+		else
+		{
+			unroll(mPrevSolution, mRowPitch);
+			unroll(mCurrSolution, mRowPitch);
+			unroll(mNormals, mNumCols);
+			unroll(mTangentX, mNumCols);
+		}
+
+		mRowOffset = 0;
+		mColOffset = 0;
+	}
+
+	void Waves::Recenter(float x, float z)
+	{
+		const double dx = mSpatialStep;
+		const double cols = std::floor((double(x) - double(mWindowCol) * dx) / dx + 0.5);
+		const double rows = std::floor((-double(mWindowRow) * dx - double(z)) / dx + 0.5);
+		if (rows == 0.0 && cols == 0.0)
+			return;
+
+		mWindowRow += int64_t(rows);
+		mWindowCol += int64_t(cols);
+		// Anything past the grid size clears it all the same.
+		Shift(int(std::clamp(rows, -double(mNumRows), double(mNumRows))),
+			int(std::clamp(cols, -double(mNumCols), double(mNumCols))));
+	}
+
+	XMFLOAT2 Waves::Center()const
+	{
+		return XMFLOAT2(float(double(mWindowCol) * mSpatialStep), float(double(-mWindowRow) * mSpatialStep));
+	}
+
+	void Waves::SetAbsorbingBorder(UINT width, float reflection)
+	{
+		mAbsorbingWidth = width;
+		mAbsorbingReflection = std::clamp(reflection, std::numeric_limits<float>::min(), 1.0f);
+		if (mNumRows > 0)
+			BuildAbsorbingLayer();
+	}
+
+	void Waves::BuildAbsorbingLayer()
+	{
+		if (mAbsorbingWidth == 0)
+		{
+			mAbsorbingRows.clear();
+			mAbsorbingColumns.clear();
+			return;
+		}
+
+		// Courant number speed * dt / dx, from the stencil constants so that it
+		// also holds after LoadSnapshot(): k2 + 4 k3 = 4 / d and k3 = 2 e / d.
+		const float courant = std::sqrt(2.0f * mK3 / (mK2 + 4.0f * mK3));
+
+		// A point at depth t in (0, 1] loses sigma t^2 of its velocity per step,
+		// which takes sigma t^2 / 2 off the amplitude of a wave.  The wave spends
+		// width / courant steps crossing the layer, where t^2 averages 1/3, so it
+		// keeps exp(-sigma / 3 * width / courant) of its amplitude there and back.
+		const float width = static_cast<float>(mAbsorbingWidth);
+		const float sigma = 3.0f * std::log(1.0f / mAbsorbingReflection) * courant / width;
+
+		auto ramp = [this, width, sigma](std::vector<float>& factors, UINT count)
+			{
+				factors.assign(count, 1.0f);
+				for (UINT k = 1; k + 1 < count; ++k)
+				{
+					UINT distance = std::min(k, count - 1 - k);
+					if (distance > mAbsorbingWidth)
+						continue;
+					float t = (mAbsorbingWidth + 1 - distance) / width;
+					factors[k] = std::exp(-sigma * t * t);
+				}
+			};
+		ramp(mAbsorbingRows, mNumRows);
+		ramp(mAbsorbingColumns, mNumCols);
+	}
+
+	void Waves::ReadRow(float* dst, UINT i)const
+	{
+		const size_t row = size_t(PhysicalRow(i)) * mRowPitch;
+		ForEachRingRun(0, mNumCols, [&](UINT b, UINT e, UINT j)
+			{
+				if (mCurrQuantized)
+					waves_kernels::DequantizeRow(dst + j, mCurrQuantized + row + b, 0, e - b, mHeightScale);
+				else
+					std::memcpy(dst + j, mCurrSolution + row + b, (e - b) * sizeof(float));
+			});
+	}
+
+	void Waves::WriteRow(UINT i, const float* src)
+	{
+		const size_t row = size_t(PhysicalRow(i)) * mRowPitch;
+		ForEachRingRun(0, mNumCols, [&](UINT b, UINT e, UINT j)
+			{
+				if (mCurrQuantized)
+				{
+					for (UINT k = b; k < e; ++k)
+						mCurrQuantized[row + k] = Quantize(src[j + k - b], mHeightScale);
+				}
+				else
+				{
+					std::memcpy(mCurrSolution + row + b, src + j, (e - b) * sizeof(float));
+				}
+			});
+	}
+
+	void Waves::SetActiveTiles(bool enabled, float sleepThreshold)
+	{
+		// The field may not be at rest, let every tile decide after its next step.
+		if (enabled && !mActiveTiles)
+			mTileAwake = mTileWet;
+
+		mActiveTiles = enabled;
+		mSleepThreshold = sleepThreshold;
+	}
+
+	UINT Waves::ActiveTileCount()const
+	{
+		if (!mActiveTiles)
+			return mTileCountX * mTileCountZ;
+
+		return static_cast<UINT>(std::count(mTileAwake.begin(), mTileAwake.end(), 1));
+	}
+
+	void Waves::SetObstacleMask(const std::function<float(float x, float z)>& terrainHeight, float waterLevel)
+	{
+		mWet.assign(size_t(mNumRows) * mNumCols, 1);
+		for (UINT i = 0; i < mNumRows; ++i)
+		{
+			float z = mHalfDepth - i * mSpatialStep;
+			for (UINT j = 0; j < mNumCols; ++j)
+			{
+				float x = -mHalfWidth + j * mSpatialStep;
+				if (terrainHeight(x, z) < waterLevel)
+					continue;
+
+				mWet[size_t(i) * mNumCols + j] = 0;
+				size_t k = PlaneIndex(i, j);
+				if (mCurrQuantized)
+				{
+					mPrevQuantized[k] = 0;
+					mCurrQuantized[k] = 0;
+				}
+				else
+				{
+					mPrevSolution[k] = 0.0f;
+					mCurrSolution[k] = 0.0f;
+				}
+				MarkRowDirty(i);
+			}
+		}
+
+		BuildWetSpans();
+	}
+
+	void Waves::ClearObstacleMask()
+	{
+		mWet.clear();
+		BuildWetSpans();
+	}
+
+	void Waves::BuildWetSpans()
+	{
+		const UINT m = mNumRows;
+		const UINT n = mNumCols;
+
+		mWetSpans.clear();
+		mWetRowSpans.assign(size_t(m) + 1, 0);
+		for (UINT i = 1; i + 1 < m; ++i)
+		{
+			mWetRowSpans[i] = mWetSpans.size();
+
+			UINT j = 1;
+			while (j < n - 1)
+			{
+				while (j < n - 1 && !IsWet(i, j))
+					++j;
+				UINT spanBegin = j;
+				while (j < n - 1 && IsWet(i, j))
+					++j;
+				if (spanBegin < j)
+				{
+					mWetSpans.push_back(spanBegin);
+					mWetSpans.push_back(j);
+				}
+			}
+		}
+		mWetRowSpans[m - 1] = mWetSpans.size();
+		mWetRowSpans[m] = mWetSpans.size();
+
+		// A tile with no wet point is never stepped, whatever its neighbors do.
+		mTileWet.assign(size_t(mTileCountX) * mTileCountZ, 0);
+		for (UINT t = 0; t < mTileCountX * mTileCountZ; ++t)
+		{
+			UINT r0, r1, c0, c1;
+			TileBounds(t, r0, r1, c0, c1);
+			for (UINT i = r0; i < r1 && !mTileWet[t]; ++i)
+				ForEachWetSpan(i, c0, c1, [&](UINT, UINT) { mTileWet[t] = 1; });
+			mTileAwake[t] &= mTileWet[t];
+		}
+
+		if (mSolver == ESolver::ADI && mCurrSolution)
+			BuildImplicitMasks();
+	}
+
+	void Waves::SetStorage(EStorage storage, float heightRange)
+	{
+		if (!(heightRange > 0.0f))
+			throw std::invalid_argument("Waves::SetStorage: heightRange must be positive");
+
+		mStorage = storage;
+		mHeightScale = heightRange / 32767.0f;
+	}
+
+	void Waves::SetLargeGrid(bool enabled)
+	{
+		mLargeGrid = enabled;
+	}
+
+	void Waves::SetKernel(EKernel kernel)
+	{
+		mStencilRow = kernel == EKernel::Scalar
+			? &waves_kernels::StencilRowScalar
+			: waves_kernels::BestStencilRow();
+		mNormalRow = kernel == EKernel::Scalar
+			? &waves_kernels::NormalRowScalar
+			: waves_kernels::BestNormalRow();
+		mStencilRowInt16 = kernel == EKernel::Scalar
+			? &waves_kernels::StencilRowInt16Scalar
+			: waves_kernels::BestStencilRowInt16();
+		mTridiagonalColumns = kernel == EKernel::Scalar
+			? &waves_kernels::TridiagonalColumnsScalar
+			: waves_kernels::BestTridiagonalColumns();
+		mSplatRow = kernel == EKernel::Scalar
+			? &waves_kernels::SplatRowScalar
+			: waves_kernels::BestSplatRow();
+	}
+
+	void Waves::SetSolver(ESolver solver)
+	{
+		mSolver = solver;
+		if (mSolver == ESolver::ADI && mCurrSolution)
+			BuildImplicitMasks();
+	}
+
+	void Waves::SetThreadCount(UINT threadCount)
+	{
+		if (threadCount <= 1)
+			mThreadPool.reset();
+		else if (!mThreadPool || mThreadPool->ThreadCount() != threadCount)
+			mThreadPool = std::make_unique<ThreadPool>(threadCount);
+	}
+
+	void Waves::SetTemporalBlocking(UINT stepsPerSweep, UINT tileRows)
+	{
+		mStepsPerSweep = std::max(stepsPerSweep, 1u);
+		mBlockRows = tileRows;
+	}
+
+	UINT Waves::ThreadCount()const
+	{
+		return mThreadPool ? mThreadPool->ThreadCount() : 1;
 	}
 
 
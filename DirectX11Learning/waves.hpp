@@ -1,46 +1,526 @@
 #pragma once
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include "DirectXMath.h"
 
+#include "waves_kernels.hpp"
+
 using namespace DirectX;
 
 using UINT = uint32_t;
 
 namespace lea {
+	class MappedFile;
+	class ThreadPool;
+	class WavesRecording;
+
 	class Waves
 	{
 	public:
+		enum class EKernel {
+			Scalar,
+			SIMD, // widest of SSE/AVX2 the CPU runs
+		};
+
+		enum class ESolver {
+			// The explicit scheme, stable while speed * dt / dx stays under 1 / sqrt(2).
+			Explicit,
+			// Alternating-direction implicit, stable at any time step, see SetSolver().
+			ADI,
+		};
+
+		enum class EStorage {
+			Float,
+			// int16 fixed-point heights, normals computed on demand, see SetStorage()
+			Int16,
+		};
+
+		enum class EVertexLayout {
+			// Position, normal and texcoords like utils::Vertex3, 32 bytes per vertex.
+			Interleaved,
+			// Only what changes every frame, a DynamicVertex (8 bytes).  x, z and the
+			// texcoords come from a second, immutable stream, see EmitStaticVertices().
+			Split,
+		};
+
+		// Rows [begin, end) of the grid.
+		struct RowRange
+		{
+			UINT begin;
+			UINT end;
+		};
+
+		// Static stream of the split layout.
+		struct StaticVertex
+		{
+			float x;
+			float z;
+			float u;
+			float v;
+		};
+
+		// Per-frame stream of the split layout.
+		struct DynamicVertex
+		{
+			float height;
+			uint32_t normal; // DXGI_FORMAT_R8G8B8A8_SNORM
+		};
+
 		Waves();
 		~Waves();
 
 		UINT RowCount()const;
 		UINT ColumnCount()const;
-		UINT VertexCount()const;
-		UINT TriangleCount()const;
+		size_t VertexCount()const;
+		size_t TriangleCount()const;
 		float Width()const;
 		float Depth()const;
+		// Seconds of simulated time per step.
+		float TimeStep()const;
 
-		// Returns the solution at the ith grid point.
-		const DirectX::XMFLOAT3& operator[](int i)const { return mCurrSolution[i]; }
+		// Returns the solution at the ith grid point.  Only the heights are stored,
+		// x and z are derived from the grid index.
+		DirectX::XMFLOAT3 operator[](size_t i)const
+		{
+			UINT row = static_cast<UINT>(i / mNumCols);
+			UINT col = static_cast<UINT>(i - size_t(row) * mNumCols);
+			return DirectX::XMFLOAT3(-mHalfWidth + col * mSpatialStep, Height(row, col), mHalfDepth - row * mSpatialStep);
+		}
+
+		// Returns the height at grid row i, column j.
+		float Height(UINT i, UINT j)const
+		{
+			size_t k = PlaneIndex(i, j);
+			return mCurrQuantized ? mCurrQuantized[k] * mHeightScale : mCurrSolution[k];
+		}
+
+		// Returns the height of the step before, the other half of the state the
+		// explicit scheme carries.
+		float PreviousHeight(UINT i, UINT j)const
+		{
+			size_t k = PlaneIndex(i, j);
+			return mPrevQuantized ? mPrevQuantized[k] * mHeightScale : mPrevSolution[k];
+		}
 
 		// Returns the solution normal at the ith grid point.
-		const DirectX::XMFLOAT3& Normal(int i)const { return mNormals[i]; }
+		DirectX::XMFLOAT3 Normal(size_t i)const
+		{
+			if (mCurrQuantized)
+				return SampleNormal(i, false);
+			EnsureNormals();
+			return mNormals[NormalIndex(i)];
+		}
 
 		// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
-		const DirectX::XMFLOAT3& TangentX(int i)const { return mTangentX[i]; }
+		DirectX::XMFLOAT3 TangentX(size_t i)const
+		{
+			if (mCurrQuantized)
+				return SampleNormal(i, true);
+			EnsureNormals();
+			return mTangentX[NormalIndex(i)];
+		}
+
+		// Brings normals and tangents up to date with the heights.  Only does work
+		// in lazy mode, call it before a vertex emission pass so the first Normal()
+		// doesn't pay for the whole grid.
+		void EnsureNormals()const;
+
+		// Writes every vertex of the grid straight into dst, e.g. a mapped vertex
+		// buffer, one vertex every stride bytes.  Texcoords span [0, 1] like they
+		// always did in WavesApp.
+		void EmitVertices(void* dst, UINT stride, EVertexLayout layout)const;
+		// Same, but only for the vertices of the given rows, which end up at the same
+		// place in dst as with a full emission.
+		void EmitVertices(void* dst, UINT stride, EVertexLayout layout, const std::vector<RowRange>& rows)const;
+		// Writes the StaticVertex stream of the split layout, it only changes with Init().
+		void EmitStaticVertices(void* dst, UINT stride)const;
+
+		// Keeps a bitmap of the rows whose heights moved by more than tolerance since
+		// they were last taken with TakeDirtyRows().  The steps accumulate the largest
+		// height change of every row, Disturb() marks its rows right away.  Without
+		// tracking every row is always reported dirty.
+		void SetDirtyRowTracking(bool enabled, float tolerance = 1e-3f);
+		// Returns the rows whose vertices changed, merged into ranges, and marks
+		// them clean.  Normals depend on the rows around them, so every dirty row
+		// brings its neighbors along.
+		std::vector<RowRange> TakeDirtyRows();
+
+		// Delta packet with the heights of the given rows, e.g. for a remote viewer.
+		void SerializeRows(const std::vector<RowRange>& rows, std::vector<uint8_t>& packet)const;
+		// Viewer side of SerializeRows(): overwrites the heights of the rows in the
+		// packet, updates their normals and marks them dirty.  Throws
+		// std::runtime_error if the packet doesn't fit this grid.
+		void ApplyRows(const uint8_t* packet, size_t size);
+
+		// Selects how the next Init() stores the grid.  Float keeps two float
+		// height planes plus normals and tangents, 32 bytes per point.  Int16 keeps
+		// only two int16 planes in steps of heightRange / 32767, 4 bytes per point,
+		// and computes normals when they are read or emitted; a 4096x4096 grid
+		// takes 64 MB.  Steps read and write half the bytes of the float path.
+		//
+		// Accuracy: every step rounds to the nearest step of the fixed-point grid,
+		// so heights drift from the float path until damping wears the old errors
+		// away.  Heights beyond +-heightRange saturate and drift far more, so pick
+		// the range from the highest crests the float path reaches.  With the
+		// WavesApp constants (200x200 or 100x100, drops of 1 to 2 every 4 or 8
+		// steps) crests reach 13 to 21; the default range of 32 keeps every point
+		// within 0.5 of the float path over 10000 steps, a range of 8 saturates
+		// and is off by 5 to 12.  Waves smaller than half a step are lost instead
+		// of dying out smoothly.  Temporal blocking, active tiles and dirty-row
+		// tracking are not available in this mode.  Throws std::invalid_argument
+		// unless heightRange is positive.
+		void SetStorage(EStorage storage, float heightRange = 32.0f);
+
+		// Large-grid mode for offline runs on huge grids, e.g. 16k x 16k coastlines.
+		// The next Init() takes the height planes, normals and tangents straight
+		// from the OS on huge pages, see AllocateLargePages(), which saves most of
+		// the TLB misses of streaming gigabytes through a step.  Each thread then
+		// clears the rows of the band it steps, so on NUMA machines the rows are
+		// placed on the node that uses them; call SetThreadCount() before Init().
+		// Indices are 64-bit everywhere, only the row and column counts have to
+		// fit in a UINT.  Keep the footprint in mind: float storage takes 32 bytes
+		// per point (8 GB at 16k x 16k), Int16 storage 4 bytes.
+		void SetLargeGrid(bool enabled);
+
+		// Writes the state of the grid to a binary file: both height planes in
+		// their in-memory layout, the obstacle mask, the sleeping tiles, the
+		// queued disturbances and the time Update() has accumulated.  Normals are
+		// left out, so it takes 8 bytes per point with float storage and 4 with
+		// Int16.  Throws std::runtime_error if the file can't be written.
+		void SaveSnapshot(const char* path)const;
+		// Restores a SaveSnapshot() file in place of Init().  The file is mapped
+		// copy-on-write, see MappedFile, and the steps run on the height planes
+		// right where they are mapped: nothing is read or copied up front, pages
+		// come in from disk as they are first touched.  Normals are recomputed on
+		// their first use.  Grid size, time step, wave constants and storage come
+		// from the file; the other settings, e.g. threads, solver, active tiles,
+		// stay as they are; a scrolling grid's snapshot loaded with scrolling off
+		// is put back in order, which touches every point.  Throws
+		// std::runtime_error if the file can't be mapped or isn't a snapshot of
+		// this version.
+		void LoadSnapshot(const char* path);
+
+		// Logs every call that changes the grid into recording from here on, see
+		// WavesRecording.  nullptr stops logging.
+		void SetRecording(WavesRecording* recording);
+		WavesRecording* Recording()const;
 
 		void Init(UINT m, UINT n, float dx, float dt, float speed, float damping);
 		void Update(float dt);
+		// Advances the simulation by exactly `steps` time steps.
+		void Advance(UINT steps);
+		// Adds magnitude at grid row i, column j and half of it at the four
+		// neighbors.  Points on the border or on land are left out.
 		void Disturb(UINT i, UINT j, float magnitude);
 
+		// Queues an impulse for the next step.  Everything queued by then is
+		// applied in one pass just before the stencil runs, sorted by active tile
+		// so nearby impulses hit rows still in cache, in row bands on the thread
+		// pool.  Thousands per step are fine, e.g. rain, boat wakes or explosions.
+		// (row, col) may lie between grid points or off the grid.  With radius 0
+		// the impulse is the Disturb() stencil at the nearest point.  Otherwise it
+		// is a Gaussian bump with a standard deviation of radius cells, magnitude
+		// at its center, cut off at 3 radius.  Parts that fall on the border or on
+		// land are dropped.  Results don't depend on the thread count.
+		void QueueDisturbance(float row, float col, float magnitude, float radius = 0.0f);
+		size_t QueuedDisturbanceCount()const;
+
+		// Overwrites the state at grid row i, column j, e.g. to couple this grid to
+		// another one.  The border is never stepped, so writing it sets the boundary
+		// values of the next steps.  Land points stay flat.  Normals catch up on the
+		// next Normal()/EnsureNormals(), so with many writes per step lazy normals
+		// avoid computing them twice.
+		void SetHeight(UINT i, UINT j, float height, float previousHeight);
+
+		// Moves the solution by whole cells: point (i, j) takes the state of point
+		// (i + rows, j + cols), and points shifted in from outside the grid are flat.
+		// Lets a grid follow the camera; the caller keeps track of where it is.  Not
+		// for grids with an obstacle mask, which would not move along.  Moves every
+		// point unless scrolling is on, see SetScrolling().
+		void Shift(int rows, int cols);
+
+		// Scrolling mode for a window of water that follows the camera.  Both
+		// height planes and the normals become toroidal ring buffers: Shift() only
+		// moves the origin of the rings and clears the rows and columns shifted in,
+		// so moving the window costs the exposed cells instead of the whole grid,
+		// however far it travels.  Results are the same as without it.  Temporal
+		// blocking, active tiles and the ADI solver are not used while it is on.
+		// Turning it off puts the planes back in order, which moves every point
+		// once.
+		void SetScrolling(bool enabled);
+
+		// Shifts the window by whole cells so that world point (x, z) lies within
+		// half a cell of its center, e.g. the camera position every frame.  Does
+		// nothing until it has moved a full cell.  Positions from operator[] and
+		// emitted vertices stay relative to the window, draw it translated by
+		// Center().
+		void Recenter(float x, float z);
+		// World position of the window center, (0, 0) after Init().
+		DirectX::XMFLOAT2 Center()const;
+
+		// Absorbing layers along the four borders, so waves leave the grid
+		// instead of bouncing off its edges and a small grid passes for open
+		// water.  Within width cells of the border each step pulls the new height
+		// of a point back towards the current one, which damps its velocity the
+		// more the closer it is to the edge, on a quadratic ramp like a perfectly
+		// matched layer's; corners take the damping of both borders.  reflection
+		// is the amplitude a wave keeps after crossing the layer and back, the
+		// ramp follows the wave speed so that holds at any time step.  The ramp
+		// itself reflects too, more the longer the waves are next to its width.
+		// With the default, an undamped still Gaussian bump of standard deviation
+		// 1.5, 2.5, 4 and 6 cells comes back at 10, 17, 25 and 35% of what the
+		// bare border sends back from a 16-cell layer, 4, 7, 10 and 17% from a
+		// 32-cell one (peak error against a grid without borders).  The layer
+		// takes up cells of the grid, only the water it surrounds looks open.
+		// Works with every solver, storage and mode; width 0 turns it off.
+		void SetAbsorbingBorder(UINT width, float reflection = 5e-3f);
+
+		void SetKernel(EKernel kernel);
+
+		// Selects the time integration.  ADI treats the Laplacian implicitly,
+		// averaged over three time levels with weights 1/4, 1/2, 1/4 and factored
+		// into an x and a z sweep, which keeps it stable at any dt: a coarse grid
+		// can cover a large area with time steps far past the explicit limit.
+		// Each sweep solves one tridiagonal system per row or column, one system
+		// per SIMD lane, spread over the threads.  Long time steps still cost
+		// accuracy, short waves then travel too slowly instead of blowing up.
+		// Int16 storage always steps explicitly, and temporal blocking and active
+		// tiles are not used with ADI.
+		void SetSolver(ESolver solver);
+
+		// Splits each step into row bands run on threadCount threads (the caller
+		// included).  Each band updates its heights, waits at one barrier and then
+		// updates its normals, so results are bit-identical to the serial path at
+		// any thread count.  0 or 1 runs serially.
+		void SetThreadCount(UINT threadCount);
+		UINT ThreadCount()const;
+
+		// Temporal blocking for grids larger than the cache: the grid is cut into
+		// tiles of tileRows rows and each tile is advanced stepsPerSweep steps,
+		// using overlapped ghost rows, before moving on to the next tile.  The grid
+		// then streams through memory once per stepsPerSweep steps instead of once
+		// per step.  Results are bit-identical to stepping one sweep at a time.
+		// In this mode Update() runs every whole time step that has accumulated.
+		// stepsPerSweep <= 1 disables it, tileRows = 0 picks a cache-sized tile.
+		void SetTemporalBlocking(UINT stepsPerSweep, UINT tileRows = 0);
+
+		// In lazy mode steps only advance the heights; normals and tangents are
+		// computed on the first Normal()/TangentX()/EnsureNormals() after a step.
+		// Consumers that only read heights never pay for them.
+		void SetLazyNormals(bool lazy);
+
+		// Sparse mode for mostly calm water: the grid is split into ActiveTileSize
+		// square tiles.  A tile whose heights and velocities all fall under
+		// sleepThreshold goes to sleep and is frozen; it is only stepped again when
+		// a neighboring tile is awake or Disturb() touches it.  Step cost then scales
+		// with the disturbed area instead of the whole grid.  Temporal blocking is
+		// not used while this mode is on.
+		static constexpr UINT ActiveTileSize = 32;
+		void SetActiveTiles(bool enabled, float sleepThreshold = 1e-3f);
+		UINT ActiveTileCount()const;
+
+		// Marks every grid point where terrainHeight(x, z) >= waterLevel as land.
+		// Land points are never simulated and stay at height 0, so they act as
+		// reflecting walls like the grid border does.  Each row keeps a list of its
+		// wet spans, so rows and tiles that are entirely land cost nothing and the
+		// stencil itself has no per-point test.  Call it after Init(), which clears
+		// the mask again.
+		void SetObstacleMask(const std::function<float(float x, float z)>& terrainHeight, float waterLevel);
+		void ClearObstacleMask();
+		bool IsWet(UINT i, UINT j)const { return mWet.empty() || mWet[size_t(i) * mNumCols + j]; }
+
 	private:
+		// Per-thread working set of the temporally blocked step.
+		struct TemporalScratch
+		{
+			std::vector<float> prev;
+			std::vector<float> curr;
+			// Original rows just above the tile being loaded, [0, depth) prev and [depth, 2 * depth) curr.
+			std::vector<float> above;
+			// Original rows just below the band, same layout as above.
+			std::vector<float> below;
+		};
+
+		// An impulse of the disturbance queue with the interior rows [r0, r1) and
+		// columns [c0, c1) it covers.
+		struct QueuedDisturbance
+		{
+			float row;
+			float col;
+			float magnitude;
+			float radius;
+			UINT tile;
+			UINT r0;
+			UINT r1;
+			UINT c0;
+			UINT c1;
+		};
+
+		void FreePlanes();
+
+		// Where logical row i and column j are stored in the ring buffers, see
+		// SetScrolling().  Identity while the rings are in order.
+		UINT PhysicalRow(UINT i)const
+		{
+			UINT r = i + mRowOffset;
+			return r >= mNumRows ? r - mNumRows : r;
+		}
+		UINT PhysicalColumn(UINT j)const
+		{
+			UINT c = j + mColOffset;
+			return c >= mNumCols ? c - mNumCols : c;
+		}
+		size_t PlaneIndex(UINT i, UINT j)const { return size_t(PhysicalRow(i)) * mRowPitch + PhysicalColumn(j); }
+		// Index into mNormals and mTangentX of the ith grid point.
+		size_t NormalIndex(size_t i)const
+		{
+			if (mRowOffset == 0 && mColOffset == 0)
+				return i;
+			UINT row = static_cast<UINT>(i / mNumCols);
+			UINT col = static_cast<UINT>(i - size_t(row) * mNumCols);
+			return size_t(PhysicalRow(row)) * mNumCols + PhysicalColumn(col);
+		}
+
+		// Calls fn(physicalBegin, physicalEnd, logicalBegin) for the parts of the
+		// logical columns [begin, end) that are contiguous in a row of the rings.
+		template<typename Fn>
+		void ForEachRingRun(UINT begin, UINT end, Fn&& fn)const
+		{
+			if (begin >= end)
+				return;
+
+			UINT b = PhysicalColumn(begin);
+			UINT count = end - begin;
+			if (b + count <= mNumCols)
+			{
+				fn(b, b + count, begin);
+				return;
+			}
+			fn(b, mNumCols, begin);
+			fn(0, b + count - mNumCols, begin + (mNumCols - b));
+		}
+
+		// Same for interior columns [begin, end) that a row kernel reads one
+		// column to each side of.  The kernels get fn(physicalBegin, physicalEnd);
+		// the columns at the two ends of a row, whose neighbors are at the other
+		// end, go to seam(physicalColumn) one at a time.
+		template<typename Fn, typename SeamFn>
+		void ForEachRingSpan(UINT begin, UINT end, Fn&& fn, SeamFn&& seam)const
+		{
+			ForEachRingRun(begin, end, [&](UINT b, UINT e, UINT)
+				{
+					if (b == 0)
+						seam(b++);
+					if (e == mNumCols && b < e)
+						seam(--e);
+					if (b < e)
+						fn(b, e);
+				});
+		}
+
+		// Calls fn(physicalBegin, count, factors, scale) for the parts of the
+		// logical columns [begin, end) of row i that lie in the absorbing layer,
+		// with the column factors of the first of them and the factor of the row.
+		template<typename Fn>
+		void ForEachAbsorbingRun(UINT i, UINT begin, UINT end, Fn&& fn)const
+		{
+			if (mAbsorbingWidth == 0)
+				return;
+
+			auto run = [&](UINT runBegin, UINT runEnd)
+				{
+					ForEachRingRun(runBegin, runEnd, [&](UINT b, UINT e, UINT logicalBegin)
+						{
+							fn(b, e - b, mAbsorbingColumns.data() + logicalBegin, mAbsorbingRows[i]);
+						});
+				};
+
+			// Rows within the layer are damped all along, the others only near
+			// the left and right border.
+			if (std::min(i, mNumRows - 1 - i) <= mAbsorbingWidth)
+			{
+				run(begin, end);
+				return;
+			}
+			UINT leftEnd = std::min(end, mAbsorbingWidth + 1);
+			run(begin, leftEnd);
+			run(std::max({ begin, leftEnd, mNumCols - 1 - std::min(mAbsorbingWidth, mNumCols - 1) }), end);
+		}
+
+		// Current heights of row i in column order, and back.
+		void ReadRow(float* dst, UINT i)const;
+		void WriteRow(UINT i, const float* src);
+
+		// Makes the rings start at physical (0, 0) again.
+		void UnrollRings();
+		// Per-step damping factors of the absorbing layer, see SetAbsorbingBorder().
+		void BuildAbsorbingLayer();
+		// After a scrolling Shift(): resets the normals of the new border and
+		// recomputes those next to the cells shifted in.
+		void RefreshShiftedNormals(int rows, int cols);
+		// Advance() without logging it, also used by Update().
+		void AdvanceSteps(UINT steps);
+		// Adds to the height of a water point, without any bookkeeping.
+		void AddHeight(UINT i, UINT j, float magnitude);
+		void ApplyDisturbances();
+		void Step();
+		void StepQuantized();
+		void StepImplicit();
+		// Builds the ADI masks from the wet spans and sizes the ADI planes.
+		void BuildImplicitMasks();
+		DirectX::XMFLOAT3 SampleNormal(size_t i, bool tangent)const;
+		void StepBlocked(UINT depth);
+		void StepTiles();
+		void UpdateHeights(UINT rowBegin, UINT rowEnd);
+		void ComputeNormals(const float* heights, UINT rowBegin, UINT rowEnd)const;
+		void ComputeNormals(const float* heights, UINT rowBegin, UINT rowEnd, UINT colBegin, UINT colEnd)const;
+		// Normals of the first and last row of a band, once the neighboring bands are done.
+		void ComputeBandEdgeNormals(const float* heights, UINT rowBegin, UINT rowEnd)const;
+		void ComputeTileNormals(const float* heights, UINT tileBegin, UINT tileEnd)const;
+
+		// Interior cell rows [r0, r1) and columns [c0, c1) covered by a tile.
+		void TileBounds(UINT tile, UINT& r0, UINT& r1, UINT& c0, UINT& c1)const;
+		void WakeTileAt(UINT i, UINT j);
+
+		void EmitRows(uint8_t* dst, UINT stride, EVertexLayout layout, UINT rowBegin, UINT rowEnd)const;
+
+		// Adds the height change of the last step(s) to every row's drift and marks
+		// the rows that drifted past the tolerance.
+		void CollectDirtyRows();
+		void MarkRowDirty(UINT i) { mDirtyRows[i / 64] |= uint64_t(1) << (i % 64); }
+
+		// Rebuilds the wet spans of every row and the wet flag of every tile from mWet.
+		void BuildWetSpans();
+
+		// Calls fn(spanBegin, spanEnd) for the wet parts of row i within columns [begin, end).
+		template<typename Fn>
+		void ForEachWetSpan(UINT i, UINT begin, UINT end, Fn&& fn)const
+		{
+			for (size_t s = mWetRowSpans[i]; s < mWetRowSpans[i + 1]; s += 2)
+			{
+				UINT spanBegin = std::max(mWetSpans[s], begin);
+				UINT spanEnd = std::min(mWetSpans[s + 1], end);
+				if (spanBegin < spanEnd)
+					fn(spanBegin, spanEnd);
+			}
+		}
+
 		UINT mNumRows;
 		UINT mNumCols;
 
-		UINT mVertexCount;
-		UINT mTriangleCount;
+		// Elements, floats or int16s, between the starts of two consecutive rows of
+		// a height plane.  Rows are padded so that each of them starts on a 64-byte
+		// boundary.
+		UINT mRowPitch;
+
+		size_t mVertexCount;
+		size_t mTriangleCount;
 
 		// Simulation constants we can precompute.
 		float mK1;
@@ -49,11 +529,107 @@ namespace lea {
 
 		float mTimeStep;
 		float mSpatialStep;
+		// Time accumulated by Update() since the last step.
+		float mTimeAccum;
+
+		float mHalfWidth;
+		float mHalfDepth;
+
+		waves_kernels::StencilRowFn mStencilRow;
+		waves_kernels::NormalRowFn mNormalRow;
+
+		std::unique_ptr<ThreadPool> mThreadPool;
+
+		UINT mStepsPerSweep;
+		UINT mBlockRows;
+		std::vector<TemporalScratch> mTemporalScratch;
+
+		bool mLazyNormals;
+		mutable bool mNormalsDirty;
+
+		bool mActiveTiles;
+		float mSleepThreshold;
+		UINT mTileCountX;
+		UINT mTileCountZ;
+		std::vector<uint8_t> mTileAwake;
+		std::vector<uint8_t> mTileUpdate;
+		mutable std::vector<uint8_t> mTileNormalsDirty;
+		std::vector<uint8_t> mTileWet;
+
+		// One byte per grid point, 1 for water.  Empty when there is no mask.
+		std::vector<uint8_t> mWet;
+		// Begin/end column pairs of the wet spans of all rows; the spans of row i
+		// are [mWetRowSpans[i], mWetRowSpans[i + 1]).
+		std::vector<UINT> mWetSpans;
+		std::vector<size_t> mWetRowSpans;
+
+		bool mTrackDirtyRows;
+		float mDirtyTolerance;
+		std::vector<uint64_t> mDirtyRows;
+		// Largest height change of each row in the current step, written by the
+		// thread owning the row, and its sum since the row was last taken.
+		std::vector<float> mRowDelta;
+		std::vector<float> mRowDrift;
+
+		ESolver mSolver;
+		waves_kernels::TridiagonalColumnsFn mTridiagonalColumns;
+		// ADI constants, see StepImplicit().
+		float mAdiLaplacian;
+		float mAdiDamping;
+		float mAdiBeta;
+		// Floats between consecutive rows of the transposed planes.
+		UINT mAdiPitchT;
+		// 1 where the ADI sweeps solve for the heights, 0 on the border and on land,
+		// in grid layout and transposed.
+		std::vector<float> mAdiMask;
+		std::vector<float> mAdiMaskT;
+		// Right-hand side and intermediate solutions of the sweeps.
+		std::vector<float> mAdiWork;
+		std::vector<float> mAdiWorkT;
+		// Per thread forward-elimination coefficients of the tridiagonal solves.
+		std::vector<std::vector<float>> mAdiScratch;
+
+		std::vector<QueuedDisturbance> mDisturbances;
+		waves_kernels::SplatRowFn mSplatRow;
+
+		EStorage mStorage;
+		float mHeightScale;
+		waves_kernels::StencilRowInt16Fn mStencilRowInt16;
+
+		bool mLargeGrid;
+		// Whether the current planes came from AllocateLargePages().
+		bool mPlanesOnLargePages;
+		// Mapping of the snapshot the height planes live in after LoadSnapshot(),
+		// null when they were allocated by Init().
+		std::unique_ptr<MappedFile> mSnapshot;
+
+		WavesRecording* mRecording;
+
+		bool mScrolling;
+		// Physical row and column of logical point (0, 0) in the ring buffers.
+		UINT mRowOffset;
+		UINT mColOffset;
+		// Cells Recenter() moved the window by.
+		int64_t mWindowRow;
+		int64_t mWindowCol;
+
+		UINT mAbsorbingWidth;
+		float mAbsorbingReflection;
+		// Factor of every row and column, 1 outside the layer; a point is damped
+		// by the product of its row's and its column's.
+		std::vector<float> mAbsorbingRows;
+		std::vector<float> mAbsorbingColumns;
 
-		DirectX::XMFLOAT3* mPrevSolution;
-		DirectX::XMFLOAT3* mCurrSolution;
+		// Structure-of-arrays height planes, 64-byte aligned.  Either the float or
+		// the quantized pair is allocated, see SetStorage().
+		float* mPrevSolution;
+		float* mCurrSolution;
+		int16_t* mPrevQuantized;
+		int16_t* mCurrQuantized;
+		// Normals and tangents are a cache of the heights, filled on demand in lazy
+		// mode.  Not allocated with Int16 storage.
 		DirectX::XMFLOAT3* mNormals;
 		DirectX::XMFLOAT3* mTangentX;
 	};
 
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #include "waves_app.hpp"
 
 #include <algorithm>
+#include <cstring>
+#include <thread>
 #include <vector>
 
 #include <DirectXMath.h>
@@ -8,6 +10,7 @@
 
 #include "lea_timer.hpp"
 #include "lea_engine_utils.hpp"
+#include "lea_mesh_optimizer.hpp"
 #include "DXHelper.hpp"
 
 using lea::utils::Vertex3;
@@ -69,7 +72,14 @@ namespace lea {
 	}
 	void WavesApp::Init()
 	{
+		waves.SetThreadCount(std::thread::hardware_concurrency());
 		waves.Init(200, 200, 0.8f, 0.03f, 3.25f, 0.4f);
+		waves.SetActiveTiles(true);
+		waves.SetDirtyRowTracking(true);
+		// The water plane sits 3 units down, see mWavesWorld.
+		waves.SetObstacleMask([this](float x, float z) { return GetHeight(x, z); }, -3.0f);
+		// Levels of 102, 205, 410 and 819 units a side.
+		wavesClipmap_.Init(ClipmapLevelCount, 129, 0.8f, 0.03f, 3.25f, 0.4f);
 
 		InitFX();
 		LoadTextures();
@@ -77,6 +87,7 @@ namespace lea {
 		CreateInputLayout();
 		BuildLandGeometryBuffers();
 		BuildWavesGeometryBuffers();
+		BuildClipmapGeometryBuffers();
 		BuildCommonGeometryBuffers();
 
 		device_.Context()->IASetInputLayout(inputLayout_.Get());
@@ -87,6 +98,8 @@ namespace lea {
 		XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * XM_PI,
 			window_.AspectRatio(), 1.0f, 1000.0f);
 		XMStoreFloat4x4(&mProj, P);
+
+		wavesThread_.Start();
 	}
 	void WavesApp::PollEvents()
 	{
@@ -132,6 +145,15 @@ namespace lea {
 			{
 				renderOptions = ERenderTypes::LightAndTextures;
 			}
+			if (event.key == LeaEvent::KeyFour)
+			{
+				// Only the sea on screen is stepped.
+				drawClipmap_ = !drawClipmap_;
+				if (drawClipmap_)
+					wavesThread_.Stop();
+				else
+					wavesThread_.Start();
+			}
 		}
 		m_LastMousePos.first = event.mouse_x;
 		m_LastMousePos.second = event.mouse_y;
@@ -167,29 +189,49 @@ namespace lea {
 
 			float r = MathHelper::RandF(1.0f, 2.0f);
 
-			waves.Disturb(i, j, r);
+			if (drawClipmap_)
+				wavesClipmap_.Disturb(MathHelper::RandF(-80.0f, 80.0f), MathHelper::RandF(-80.0f, 80.0f), r);
+			else
+				wavesThread_.Disturb(i, j, r);
 		}
 
-		waves.Update(deltaTime);
-
-		//
-		// Update the wave vertex buffer with the new solution.
-		//
-
-		D3D11_MAPPED_SUBRESOURCE mappedData;
-		DX::ThrowIfFailed(device_.Context()->Map(wavesVertexBuffer_.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
-
-		Vertex3* v = reinterpret_cast<Vertex3*>(mappedData.pData);
-		for (UINT i = 0; i < waves.VertexCount(); ++i)
+		if (drawClipmap_)
 		{
-			v[i].pos = waves[i];
-			v[i].norm = waves.Normal(i);
-
-			v[i].tex.x = 0.5f + waves[i].x / waves.Width();
-			v[i].tex.y = 0.5f - waves[i].z / waves.Depth();
+			// The levels follow the camera, the finest one right under it.
+			wavesClipmap_.SetCenter(mEyePosW.x, mEyePosW.z);
+			wavesClipmap_.Update(deltaTime);
+			UpdateClipmapGeometryBuffers();
+		}
+		else
+		{
+			//
+			// Update the wave vertex buffer with the latest solution of the
+			// simulation thread.
+			//
+
+			// Only heights and normals change, x, z and texcoords live in
+			// wavesStaticVertexBuffer_.  Rows that didn't move are left alone, unless
+			// frames were skipped since the last upload.
+			const WavesThread::Frame& frame = wavesThread_.LatestFrame();
+			if (frame.sequence != wavesSequence_)
+			{
+				std::vector<Waves::RowRange> allRows = { { 0, waves.RowCount() } };
+				const std::vector<Waves::RowRange>& dirtyRows = frame.sequence == wavesSequence_ + 1 ? frame.rows : allRows;
+				wavesSequence_ = frame.sequence;
+
+				const UINT rowBytes = sizeof(Waves::DynamicVertex) * waves.ColumnCount();
+				for (const Waves::RowRange& rows : dirtyRows)
+				{
+					D3D11_BOX box{};
+					box.left = rows.begin * rowBytes;
+					box.right = rows.end * rowBytes;
+					box.bottom = 1;
+					box.back = 1;
+					device_.Context()->UpdateSubresource(wavesVertexBuffer_.Get(), 0, &box,
+						reinterpret_cast<const uint8_t*>(frame.vertices.data()) + box.left, 0, 0);
+				}
+			}
 		}
-
-		device_.Context()->Unmap(wavesVertexBuffer_.Get(), 0);
 
 		XMMATRIX wavesScale = XMMatrixScaling(5.0f, 5.0f, 5.0f);
 		mWaterTexOffset.y += 0.05f * deltaTime;
@@ -202,30 +244,23 @@ namespace lea {
 	void WavesApp::BuildLandGeometryBuffers()
 	{
 		using namespace lea::utils;
-		GeometryGenerator::MeshData grid;
+		GeometryGenerator::BasicMeshData<Vertex3> grid;
 
 		GeometryGenerator geoGen;
 
 		geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+		MeshOptimizer::Optimize(grid);
 
 		mGridIndexCount = grid.Indices.size();
 
 		//
-		// Extract the vertex elements we are interested and apply the height function to
-		// each vertex.  In addition, color the vertices based on their height so we have
-		// sandy looking beaches, grassy low hills, and snow mountain peaks.
+		// Apply the height function to each vertex, in place.
 		//
 
-		std::vector<Vertex3> vertices(grid.Vertices.size());
-		for (size_t i = 0; i < grid.Vertices.size(); ++i)
+		for (Vertex3& v : grid.Vertices)
 		{
-			XMFLOAT3 p = grid.Vertices[i].Position;
-
-			p.y = GetHeight(p.x, p.z);
-
-			vertices[i].pos = p;
-			vertices[i].norm = GetHillNormal(p.x, p.z);
-			vertices[i].tex = grid.Vertices[i].TexC;
+			v.pos.y = GetHeight(v.pos.x, v.pos.z);
+			v.norm = GetHillNormal(v.pos.x, v.pos.z);
 		}
 
 		D3D11_BUFFER_DESC vbd{};
@@ -235,31 +270,39 @@ namespace lea {
 		vbd.CPUAccessFlags = 0;
 		vbd.MiscFlags = 0;
 		D3D11_SUBRESOURCE_DATA vinitData{};
-		vinitData.pSysMem = vertices.data();
+		vinitData.pSysMem = grid.Vertices.data();
 		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&vbd, &vinitData, landVertexBuffer_.GetAddressOf()));
 
 		//
 		// Pack the indices of all the meshes into one index buffer.
 		//
 
-		D3D11_BUFFER_DESC ibd{};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;
-		ibd.ByteWidth = sizeof(UINT) * mGridIndexCount;
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		ibd.CPUAccessFlags = 0;
-		ibd.MiscFlags = 0;
-		D3D11_SUBRESOURCE_DATA iinitData{};
-		iinitData.pSysMem = grid.Indices.data();
-		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&ibd, &iinitData, landIndexBuffer_.GetAddressOf()));
+		IndexBufferData indices;
+		indices.Append(grid.Indices);
+		landIndexFormat_ = device_.CreateIndexBuffer(indices, landIndexBuffer_.GetAddressOf());
 
 	}
 	void WavesApp::BuildWavesGeometryBuffers()
 	{
+		std::vector<Waves::StaticVertex> staticVertices(waves.VertexCount());
+		waves.EmitStaticVertices(staticVertices.data(), sizeof(Waves::StaticVertex));
+
+		D3D11_BUFFER_DESC svbd{};
+		svbd.Usage = D3D11_USAGE_IMMUTABLE;
+		svbd.ByteWidth = static_cast<UINT>(sizeof(Waves::StaticVertex) * waves.VertexCount());
+		svbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		svbd.CPUAccessFlags = 0;
+		svbd.MiscFlags = 0;
+		D3D11_SUBRESOURCE_DATA svinitData{};
+		svinitData.pSysMem = staticVertices.data();
+		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&svbd, &svinitData, wavesStaticVertexBuffer_.GetAddressOf()));
+
+		// Partial updates keep the rest of the buffer, which WRITE_DISCARD maps can't.
 		D3D11_BUFFER_DESC vbd{};
-		vbd.Usage = D3D11_USAGE_DYNAMIC;
-		vbd.ByteWidth = sizeof(Vertex3) * waves.VertexCount();
+		vbd.Usage = D3D11_USAGE_DEFAULT;
+		vbd.ByteWidth = static_cast<UINT>(sizeof(Waves::DynamicVertex) * waves.VertexCount());
 		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		vbd.CPUAccessFlags = 0;
 		vbd.MiscFlags = 0;
 		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&vbd, 0, wavesVertexBuffer_.GetAddressOf()));
 
@@ -289,15 +332,79 @@ namespace lea {
 			}
 		}
 
+		// Only the triangle order changes; the vertices stay in the row order
+		// Waves writes them in.
+		MeshOptimizer::OptimizeVertexCache(indices.data(), indices.size(), waves.VertexCount());
+
+		// 16-bit while the grid has fewer than 65535 points, like the 200x200 one.
+		utils::IndexBufferData indexData;
+		indexData.Append(indices);
+		wavesIndexFormat_ = device_.CreateIndexBuffer(indexData, wavesIndexBuffer_.GetAddressOf());
+	}
+	void WavesApp::BuildClipmapGeometryBuffers()
+	{
+		const Waves& finest = wavesClipmap_.Level(0);
+		const UINT n = finest.RowCount();
+
+		D3D11_BUFFER_DESC vbd{};
+		vbd.Usage = D3D11_USAGE_DYNAMIC;
+		vbd.ByteWidth = static_cast<UINT>(sizeof(Vertex3) * finest.VertexCount());
+		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		vbd.MiscFlags = 0;
+
+		// At most two triangles a cell; the hole and the stitched border have fewer.
 		D3D11_BUFFER_DESC ibd{};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;
-		ibd.ByteWidth = sizeof(UINT) * indices.size();
+		ibd.Usage = D3D11_USAGE_DYNAMIC;
+		ibd.ByteWidth = sizeof(UINT) * 6 * (n - 1) * (n - 1);
 		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		ibd.CPUAccessFlags = 0;
+		ibd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		ibd.MiscFlags = 0;
-		D3D11_SUBRESOURCE_DATA iinitData{};
-		iinitData.pSysMem = indices.data();
-		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&ibd, &iinitData, wavesIndexBuffer_.GetAddressOf()));
+
+		const UINT levelCount = wavesClipmap_.LevelCount();
+		clipmapVertexBuffers_.resize(levelCount);
+		clipmapIndexBuffers_.resize(levelCount);
+		clipmapIndexCounts_.assign(levelCount, 0);
+		for (UINT l = 0; l < levelCount; ++l)
+		{
+			DX::ThrowIfFailed(device_.Device()->CreateBuffer(&vbd, nullptr, clipmapVertexBuffers_[l].ReleaseAndGetAddressOf()));
+			DX::ThrowIfFailed(device_.Device()->CreateBuffer(&ibd, nullptr, clipmapIndexBuffers_[l].ReleaseAndGetAddressOf()));
+		}
+
+		// The indices are written with the first vertices.
+		clipmapLayoutVersion_ = wavesClipmap_.LayoutVersion() - 1;
+	}
+	void WavesApp::UpdateClipmapGeometryBuffers()
+	{
+		auto context = device_.Context();
+		const bool layoutChanged = wavesClipmap_.LayoutVersion() != clipmapLayoutVersion_;
+		clipmapLayoutVersion_ = wavesClipmap_.LayoutVersion();
+
+		std::vector<UINT> indices;
+		for (UINT l = 0; l < wavesClipmap_.LevelCount(); ++l)
+		{
+			D3D11_MAPPED_SUBRESOURCE mappedData;
+			DX::ThrowIfFailed(context->Map(clipmapVertexBuffers_[l].Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+			Vertex3* v = reinterpret_cast<Vertex3*>(mappedData.pData);
+			const size_t vertexCount = wavesClipmap_.Level(l).VertexCount();
+			for (size_t i = 0; i < vertexCount; ++i)
+			{
+				v[i].pos = wavesClipmap_.Position(l, i);
+				v[i].norm = wavesClipmap_.Normal(l, i);
+				// Same texture scale as the single grid, which is 160 units wide.
+				v[i].tex = XMFLOAT2(0.5f + v[i].pos.x / 160.0f, 0.5f - v[i].pos.z / 160.0f);
+			}
+			context->Unmap(clipmapVertexBuffers_[l].Get(), 0);
+
+			if (!layoutChanged)
+				continue;
+
+			wavesClipmap_.BuildIndices(l, indices);
+			DX::ThrowIfFailed(context->Map(clipmapIndexBuffers_[l].Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedData));
+			std::memcpy(mappedData.pData, indices.data(), sizeof(UINT) * indices.size());
+			context->Unmap(clipmapIndexBuffers_[l].Get(), 0);
+			clipmapIndexCounts_[l] = static_cast<UINT>(indices.size());
+		}
 	}
 	void WavesApp::BuildCommonGeometryBuffers()
 	{
@@ -305,45 +412,29 @@ namespace lea {
 
 		GeometryGenerator gen;
 
-		GeometryGenerator::MeshData boxMesh;
+		GeometryGenerator::BasicMeshData<Vertex3> boxMesh;
 
 		gen.CreateBox(1.f, 1.f, 1.f, boxMesh);
 
 		mBoxIndexCount = boxMesh.Indices.size();
 
-		std::vector<Vertex3> vertices(boxMesh.Vertices.size());
-
-		for (UINT i = 0; i < boxMesh.Vertices.size(); ++i)
-		{
-			vertices[i].pos = boxMesh.Vertices[i].Position;
-			vertices[i].norm = boxMesh.Vertices[i].Normal;
-			vertices[i].tex = boxMesh.Vertices[i].TexC;
-		}
-
-
 		D3D11_BUFFER_DESC vbd{};
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;
-		vbd.ByteWidth = sizeof(Vertex3) * vertices.size();
+		vbd.ByteWidth = sizeof(Vertex3) * boxMesh.Vertices.size();
 		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 		vbd.CPUAccessFlags = 0;
 		vbd.MiscFlags = 0;
 		D3D11_SUBRESOURCE_DATA vinitData{};
-		vinitData.pSysMem = vertices.data();
+		vinitData.pSysMem = boxMesh.Vertices.data();
 		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&vbd, &vinitData, commonVertexBuffer_.GetAddressOf()));
 
 		//
 		// Pack the indices of all the meshes into one index buffer.
 		//
 
-		D3D11_BUFFER_DESC ibd{};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;
-		ibd.ByteWidth = sizeof(UINT) * mBoxIndexCount;
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		ibd.CPUAccessFlags = 0;
-		ibd.MiscFlags = 0;
-		D3D11_SUBRESOURCE_DATA iinitData{};
-		iinitData.pSysMem = boxMesh.Indices.data();
-		DX::ThrowIfFailed(device_.Device()->CreateBuffer(&ibd, &iinitData, commonIndexBuffer_.GetAddressOf()));
+		lea::utils::IndexBufferData indices;
+		indices.Append(boxMesh.Indices);
+		commonIndexFormat_ = device_.CreateIndexBuffer(indices, commonIndexBuffer_.GetAddressOf());
 	}
 
 	void WavesApp::CreateInputLayout()
@@ -359,6 +450,18 @@ namespace lea {
 		DX::ThrowIfFailed(
 			device_.Device()->CreateInputLayout
 			(inputs, ARRAYSIZE(inputs), passDesc.pIAInputSignature, passDesc.IAInputSignatureSize, inputLayout_.GetAddressOf()));
+
+		// Water: slot 0 is Waves::StaticVertex, slot 1 is Waves::DynamicVertex.
+		D3D11_INPUT_ELEMENT_DESC wavesInputs[] = {
+		{"POSITION", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"HEIGHT", 0, DXGI_FORMAT_R32_FLOAT, 1, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		{"NORMAL", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 1, 4, D3D11_INPUT_PER_VERTEX_DATA, 0},
+		};
+
+		wavesEffectTechniques_.at(ERenderTypes::LightOnly)->GetPassByIndex(0)->GetDesc(&passDesc);
+		DX::ThrowIfFailed(
+			device_.Device()->CreateInputLayout
+			(wavesInputs, ARRAYSIZE(wavesInputs), passDesc.pIAInputSignature, passDesc.IAInputSignatureSize, wavesInputLayout_.GetAddressOf()));
 	}
 
 	void WavesApp::CreateRasterizerStates()
@@ -420,6 +523,11 @@ namespace lea {
 			{ ERenderTypes::LightAndTextures, effect_->GetTechniqueByName("Light3TexAlphaClip")},
 			{ ERenderTypes::LightAndTexturesAndFog, effect_->GetTechniqueByName("Light3TexAlphaClipFog")},
 		};
+		wavesEffectTechniques_ = {
+			{ ERenderTypes::LightOnly, effect_->GetTechniqueByName("Light3Split")},
+			{ ERenderTypes::LightAndTextures, effect_->GetTechniqueByName("Light3TexAlphaClipSplit")},
+			{ ERenderTypes::LightAndTexturesAndFog, effect_->GetTechniqueByName("Light3TexAlphaClipFogSplit")},
+		};
 
 		mfxWorldViewProj = effect_->GetVariableByName("gWorldProjectView")->AsMatrix();
 		mfxWorld = effect_->GetVariableByName("gWorld")->AsMatrix();
@@ -466,6 +574,11 @@ namespace lea {
 		mfxFogRange->SetFloat(175.0f);
 
 		auto& effectTechnique_ = effectTechniques_[renderOptions];
+		auto& wavesEffectTechnique_ = wavesEffectTechniques_[renderOptions];
+
+		ID3D11Buffer* wavesVertexBuffers[] = { wavesStaticVertexBuffer_.Get(), wavesVertexBuffer_.Get() };
+		UINT wavesStrides[] = { sizeof(Waves::StaticVertex), sizeof(Waves::DynamicVertex) };
+		UINT wavesOffsets[] = { 0, 0 };
 
 		D3DX11_TECHNIQUE_DESC techDesc;
 		effectTechnique_->GetDesc(&techDesc);
@@ -473,7 +586,7 @@ namespace lea {
 		{
 			// Box drawing
 			context->IASetVertexBuffers(0, 1, commonVertexBuffer_.GetAddressOf(), &strides, &offset);
-			context->IASetIndexBuffer(commonIndexBuffer_.Get(), DXGI_FORMAT_R32_UINT, 0);
+			context->IASetIndexBuffer(commonIndexBuffer_.Get(), commonIndexFormat_, 0);
 
 			XMMATRIX world = XMLoadFloat4x4(&mBoxWorld);
 			XMMATRIX worldInvTrans = lea::utils::MathHelper::InverseTranspose(world);
@@ -494,7 +607,7 @@ namespace lea {
 
 			// grid drawing
 			context->IASetVertexBuffers(0, 1, landVertexBuffer_.GetAddressOf(), &strides, &offset);
-			context->IASetIndexBuffer(landIndexBuffer_.Get(), DXGI_FORMAT_R32_UINT, 0);
+			context->IASetIndexBuffer(landIndexBuffer_.Get(), landIndexFormat_, 0);
 
 			world = XMLoadFloat4x4(&mLandWorld);
 			worldInvTrans = lea::utils::MathHelper::InverseTranspose(world);
@@ -512,9 +625,6 @@ namespace lea {
 			context->DrawIndexed(mGridIndexCount, 0, 0);
 
 			// waves drawing
-			context->IASetVertexBuffers(0, 1, wavesVertexBuffer_.GetAddressOf(), &strides, &offset);
-			context->IASetIndexBuffer(wavesIndexBuffer_.Get(), DXGI_FORMAT_R32_UINT, 0);
-
 			world = XMLoadFloat4x4(&mWavesWorld);
 			worldInvTrans = lea::utils::MathHelper::InverseTranspose(world);
 			worldViewProj = world * viewProj;
@@ -527,8 +637,26 @@ namespace lea {
 			mfxTexture->SetResource(wavesTexture_.Get());
 			
 			context->OMSetBlendState(mTransparentBS.Get(), blendFactor, 0xFFFFFFFF);
-			effectTechnique_->GetPassByIndex(i)->Apply(0, context);
-			context->DrawIndexed(3*waves.TriangleCount(), 0, 0);
+			if (drawClipmap_)
+			{
+				// Plain Vertex3 levels, positions already in world x and z.
+				effectTechnique_->GetPassByIndex(i)->Apply(0, context);
+				for (UINT l = 0; l < wavesClipmap_.LevelCount(); ++l)
+				{
+					context->IASetVertexBuffers(0, 1, clipmapVertexBuffers_[l].GetAddressOf(), &strides, &offset);
+					context->IASetIndexBuffer(clipmapIndexBuffers_[l].Get(), DXGI_FORMAT_R32_UINT, 0);
+					context->DrawIndexed(clipmapIndexCounts_[l], 0, 0);
+				}
+			}
+			else
+			{
+				context->IASetInputLayout(wavesInputLayout_.Get());
+				context->IASetVertexBuffers(0, 2, wavesVertexBuffers, wavesStrides, wavesOffsets);
+				context->IASetIndexBuffer(wavesIndexBuffer_.Get(), wavesIndexFormat_, 0);
+				wavesEffectTechnique_->GetPassByIndex(i)->Apply(0, context);
+				context->DrawIndexed(static_cast<UINT>(3 * waves.TriangleCount()), 0, 0);
+				context->IASetInputLayout(inputLayout_.Get());
+			}
 			context->OMSetBlendState(0, blendFactor, 0xFFFFFFFF);
 
 		}
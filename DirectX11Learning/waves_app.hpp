@@ -2,8 +2,11 @@
 
 #include "app.hpp"
 #include "waves.hpp"
+#include "waves_clipmap.hpp"
+#include "waves_thread.hpp"
 
 #include <unordered_map>
+#include <vector>
 
 #include "lea_engine_utils.hpp"
 
@@ -24,22 +27,50 @@ namespace lea {
 	protected:
 		ComPtr<ID3DX11Effect> effect_;
 		std::unordered_map<ERenderTypes, ComPtr<ID3DX11EffectTechnique>> effectTechniques_;
+		// Same techniques for the split vertex streams of the water.
+		std::unordered_map<ERenderTypes, ComPtr<ID3DX11EffectTechnique>> wavesEffectTechniques_;
 
 		ComPtr<ID3D11Buffer> landVertexBuffer_;
 		ComPtr<ID3D11Buffer> landIndexBuffer_;
+		DXGI_FORMAT landIndexFormat_ = DXGI_FORMAT_R32_UINT;
+		// x, z and texcoords of the water, written once.
+		ComPtr<ID3D11Buffer> wavesStaticVertexBuffer_;
+		// Heights and normals of the water.  Only the rows that changed are
+		// uploaded, from the latest frame of wavesThread_.
 		ComPtr<ID3D11Buffer> wavesVertexBuffer_;
+		// Sequence number of the frame in wavesVertexBuffer_, 0 before the first upload.
+		uint64_t wavesSequence_ = 0;
 		ComPtr<ID3D11Buffer> wavesIndexBuffer_;
+		DXGI_FORMAT wavesIndexFormat_ = DXGI_FORMAT_R32_UINT;
 
 		ComPtr<ID3D11Buffer> commonVertexBuffer_;
 		ComPtr<ID3D11Buffer> commonIndexBuffer_;
+		DXGI_FORMAT commonIndexFormat_ = DXGI_FORMAT_R32_UINT;
 
 		ComPtr<ID3D11InputLayout> inputLayout_;
+		ComPtr<ID3D11InputLayout> wavesInputLayout_;
 
 		ComPtr<ID3D11ShaderResourceView> grassTexture_;
 		ComPtr<ID3D11ShaderResourceView> wavesTexture_;
 		ComPtr<ID3D11ShaderResourceView> boxTexture_;
 
 		Waves waves;
+		// Steps waves once Init() is done; from then on waves is only touched
+		// through it.
+		WavesThread wavesThread_{ waves };
+
+		// Levels of wavesClipmap_, one thread each.
+		static constexpr UINT ClipmapLevelCount = 4;
+		// A kilometer of sea around the camera instead of waves, toggled with
+		// key 4.  It has no obstacles, steps on the render thread, and every
+		// level is rewritten whole into its own dynamic buffers.
+		WavesClipmap wavesClipmap_{ ClipmapLevelCount };
+		bool drawClipmap_ = false;
+		std::vector<ComPtr<ID3D11Buffer>> clipmapVertexBuffers_;
+		std::vector<ComPtr<ID3D11Buffer>> clipmapIndexBuffers_;
+		std::vector<UINT> clipmapIndexCounts_;
+		// wavesClipmap_.LayoutVersion() of clipmapIndexBuffers_.
+		uint64_t clipmapLayoutVersion_ = 0;
 
 		XMFLOAT4X4 mLandWorld;
 		XMFLOAT4X4 mWavesWorld;
@@ -95,6 +126,8 @@ namespace lea {
 		void UpdateScene(float deltaTime) override;
 		void BuildLandGeometryBuffers();
 		void BuildWavesGeometryBuffers();
+		void BuildClipmapGeometryBuffers();
+		void UpdateClipmapGeometryBuffers();
 		void BuildCommonGeometryBuffers();
 		void CreateInputLayout();
 		void CreateRasterizerStates();
@@ -0,0 +1,211 @@
+#include "waves_batch.hpp"
+
+#include "lea_thread_pool.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cmath>
+
+namespace lea {
+	WavesBatch::WavesBatch(UINT threadCount)
+		: stencilRow_(waves_kernels::BestStencilRowInterleaved())
+	{
+		if (threadCount > 1)
+			threadPool_ = std::make_unique<ThreadPool>(threadCount);
+	}
+
+	WavesBatch::~WavesBatch()
+	{
+	}
+
+	UINT WavesBatch::Add(UINT m, UINT n, float dx, float dt, float speed, float damping)
+	{
+		constexpr UINT L = waves_kernels::InterleavedLanes;
+
+		if (size_t(m) * n > SmallGridPoints)
+		{
+			auto waves = std::make_unique<Waves>();
+			waves->Init(m, n, dx, dt, speed, damping);
+			grids_.push_back({ static_cast<UINT>(large_.size()), NotPacked });
+			large_.push_back(std::move(waves));
+			return static_cast<UINT>(grids_.size() - 1);
+		}
+
+		// Join a group with a free lane.  The new grid's clock starts at zero, so
+		// it can only share a group whose clock is at zero too.
+		for (UINT g = 0; g < groups_.size(); ++g)
+		{
+			Group& group = groups_[g];
+			if (group.laneCount < L && group.numRows == m && group.numCols == n &&
+				group.dx == dx && group.timeStep == dt && group.speed == speed && group.damping == damping &&
+				group.timeAccum == 0.0f)
+			{
+				grids_.push_back({ g, group.laneCount++ });
+				return static_cast<UINT>(grids_.size() - 1);
+			}
+		}
+
+		Group group;
+		group.numRows = m;
+		group.numCols = n;
+		group.dx = dx;
+		group.timeStep = dt;
+		group.speed = speed;
+		group.damping = damping;
+
+		// Same constants as Waves::Init(), so a packed grid evolves bit-identically
+		// to a standalone one.
+		float d = damping * dt + 2.0f;
+		float e = (speed * speed) * (dt * dt) / (dx * dx);
+		group.k1 = (damping * dt - 2.0f) / d;
+		group.k2 = (4.0f - 8.0f * e) / d;
+		group.k3 = (2.0f * e) / d;
+
+		group.timeAccum = 0.0f;
+		group.laneCount = 1;
+		group.prevSolution.assign(size_t(m) * n * L, 0.0f);
+		group.currSolution.assign(size_t(m) * n * L, 0.0f);
+
+		grids_.push_back({ static_cast<UINT>(groups_.size()), 0 });
+		groups_.push_back(std::move(group));
+		return static_cast<UINT>(grids_.size() - 1);
+	}
+
+	UINT WavesBatch::GridCount()const
+	{
+		return static_cast<UINT>(grids_.size());
+	}
+
+	UINT WavesBatch::RowCount(UINT grid)const
+	{
+		const Grid& g = grids_[grid];
+		return g.lane == NotPacked ? large_[g.index]->RowCount() : groups_[g.index].numRows;
+	}
+
+	UINT WavesBatch::ColumnCount(UINT grid)const
+	{
+		const Grid& g = grids_[grid];
+		return g.lane == NotPacked ? large_[g.index]->ColumnCount() : groups_[g.index].numCols;
+	}
+
+	float WavesBatch::Sample(const Grid& grid, UINT i, UINT j)const
+	{
+		if (grid.lane == NotPacked)
+			return large_[grid.index]->Height(i, j);
+
+		const Group& group = groups_[grid.index];
+		return group.currSolution[(size_t(i) * group.numCols + j) * waves_kernels::InterleavedLanes + grid.lane];
+	}
+
+	float WavesBatch::Height(UINT grid, UINT i, UINT j)const
+	{
+		return Sample(grids_[grid], i, j);
+	}
+
+	DirectX::XMFLOAT3 WavesBatch::Normal(UINT grid, UINT i, UINT j)const
+	{
+		const Grid& g = grids_[grid];
+		if (g.lane == NotPacked)
+			return large_[g.index]->Normal(size_t(i) * large_[g.index]->ColumnCount() + j);
+
+		const Group& group = groups_[g.index];
+		if (i == 0 || j == 0 || i + 1 >= group.numRows || j + 1 >= group.numCols)
+			return DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+
+		float l = Sample(g, i, j - 1);
+		float r = Sample(g, i, j + 1);
+		float t = Sample(g, i - 1, j);
+		float b = Sample(g, i + 1, j);
+
+		float twoDx = 2.0f * group.dx;
+		float nx = l - r;
+		float nz = b - t;
+		float nLength = std::sqrt((nx * nx + twoDx * twoDx) + nz * nz);
+		return DirectX::XMFLOAT3(nx / nLength, twoDx / nLength, nz / nLength);
+	}
+
+	void WavesBatch::Disturb(UINT grid, UINT i, UINT j, float magnitude)
+	{
+		const Grid& g = grids_[grid];
+		if (g.lane == NotPacked)
+		{
+			large_[g.index]->Disturb(i, j, magnitude);
+			return;
+		}
+
+		Group& group = groups_[g.index];
+		float* h = group.currSolution.data() + g.lane;
+
+		float halfMag = 0.5f * magnitude;
+
+		// Don't disturb boundaries, like Waves::Disturb().  Off the grid, i - 1 or
+		// j - 1 wraps around and is left out as well.
+		auto disturb = [&group, h](UINT i, UINT j, float magnitude)
+			{
+				if (i == 0 || j == 0 || i >= group.numRows - 1 || j >= group.numCols - 1)
+					return;
+
+				h[(size_t(i) * group.numCols + j) * waves_kernels::InterleavedLanes] += magnitude;
+			};
+
+		// Disturb the ijth vertex height and its neighbors.
+		disturb(i, j, magnitude);
+		disturb(i, j + 1, halfMag);
+		disturb(i, j - 1, halfMag);
+		disturb(i + 1, j, halfMag);
+		disturb(i - 1, j, halfMag);
+	}
+
+	void WavesBatch::StepGroup(Group& group)
+	{
+		const size_t rowFloats = size_t(group.numCols) * waves_kernels::InterleavedLanes;
+
+		// Only update interior points; we use zero boundary conditions.  Unused
+		// lanes are flat and stay flat.
+		for (UINT i = 1; i < group.numRows - 1; ++i)
+		{
+			const float* curr = group.currSolution.data() + i * rowFloats;
+			stencilRow_(group.prevSolution.data() + i * rowFloats, curr,
+				curr - rowFloats, curr + rowFloats, 1, group.numCols - 1, group.k1, group.k2, group.k3);
+		}
+
+		std::swap(group.prevSolution, group.currSolution);
+	}
+
+	void WavesBatch::Update(float dt)
+	{
+		// Work items: groups due for a step first, then every large grid, which
+		// keeps its own clock.
+		std::vector<Group*> due;
+		for (Group& group : groups_)
+		{
+			group.timeAccum += dt;
+			if (group.timeAccum >= group.timeStep)
+			{
+				due.push_back(&group);
+				group.timeAccum = 0.0f; // reset time
+			}
+		}
+
+		const UINT itemCount = static_cast<UINT>(due.size() + large_.size());
+		std::atomic<UINT> next(0);
+
+		// Grid sizes vary a lot, so threads pull items one at a time instead of
+		// taking fixed shares.
+		auto work = [this, dt, &due, &next, itemCount](UINT, UINT)
+			{
+				for (UINT item = next++; item < itemCount; item = next++)
+				{
+					if (item < due.size())
+						StepGroup(*due[item]);
+					else
+						large_[item - due.size()]->Update(dt);
+				}
+			};
+
+		if (threadPool_)
+			threadPool_->Run(work);
+		else
+			work(0, 1);
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
+#include "DirectXMath.h"
+
+#include "waves.hpp"
+#include "waves_kernels.hpp"
+
+using UINT = uint32_t;
+
+namespace lea {
+	class ThreadPool;
+
+	// Steps many independent wave grids together, e.g. every pool and river of a
+	// scene.  Small grids with the same size and constants are packed four to a
+	// group and stored lane-interleaved, so one SSE register advances the same
+	// point of four grids at once and narrow grids don't waste their rows on
+	// scalar tails.  Larger grids are plain Waves instances.  Groups and large
+	// grids are handed out to the threads of one shared pool.
+	class WavesBatch
+	{
+	public:
+		// Grids with at most this many points are packed.
+		static constexpr UINT SmallGridPoints = 128 * 128;
+
+		explicit WavesBatch(UINT threadCount = 1);
+		~WavesBatch();
+
+		WavesBatch(const WavesBatch& other) = delete;
+		WavesBatch& operator=(const WavesBatch& other) = delete;
+
+		// Adds a flat grid, see Waves::Init(), and returns its handle.
+		UINT Add(UINT m, UINT n, float dx, float dt, float speed, float damping);
+
+		UINT GridCount()const;
+		UINT RowCount(UINT grid)const;
+		UINT ColumnCount(UINT grid)const;
+
+		float Height(UINT grid, UINT i, UINT j)const;
+		// Unit normal at grid row i, column j, from central differences of the heights.
+		DirectX::XMFLOAT3 Normal(UINT grid, UINT i, UINT j)const;
+
+		// See Waves::Disturb(); points on or past the border are left out.
+		void Disturb(UINT grid, UINT i, UINT j, float magnitude);
+
+		// Advances every grid like Waves::Update() would, each on its own clock.
+		void Update(float dt);
+
+	private:
+		// Up to InterleavedLanes small grids sharing size and constants.
+		struct Group
+		{
+			UINT numRows;
+			UINT numCols;
+			float dx;
+			float timeStep;
+			float speed;
+			float damping;
+			float k1;
+			float k2;
+			float k3;
+
+			float timeAccum;
+			UINT laneCount;
+
+			// numRows * numCols * InterleavedLanes floats; point (i, j) of lane g is
+			// at [(i * numCols + j) * InterleavedLanes + g].
+			std::vector<float> prevSolution;
+			std::vector<float> currSolution;
+		};
+
+		struct Grid
+		{
+			// Index into groups_ or large_.
+			UINT index;
+			// Lane within the group, or NotPacked.
+			UINT lane;
+		};
+		static constexpr UINT NotPacked = ~0u;
+
+		float Sample(const Grid& grid, UINT i, UINT j)const;
+		void StepGroup(Group& group);
+
+		std::unique_ptr<ThreadPool> threadPool_;
+		waves_kernels::StencilRowFn stencilRow_;
+
+		std::vector<Grid> grids_;
+		std::vector<Group> groups_;
+		std::vector<std::unique_ptr<Waves>> large_;
+	};
+}
@@ -47,6 +47,25 @@ VertexOut VS(VertexIn vIn)
     return vOut;
 }
 
+// Split stream layout of the water grid: x, z and texcoords never change and
+// live in an immutable buffer, only the height and the SNORM8 normal are
+// uploaded every frame.
+struct VertexInSplit
+{
+    float4 xzuv : POSITION;
+    float height : HEIGHT;
+    float4 normL : NORMAL;
+};
+
+VertexOut VSSplit(VertexInSplit vIn)
+{
+    VertexIn v;
+    v.posL = float3(vIn.xzuv.x, vIn.height, vIn.xzuv.y);
+    v.normL = vIn.normL.xyz;
+    v.tex = vIn.xzuv.zw;
+    return VS(v);
+}
+
 float4 PS(VertexOut vOut, 
 uniform int gLightCount, uniform bool gUseTexure, uniform bool gAlphaClip, uniform bool gFogEnabled) : SV_Target
 {
@@ -319,4 +338,34 @@ technique11 Light3TexAlphaClipFog
         SetGeometryShader(NULL);
         SetPixelShader(CompileShader(ps_5_0, PS(3, true, true, true)));
     }
+}
+
+technique11 Light3Split
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSSplit()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PS(3, false, false, false)));
+    }
+}
+
+technique11 Light3TexAlphaClipSplit
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSSplit()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PS(3, true, true, false)));
+    }
+}
+
+technique11 Light3TexAlphaClipFogSplit
+{
+    pass P0
+    {
+        SetVertexShader(CompileShader(vs_5_0, VSSplit()));
+        SetGeometryShader(NULL);
+        SetPixelShader(CompileShader(ps_5_0, PS(3, true, true, true)));
+    }
 }
\ No newline at end of file
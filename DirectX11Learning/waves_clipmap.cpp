@@ -0,0 +1,372 @@
+#include "waves_clipmap.hpp"
+
+#include "lea_thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+namespace lea {
+	WavesClipmap::WavesClipmap(UINT threadCount)
+	{
+		if (threadCount > 1)
+			threadPool_ = std::make_unique<ThreadPool>(threadCount);
+	}
+
+	WavesClipmap::~WavesClipmap()
+	{
+	}
+
+	void WavesClipmap::Init(UINT levelCount, UINT n, float dx, float dt, float speed, float damping)
+	{
+		if (levelCount == 0 || n < 5 || (n - 1) % 4 != 0)
+			throw std::invalid_argument("WavesClipmap: n - 1 must be a positive multiple of 4");
+
+		size_ = n;
+		timeStep_ = dt;
+		timeAccum_ = 0.0f;
+		++layoutVersion_;
+
+		const int half = int(n - 1) / 2;
+		levels_.clear();
+		levels_.resize(levelCount);
+		for (UINT l = 0; l < levelCount; ++l)
+		{
+			LevelState& level = levels_[l];
+			level.spacing = std::ldexp(dx, int(l));
+			level.originX = -half;
+			level.originZ = half;
+
+			// Every exchange rewrites points, normals are only worth computing
+			// when they are read.  Levels follow the center by scrolling, so a
+			// move only writes the cells it exposes.
+			level.waves = std::make_unique<Waves>();
+			level.waves->SetLazyNormals(true);
+			level.waves->SetScrolling(true);
+			// The outermost level has no coarser one to take its border from, so
+			// waves leave it through an absorbing layer instead of coming back.
+			if (l + 1 == levelCount)
+				level.waves->SetAbsorbingBorder(n / 8);
+			level.waves->Init(n, n, level.spacing, dt, speed, damping);
+		}
+	}
+
+	void WavesClipmap::SetCenter(float x, float z)
+	{
+		const int half = int(size_ - 1) / 2;
+		bool moved = false;
+
+		// Coarsest first, so points moving into a level can be filled from the
+		// coarser one at its new place.
+		for (UINT l = UINT(levels_.size()); l-- > 0;)
+		{
+			LevelState& level = levels_[l];
+			const float step = 2.0f * level.spacing;
+			int originX = 2 * int(std::lround(x / step)) - half;
+			int originZ = 2 * int(std::lround(z / step)) + half;
+
+			int cols = originX - level.originX;
+			int rows = level.originZ - originZ;
+			if (rows == 0 && cols == 0)
+				continue;
+
+			level.waves->Shift(rows, cols);
+			level.originX = originX;
+			level.originZ = originZ;
+			moved = true;
+
+			if (l + 1 == levels_.size())
+				continue;
+
+			const UINT n = size_;
+			UINT rowCount = std::min(UINT(std::abs(rows)), n);
+			UINT colCount = std::min(UINT(std::abs(cols)), n);
+			if (rows > 0)
+				FillFromCoarser(l, n - rowCount, n, 0, n);
+			else if (rows < 0)
+				FillFromCoarser(l, 0, rowCount, 0, n);
+			if (cols > 0)
+				FillFromCoarser(l, 0, n, n - colCount, n);
+			else if (cols < 0)
+				FillFromCoarser(l, 0, n, 0, colCount);
+		}
+
+		if (!moved)
+			return;
+
+		// The borders of the levels that moved now hold their own, stepped
+		// heights, or heights of a coarser level before it moved.
+		FillBorders();
+		++layoutVersion_;
+	}
+
+	void WavesClipmap::Update(float dt)
+	{
+		// Accumulate time.
+		timeAccum_ += dt;
+
+		// Only update the simulation at the specified time step.
+		if (timeAccum_ < timeStep_)
+			return;
+
+		// The levels are independent during the step, one thread each.
+		std::atomic<UINT> next(0);
+		auto work = [this, &next](UINT, UINT)
+			{
+				for (UINT l = next++; l < levels_.size(); l = next++)
+					levels_[l].waves->Advance(1);
+			};
+
+		if (threadPool_)
+			threadPool_->Run(work);
+		else
+			work(0, 1);
+
+		Exchange();
+
+		timeAccum_ = 0.0f; // reset time
+	}
+
+	void WavesClipmap::Exchange()
+	{
+		const UINT n = size_;
+
+		// Fine to coarse, finest first so the result carries outwards: every
+		// interior point of a level that lies on a point of the next coarser one
+		// overwrites it.
+		for (UINT l = 0; l + 1 < levels_.size(); ++l)
+		{
+			const Waves& fine = *levels_[l].waves;
+			Waves& coarse = *levels_[l + 1].waves;
+			for (UINT i = 2; i < n - 1; i += 2)
+			{
+				for (UINT j = 2; j < n - 1; j += 2)
+				{
+					float row, col;
+					ToCoarser(l, i, j, row, col);
+					coarse.SetHeight(UINT(row), UINT(col), fine.Height(i, j), fine.PreviousHeight(i, j));
+				}
+			}
+		}
+
+		FillBorders();
+	}
+
+	void WavesClipmap::FillBorders()
+	{
+		const UINT n = size_;
+
+		// Coarse to fine, coarsest first: the border of every level takes the
+		// heights of the next coarser one, which sets the boundary of its next step
+		// and leaves no step in the surface where the levels meet.
+		for (UINT l = UINT(levels_.size()) - 1; l-- > 0;)
+		{
+			FillFromCoarser(l, 0, 1, 0, n);
+			FillFromCoarser(l, n - 1, n, 0, n);
+			FillFromCoarser(l, 1, n - 1, 0, 1);
+			FillFromCoarser(l, 1, n - 1, n - 1, n);
+		}
+	}
+
+	void WavesClipmap::ToCoarser(UINT level, UINT i, UINT j, float& row, float& col)const
+	{
+		const LevelState& fine = levels_[level];
+		const LevelState& coarse = levels_[level + 1];
+		col = 0.5f * float(fine.originX + int(j)) - float(coarse.originX);
+		row = float(coarse.originZ) - 0.5f * float(fine.originZ - int(i));
+	}
+
+	void WavesClipmap::Sample(UINT level, float row, float col, float& height, float& previousHeight)const
+	{
+		const Waves& waves = *levels_[level].waves;
+		const float last = float(size_ - 1);
+		row = std::clamp(row, 0.0f, last);
+		col = std::clamp(col, 0.0f, last);
+
+		UINT r0 = UINT(row);
+		UINT c0 = UINT(col);
+		UINT r1 = std::min(r0 + 1, size_ - 1);
+		UINT c1 = std::min(c0 + 1, size_ - 1);
+		float fr = row - float(r0);
+		float fc = col - float(c0);
+
+		auto lerp2 = [fr, fc](float h00, float h01, float h10, float h11)
+			{
+				float top = h00 + (h01 - h00) * fc;
+				float bottom = h10 + (h11 - h10) * fc;
+				return top + (bottom - top) * fr;
+			};
+
+		height = lerp2(waves.Height(r0, c0), waves.Height(r0, c1), waves.Height(r1, c0), waves.Height(r1, c1));
+		previousHeight = lerp2(waves.PreviousHeight(r0, c0), waves.PreviousHeight(r0, c1),
+			waves.PreviousHeight(r1, c0), waves.PreviousHeight(r1, c1));
+	}
+
+	void WavesClipmap::FillFromCoarser(UINT level, UINT r0, UINT r1, UINT c0, UINT c1)
+	{
+		Waves& waves = *levels_[level].waves;
+		for (UINT i = r0; i < r1; ++i)
+		{
+			for (UINT j = c0; j < c1; ++j)
+			{
+				float row, col, height, previousHeight;
+				ToCoarser(level, i, j, row, col);
+				Sample(level + 1, row, col, height, previousHeight);
+				waves.SetHeight(i, j, height, previousHeight);
+			}
+		}
+	}
+
+	void WavesClipmap::Disturb(float x, float z, float magnitude)
+	{
+		const int n = int(size_);
+		for (LevelState& level : levels_)
+		{
+			int j = int(std::lround(x / level.spacing)) - level.originX;
+			int i = level.originZ - int(std::lround(z / level.spacing));
+
+			// Waves::Disturb() stays off the two outer rings.
+			if (i > 1 && i < n - 2 && j > 1 && j < n - 2)
+			{
+				level.waves->Disturb(UINT(i), UINT(j), magnitude);
+				return;
+			}
+		}
+	}
+
+	UINT WavesClipmap::LevelCount()const
+	{
+		return UINT(levels_.size());
+	}
+
+	const Waves& WavesClipmap::Level(UINT level)const
+	{
+		return *levels_[level].waves;
+	}
+
+	DirectX::XMFLOAT3 WavesClipmap::Position(UINT level, size_t i)const
+	{
+		const LevelState& state = levels_[level];
+		UINT row = UINT(i / size_);
+		UINT col = UINT(i - size_t(row) * size_);
+		return DirectX::XMFLOAT3(float(state.originX + int(col)) * state.spacing, state.waves->Height(row, col),
+			float(state.originZ - int(row)) * state.spacing);
+	}
+
+	DirectX::XMFLOAT3 WavesClipmap::Normal(UINT level, size_t i)const
+	{
+		const Waves& waves = *levels_[level].waves;
+		UINT row = UINT(i / size_);
+		UINT col = UINT(i - size_t(row) * size_);
+		bool border = row == 0 || col == 0 || row == size_ - 1 || col == size_ - 1;
+		if (!border || level + 1 == levels_.size())
+			return waves.Normal(i);
+
+		// Border points lie on a line of the coarser grid, halfway between two of
+		// its points or on one.
+		float cRow, cCol;
+		ToCoarser(level, row, col, cRow, cCol);
+		const Waves& coarse = *levels_[level + 1].waves;
+		UINT r0 = UINT(std::floor(cRow));
+		UINT r1 = UINT(std::ceil(cRow));
+		UINT c0 = UINT(std::floor(cCol));
+		UINT c1 = UINT(std::ceil(cCol));
+		DirectX::XMFLOAT3 a = coarse.Normal(size_t(r0) * size_ + c0);
+		DirectX::XMFLOAT3 b = coarse.Normal(size_t(r1) * size_ + c1);
+		float nx = a.x + b.x;
+		float ny = a.y + b.y;
+		float nz = a.z + b.z;
+		float nLength = std::sqrt(nx * nx + ny * ny + nz * nz);
+		return DirectX::XMFLOAT3(nx / nLength, ny / nLength, nz / nLength);
+	}
+
+	uint64_t WavesClipmap::LayoutVersion()const
+	{
+		return layoutVersion_;
+	}
+
+	void WavesClipmap::BuildIndices(UINT level, std::vector<UINT>& indices)const
+	{
+		const UINT n = size_;
+		const UINT blocks = (n - 1) / 2;
+		const bool stitched = level + 1 < levels_.size();
+
+		// Cells of this level under the next finer one, which covers blocks cells a side.
+		UINT holeRow = n;
+		UINT holeCol = n;
+		if (level > 0)
+		{
+			const LevelState& state = levels_[level];
+			const LevelState& finer = levels_[level - 1];
+			holeRow = UINT(state.originZ - finer.originZ / 2);
+			holeCol = UINT(finer.originX / 2 - state.originX);
+		}
+		auto inHole = [holeRow, holeCol, blocks](UINT r, UINT c)
+			{
+				return r >= holeRow && r < holeRow + blocks && c >= holeCol && c < holeCol + blocks;
+			};
+
+		indices.clear();
+		indices.reserve(size_t(n - 1) * (n - 1) * 6);
+
+		// Plain cells, two triangles each.
+		const UINT ring = stitched ? 2 : 0;
+		for (UINT r = ring; r < n - 1 - ring; ++r)
+		{
+			for (UINT c = ring; c < n - 1 - ring; ++c)
+			{
+				if (inHole(r, c))
+					continue;
+
+				indices.push_back(r * n + c);
+				indices.push_back(r * n + c + 1);
+				indices.push_back((r + 1) * n + c);
+
+				indices.push_back((r + 1) * n + c);
+				indices.push_back(r * n + c + 1);
+				indices.push_back((r + 1) * n + c + 1);
+			}
+		}
+
+		if (!stitched)
+			return;
+
+		// The outer ring of 2 x 2 blocks, each a fan around its center.  The
+		// perimeter goes around in the same sense as the cells above.
+		static const int Perimeter[8][2] = {
+			{ 0, 1 }, { 1, 1 }, { 1, 0 }, { 1, -1 }, { 0, -1 }, { -1, -1 }, { -1, 0 }, { -1, 1 },
+		};
+		for (UINT bi = 0; bi < blocks; ++bi)
+		{
+			for (UINT bj = 0; bj < blocks; ++bj)
+			{
+				if (bi != 0 && bi != blocks - 1 && bj != 0 && bj != blocks - 1)
+					continue;
+
+				const UINT centerRow = 2 * bi + 1;
+				const UINT centerCol = 2 * bj + 1;
+				UINT fan[8];
+				UINT fanSize = 0;
+				for (const int* offset : Perimeter)
+				{
+					UINT r = UINT(int(centerRow) + offset[0]);
+					UINT c = UINT(int(centerCol) + offset[1]);
+					bool midpoint = offset[0] == 0 || offset[1] == 0;
+					bool onBorder = r == 0 || c == 0 || r == n - 1 || c == n - 1;
+					if (midpoint && onBorder)
+						continue;
+					fan[fanSize++] = r * n + c;
+				}
+
+				const UINT center = centerRow * n + centerCol;
+				for (UINT k = 0; k < fanSize; ++k)
+				{
+					indices.push_back(center);
+					indices.push_back(fan[k]);
+					indices.push_back(fan[(k + 1) % fanSize]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
+#include "DirectXMath.h"
+
+#include "waves.hpp"
+
+using UINT = uint32_t;
+
+namespace lea {
+	class ThreadPool;
+
+	// Nested wave grids around a moving center, usually the camera: level 0 is
+	// the finest, and every next level has twice the spacing and covers four
+	// times the area, so a few small grids reach far out.  Each level is a
+	// Waves; where levels overlap they are coupled both ways after every step.
+	// The coarser level gives the finer one its border heights, and the finer
+	// one overwrites the coarser points it covers.  Waves cross from one level
+	// to the next, except that those too short for the coarser grid are lost.
+	//
+	// Levels follow the center in steps of two of their own cells, so every
+	// point of a level's border lies on a line of the next coarser grid and
+	// every other one on a coarser point.  Points that move in are filled from
+	// the coarser level.
+	class WavesClipmap
+	{
+	public:
+		explicit WavesClipmap(UINT threadCount = 1);
+		~WavesClipmap();
+
+		WavesClipmap(const WavesClipmap& other) = delete;
+		WavesClipmap& operator=(const WavesClipmap& other) = delete;
+
+		// levelCount levels of n x n points centered on the origin, n - 1 a
+		// multiple of 4.  Level 0 has spacing dx, the outermost one covers
+		// (n - 1) * dx * 2^(levelCount - 1) and absorbs the waves reaching its
+		// outer eighth, see Waves::SetAbsorbingBorder().  dt has to be stable for
+		// level 0.
+		void Init(UINT levelCount, UINT n, float dx, float dt, float speed, float damping);
+
+		// Keeps the levels centered on (x, z).  Moving a level shifts its grid by
+		// whole cells, so call it every frame.
+		void SetCenter(float x, float z);
+
+		// Steps every level once every time step, like Waves::Update().
+		void Update(float dt);
+
+		// Disturbs the finest level that has (x, z) well inside its border; does
+		// nothing outside the outermost one.
+		void Disturb(float x, float z, float magnitude);
+
+		UINT LevelCount()const;
+		const Waves& Level(UINT level)const;
+
+		// World position of the ith grid point of a level.
+		DirectX::XMFLOAT3 Position(UINT level, size_t i)const;
+		// Normal at the ith grid point of a level.  On a border that touches a
+		// coarser level it is the coarser level's, so shading matches across.
+		DirectX::XMFLOAT3 Normal(UINT level, size_t i)const;
+
+		// Changes whenever a level moves relative to the next finer one, which
+		// moves the hole in its indices.
+		uint64_t LayoutVersion()const;
+
+		// Triangle list over the points of a level, indices as in Waves, wound
+		// like the single-grid mesh of WavesApp.  The part covered by the next
+		// finer level is left out.  If a coarser level surrounds it, the outer
+		// ring of 2 x 2 cell blocks is fanned around the block centers and skips
+		// the border midpoints, so its edges are exactly those of the coarser
+		// grid and there are no cracks or T-junctions between levels.
+		void BuildIndices(UINT level, std::vector<UINT>& indices)const;
+
+	private:
+		struct LevelState
+		{
+			std::unique_ptr<Waves> waves;
+			float spacing;
+			// Point (i, j) sits at x = (originX + j) * spacing, z = (originZ - i) * spacing.
+			// Both are even, so the origin is a point of the next coarser level.
+			int originX;
+			int originZ;
+		};
+
+		// Bilinear sample of a level at fractional grid coordinates.
+		void Sample(UINT level, float row, float col, float& height, float& previousHeight)const;
+		// Coordinates in level + 1 of point (i, j) of level.
+		void ToCoarser(UINT level, UINT i, UINT j, float& row, float& col)const;
+		// Copies the coarser level into the points of a level in rows [r0, r1) and columns [c0, c1).
+		void FillFromCoarser(UINT level, UINT r0, UINT r1, UINT c0, UINT c1);
+		void Exchange();
+		// Sets the border of every level but the outermost from the next coarser one.
+		void FillBorders();
+
+		std::unique_ptr<ThreadPool> threadPool_;
+		std::vector<LevelState> levels_;
+		UINT size_ = 0;
+		float timeStep_ = 0.0f;
+		float timeAccum_ = 0.0f;
+		uint64_t layoutVersion_ = 0;
+	};
+}
@@ -0,0 +1,740 @@
+#include "waves_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <cstring>
+
+#if defined(LEA_WAVES_AVX2)
+#include <immintrin.h>
+#elif defined(_XM_SSE_INTRINSICS_)
+#include <emmintrin.h>
+#endif
+
+#if defined(LEA_WAVES_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace lea {
+	namespace waves_kernels {
+
+		bool HasAVX2()
+		{
+#if defined(LEA_WAVES_AVX2) && (defined(__GNUC__) || defined(__clang__))
+			static const bool has = __builtin_cpu_supports("avx2");
+			return has;
+#elif defined(LEA_WAVES_AVX2)
+			static const bool has = []()
+				{
+					int info[4];
+					__cpuid(info, 0);
+					if (info[0] < 7)
+						return false;
+
+					// AVX support, and the OS saving the YMM registers on context switches.
+					__cpuid(info, 1);
+					const int osxsaveAvx = (1 << 27) | (1 << 28);
+					if ((info[2] & osxsaveAvx) != osxsaveAvx || (_xgetbv(0) & 6) != 6)
+						return false;
+
+					__cpuidex(info, 7, 0);
+					return (info[1] & (1 << 5)) != 0;
+				}();
+			return has;
+#else
+			return false;
+#endif
+		}
+
+		void StencilRowScalar(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3)
+		{
+			for (UINT j = begin; j < end; ++j)
+			{
+				prev[j] =
+					k1 * prev[j] +
+					k2 * curr[j] +
+					k3 * (down[j] +
+						up[j] +
+						curr[j + 1] +
+						curr[j - 1]);
+			}
+		}
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void StencilRowSSE(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3)
+		{
+			const __m128 K1 = _mm_set1_ps(k1);
+			const __m128 K2 = _mm_set1_ps(k2);
+			const __m128 K3 = _mm_set1_ps(k3);
+
+			UINT j = begin;
+			for (; j + 4 <= end; j += 4)
+			{
+				__m128 sum = _mm_add_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j + 1));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(curr + j - 1));
+
+				__m128 h = _mm_add_ps(
+					_mm_mul_ps(K1, _mm_loadu_ps(prev + j)),
+					_mm_mul_ps(K2, _mm_loadu_ps(curr + j)));
+				h = _mm_add_ps(h, _mm_mul_ps(K3, sum));
+
+				_mm_storeu_ps(prev + j, h);
+			}
+
+			StencilRowScalar(prev, curr, up, down, j, end, k1, k2, k3);
+		}
+#endif
+
+#if defined(LEA_WAVES_AVX2)
+		LEA_TARGET_AVX2 void StencilRowAVX2(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3)
+		{
+			const __m256 K1 = _mm256_set1_ps(k1);
+			const __m256 K2 = _mm256_set1_ps(k2);
+			const __m256 K3 = _mm256_set1_ps(k3);
+
+			// No FMA here on purpose: fusing the multiply-adds would round differently
+			// from the scalar path.
+			UINT j = begin;
+			for (; j + 8 <= end; j += 8)
+			{
+				__m256 sum = _mm256_add_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+				sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j + 1));
+				sum = _mm256_add_ps(sum, _mm256_loadu_ps(curr + j - 1));
+
+				__m256 h = _mm256_add_ps(
+					_mm256_mul_ps(K1, _mm256_loadu_ps(prev + j)),
+					_mm256_mul_ps(K2, _mm256_loadu_ps(curr + j)));
+				h = _mm256_add_ps(h, _mm256_mul_ps(K3, sum));
+
+				_mm256_storeu_ps(prev + j, h);
+			}
+
+			StencilRowSSE(prev, curr, up, down, j, end, k1, k2, k3);
+		}
+#endif
+
+		void StencilRowInterleavedScalar(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3)
+		{
+			constexpr UINT L = InterleavedLanes;
+			for (UINT f = begin * L; f < end * L; ++f)
+			{
+				prev[f] =
+					k1 * prev[f] +
+					k2 * curr[f] +
+					k3 * (down[f] +
+						up[f] +
+						curr[f + L] +
+						curr[f - L]);
+			}
+		}
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void StencilRowInterleavedSSE(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3)
+		{
+			constexpr UINT L = InterleavedLanes;
+			const __m128 K1 = _mm_set1_ps(k1);
+			const __m128 K2 = _mm_set1_ps(k2);
+			const __m128 K3 = _mm_set1_ps(k3);
+
+			// One register per column, no tail.
+			for (UINT f = begin * L; f < end * L; f += L)
+			{
+				__m128 sum = _mm_add_ps(_mm_loadu_ps(down + f), _mm_loadu_ps(up + f));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(curr + f + L));
+				sum = _mm_add_ps(sum, _mm_loadu_ps(curr + f - L));
+
+				__m128 h = _mm_add_ps(
+					_mm_mul_ps(K1, _mm_loadu_ps(prev + f)),
+					_mm_mul_ps(K2, _mm_loadu_ps(curr + f)));
+				h = _mm_add_ps(h, _mm_mul_ps(K3, sum));
+
+				_mm_storeu_ps(prev + f, h);
+			}
+		}
+#endif
+
+		void StencilRowInt16Scalar(int16_t* prev, const int16_t* curr, const int16_t* up, const int16_t* down,
+			UINT begin, UINT end, float k1, float k2, float k3)
+		{
+			for (UINT j = begin; j < end; ++j)
+			{
+				float h =
+					k1 * float(prev[j]) +
+					k2 * float(curr[j]) +
+					k3 * (float(down[j]) +
+						float(up[j]) +
+						float(curr[j + 1]) +
+						float(curr[j - 1]));
+				prev[j] = static_cast<int16_t>(std::clamp(std::nearbyint(h), -32768.0f, 32767.0f));
+			}
+		}
+
+#if defined(_XM_SSE_INTRINSICS_)
+		namespace {
+			__m128 WidenLo(__m128i v) { return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)); }
+			__m128 WidenHi(__m128i v) { return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)); }
+
+			__m128 StencilInt16(__m128 prev, __m128 curr, __m128 up, __m128 down, __m128 right, __m128 left,
+				__m128 k1, __m128 k2, __m128 k3)
+			{
+				__m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(down, up), right), left);
+				return _mm_add_ps(_mm_add_ps(_mm_mul_ps(k1, prev), _mm_mul_ps(k2, curr)), _mm_mul_ps(k3, sum));
+			}
+		}
+
+		void StencilRowInt16SSE(int16_t* prev, const int16_t* curr, const int16_t* up, const int16_t* down,
+			UINT begin, UINT end, float k1, float k2, float k3)
+		{
+			const __m128 K1 = _mm_set1_ps(k1);
+			const __m128 K2 = _mm_set1_ps(k2);
+			const __m128 K3 = _mm_set1_ps(k3);
+
+			UINT j = begin;
+			for (; j + 8 <= end; j += 8)
+			{
+				__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + j));
+				__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + j));
+				__m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + j));
+				__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + j));
+				__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + j + 1));
+				__m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + j - 1));
+
+				__m128 lo = StencilInt16(WidenLo(p), WidenLo(c), WidenLo(u), WidenLo(d), WidenLo(r), WidenLo(l), K1, K2, K3);
+				__m128 hi = StencilInt16(WidenHi(p), WidenHi(c), WidenHi(u), WidenHi(d), WidenHi(r), WidenHi(l), K1, K2, K3);
+
+				// cvtps rounds to nearest even, packs saturates.
+				__m128i h = _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(prev + j), h);
+			}
+
+			StencilRowInt16Scalar(prev, curr, up, down, j, end, k1, k2, k3);
+		}
+#endif
+
+		StencilRowInt16Fn BestStencilRowInt16()
+		{
+#if defined(_XM_SSE_INTRINSICS_)
+			return &StencilRowInt16SSE;
+#else
+			return &StencilRowInt16Scalar;
+#endif
+		}
+
+		void DequantizeRow(float* dst, const int16_t* src, UINT begin, UINT end, float scale)
+		{
+			UINT j = begin;
+#if defined(_XM_SSE_INTRINSICS_)
+			const __m128 Scale = _mm_set1_ps(scale);
+			for (; j + 8 <= end; j += 8)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + j));
+				_mm_storeu_ps(dst + j, _mm_mul_ps(WidenLo(v), Scale));
+				_mm_storeu_ps(dst + j + 4, _mm_mul_ps(WidenHi(v), Scale));
+			}
+#endif
+			for (; j < end; ++j)
+			{
+				dst[j] = float(src[j]) * scale;
+			}
+		}
+
+		void NormalRowScalar(DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents,
+			const float* row, const float* up, const float* down, UINT begin, UINT end, float twoDx)
+		{
+			for (UINT j = begin; j < end; ++j)
+			{
+				float l = row[j - 1];
+				float r = row[j + 1];
+				float t = up[j];
+				float b = down[j];
+
+				float nx = l - r;
+				float nz = b - t;
+				float nLength = std::sqrt((nx * nx + twoDx * twoDx) + nz * nz);
+				normals[j] = DirectX::XMFLOAT3(nx / nLength, twoDx / nLength, nz / nLength);
+
+				float ty = r - l;
+				float tLength = std::sqrt(twoDx * twoDx + ty * ty);
+				tangents[j] = DirectX::XMFLOAT3(twoDx / tLength, ty / tLength, 0.0f);
+			}
+		}
+
+#if defined(_XM_SSE_INTRINSICS_)
+		namespace {
+			// Writes four consecutive XMFLOAT3 from the x, y and z lanes without
+			// touching the element after the fourth one.
+			void StoreFloat3x4(DirectX::XMFLOAT3* dst, __m128 x, __m128 y, __m128 z)
+			{
+				__m128 w = _mm_setzero_ps();
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+
+				float* f = &dst[0].x;
+				_mm_storeu_ps(f + 0, x);
+				_mm_storeu_ps(f + 3, y);
+				_mm_storeu_ps(f + 6, z);
+				_mm_storel_pi(reinterpret_cast<__m64*>(f + 9), w);
+				_mm_store_ss(f + 11, _mm_movehl_ps(w, w));
+			}
+		}
+
+		void NormalRowSSE(DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents,
+			const float* row, const float* up, const float* down, UINT begin, UINT end, float twoDx)
+		{
+			const __m128 TwoDx = _mm_set1_ps(twoDx);
+			const __m128 TwoDxSq = _mm_mul_ps(TwoDx, TwoDx);
+			const __m128 Zero = _mm_setzero_ps();
+
+			UINT j = begin;
+			for (; j + 4 <= end; j += 4)
+			{
+				__m128 l = _mm_loadu_ps(row + j - 1);
+				__m128 r = _mm_loadu_ps(row + j + 1);
+				__m128 t = _mm_loadu_ps(up + j);
+				__m128 b = _mm_loadu_ps(down + j);
+
+				__m128 nx = _mm_sub_ps(l, r);
+				__m128 nz = _mm_sub_ps(b, t);
+				__m128 nLength = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), TwoDxSq), _mm_mul_ps(nz, nz)));
+				StoreFloat3x4(normals + j, _mm_div_ps(nx, nLength), _mm_div_ps(TwoDx, nLength), _mm_div_ps(nz, nLength));
+
+				__m128 ty = _mm_sub_ps(r, l);
+				__m128 tLength = _mm_sqrt_ps(_mm_add_ps(TwoDxSq, _mm_mul_ps(ty, ty)));
+				StoreFloat3x4(tangents + j, _mm_div_ps(TwoDx, tLength), _mm_div_ps(ty, tLength), Zero);
+			}
+
+			NormalRowScalar(normals, tangents, row, up, down, j, end, twoDx);
+		}
+#endif
+
+		NormalRowFn BestNormalRow()
+		{
+#if defined(_XM_SSE_INTRINSICS_)
+			return &NormalRowSSE;
+#else
+			return &NormalRowScalar;
+#endif
+		}
+
+#if defined(_XM_SSE_INTRINSICS_)
+		namespace {
+			// Loads four consecutive XMFLOAT3 as x, y and z lanes.
+			void LoadFloat3x4(const DirectX::XMFLOAT3* src, __m128& x, __m128& y, __m128& z)
+			{
+				const float* f = &src[0].x;
+				__m128 a = _mm_loadu_ps(f + 0); // x0 y0 z0 x1
+				__m128 b = _mm_loadu_ps(f + 4); // y1 z1 x2 y2
+				__m128 c = _mm_loadu_ps(f + 8); // z2 x3 y3 z3
+
+				x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2)), _MM_SHUFFLE(3, 0, 3, 0));
+				y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+					_mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+				z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 2)), c, _MM_SHUFFLE(3, 0, 3, 0));
+			}
+
+			// PackNormalSnorm8 of four normals; cvtps rounds to nearest even like nearbyint.
+			__m128i PackNormalsSnorm8(__m128 x, __m128 y, __m128 z)
+			{
+				const __m128 Scale = _mm_set1_ps(127.0f);
+				const __m128i ByteMask = _mm_set1_epi32(0xFF);
+
+				__m128i xi = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(x, Scale)), ByteMask);
+				__m128i yi = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(y, Scale)), ByteMask);
+				__m128i zi = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(z, Scale)), ByteMask);
+				return _mm_or_si128(xi, _mm_or_si128(_mm_slli_epi32(yi, 8), _mm_slli_epi32(zi, 16)));
+			}
+		}
+#endif
+
+		uint32_t PackNormalSnorm8(const DirectX::XMFLOAT3& n)
+		{
+			uint32_t x = static_cast<uint32_t>(static_cast<int32_t>(std::nearbyint(n.x * 127.0f))) & 0xFF;
+			uint32_t y = static_cast<uint32_t>(static_cast<int32_t>(std::nearbyint(n.y * 127.0f))) & 0xFF;
+			uint32_t z = static_cast<uint32_t>(static_cast<int32_t>(std::nearbyint(n.z * 127.0f))) & 0xFF;
+			return x | (y << 8) | (z << 16);
+		}
+
+		void EmitDynamicRow(uint8_t* dst, UINT stride, const float* heights,
+			const DirectX::XMFLOAT3* normals, UINT count)
+		{
+			UINT j = 0;
+#if defined(_XM_SSE_INTRINSICS_)
+			for (; j + 4 <= count; j += 4)
+			{
+				__m128 nx, ny, nz;
+				LoadFloat3x4(normals + j, nx, ny, nz);
+				__m128 n = _mm_castsi128_ps(PackNormalsSnorm8(nx, ny, nz));
+				__m128 h = _mm_loadu_ps(heights + j);
+
+				__m128 lo = _mm_unpacklo_ps(h, n); // h0 n0 h1 n1
+				__m128 hi = _mm_unpackhi_ps(h, n); // h2 n2 h3 n3
+				uint8_t* v = dst + size_t(j) * stride;
+				_mm_storel_pi(reinterpret_cast<__m64*>(v), lo);
+				_mm_storeh_pi(reinterpret_cast<__m64*>(v + stride), lo);
+				_mm_storel_pi(reinterpret_cast<__m64*>(v + 2 * size_t(stride)), hi);
+				_mm_storeh_pi(reinterpret_cast<__m64*>(v + 3 * size_t(stride)), hi);
+			}
+#endif
+			for (; j < count; ++j)
+			{
+				uint8_t* v = dst + size_t(j) * stride;
+				uint32_t n = PackNormalSnorm8(normals[j]);
+				std::memcpy(v, heights + j, sizeof(float));
+				std::memcpy(v + sizeof(float), &n, sizeof(n));
+			}
+		}
+
+		void EmitInterleavedRow(uint8_t* dst, UINT stride, const float* heights,
+			const DirectX::XMFLOAT3* normals, UINT count, float x0, float dx, float z, float u0, float du, float v)
+		{
+			UINT j = 0;
+#if defined(_XM_SSE_INTRINSICS_)
+			const __m128 X0 = _mm_set1_ps(x0);
+			const __m128 Dx = _mm_set1_ps(dx);
+			const __m128 Z = _mm_set1_ps(z);
+			const __m128 U0 = _mm_set1_ps(u0);
+			const __m128 Du = _mm_set1_ps(du);
+			const __m128 V = _mm_set1_ps(v);
+			for (; j + 4 <= count; j += 4)
+			{
+				__m128 col = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(static_cast<int>(j)), _mm_set_epi32(3, 2, 1, 0)));
+				__m128 x = _mm_add_ps(X0, _mm_mul_ps(col, Dx));
+				__m128 u = _mm_add_ps(U0, _mm_mul_ps(x, Du));
+				__m128 h = _mm_loadu_ps(heights + j);
+				__m128 nx, ny, nz;
+				LoadFloat3x4(normals + j, nx, ny, nz);
+
+				// Each vertex is two registers: x h z nx | ny nz u v.
+				__m128 xh[2] = { _mm_unpacklo_ps(x, h), _mm_unpackhi_ps(x, h) };
+				__m128 zn[2] = { _mm_unpacklo_ps(Z, nx), _mm_unpackhi_ps(Z, nx) };
+				__m128 nn[2] = { _mm_unpacklo_ps(ny, nz), _mm_unpackhi_ps(ny, nz) };
+				__m128 uv[2] = { _mm_unpacklo_ps(u, V), _mm_unpackhi_ps(u, V) };
+
+				float* f = reinterpret_cast<float*>(dst + size_t(j) * stride);
+				for (int k = 0; k < 2; ++k)
+				{
+					float* a = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(f) + 2 * k * size_t(stride));
+					float* b = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(a) + stride);
+					_mm_storeu_ps(a, _mm_movelh_ps(xh[k], zn[k]));
+					_mm_storeu_ps(a + 4, _mm_movelh_ps(nn[k], uv[k]));
+					_mm_storeu_ps(b, _mm_movehl_ps(zn[k], xh[k]));
+					_mm_storeu_ps(b + 4, _mm_movehl_ps(uv[k], nn[k]));
+				}
+			}
+#endif
+			for (; j < count; ++j)
+			{
+				float x = x0 + j * dx;
+				float vertex[8] = { x, heights[j], z, normals[j].x, normals[j].y, normals[j].z, u0 + x * du, v };
+				std::memcpy(dst + size_t(j) * stride, vertex, sizeof(vertex));
+			}
+		}
+
+		void SplatRowScalar(float* dst, const float* weights, float scale, UINT count)
+		{
+			for (UINT j = 0; j < count; ++j)
+				dst[j] += scale * weights[j];
+		}
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void SplatRowSSE(float* dst, const float* weights, float scale, UINT count)
+		{
+			const __m128 s = _mm_set1_ps(scale);
+			UINT j = 0;
+			for (; j + 4 <= count; j += 4)
+				_mm_storeu_ps(dst + j, _mm_add_ps(_mm_loadu_ps(dst + j), _mm_mul_ps(s, _mm_loadu_ps(weights + j))));
+			SplatRowScalar(dst + j, weights + j, scale, count - j);
+		}
+#endif
+
+#if defined(LEA_WAVES_AVX2)
+		LEA_TARGET_AVX2 void SplatRowAVX2(float* dst, const float* weights, float scale, UINT count)
+		{
+			const __m256 s = _mm256_set1_ps(scale);
+			UINT j = 0;
+			for (; j + 8 <= count; j += 8)
+				_mm256_storeu_ps(dst + j, _mm256_add_ps(_mm256_loadu_ps(dst + j), _mm256_mul_ps(s, _mm256_loadu_ps(weights + j))));
+			SplatRowSSE(dst + j, weights + j, scale, count - j);
+		}
+#endif
+
+		SplatRowFn BestSplatRow()
+		{
+#if defined(LEA_WAVES_AVX2)
+			if (HasAVX2())
+				return &SplatRowAVX2;
+#endif
+#if defined(_XM_SSE_INTRINSICS_)
+			return &SplatRowSSE;
+#else
+			return &SplatRowScalar;
+#endif
+		}
+
+		float MaxDeltaRow(const float* a, const float* b, UINT begin, UINT end)
+		{
+			float delta = 0.0f;
+			UINT j = begin;
+#if defined(_XM_SSE_INTRINSICS_)
+			const __m128 SignMask = _mm_set1_ps(-0.0f);
+			__m128 d = _mm_setzero_ps();
+			for (; j + 4 <= end; j += 4)
+			{
+				__m128 diff = _mm_sub_ps(_mm_loadu_ps(a + j), _mm_loadu_ps(b + j));
+				d = _mm_max_ps(d, _mm_andnot_ps(SignMask, diff));
+			}
+			d = _mm_max_ps(d, _mm_movehl_ps(d, d));
+			d = _mm_max_ss(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1)));
+			delta = _mm_cvtss_f32(d);
+#endif
+			for (; j < end; ++j)
+			{
+				delta = std::max(delta, std::fabs(a[j] - b[j]));
+			}
+			return delta;
+		}
+
+		float ActivityRow(const float* curr, const float* prev, UINT begin, UINT end)
+		{
+			float activity = 0.0f;
+			UINT j = begin;
+#if defined(_XM_SSE_INTRINSICS_)
+			const __m128 SignMask = _mm_set1_ps(-0.0f);
+			__m128 a = _mm_setzero_ps();
+			for (; j + 4 <= end; j += 4)
+			{
+				__m128 c = _mm_loadu_ps(curr + j);
+				__m128 d = _mm_sub_ps(c, _mm_loadu_ps(prev + j));
+				a = _mm_max_ps(a, _mm_andnot_ps(SignMask, c));
+				a = _mm_max_ps(a, _mm_andnot_ps(SignMask, d));
+			}
+			a = _mm_max_ps(a, _mm_movehl_ps(a, a));
+			a = _mm_max_ss(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)));
+			activity = _mm_cvtss_f32(a);
+#endif
+			for (; j < end; ++j)
+			{
+				activity = std::max(activity, std::fabs(curr[j]));
+				activity = std::max(activity, std::fabs(curr[j] - prev[j]));
+			}
+			return activity;
+		}
+
+		void AbsorbRow(float* next, const float* curr, const float* factors, float scale, UINT count)
+		{
+			UINT j = 0;
+#if defined(_XM_SSE_INTRINSICS_)
+			const __m128 Scale = _mm_set1_ps(scale);
+			for (; j + 4 <= count; j += 4)
+			{
+				__m128 c = _mm_loadu_ps(curr + j);
+				__m128 f = _mm_mul_ps(Scale, _mm_loadu_ps(factors + j));
+				__m128 d = _mm_sub_ps(_mm_loadu_ps(next + j), c);
+				_mm_storeu_ps(next + j, _mm_add_ps(c, _mm_mul_ps(f, d)));
+			}
+#endif
+			for (; j < count; ++j)
+				next[j] = curr[j] + (scale * factors[j]) * (next[j] - curr[j]);
+		}
+
+		void AbsorbRowInt16(int16_t* next, const int16_t* curr, const float* factors, float scale, UINT count)
+		{
+			UINT j = 0;
+#if defined(_XM_SSE_INTRINSICS_)
+			const __m128 Scale = _mm_set1_ps(scale);
+			for (; j + 8 <= count; j += 8)
+			{
+				__m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(next + j));
+				__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr + j));
+				__m128 cLo = WidenLo(c);
+				__m128 cHi = WidenHi(c);
+				__m128 lo = _mm_add_ps(cLo, _mm_mul_ps(_mm_mul_ps(Scale, _mm_loadu_ps(factors + j)), _mm_sub_ps(WidenLo(n), cLo)));
+				__m128 hi = _mm_add_ps(cHi, _mm_mul_ps(_mm_mul_ps(Scale, _mm_loadu_ps(factors + j + 4)), _mm_sub_ps(WidenHi(n), cHi)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(next + j), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+			}
+#endif
+			// The result lies between the two heights, so it needs no saturation.
+			for (; j < count; ++j)
+			{
+				float c = float(curr[j]);
+				next[j] = static_cast<int16_t>(std::nearbyint(c + (scale * factors[j]) * (float(next[j]) - c)));
+			}
+		}
+
+		void TridiagonalColumnsScalar(float* x, const float* mask, size_t pitch, UINT rows,
+			UINT begin, UINT end, float beta, float* scratch)
+		{
+			// g[i] is minus the eliminated upper coefficient, g[i] = o[i] / denom[i].
+			float* g = scratch;
+			for (UINT j = begin; j < end; ++j)
+			{
+				float gPrev = 0.0f;
+				float dPrev = 0.0f;
+				for (UINT i = 0; i < rows; ++i)
+				{
+					float s = mask[i * pitch + j];
+					float o = beta * s;
+					float r = 1.0f / ((1.0f + (o + o)) - o * gPrev);
+					gPrev = g[i] = o * r;
+					dPrev = x[i * pitch + j] = (s * x[i * pitch + j] + o * dPrev) * r;
+				}
+
+				float next = 0.0f;
+				for (UINT i = rows; i-- > 0;)
+					next = x[i * pitch + j] = x[i * pitch + j] + g[i] * next;
+			}
+		}
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void TridiagonalColumnsSSE(float* x, const float* mask, size_t pitch, UINT rows,
+			UINT begin, UINT end, float beta, float* scratch)
+		{
+			const __m128 Beta = _mm_set1_ps(beta);
+			const __m128 One = _mm_set1_ps(1.0f);
+
+			UINT j = begin;
+			for (; j + 4 <= end; j += 4)
+			{
+				__m128 gPrev = _mm_setzero_ps();
+				__m128 dPrev = _mm_setzero_ps();
+				for (UINT i = 0; i < rows; ++i)
+				{
+					__m128 s = _mm_loadu_ps(mask + i * pitch + j);
+					__m128 o = _mm_mul_ps(Beta, s);
+					__m128 r = _mm_div_ps(One, _mm_sub_ps(_mm_add_ps(One, _mm_add_ps(o, o)), _mm_mul_ps(o, gPrev)));
+					gPrev = _mm_mul_ps(o, r);
+					_mm_storeu_ps(scratch + i * 4, gPrev);
+					dPrev = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(s, _mm_loadu_ps(x + i * pitch + j)), _mm_mul_ps(o, dPrev)), r);
+					_mm_storeu_ps(x + i * pitch + j, dPrev);
+				}
+
+				__m128 next = _mm_setzero_ps();
+				for (UINT i = rows; i-- > 0;)
+				{
+					next = _mm_add_ps(_mm_loadu_ps(x + i * pitch + j), _mm_mul_ps(_mm_loadu_ps(scratch + i * 4), next));
+					_mm_storeu_ps(x + i * pitch + j, next);
+				}
+			}
+
+			TridiagonalColumnsScalar(x, mask, pitch, rows, j, end, beta, scratch);
+		}
+#endif
+
+#if defined(LEA_WAVES_AVX2)
+		LEA_TARGET_AVX2 void TridiagonalColumnsAVX2(float* x, const float* mask, size_t pitch, UINT rows,
+			UINT begin, UINT end, float beta, float* scratch)
+		{
+			const __m256 Beta = _mm256_set1_ps(beta);
+			const __m256 One = _mm256_set1_ps(1.0f);
+
+			// No FMA, like the scalar version.
+			UINT j = begin;
+			for (; j + 8 <= end; j += 8)
+			{
+				__m256 gPrev = _mm256_setzero_ps();
+				__m256 dPrev = _mm256_setzero_ps();
+				for (UINT i = 0; i < rows; ++i)
+				{
+					__m256 s = _mm256_loadu_ps(mask + i * pitch + j);
+					__m256 o = _mm256_mul_ps(Beta, s);
+					__m256 r = _mm256_div_ps(One, _mm256_sub_ps(_mm256_add_ps(One, _mm256_add_ps(o, o)), _mm256_mul_ps(o, gPrev)));
+					gPrev = _mm256_mul_ps(o, r);
+					_mm256_storeu_ps(scratch + i * 8, gPrev);
+					dPrev = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(s, _mm256_loadu_ps(x + i * pitch + j)), _mm256_mul_ps(o, dPrev)), r);
+					_mm256_storeu_ps(x + i * pitch + j, dPrev);
+				}
+
+				__m256 next = _mm256_setzero_ps();
+				for (UINT i = rows; i-- > 0;)
+				{
+					next = _mm256_add_ps(_mm256_loadu_ps(x + i * pitch + j), _mm256_mul_ps(_mm256_loadu_ps(scratch + i * 8), next));
+					_mm256_storeu_ps(x + i * pitch + j, next);
+				}
+			}
+
+			TridiagonalColumnsSSE(x, mask, pitch, rows, j, end, beta, scratch);
+		}
+#endif
+
+		TridiagonalColumnsFn BestTridiagonalColumns()
+		{
+#if defined(LEA_WAVES_AVX2)
+			if (HasAVX2())
+				return &TridiagonalColumnsAVX2;
+#endif
+#if defined(_XM_SSE_INTRINSICS_)
+			return &TridiagonalColumnsSSE;
+#else
+			return &TridiagonalColumnsScalar;
+#endif
+		}
+
+		void TransposeRows(float* dst, size_t dstPitch, const float* src, size_t srcPitch,
+			UINT rowBegin, UINT rowEnd, UINT cols)
+		{
+			// Square tiles, so both the rows read and the rows written stay in cache.
+			constexpr UINT Tile = 32;
+			for (UINT i0 = rowBegin; i0 < rowEnd; i0 += Tile)
+			{
+				const UINT i1 = std::min(i0 + Tile, rowEnd);
+				for (UINT j0 = 0; j0 < cols; j0 += Tile)
+				{
+					const UINT j1 = std::min(j0 + Tile, cols);
+					UINT i = i0;
+#if defined(_XM_SSE_INTRINSICS_)
+					for (; i + 4 <= i1; i += 4)
+					{
+						const float* s = src + i * srcPitch;
+						UINT j = j0;
+						for (; j + 4 <= j1; j += 4)
+						{
+							__m128 r0 = _mm_loadu_ps(s + j);
+							__m128 r1 = _mm_loadu_ps(s + srcPitch + j);
+							__m128 r2 = _mm_loadu_ps(s + 2 * srcPitch + j);
+							__m128 r3 = _mm_loadu_ps(s + 3 * srcPitch + j);
+							_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+							_mm_storeu_ps(dst + j * dstPitch + i, r0);
+							_mm_storeu_ps(dst + (j + 1) * dstPitch + i, r1);
+							_mm_storeu_ps(dst + (j + 2) * dstPitch + i, r2);
+							_mm_storeu_ps(dst + (j + 3) * dstPitch + i, r3);
+						}
+						for (; j < j1; ++j)
+							for (UINT k = 0; k < 4; ++k)
+								dst[j * dstPitch + i + k] = s[k * srcPitch + j];
+					}
+#endif
+					for (; i < i1; ++i)
+						for (UINT j = j0; j < j1; ++j)
+							dst[j * dstPitch + i] = src[i * srcPitch + j];
+				}
+			}
+		}
+
+		StencilRowFn BestStencilRowInterleaved()
+		{
+#if defined(_XM_SSE_INTRINSICS_)
+			return &StencilRowInterleavedSSE;
+#else
+			return &StencilRowInterleavedScalar;
+#endif
+		}
+
+		StencilRowFn BestStencilRow()
+		{
+#if defined(LEA_WAVES_AVX2)
+			if (HasAVX2())
+				return &StencilRowAVX2;
+#endif
+#if defined(_XM_SSE_INTRINSICS_)
+			return &StencilRowSSE;
+#else
+			return &StencilRowScalar;
+#endif
+		}
+	}
+}
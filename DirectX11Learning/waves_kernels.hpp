@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cinttypes>
+
+#include "DirectXMath.h"
+
+using UINT = uint32_t;
+
+// The AVX2 kernels are compiled in whatever the build's /arch and picked at run
+// time, see HasAVX2(), so a baseline x64 build still uses them where the CPU
+// has AVX2.
+#if defined(_XM_AVX2_INTRINSICS_) || (defined(_XM_SSE_INTRINSICS_) && (defined(_MSC_VER) || defined(__GNUC__)))
+#define LEA_WAVES_AVX2
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions marked for it when
+// the build targets an older CPU; MSVC emits whatever intrinsics it is given.
+#if defined(LEA_WAVES_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define LEA_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LEA_TARGET_AVX2
+#endif
+
+namespace lea {
+	namespace waves_kernels {
+
+		// Bit-identical results between the scalar and SIMD kernels, promised
+		// below, need the compiler to round every multiply and add on its own:
+		// no fused multiply-add contraction.  MSVC's /fp:precise (the default)
+		// doesn't contract, /fp:fast and /fp:contract may; GCC and Clang need
+		// -ffp-contract=off whenever the target has FMA, e.g. with -march=native.
+
+		// Whether the CPU and the OS support AVX2, checked once with CPUID.
+		bool HasAVX2();
+
+		// Advances columns [begin, end) of one interior row by one time step:
+		//
+		//   prev[j] = k1 * prev[j] + k2 * curr[j] + k3 * (down[j] + up[j] + curr[j + 1] + curr[j - 1])
+		//
+		// prev is overwritten in place, curr/up/down are the current solution of the
+		// row itself and of the rows above and below it.  Every kernel evaluates the
+		// expression in the same order, so all of them produce bit-identical results.
+		using StencilRowFn = void(*)(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+
+		void StencilRowScalar(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void StencilRowSSE(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+#endif
+
+#if defined(LEA_WAVES_AVX2)
+		void StencilRowAVX2(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+#endif
+
+		// Widest kernel the CPU runs.
+		StencilRowFn BestStencilRow();
+
+		// Same update for four independent grids stored lane-interleaved: the value
+		// of grid g at column j lives at [4 * j + g], so one SSE register holds the
+		// same point of all four grids.  begin/end are in columns, not floats.
+		constexpr UINT InterleavedLanes = 4;
+
+		void StencilRowInterleavedScalar(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void StencilRowInterleavedSSE(float* prev, const float* curr, const float* up, const float* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+#endif
+
+		StencilRowFn BestStencilRowInterleaved();
+
+		// The stencil on int16 fixed-point heights.  The update is linear and
+		// homogeneous, so it runs on the raw integers without rescaling: they are
+		// widened to float, combined in the same order as StencilRowScalar, then
+		// rounded to nearest even and saturated back to int16.
+		using StencilRowInt16Fn = void(*)(int16_t* prev, const int16_t* curr, const int16_t* up, const int16_t* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+
+		void StencilRowInt16Scalar(int16_t* prev, const int16_t* curr, const int16_t* up, const int16_t* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void StencilRowInt16SSE(int16_t* prev, const int16_t* curr, const int16_t* up, const int16_t* down,
+			UINT begin, UINT end, float k1, float k2, float k3);
+#endif
+
+		StencilRowInt16Fn BestStencilRowInt16();
+
+		// dst[j] = src[j] * scale over columns [begin, end).
+		void DequantizeRow(float* dst, const int16_t* src, UINT begin, UINT end, float scale);
+
+		// Computes the unit normal and unit x-tangent of columns [begin, end) of one
+		// interior row from central differences of the heights:
+		//
+		//   normal  = normalize(left - right, 2 * dx, down - up)
+		//   tangent = normalize(2 * dx, right - left, 0)
+		//
+		// The scalar and SIMD versions use correctly rounded sqrt and division only,
+		// so they produce bit-identical results.
+		using NormalRowFn = void(*)(DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents,
+			const float* row, const float* up, const float* down, UINT begin, UINT end, float twoDx);
+
+		void NormalRowScalar(DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents,
+			const float* row, const float* up, const float* down, UINT begin, UINT end, float twoDx);
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void NormalRowSSE(DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents,
+			const float* row, const float* up, const float* down, UINT begin, UINT end, float twoDx);
+#endif
+
+		NormalRowFn BestNormalRow();
+
+		// Packs a unit vector as DXGI_FORMAT_R8G8B8A8_SNORM with w = 0.
+		uint32_t PackNormalSnorm8(const DirectX::XMFLOAT3& n);
+
+		// Writes the height and packed normal (PackNormalSnorm8) of count consecutive
+		// grid points, 8 bytes per vertex, one vertex every stride bytes.
+		void EmitDynamicRow(uint8_t* dst, UINT stride, const float* heights,
+			const DirectX::XMFLOAT3* normals, UINT count);
+
+		// Writes position, normal and texcoords (32 bytes, utils::Vertex3 layout) of
+		// count consecutive grid points of one row, one vertex every stride bytes.
+		// Point j sits at x = x0 + j * dx, u = u0 + x * du.
+		void EmitInterleavedRow(uint8_t* dst, UINT stride, const float* heights,
+			const DirectX::XMFLOAT3* normals, UINT count, float x0, float dx, float z, float u0, float du, float v);
+
+		// Solves, independently for every column j in [begin, end) of a plane of
+		// `rows` rows, the tridiagonal system
+		//
+		//   (1 + 2 * o[i]) * x[i] - o[i] * (x[i - 1] + x[i + 1]) = mask[i] * d[i],   o[i] = beta * mask[i]
+		//
+		// where mask is 1 for the unknowns and 0 for points held at 0 (borders, land).
+		// d comes in x and is overwritten by the solution; consecutive rows are pitch
+		// floats apart in both x and mask.  Thomas algorithm, the SIMD versions solve
+		// one column per lane.  scratch must hold rows * TridiagonalMaxLanes floats.
+		// All versions evaluate in the same order and produce bit-identical results.
+		constexpr UINT TridiagonalMaxLanes = 8;
+
+		using TridiagonalColumnsFn = void(*)(float* x, const float* mask, size_t pitch, UINT rows,
+			UINT begin, UINT end, float beta, float* scratch);
+
+		void TridiagonalColumnsScalar(float* x, const float* mask, size_t pitch, UINT rows,
+			UINT begin, UINT end, float beta, float* scratch);
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void TridiagonalColumnsSSE(float* x, const float* mask, size_t pitch, UINT rows,
+			UINT begin, UINT end, float beta, float* scratch);
+#endif
+
+#if defined(LEA_WAVES_AVX2)
+		void TridiagonalColumnsAVX2(float* x, const float* mask, size_t pitch, UINT rows,
+			UINT begin, UINT end, float beta, float* scratch);
+#endif
+
+		TridiagonalColumnsFn BestTridiagonalColumns();
+
+		// Writes rows [rowBegin, rowEnd), columns [0, cols) of src transposed into
+		// dst: dst[j * dstPitch + i] = src[i * srcPitch + j].
+		void TransposeRows(float* dst, size_t dstPitch, const float* src, size_t srcPitch,
+			UINT rowBegin, UINT rowEnd, UINT cols);
+
+		// dst[j] += scale * weights[j] for j in [0, count): one row of a separable
+		// splat.  All versions produce bit-identical results.
+		using SplatRowFn = void(*)(float* dst, const float* weights, float scale, UINT count);
+
+		void SplatRowScalar(float* dst, const float* weights, float scale, UINT count);
+
+#if defined(_XM_SSE_INTRINSICS_)
+		void SplatRowSSE(float* dst, const float* weights, float scale, UINT count);
+#endif
+
+#if defined(LEA_WAVES_AVX2)
+		void SplatRowAVX2(float* dst, const float* weights, float scale, UINT count);
+#endif
+
+		SplatRowFn BestSplatRow();
+
+		// Returns the largest |a[j] - b[j]| over columns [begin, end).
+		float MaxDeltaRow(const float* a, const float* b, UINT begin, UINT end);
+
+		// Returns the largest of |curr[j]| and |curr[j] - prev[j]| over columns
+		// [begin, end): how far one row is from flat water at rest.
+		float ActivityRow(const float* curr, const float* prev, UINT begin, UINT end);
+
+		// Pulls the new heights of count points back towards the current ones,
+		//
+		//   next[j] = curr[j] + (scale * factors[j]) * (next[j] - curr[j])
+		//
+		// which damps their velocity.  The SSE paths give the same results as the
+		// scalar ones.
+		void AbsorbRow(float* next, const float* curr, const float* factors, float scale, UINT count);
+		// Same on int16 heights, rounded to nearest even.
+		void AbsorbRowInt16(int16_t* next, const int16_t* curr, const float* factors, float scale, UINT count);
+	}
+}
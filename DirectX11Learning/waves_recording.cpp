@@ -0,0 +1,95 @@
+#include "waves_recording.hpp"
+
+#include "waves.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	constexpr char RecordingMagic[8] = { 'L', 'E', 'A', 'W', 'R', 'E', 'C', '1' };
+
+	struct RecordingHeader
+	{
+		char magic[8];
+		uint64_t eventCount;
+	};
+}
+
+namespace lea {
+	void WavesRecording::Replay(Waves& waves) const
+	{
+		if (waves.Recording() == this)
+			throw std::invalid_argument("WavesRecording::Replay: the grid is recording into this log");
+
+		for (const Event& e : events_)
+		{
+			switch (e.type)
+			{
+			case EEvent::Update:
+				waves.Update(e.values[0]);
+				break;
+			case EEvent::Advance:
+				waves.Advance(static_cast<UINT>(e.i));
+				break;
+			case EEvent::Disturb:
+				waves.Disturb(static_cast<UINT>(e.i), static_cast<UINT>(e.j), e.values[0]);
+				break;
+			case EEvent::QueueDisturbance:
+				waves.QueueDisturbance(e.values[0], e.values[1], e.values[2], e.values[3]);
+				break;
+			case EEvent::SetHeight:
+				waves.SetHeight(static_cast<UINT>(e.i), static_cast<UINT>(e.j), e.values[0], e.values[1]);
+				break;
+			case EEvent::Shift:
+				waves.Shift(e.i, e.j);
+				break;
+			}
+		}
+	}
+
+	void WavesRecording::Save(const char* path) const
+	{
+		std::ofstream fout(path, std::ios::binary);
+		if (!fout)
+			throw std::runtime_error(std::string("WavesRecording::Save: can't create ") + path);
+
+		RecordingHeader header;
+		std::memcpy(header.magic, RecordingMagic, sizeof(header.magic));
+		header.eventCount = events_.size();
+		fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		fout.write(reinterpret_cast<const char*>(events_.data()), events_.size() * sizeof(Event));
+		if (!fout)
+			throw std::runtime_error(std::string("WavesRecording::Save: can't write ") + path);
+	}
+
+	void WavesRecording::Load(const char* path)
+	{
+		std::ifstream fin(path, std::ios::binary | std::ios::ate);
+		if (!fin)
+			throw std::runtime_error(std::string("WavesRecording::Load: can't open ") + path);
+
+		const uint64_t size = static_cast<uint64_t>(fin.tellg());
+		fin.seekg(0);
+
+		RecordingHeader header;
+		if (size < sizeof(header) || !fin.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+			std::memcmp(header.magic, RecordingMagic, sizeof(header.magic)) != 0)
+			throw std::runtime_error(std::string("WavesRecording::Load: not a recording: ") + path);
+		if (header.eventCount > (size - sizeof(header)) / sizeof(Event))
+			throw std::runtime_error(std::string("WavesRecording::Load: truncated recording: ") + path);
+
+		std::vector<Event> events(static_cast<size_t>(header.eventCount));
+		if (!fin.read(reinterpret_cast<char*>(events.data()), events.size() * sizeof(Event)))
+			throw std::runtime_error(std::string("WavesRecording::Load: can't read ") + path);
+
+		for (const Event& e : events)
+		{
+			if (e.type > EEvent::Shift)
+				throw std::runtime_error(std::string("WavesRecording::Load: unknown event in ") + path);
+		}
+
+		events_ = std::move(events);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cinttypes>
+#include <vector>
+
+using UINT = uint32_t;
+
+namespace lea {
+	class Waves;
+
+	// Log of the calls that change a Waves, in call order: Update() with its dt,
+	// Advance(), Disturb(), QueueDisturbance(), SetHeight() and Shift().  Attach it
+	// with Waves::SetRecording() right after Waves::SaveSnapshot(); replaying it on
+	// a grid restored from that snapshot then repeats the same wave history
+	// exactly, e.g. to benchmark different builds on identical work.  What a step
+	// does depends on the solver, active tiles and temporal blocking, so the
+	// replaying grid needs the same settings; the thread count, kernels and lazy
+	// normals don't change the results.
+	class WavesRecording {
+	public:
+		enum class EEvent : uint32_t {
+			Update,
+			Advance,
+			Disturb,
+			QueueDisturbance,
+			SetHeight,
+			Shift,
+		};
+
+		// One call, unused fields are 0.
+		struct Event
+		{
+			EEvent type;
+			// Row and column of Disturb() and SetHeight(), rows and columns of
+			// Shift(), step count of Advance() in i.
+			int32_t i;
+			int32_t j;
+			// dt of Update(), magnitude of Disturb(), height and previous height of
+			// SetHeight(), row, column, magnitude and radius of QueueDisturbance().
+			float values[4];
+		};
+
+		void Record(const Event& event) { events_.push_back(event); }
+		const std::vector<Event>& Events() const { return events_; }
+		void Clear() { events_.clear(); }
+
+		// Makes every recorded call on waves, in order.  Throws
+		// std::invalid_argument if waves is recording into this log.
+		void Replay(Waves& waves) const;
+
+		// Native endianness, like Waves::SerializeRows().  Both throw
+		// std::runtime_error on I/O errors, Load() also on a file that isn't a
+		// recording.
+		void Save(const char* path) const;
+		void Load(const char* path);
+
+	private:
+		std::vector<Event> events_;
+	};
+}
@@ -0,0 +1,139 @@
+#include "waves_thread.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace lea {
+
+	WavesThread::WavesThread(Waves& waves)
+		: waves_(waves)
+	{
+	}
+
+	WavesThread::~WavesThread()
+	{
+		Stop();
+	}
+
+	void WavesThread::Start()
+	{
+		if (thread_.joinable())
+			return;
+
+		const UINT m = waves_.RowCount();
+
+		// Every buffer starts out with the current state of the grid.  The
+		// sequence carries on from before a Stop(), so a reader holding an older
+		// frame never mistakes this one for it.
+		Frame frame;
+		frame.vertices.resize(waves_.VertexCount());
+		waves_.EmitVertices(frame.vertices.data(), sizeof(Waves::DynamicVertex), Waves::EVertexLayout::Split);
+		frame.rows = { { 0, m } };
+		frame.sequence = ++sequence_;
+		frames_.Reset(frame);
+		waves_.TakeDirtyRows();
+
+		for (std::vector<uint8_t>& stale : staleRows_)
+			stale.assign(m, 0);
+
+		stop_ = false;
+		thread_ = std::thread(&WavesThread::Run, this);
+	}
+
+	void WavesThread::Stop()
+	{
+		if (!thread_.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_one();
+		thread_.join();
+	}
+
+	void WavesThread::Disturb(UINT i, UINT j, float magnitude)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		disturbances_.push_back({ i, j, magnitude });
+	}
+
+	const WavesThread::Frame& WavesThread::LatestFrame()
+	{
+		frames_.Acquire();
+		return frames_.ReadBuffer();
+	}
+
+	void WavesThread::Run()
+	{
+		using Clock = std::chrono::steady_clock;
+
+		// Don't try to catch up on more than this many late steps, or one long
+		// hitch would leave the simulation running flat out for a while.
+		constexpr UINT MaxLateSteps = 4;
+
+		const auto timeStep = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(waves_.TimeStep()));
+		auto next = Clock::now();
+		std::vector<Disturbance> disturbances;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wake_.wait_until(lock, next, [this] { return stop_; });
+				if (stop_)
+					return;
+				disturbances.swap(disturbances_);
+			}
+
+			// Applied together by Advance().
+			for (const Disturbance& d : disturbances)
+				waves_.QueueDisturbance(float(d.i), float(d.j), d.magnitude);
+			disturbances.clear();
+
+			waves_.Advance(1);
+			Publish();
+
+			next += timeStep;
+			if (Clock::now() > next + MaxLateSteps * timeStep)
+				next = Clock::now();
+		}
+	}
+
+	void WavesThread::Publish()
+	{
+		const UINT n = waves_.ColumnCount();
+		const UINT writeIndex = frames_.WriteIndex();
+		Frame& frame = frames_.WriteBuffer();
+
+		// The buffer about to be written is a few frames old.  Copy the rows that
+		// changed since then from the latest frame, rather than emitting them
+		// again, so that the new frame differs from the latest one in exactly the
+		// rows that are dirty now.
+		const Frame& latest = frames_.PublishedBuffer();
+		std::vector<uint8_t>& stale = staleRows_[writeIndex];
+		for (UINT i = 0; i < stale.size(); ++i)
+		{
+			if (!stale[i])
+				continue;
+
+			std::copy_n(latest.vertices.begin() + size_t(i) * n, n, frame.vertices.begin() + size_t(i) * n);
+			stale[i] = 0;
+		}
+
+		std::vector<Waves::RowRange> rows = waves_.TakeDirtyRows();
+		waves_.EmitVertices(frame.vertices.data(), sizeof(Waves::DynamicVertex), Waves::EVertexLayout::Split, rows);
+		for (UINT s = 0; s < 3; ++s)
+		{
+			if (s == writeIndex)
+				continue;
+			for (const Waves::RowRange& range : rows)
+				std::fill(staleRows_[s].begin() + range.begin, staleRows_[s].begin() + range.end, uint8_t(1));
+		}
+
+		frame.rows = std::move(rows);
+		frame.sequence = ++sequence_;
+		frames_.Publish();
+	}
+}
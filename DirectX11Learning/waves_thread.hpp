@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cinttypes>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "lea_triple_buffer.hpp"
+#include "waves.hpp"
+
+using UINT = uint32_t;
+
+namespace lea {
+
+	// Steps a Waves on a thread of its own, one step every TimeStep() seconds of
+	// wall-clock time, so a slow step never holds up a frame.  After each step the
+	// heights and normals are emitted in the split layout and published through a
+	// TripleBuffer; the render thread picks up the latest one without waiting and
+	// the two run at independent rates.
+	class WavesThread
+	{
+	public:
+		// One published state of the grid.
+		struct Frame
+		{
+			// Every vertex of the grid, see Waves::EVertexLayout::Split.
+			std::vector<Waves::DynamicVertex> vertices;
+			// Rows whose vertices differ from the frame published just before.
+			std::vector<Waves::RowRange> rows;
+			// Counts up from 1, the frame handed out by the first Start(), and keeps
+			// counting across Stop() and Start(); the frame handed out by Start()
+			// has every row in rows.
+			uint64_t sequence;
+		};
+
+		// waves must stay alive as long as this object.  Set it up and Init() it
+		// before Start(); while the thread runs, nothing else may touch it.
+		explicit WavesThread(Waves& waves);
+		~WavesThread();
+
+		WavesThread(const WavesThread& other) = delete;
+		WavesThread& operator=(const WavesThread& other) = delete;
+
+		void Start();
+		// Waits for the step in progress.  Does nothing if the thread isn't running.
+		void Stop();
+
+		// Queued and applied before the next step.
+		void Disturb(UINT i, UINT j, float magnitude);
+
+		// Latest published frame.  Never waits; the frame stays valid and unchanged
+		// until the next call.  If frames were skipped since the last call, their
+		// rows are missing from Frame::rows, which the sequence numbers tell.
+		const Frame& LatestFrame();
+
+	private:
+		struct Disturbance
+		{
+			UINT i;
+			UINT j;
+			float magnitude;
+		};
+
+		void Run();
+		void Publish();
+
+		Waves& waves_;
+		std::thread thread_;
+
+		// Guards stop_ and disturbances_.
+		std::mutex mutex_;
+		std::condition_variable wake_;
+		bool stop_ = false;
+		std::vector<Disturbance> disturbances_;
+
+		TripleBuffer<Frame> frames_;
+		// Per buffer of frames_, the rows that differ from the latest frame.
+		std::vector<uint8_t> staleRows_[3];
+		uint64_t sequence_ = 0;
+	};
+}
@@ -0,0 +1,78 @@
+// Headless benchmark of lea::SpectralOcean.
+//
+// Times one Advance(1) step, which advances every phase by one rotation and
+// runs the inverse FFTs along z and then x (height + i slope x as one complex
+// field, slope z as half of one), and one resync, which recomputes every
+// phase with cos/sin as Advance(steps > 1) and every ResyncSteps-th step do.
+// It sweeps the thread count from 1 to maxThreads in powers of two and
+// reports the speedup over one thread.
+//
+// At 512x512 on one thread (a single-core AVX2 Xeon VM, best of five runs of
+// 256 steps) a step takes 7.2 ms, 8.1 ms before slope z was packed; the FFTs
+// are about 3 ms of it, the phase update and the transposes the rest.  That
+// is far from 1 ms per step: getting there takes several cores, which that
+// machine couldn't measure.
+//
+// Build (needs only DirectXMath, no D3D), see CMakeLists.txt in the repository
+// root:
+//   cmake -S . -B build -DDIRECTXMATH_INCLUDE_DIR=<DirectXMath/Inc>
+//   cmake --build build --target spectral_ocean_benchmark
+//
+// Usage: spectral_ocean_benchmark [size=512] [steps=64] [maxThreads=cores]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "spectral_ocean.hpp"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	double Milliseconds(Clock::time_point start, Clock::time_point stop)
+	{
+		return std::chrono::duration<double, std::milli>(stop - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT size = argc > 1 ? static_cast<UINT>(std::atoi(argv[1])) : 512;
+	UINT steps = argc > 2 ? static_cast<UINT>(std::atoi(argv[2])) : 64;
+	UINT maxThreads = argc > 3 ? static_cast<UINT>(std::atoi(argv[3])) : std::max(1u, std::thread::hardware_concurrency());
+
+	std::printf("grid %ux%u, %u steps, up to %u thread(s)\n", size, size, steps, maxThreads);
+	std::printf("%8s %12s %14s %12s %10s\n", "threads", "ms/step", "ns/point/step", "ms/resync", "speedup");
+
+	double serialMs = 0.0;
+	for (UINT threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		lea::SpectralOcean ocean;
+		ocean.SetThreadCount(threads);
+		ocean.Init(size, 1000.0f, 1.0f / 60.0f, 20.0f, 0.5f);
+
+		// Warm up, then time single steps, staying clear of the periodic resync.
+		ocean.Advance(1);
+
+		auto start = Clock::now();
+		for (UINT step = 0; step < steps; ++step)
+			ocean.Advance(1);
+		auto stop = Clock::now();
+		double msPerStep = Milliseconds(start, stop) / steps;
+
+		start = Clock::now();
+		ocean.Advance(2);
+		stop = Clock::now();
+		double msResync = Milliseconds(start, stop);
+
+		if (threads == 1)
+			serialMs = msPerStep;
+
+		std::printf("%8u %12.3f %14.3f %12.3f %9.2fx\n", threads, msPerStep,
+			1e6 * msPerStep / (double(size) * size), msResync, serialMs / msPerStep);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+// Headless benchmark of lea::Waves temporal blocking.
+//
+// Compares one sweep over the grid per time step with the temporally blocked
+// mode, which advances a cache-sized tile several steps before moving on.  For
+// each run it reports the measured time per step, and the DRAM traffic per
+// step and the bandwidth that traffic implies from a model, not from hardware
+// counters (use a profiler's memory counters to measure them):
+//
+//   one sweep per step : 12 B/cell for the stencil (read prev + curr, write prev)
+//                        + 28 B/cell for the normal pass (read heights, write
+//                        normal + tangent)
+//   blocked, depth D   : (16 B/cell to load/store both planes + 28 B/cell for
+//                        normals) / D, plus the re-read ghost rows
+//
+// Build (needs only DirectXMath, no D3D), see CMakeLists.txt in the repository
+// root:
+//   cmake -S . -B build -DDIRECTXMATH_INCLUDE_DIR=<DirectXMath/Inc>
+//   cmake --build build --target waves_benchmark
+//
+// See waves_sweep.cpp for the sweep over grid sizes, threads and storage modes.
+//
+// Usage: waves_benchmark [gridSize=2048] [steps=32] [threads=1]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "waves.hpp"
+
+namespace {
+	double ModelledBytesPerStep(UINT m, UINT n, UINT depth, UINT tileRows)
+	{
+		double cells = double(m) * n;
+		if (depth <= 1)
+			return cells * (12.0 + 28.0);
+
+		double ghost = tileRows > 0 ? 1.0 + 2.0 * depth / tileRows : 1.0;
+		return cells * (16.0 * ghost + 28.0) / depth;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UINT size = argc > 1 ? static_cast<UINT>(std::atoi(argv[1])) : 2048;
+	UINT steps = argc > 2 ? static_cast<UINT>(std::atoi(argv[2])) : 32;
+	UINT threads = argc > 3 ? static_cast<UINT>(std::atoi(argv[3])) : 1;
+
+	const UINT depths[] = { 1, 2, 4, 8 };
+	const UINT tileRows = 64;
+
+	std::printf("grid %ux%u, %u steps, %u thread(s)\n", size, size, steps, threads);
+	std::printf("%8s %12s %14s %16s %16s %16s\n", "depth", "ms/step", "ns/cell/step", "modelled MB/step",
+		"modelled GB/s", "modelled saving");
+
+	double baseBytes = ModelledBytesPerStep(size, size, 1, tileRows);
+	for (UINT depth : depths)
+	{
+		lea::Waves waves;
+		waves.SetThreadCount(threads);
+		waves.SetTemporalBlocking(depth, tileRows);
+		waves.Init(size, size, 0.8f, 0.03f, 3.25f, 0.4f);
+		waves.Disturb(size / 2, size / 2, 1.0f);
+
+		// Warm up, then time.
+		waves.Advance(depth);
+
+		auto start = std::chrono::steady_clock::now();
+		waves.Advance(steps);
+		auto stop = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(stop - start).count();
+		double msPerStep = 1000.0 * seconds / steps;
+		double nsPerCell = 1e9 * seconds / (double(steps) * size * size);
+		double bytes = ModelledBytesPerStep(size, size, depth, tileRows);
+
+		std::printf("%8u %12.3f %14.3f %16.1f %16.2f %15.1f%%\n", depth, msPerStep, nsPerCell,
+			bytes / (1024.0 * 1024.0), bytes / (1e6 * msPerStep), 100.0 * (1.0 - bytes / baseBytes));
+	}
+
+	return EXIT_SUCCESS;
+}
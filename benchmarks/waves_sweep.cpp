@@ -0,0 +1,254 @@
+// Headless benchmark suite of lea::Waves.
+//
+// Sweeps grid sizes, thread counts and storage modes.  For every combination
+// it times Init(), a burst of Disturb() calls and then Update() steps, each
+// with a few disturbances like rain in WavesApp, until the time budget is
+// spent.  Results go to stdout as CSV, one row per combination, so runs of
+// different builds can be diffed or plotted; progress goes to stderr.
+//
+// Columns:
+//   size            grid points per side
+//   threads         Waves::SetThreadCount()
+//   storage         float or int16, see Waves::SetStorage()
+//   init_ms         Init()
+//   disturb_ns      one Disturb() at a random point
+//   steps           timed steps
+//   ms_per_step     one Update() step including its disturbances
+//   cells_per_s     grid points advanced per second
+//   ns_per_cell     per grid point and step
+//   modelled_bytes_per_cell
+//                   DRAM traffic of a step per grid point, from a model:
+//                     float: 12 B for the stencil (read prev + curr, write prev)
+//                            + 28 B for the normal pass (read heights, write
+//                            normal + tangent)
+//                     int16:  6 B for the stencil, no normals
+//   modelled_gb_per_s
+//                   bandwidth that traffic implies, modelled_bytes_per_cell *
+//                   cells_per_s; not measured with hardware counters
+//
+// With snapshot= and recording= it replays a run recorded with
+// WavesRecording instead, for every thread count, and prints
+// threads,events,load_ms,replay_ms.
+//
+// Build (needs only DirectXMath, no D3D), see CMakeLists.txt in the repository
+// root:
+//   cmake -S . -B build -DDIRECTXMATH_INCLUDE_DIR=<DirectXMath/Inc>
+//   cmake --build build --target waves_sweep
+//
+// Usage: waves_sweep [sizes=64,128,...,8192] [threads=1,2,4,...,cores] [storage=float,int16] [seconds=0.5]
+//        waves_sweep snapshot=<file> recording=<file> [threads=...]
+//
+// 8192^2 with float storage takes 2 GB.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "waves.hpp"
+#include "waves_recording.hpp"
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	struct Options
+	{
+		std::vector<UINT> sizes;
+		std::vector<UINT> threads;
+		std::vector<lea::Waves::EStorage> storages;
+		double seconds = 0.5;
+		std::string snapshot;
+		std::string recording;
+	};
+
+	// Disturbances per step, about what WavesApp's rain adds.
+	constexpr UINT DisturbancesPerStep = 8;
+	constexpr UINT TimedDisturbances = 100000;
+	constexpr UINT MinSteps = 3;
+
+	double Seconds(Clock::time_point start, Clock::time_point stop)
+	{
+		return std::chrono::duration<double>(stop - start).count();
+	}
+
+	// Fixed sequence, so every build disturbs the same points.
+	struct Lcg
+	{
+		uint64_t state = 1;
+		UINT Next(UINT bound)
+		{
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			return static_cast<UINT>((state >> 33) % bound);
+		}
+	};
+
+	std::vector<UINT> ParseList(const std::string& list)
+	{
+		std::vector<UINT> values;
+		size_t begin = 0;
+		while (begin < list.size())
+		{
+			size_t end = list.find(',', begin);
+			if (end == std::string::npos)
+				end = list.size();
+			values.push_back(static_cast<UINT>(std::atoi(list.substr(begin, end - begin).c_str())));
+			begin = end + 1;
+		}
+		return values;
+	}
+
+	Options ParseOptions(int argc, char** argv)
+	{
+		Options options;
+		for (UINT size = 64; size <= 8192; size *= 2)
+			options.sizes.push_back(size);
+		const UINT cores = std::max(std::thread::hardware_concurrency(), 1u);
+		for (UINT threads = 1; threads < cores; threads *= 2)
+			options.threads.push_back(threads);
+		options.threads.push_back(cores);
+		options.storages = { lea::Waves::EStorage::Float, lea::Waves::EStorage::Int16 };
+
+		for (int a = 1; a < argc; ++a)
+		{
+			std::string arg = argv[a];
+			size_t eq = arg.find('=');
+			std::string key = arg.substr(0, eq);
+			std::string value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+
+			if (key == "sizes")
+				options.sizes = ParseList(value);
+			else if (key == "threads")
+				options.threads = ParseList(value);
+			else if (key == "storage")
+			{
+				options.storages.clear();
+				if (value.find("float") != std::string::npos)
+					options.storages.push_back(lea::Waves::EStorage::Float);
+				if (value.find("int16") != std::string::npos)
+					options.storages.push_back(lea::Waves::EStorage::Int16);
+			}
+			else if (key == "seconds")
+				options.seconds = std::atof(value.c_str());
+			else if (key == "snapshot")
+				options.snapshot = value;
+			else if (key == "recording")
+				options.recording = value;
+			else
+			{
+				std::fprintf(stderr, "unknown option %s\n", arg.c_str());
+				std::exit(EXIT_FAILURE);
+			}
+		}
+		return options;
+	}
+
+	void RunSweep(const Options& options)
+	{
+		std::printf("size,threads,storage,init_ms,disturb_ns,steps,ms_per_step,cells_per_s,ns_per_cell,modelled_bytes_per_cell,modelled_gb_per_s\n");
+
+		for (lea::Waves::EStorage storage : options.storages)
+		{
+			const bool quantized = storage == lea::Waves::EStorage::Int16;
+			const double bytesPerCell = quantized ? 6.0 : 12.0 + 28.0;
+
+			for (UINT size : options.sizes)
+			{
+				for (UINT threads : options.threads)
+				{
+					std::fprintf(stderr, "%s %ux%u, %u thread(s)\n", quantized ? "int16" : "float", size, size, threads);
+
+					lea::Waves waves;
+					waves.SetStorage(storage);
+					waves.SetThreadCount(threads);
+
+					auto start = Clock::now();
+					waves.Init(size, size, 0.8f, 0.03f, 3.25f, 0.4f);
+					const double initSeconds = Seconds(start, Clock::now());
+
+					Lcg lcg;
+					start = Clock::now();
+					for (UINT d = 0; d < TimedDisturbances; ++d)
+						waves.Disturb(1 + lcg.Next(size - 2), 1 + lcg.Next(size - 2), 1e-4f);
+					const double disturbSeconds = Seconds(start, Clock::now());
+
+					auto step = [&waves, &lcg, size]()
+						{
+							for (UINT d = 0; d < DisturbancesPerStep; ++d)
+								waves.Disturb(1 + lcg.Next(size - 2), 1 + lcg.Next(size - 2), 0.01f);
+							waves.Update(waves.TimeStep());
+						};
+
+					// Warm up, then step until the budget is spent.
+					step();
+
+					UINT steps = 0;
+					double seconds = 0.0;
+					start = Clock::now();
+					while (steps < MinSteps || seconds < options.seconds)
+					{
+						step();
+						++steps;
+						seconds = Seconds(start, Clock::now());
+					}
+
+					const double cells = double(size) * size;
+					const double cellsPerSecond = cells * steps / seconds;
+					std::printf("%u,%u,%s,%.3f,%.1f,%u,%.4f,%.4g,%.4f,%.0f,%.3f\n",
+						size, threads, quantized ? "int16" : "float",
+						1e3 * initSeconds, 1e9 * disturbSeconds / TimedDisturbances,
+						steps, 1e3 * seconds / steps, cellsPerSecond, 1e9 / cellsPerSecond,
+						bytesPerCell, bytesPerCell * cellsPerSecond / 1e9);
+					std::fflush(stdout);
+				}
+			}
+		}
+	}
+
+	void RunReplay(const Options& options)
+	{
+		lea::WavesRecording recording;
+		recording.Load(options.recording.c_str());
+
+		std::printf("threads,events,load_ms,replay_ms\n");
+		for (UINT threads : options.threads)
+		{
+			lea::Waves waves;
+			waves.SetThreadCount(threads);
+
+			auto start = Clock::now();
+			waves.LoadSnapshot(options.snapshot.c_str());
+			auto loaded = Clock::now();
+			recording.Replay(waves);
+			auto stop = Clock::now();
+
+			std::printf("%u,%zu,%.3f,%.3f\n", threads, recording.Events().size(),
+				1e3 * Seconds(start, loaded), 1e3 * Seconds(loaded, stop));
+			std::fflush(stdout);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options = ParseOptions(argc, argv);
+
+	try
+	{
+		if (!options.snapshot.empty() || !options.recording.empty())
+			RunReplay(options);
+		else
+			RunSweep(options);
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "%s\n", e.what());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+// GeometryGenerator::Subdivide must keep an indexed mesh watertight: on a
+// closed mesh every edge is shared by exactly two triangles, once in each
+// direction, and on an open one the border stays the only open edges.
+// CreateGeosphereLattice must build the same closed sphere directly, on any
+// number of threads.  IndexBufferData must keep merged indices 16 bits wide
+// until one doesn't fit and then widen all of them without changing a value.
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "lea_engine_utils.hpp"
+#include "lea_test.hpp"
+#include "lea_thread_pool.hpp"
+
+using namespace lea::utils;
+using DirectX::XMFLOAT3;
+
+namespace {
+	using MeshData = GeometryGenerator::MeshData;
+
+	// Number of times every directed edge is used.
+	std::map<std::pair<uint32_t, uint32_t>, UINT> DirectedEdges(const MeshData& mesh)
+	{
+		std::map<std::pair<uint32_t, uint32_t>, UINT> edges;
+		for (size_t t = 0; t < mesh.Indices.size(); t += 3)
+			for (UINT k = 0; k < 3; ++k)
+				++edges[{ mesh.Indices[t + k], mesh.Indices[t + (k + 1) % 3] }];
+		return edges;
+	}
+
+	// Closed and consistently wound, with V - E + F = 2 and no vertex left over.
+	void CheckClosed(const MeshData& mesh)
+	{
+		LEA_CHECK(mesh.Indices.size() % 3 == 0);
+		std::vector<bool> used(mesh.Vertices.size(), false);
+		for (uint32_t index : mesh.Indices)
+		{
+			LEA_CHECK(index < mesh.Vertices.size());
+			if (index < used.size())
+				used[index] = true;
+		}
+		for (bool u : used)
+			LEA_CHECK(u);
+
+		const auto edges = DirectedEdges(mesh);
+		for (const auto& [edge, count] : edges)
+		{
+			LEA_CHECK(count == 1);
+			LEA_CHECK(edges.count({ edge.second, edge.first }) == 1);
+		}
+		const long faces = long(mesh.Indices.size() / 3);
+		LEA_CHECK(long(mesh.Vertices.size()) - long(edges.size() / 2) + faces == 2);
+	}
+
+	// Number of edges used by a single triangle.
+	size_t OpenEdgeCount(const MeshData& mesh)
+	{
+		const auto edges = DirectedEdges(mesh);
+		size_t open = 0;
+		for (const auto& [edge, count] : edges)
+		{
+			LEA_CHECK(count == 1);
+			if (edges.count({ edge.second, edge.first }) == 0)
+				++open;
+		}
+		return open;
+	}
+
+	bool SamePosition(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	void TestSubdivideClosed()
+	{
+		GeometryGenerator gen;
+		MeshData mesh;
+		gen.CreateGeosphere(1.0f, 0, mesh);
+		CheckClosed(mesh);
+
+		for (UINT level = 1; level <= 4; ++level)
+		{
+			const MeshData before = mesh;
+			gen.Subdivide(mesh);
+
+			// 10 * 4^level + 2 vertices, four times the triangles.
+			LEA_CHECK(mesh.Vertices.size() == 10 * (size_t(1) << (2 * level)) + 2);
+			LEA_CHECK(mesh.Indices.size() == 4 * before.Indices.size());
+			CheckClosed(mesh);
+
+			// The old vertices keep their place, the new ones are edge midpoints
+			// that exist once.
+			for (size_t i = 0; i < before.Vertices.size(); ++i)
+				LEA_CHECK(SamePosition(mesh.Vertices[i].Position, before.Vertices[i].Position));
+			for (size_t i = before.Vertices.size(); i < mesh.Vertices.size(); ++i)
+				for (size_t j = i + 1; j < mesh.Vertices.size(); ++j)
+					LEA_CHECK(!SamePosition(mesh.Vertices[i].Position, mesh.Vertices[j].Position));
+		}
+	}
+
+	void TestSubdivideOpen()
+	{
+		GeometryGenerator gen;
+		MeshData mesh;
+		gen.CreateGrid(4.0f, 3.0f, 5, 4, mesh);
+		size_t border = OpenEdgeCount(mesh);
+		LEA_CHECK(border == 2 * (4 + 3));
+
+		for (UINT level = 1; level <= 3; ++level)
+		{
+			gen.Subdivide(mesh);
+			border *= 2;
+			LEA_CHECK(OpenEdgeCount(mesh) == border);
+		}
+	}
+
+	void TestGeosphereLattice()
+	{
+		GeometryGenerator gen;
+		lea::ThreadPool threadPool(3);
+		for (UINT level = 0; level <= 5; ++level)
+		{
+			MeshData lattice;
+			gen.CreateGeosphereLattice(2.0f, level, lattice);
+			CheckClosed(lattice);
+
+			MeshData geosphere;
+			gen.CreateGeosphere(2.0f, level, geosphere);
+			LEA_CHECK(lattice.Vertices.size() == geosphere.Vertices.size());
+			LEA_CHECK(lattice.Indices.size() == geosphere.Indices.size());
+
+			for (const GeometryGenerator::Vertex& v : lattice.Vertices)
+			{
+				const XMFLOAT3& p = v.Position;
+				LEA_CHECK(std::fabs(std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z) - 2.0f) < 1e-5f);
+			}
+
+			MeshData parallel;
+			gen.CreateGeosphereLattice(2.0f, level, parallel, &threadPool);
+			LEA_CHECK(parallel.Indices == lattice.Indices);
+			LEA_CHECK(parallel.Vertices.size() == lattice.Vertices.size() &&
+				std::memcmp(parallel.Vertices.data(), lattice.Vertices.data(),
+					lattice.Vertices.size() * sizeof(GeometryGenerator::Vertex)) == 0);
+		}
+	}
+
+	// The indices in data, whichever width they are stored in.
+	std::vector<uint32_t> Indices(const IndexBufferData& data)
+	{
+		std::vector<uint32_t> indices(data.IndexCount());
+		for (UINT i = 0; i < data.IndexCount(); ++i)
+		{
+			indices[i] = data.Is16Bit() ? static_cast<const uint16_t*>(data.Data())[i] :
+				static_cast<const uint32_t*>(data.Data())[i];
+		}
+		return indices;
+	}
+
+	void TestIndexBufferData()
+	{
+		IndexBufferData data;
+		LEA_CHECK(data.Is16Bit());
+		LEA_CHECK(data.IndexCount() == 0);
+		LEA_CHECK(data.ByteWidth() == 0);
+
+		std::vector<uint32_t> expected;
+		auto append = [&](const std::vector<uint32_t>& indices)
+			{
+				LEA_CHECK(data.Append(indices) == expected.size());
+				expected.insert(expected.end(), indices.begin(), indices.end());
+				LEA_CHECK(data.IndexCount() == expected.size());
+				LEA_CHECK(data.ByteWidth() == expected.size() * (data.Is16Bit() ? 2 : 4));
+				LEA_CHECK(Indices(data) == expected);
+			};
+
+		// 0xFFFE is the largest index kept 16 bits wide, 0xFFFF is the strip cut.
+		append({ 0, 1, 2, 2, 1, 3 });
+		append({ 0xFFFE, 7, 0 });
+		append({});
+		LEA_CHECK(data.Is16Bit());
+
+		append({ 5, 0xFFFF, 6 });
+		LEA_CHECK(!data.Is16Bit());
+
+		// Once wide it stays wide, also for small meshes.
+		append({ 1, 2, 3 });
+		append({ 70000, 0xFFFFFFFF });
+		LEA_CHECK(!data.Is16Bit());
+
+		IndexBufferData large;
+		std::vector<uint32_t> indices = { 100000, 0, 1 };
+		LEA_CHECK(large.Append(indices.data(), indices.size()) == 0);
+		LEA_CHECK(!large.Is16Bit());
+		LEA_CHECK(Indices(large) == indices);
+	}
+}
+
+int main()
+{
+	TestSubdivideClosed();
+	TestSubdivideOpen();
+	TestGeosphereLattice();
+	TestIndexBufferData();
+	return lea::test::Result();
+}
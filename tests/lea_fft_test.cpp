@@ -0,0 +1,244 @@
+// lea::Fft against a naive DFT in double precision, for every stage count
+// (radix-4 passes with and without a final radix-2 one) and for blocks of
+// columns of every width the SIMD loops split differently.  Also checks that
+// SpectralOcean, built on it, gives the same sea at any thread count, and
+// slopes that are the derivatives of its heights.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "lea_fft.hpp"
+#include "lea_test.hpp"
+#include "spectral_ocean.hpp"
+
+using namespace lea;
+
+namespace {
+	using Complex = Fft::Complex;
+
+	std::vector<std::complex<double>> NaiveDft(const std::vector<Complex>& x, bool inverse)
+	{
+		const size_t n = x.size();
+		const double sign = inverse ? 1.0 : -1.0;
+		std::vector<std::complex<double>> y;
+		y.reserve(n);
+		for (size_t k = 0; k < n; ++k)
+		{
+			std::complex<double> sum;
+			for (size_t j = 0; j < n; ++j)
+			{
+				// j * k mod n keeps the angle exact for large sizes.
+				double angle = sign * 2.0 * 3.14159265358979323846 * double((j * k) % n) / double(n);
+				sum += std::complex<double>(x[j]) * std::polar(1.0, angle);
+			}
+			y.push_back(sum);
+		}
+		return y;
+	}
+
+	// Largest error relative to the largest output, which float rounding over
+	// log2(n) stages keeps around 1e-7 * log2(n).
+	double RelativeError(const Complex* y, size_t stride, const std::vector<std::complex<double>>& reference)
+	{
+		double error = 0.0;
+		double scale = 0.0;
+		for (size_t k = 0; k < reference.size(); ++k)
+		{
+			error = std::max(error, std::abs(std::complex<double>(y[k * stride]) - reference[k]));
+			scale = std::max(scale, std::abs(reference[k]));
+		}
+		return error / scale;
+	}
+
+	std::vector<Complex> RandomSignal(size_t n, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		std::vector<Complex> x(n);
+		for (Complex& c : x)
+			c = Complex(dist(rng), dist(rng));
+		return x;
+	}
+
+	void TestTransform(std::mt19937& rng)
+	{
+		for (UINT n = 1; n <= 1024; n *= 2)
+		{
+			Fft fft(n);
+			LEA_CHECK(fft.Size() == n);
+			for (bool inverse : { false, true })
+			{
+				const std::vector<Complex> x = RandomSignal(n, rng);
+				std::vector<Complex> y = x;
+				fft.Transform(y.data(), inverse);
+				LEA_CHECK(RelativeError(y.data(), 1, NaiveDft(x, inverse)) < 2e-6);
+			}
+
+			// Forward then inverse gives back n times the input.
+			const std::vector<Complex> x = RandomSignal(n, rng);
+			std::vector<Complex> y = x;
+			fft.Transform(y.data(), false);
+			fft.Transform(y.data(), true);
+			double error = 0.0;
+			for (UINT k = 0; k < n; ++k)
+				error = std::max(error, double(std::abs(y[k] / float(n) - x[k])));
+			LEA_CHECK(error < 2e-6);
+		}
+	}
+
+	void TestTransformColumns(std::mt19937& rng)
+	{
+		for (UINT n : { 8u, 32u, 128u })
+		{
+			Fft fft(n);
+			for (UINT count = 1; count <= 9; ++count)
+			{
+				const size_t pitch = count + 3;
+				std::vector<Complex> block = RandomSignal(n * pitch, rng);
+				const std::vector<Complex> original = block;
+				fft.TransformColumns(block.data(), pitch, count, true);
+
+				for (UINT c = 0; c < count; ++c)
+				{
+					std::vector<Complex> column(n);
+					for (UINT k = 0; k < n; ++k)
+						column[k] = original[k * pitch + c];
+					LEA_CHECK(RelativeError(block.data() + c, pitch, NaiveDft(column, true)) < 2e-6);
+				}
+
+				// The padding between the columns is left alone.
+				for (UINT k = 0; k < n; ++k)
+					for (size_t c = count; c < pitch; ++c)
+						LEA_CHECK(block[k * pitch + c] == original[k * pitch + c]);
+			}
+		}
+	}
+
+	void TestInvalidSizes()
+	{
+		for (UINT n : { 0u, 3u, 12u, 1000u })
+		{
+			bool threw = false;
+			try
+			{
+				Fft fft(n);
+			}
+			catch (const std::invalid_argument&)
+			{
+				threw = true;
+			}
+			LEA_CHECK(threw);
+		}
+	}
+
+	void InitOcean(SpectralOcean& ocean, UINT size, UINT threads)
+	{
+		ocean.SetThreadCount(threads);
+		ocean.Init(size, 200.0f, 1.0f / 30.0f, 15.0f, 0.7f, SpectralOcean::ESpectrum::JONSWAP);
+		ocean.Advance(5);
+		ocean.Advance(1);
+	}
+
+	// Heights, then the normals, of every vertex.
+	std::vector<float> OceanState(UINT threads)
+	{
+		SpectralOcean ocean;
+		InitOcean(ocean, 64, threads);
+		std::vector<float> state;
+		for (UINT i = 0; i < ocean.RowCount(); ++i)
+		{
+			for (UINT j = 0; j < ocean.ColumnCount(); ++j)
+			{
+				DirectX::XMFLOAT3 n = ocean.Normal(size_t(i) * ocean.ColumnCount() + j);
+				state.insert(state.end(), { ocean.Height(i, j), n.x, n.y, n.z });
+			}
+		}
+		return state;
+	}
+
+	void TestOceanThreads()
+	{
+		const std::vector<float> serial = OceanState(1);
+		for (UINT threads : { 2u, 3u, 4u })
+		{
+			const std::vector<float> parallel = OceanState(threads);
+			LEA_CHECK(std::memcmp(parallel.data(), serial.data(), serial.size() * sizeof(float)) == 0);
+		}
+	}
+
+	// The sea has no Nyquist terms, so its slopes are exactly the spectral
+	// derivatives of its heights: i k times their forward transform, back.
+	void TestOceanSlopes()
+	{
+		constexpr float Size = 200.0f;
+		for (UINT n : { 4u, 16u, 64u })
+		{
+			for (UINT threads : { 1u, 3u })
+			{
+				SpectralOcean ocean;
+				InitOcean(ocean, n, threads);
+				const Fft fft(n);
+
+				std::vector<Complex> heights(size_t(n) * n);
+				for (UINT i = 0; i < n; ++i)
+					for (UINT j = 0; j < n; ++j)
+						heights[size_t(i) * n + j] = ocean.Height(i, j);
+				for (UINT i = 0; i < n; ++i)
+					fft.Transform(heights.data() + size_t(i) * n, false);
+				fft.TransformColumns(heights.data(), n, n, false);
+
+				const float dk = 2.0f * 3.14159265f / Size;
+				std::vector<Complex> slopesX(heights.size());
+				std::vector<Complex> slopesZ(heights.size());
+				for (UINT i = 0; i < n; ++i)
+				{
+					for (UINT j = 0; j < n; ++j)
+					{
+						int si = i < n / 2 ? int(i) : int(i) - int(n);
+						int sj = j < n / 2 ? int(j) : int(j) - int(n);
+						Complex h = heights[size_t(i) * n + j] / float(n * n);
+						slopesX[size_t(i) * n + j] = Complex(0.0f, sj * dk) * h;
+						slopesZ[size_t(i) * n + j] = Complex(0.0f, si * dk) * h;
+					}
+				}
+				for (std::vector<Complex>* slopes : { &slopesX, &slopesZ })
+				{
+					for (UINT i = 0; i < n; ++i)
+						fft.Transform(slopes->data() + size_t(i) * n, true);
+					fft.TransformColumns(slopes->data(), n, n, true);
+				}
+
+				float error = 0.0f;
+				float peak = 0.0f;
+				for (UINT i = 0; i < n; ++i)
+				{
+					for (UINT j = 0; j < n; ++j)
+					{
+						// Normal() is (-slope x, 1, slope z), normalized.
+						DirectX::XMFLOAT3 normal = ocean.Normal(size_t(i) * ocean.ColumnCount() + j);
+						const size_t k = size_t(i) * n + j;
+						error = std::max({ error, std::fabs(-normal.x / normal.y - slopesX[k].real()),
+							std::fabs(normal.z / normal.y - slopesZ[k].real()) });
+						peak = std::max({ peak, std::fabs(slopesX[k].real()), std::fabs(slopesZ[k].real()) });
+					}
+				}
+				LEA_CHECK(peak > 0.01f && error < 1e-5f * peak);
+			}
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(3);
+	TestTransform(rng);
+	TestTransformColumns(rng);
+	TestInvalidSizes();
+	TestOceanThreads();
+	TestOceanSlopes();
+	return lea::test::Result();
+}
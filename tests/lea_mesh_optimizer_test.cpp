@@ -0,0 +1,116 @@
+// MeshOptimizer only reorders: after every pass the mesh must draw the same
+// triangles, each wound the same way, only in another order and with other
+// vertex numbers.  Triangles are compared by the positions of their corners,
+// rotated so the smallest comes first, which keeps the winding.
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "lea_engine_utils.hpp"
+#include "lea_mesh_optimizer.hpp"
+#include "lea_test.hpp"
+
+using namespace lea;
+using namespace lea::utils;
+
+namespace {
+	using Corner = std::tuple<float, float, float>;
+	using Triangle = std::array<Corner, 3>;
+
+	Corner Key(const Vertex3& v) { return { v.pos.x, v.pos.y, v.pos.z }; }
+	Corner Key(const GeometryGenerator::Vertex& v) { return { v.Position.x, v.Position.y, v.Position.z }; }
+
+	template<typename V>
+	std::vector<Triangle> Triangles(const std::vector<V>& vertices, const std::vector<uint32_t>& indices)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t t = 0; t < indices.size(); t += 3)
+		{
+			Triangle tri = { Key(vertices[indices[t]]), Key(vertices[indices[t + 1]]), Key(vertices[indices[t + 2]]) };
+			std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+			triangles.push_back(tri);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	template<typename V>
+	void CheckOptimize(std::vector<V> vertices, std::vector<uint32_t> indices)
+	{
+		const std::vector<Triangle> original = Triangles(vertices, indices);
+
+		// The cache pass alone keeps the vertex numbers.
+		std::vector<uint32_t> reordered = indices;
+		MeshOptimizer::OptimizeVertexCache(reordered.data(), reordered.size(), vertices.size());
+		LEA_CHECK(Triangles(vertices, reordered) == original);
+
+		// The fetch pass numbers the vertices in order of first use.
+		std::vector<V> fetched = vertices;
+		reordered = indices;
+		MeshOptimizer::OptimizeVertexFetch(fetched, reordered);
+		LEA_CHECK(Triangles(fetched, reordered) == original);
+		uint32_t next = 0;
+		for (uint32_t index : reordered)
+		{
+			LEA_CHECK(index <= next);
+			if (index == next)
+				++next;
+		}
+		LEA_CHECK(next == fetched.size());
+
+		const MeshOptimizer::Report report = MeshOptimizer::Optimize(vertices, indices);
+		LEA_CHECK(Triangles(vertices, indices) == original);
+		LEA_CHECK(report.After.Transforms <= report.Before.Transforms);
+	}
+
+	void TestGrid()
+	{
+		GeometryGenerator gen;
+		GeometryGenerator::BasicMeshData<Vertex3> grid;
+		gen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
+		CheckOptimize(grid.Vertices, grid.Indices);
+
+		// The same grid with its triangles shuffled, its vertices renumbered at
+		// random, and vertices no triangle uses.
+		std::mt19937 rng(25);
+		std::vector<uint32_t> triangleOrder(grid.Indices.size() / 3);
+		for (uint32_t t = 0; t < triangleOrder.size(); ++t)
+			triangleOrder[t] = t;
+		std::shuffle(triangleOrder.begin(), triangleOrder.end(), rng);
+
+		std::vector<uint32_t> vertexOrder(grid.Vertices.size());
+		for (uint32_t v = 0; v < vertexOrder.size(); ++v)
+			vertexOrder[v] = v;
+		std::shuffle(vertexOrder.begin(), vertexOrder.end(), rng);
+
+		std::vector<Vertex3> vertices(grid.Vertices.size());
+		for (uint32_t v = 0; v < vertexOrder.size(); ++v)
+			vertices[vertexOrder[v]] = grid.Vertices[v];
+		for (UINT extra = 0; extra < 10; ++extra)
+			vertices.push_back(Vertex3{ { 1000.0f + extra, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f } });
+
+		std::vector<uint32_t> indices;
+		for (uint32_t t : triangleOrder)
+			for (UINT k = 0; k < 3; ++k)
+				indices.push_back(vertexOrder[grid.Indices[t * 3 + k]]);
+		CheckOptimize(vertices, indices);
+	}
+
+	void TestGeosphere()
+	{
+		GeometryGenerator gen;
+		GeometryGenerator::MeshData sphere;
+		gen.CreateGeosphere(1.0f, 4, sphere);
+		CheckOptimize(sphere.Vertices, sphere.Indices);
+	}
+}
+
+int main()
+{
+	TestGrid();
+	TestGeosphere();
+	return lea::test::Result();
+}
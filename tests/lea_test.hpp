@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the test executables: a failed LEA_CHECK prints where it
+// failed and main returns lea::test::Result().
+namespace lea {
+	namespace test {
+		inline int& FailureCount()
+		{
+			static int count = 0;
+			return count;
+		}
+
+		inline void Fail(const char* file, int line, const char* expression)
+		{
+			std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+			++FailureCount();
+		}
+
+		inline int Result()
+		{
+			if (FailureCount() > 0)
+			{
+				std::fprintf(stderr, "%d check(s) failed\n", FailureCount());
+				return 1;
+			}
+			return 0;
+		}
+	}
+}
+
+#define LEA_CHECK(expression) ((expression) ? (void)0 : lea::test::Fail(__FILE__, __LINE__, #expression))
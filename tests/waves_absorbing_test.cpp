@@ -0,0 +1,99 @@
+// The absorbing border against the figures SetAbsorbingBorder() documents: a
+// still Gaussian bump in the middle of a 129x129 grid, undamped, must come
+// back from a 16- and a 32-cell layer at no more than the stated share of
+// what the bare border sends back, measured as the peak error inside the
+// 32-cell layer against the same bump on a grid too large for its own border
+// to be heard there.
+
+#include <algorithm>
+#include <cmath>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Size = 129;
+	// The reflections from its border reach the compared cells after about
+	// 1300 steps.
+	constexpr UINT ReferenceSize = 257;
+	constexpr UINT Offset = (ReferenceSize - Size) / 2;
+	// The reflections off the layers and the bare border peak by step 1110.
+	constexpr UINT Steps = 1200;
+	constexpr UINT Inner = 32;
+
+	void Bump(Waves& waves, UINT offset, float sigma)
+	{
+		const UINT n = waves.RowCount();
+		for (UINT i = 1; i + 1 < n; ++i)
+		{
+			for (UINT j = 1; j + 1 < n; ++j)
+			{
+				float di = float(int(i) - int(offset + Size / 2));
+				float dj = float(int(j) - int(offset + Size / 2));
+				float h = std::exp(-(di * di + dj * dj) / (2.0f * sigma * sigma));
+				if (h > 1e-9f)
+					waves.SetHeight(i, j, h, h);
+			}
+		}
+	}
+
+	// Peak error, over the cells inside the widest layer and every step,
+	// against the reference for each of the border widths.
+	void Measure(float sigma, const UINT (&widths)[3], double (&errors)[3])
+	{
+		Waves reference;
+		reference.Init(ReferenceSize, ReferenceSize, 0.8f, 0.03f, 3.25f, 0.0f);
+		Bump(reference, Offset, sigma);
+
+		Waves grids[3];
+		for (UINT k = 0; k < 3; ++k)
+		{
+			grids[k].SetAbsorbingBorder(widths[k]);
+			grids[k].Init(Size, Size, 0.8f, 0.03f, 3.25f, 0.0f);
+			Bump(grids[k], 0, sigma);
+			errors[k] = 0.0;
+		}
+
+		for (UINT step = 0; step < Steps; ++step)
+		{
+			reference.Advance(1);
+			for (UINT k = 0; k < 3; ++k)
+			{
+				grids[k].Advance(1);
+				for (UINT i = Inner; i < Size - Inner; ++i)
+					for (UINT j = Inner; j < Size - Inner; ++j)
+						errors[k] = std::max(errors[k], double(std::fabs(grids[k].Height(i, j) - reference.Height(i + Offset, j + Offset))));
+			}
+		}
+	}
+
+	void TestReflection()
+	{
+		// The documented shares rounded up to the next point: 10.1, 17.0, 24.5
+		// and 34.8% are measured from the 16-cell layer, 3.8, 6.7, 10.4 and
+		// 16.9% from the 32-cell one.
+		const float sigmas[] = { 1.5f, 2.5f, 4.0f, 6.0f };
+		const double bound16[] = { 0.11, 0.18, 0.25, 0.35 };
+		const double bound32[] = { 0.04, 0.07, 0.11, 0.17 };
+		const UINT widths[3] = { 0, 16, 32 };
+		for (UINT s = 0; s < 4; ++s)
+		{
+			double errors[3];
+			Measure(sigmas[s], widths, errors);
+
+			// The bare border sends a good part of the bump back.
+			LEA_CHECK(errors[0] > 0.05);
+			LEA_CHECK(errors[1] <= bound16[s] * errors[0]);
+			LEA_CHECK(errors[2] <= bound32[s] * errors[0]);
+			LEA_CHECK(errors[2] < errors[1]);
+		}
+	}
+}
+
+int main()
+{
+	TestReflection();
+	return lea::test::Result();
+}
@@ -0,0 +1,87 @@
+// The ADI solver is meant to stay stable at time steps far past the CFL
+// limit of the explicit scheme: at dt = 1 (a Courant number of 4, the
+// explicit limit is 0.71) the heights must stay finite and never grow past
+// the drops that started them, with and without damping, while the explicit
+// scheme blows up within a few steps.
+
+#include <algorithm>
+#include <cmath>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Size = 81;
+
+	// Largest |height| of the grid, infinity once any of them isn't finite.
+	float Peak(const Waves& waves)
+	{
+		float peak = 0.0f;
+		for (UINT i = 0; i < Size; ++i)
+		{
+			for (UINT j = 0; j < Size; ++j)
+			{
+				float h = waves.Height(i, j);
+				if (!std::isfinite(h))
+					return INFINITY;
+				peak = std::max(peak, std::fabs(h));
+			}
+		}
+		return peak;
+	}
+
+	void Drops(Waves& waves)
+	{
+		waves.Disturb(40, 40, 1.0f);
+		waves.Disturb(20, 60, -0.7f);
+	}
+
+	void TestAdiStable()
+	{
+		for (float dt : { 0.25f, 1.0f })
+		{
+			for (float damping : { 0.0f, 0.4f })
+			{
+				for (UINT threads : { 1u, 3u })
+				{
+					Waves waves;
+					waves.SetThreadCount(threads);
+					waves.SetSolver(Waves::ESolver::ADI);
+					waves.Init(Size, Size, 0.8f, dt, 3.25f, damping);
+					Drops(waves);
+
+					float peak = 0.0f;
+					for (UINT step = 0; step < 2000; ++step)
+					{
+						waves.Advance(1);
+						peak = std::max(peak, Peak(waves));
+					}
+					LEA_CHECK(peak <= 1.0f);
+
+					// Damping wears the waves down, without it they keep going.
+					const float last = Peak(waves);
+					LEA_CHECK(damping > 0.0f ? last < 0.05f : last > 0.01f);
+				}
+			}
+		}
+	}
+
+	void TestExplicitUnstable()
+	{
+		Waves waves;
+		waves.Init(Size, Size, 0.8f, 1.0f, 3.25f, 0.4f);
+		Drops(waves);
+		for (UINT step = 0; step < 20; ++step)
+			waves.Advance(1);
+		LEA_CHECK(!(Peak(waves) < 1e6f));
+	}
+}
+
+int main()
+{
+	TestAdiStable();
+	TestExplicitUnstable();
+	return lea::test::Result();
+}
@@ -0,0 +1,116 @@
+// A grid in a WavesBatch, packed into a lane group or stepped as a plain
+// Waves, must evolve exactly like a standalone Waves with the same settings:
+// same heights and same normals, bit for bit, with drops on the border and
+// off the grid left out the same way.
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves_batch.hpp"
+
+using namespace lea;
+
+namespace {
+	struct Settings
+	{
+		UINT m;
+		UINT n;
+		float dx;
+		float dt;
+		float speed;
+		float damping;
+	};
+
+	bool Same(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	void Check(const WavesBatch& batch, const std::vector<std::unique_ptr<Waves>>& standalone)
+	{
+		for (UINT grid = 0; grid < standalone.size(); ++grid)
+		{
+			const Waves& waves = *standalone[grid];
+			LEA_CHECK(batch.RowCount(grid) == waves.RowCount());
+			LEA_CHECK(batch.ColumnCount(grid) == waves.ColumnCount());
+			for (UINT i = 0; i < waves.RowCount(); ++i)
+			{
+				for (UINT j = 0; j < waves.ColumnCount(); ++j)
+				{
+					LEA_CHECK(batch.Height(grid, i, j) == waves.Height(i, j));
+					LEA_CHECK(Same(batch.Normal(grid, i, j), waves.Normal(size_t(i) * waves.ColumnCount() + j)));
+				}
+			}
+		}
+	}
+
+	void TestMatchesStandalone(UINT threads)
+	{
+		const float dt = 0.03f;
+
+		// Five grids of one kind fill a group and start a second one; the others
+		// get a group each, and the last is too large to pack.
+		std::vector<Settings> settings = {
+			{ 40, 30, 0.8f, dt, 3.25f, 0.4f },
+			{ 40, 30, 0.8f, dt, 3.25f, 0.4f },
+			{ 40, 30, 0.8f, dt, 3.25f, 0.4f },
+			{ 40, 30, 0.8f, dt, 3.25f, 0.4f },
+			{ 40, 30, 0.8f, dt, 3.25f, 0.4f },
+			{ 40, 30, 0.8f, dt, 3.25f, 0.1f },
+			{ 5, 67, 1.0f, dt, 2.0f, 0.2f },
+			{ 128, 128, 0.5f, dt, 4.0f, 0.3f },
+			{ 150, 130, 0.8f, dt, 3.25f, 0.4f },
+		};
+
+		WavesBatch batch(threads);
+		std::vector<std::unique_ptr<Waves>> standalone;
+		auto add = [&](const Settings& s)
+			{
+				LEA_CHECK(batch.Add(s.m, s.n, s.dx, s.dt, s.speed, s.damping) == standalone.size());
+				auto waves = std::make_unique<Waves>();
+				waves->Init(s.m, s.n, s.dx, s.dt, s.speed, s.damping);
+				standalone.push_back(std::move(waves));
+			};
+		for (const Settings& s : settings)
+			add(s);
+
+		std::mt19937 rng(7);
+		for (UINT step = 0; step < 120; ++step)
+		{
+			// A grid added late has its own clock, so it can't join a running group.
+			if (step == 40)
+				add(settings[0]);
+
+			if (step % 4 == 0)
+			{
+				for (UINT grid = 0; grid < standalone.size(); ++grid)
+				{
+					// Anywhere from the border to one past the grid.
+					UINT i = std::uniform_int_distribution<UINT>(0, standalone[grid]->RowCount())(rng);
+					UINT j = std::uniform_int_distribution<UINT>(0, standalone[grid]->ColumnCount())(rng);
+					float magnitude = std::uniform_real_distribution<float>(0.2f, 1.0f)(rng);
+					batch.Disturb(grid, i, j, magnitude);
+					standalone[grid]->Disturb(i, j, magnitude);
+				}
+			}
+
+			batch.Update(dt);
+			for (auto& waves : standalone)
+				waves->Update(dt);
+
+			if (step % 10 == 0)
+				Check(batch, standalone);
+		}
+		LEA_CHECK(batch.GridCount() == standalone.size());
+		Check(batch, standalone);
+	}
+}
+
+int main()
+{
+	TestMatchesStandalone(1);
+	TestMatchesStandalone(3);
+	return lea::test::Result();
+}
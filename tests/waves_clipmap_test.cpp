@@ -0,0 +1,109 @@
+// WavesClipmap promises a surface without cracks: the meshes of all levels
+// together must be closed up to the outer border of the outermost level, with
+// every inner edge shared by exactly two triangles wound the same way (no
+// gaps, overlaps or T-junctions), and points shared by two levels must have
+// the same height.  Checked after moves of the center, with and without a step
+// in between.
+
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves_clipmap.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT LevelCount = 4;
+	constexpr UINT Size = 33;
+
+	// World x and z of a point, in cells of level 0; level 0 has spacing 1.
+	using Point = std::pair<long, long>;
+	using Edge = std::pair<Point, Point>;
+
+	Point Key(const DirectX::XMFLOAT3& p)
+	{
+		return { std::lround(p.x), std::lround(p.z) };
+	}
+
+	void CheckSeams(const WavesClipmap& clipmap)
+	{
+		std::map<Edge, UINT> edges;
+		std::map<Point, float> heights;
+		std::vector<UINT> indices;
+		for (UINT l = 0; l < clipmap.LevelCount(); ++l)
+		{
+			clipmap.BuildIndices(l, indices);
+			LEA_CHECK(indices.size() % 3 == 0);
+			for (size_t t = 0; t < indices.size(); t += 3)
+			{
+				Point p[3];
+				for (UINT k = 0; k < 3; ++k)
+				{
+					DirectX::XMFLOAT3 position = clipmap.Position(l, indices[t + k]);
+					p[k] = Key(position);
+					auto [it, inserted] = heights.emplace(p[k], position.y);
+					LEA_CHECK(inserted || it->second == position.y);
+				}
+				for (UINT k = 0; k < 3; ++k)
+					++edges[{ p[k], p[(k + 1) % 3] }];
+			}
+		}
+
+		const UINT outer = clipmap.LevelCount() - 1;
+		const Point first = Key(clipmap.Position(outer, 0));
+		const Point last = Key(clipmap.Position(outer, size_t(Size) * Size - 1));
+		auto onBorder = [&](const Point& a, const Point& b)
+			{
+				return (a.first == b.first && (a.first == first.first || a.first == last.first)) ||
+					(a.second == b.second && (a.second == first.second || a.second == last.second));
+			};
+
+		UINT borderEdges = 0;
+		for (const auto& [edge, count] : edges)
+		{
+			LEA_CHECK(count == 1);
+			if (edges.count({ edge.second, edge.first }) == 0)
+			{
+				LEA_CHECK(onBorder(edge.first, edge.second));
+				++borderEdges;
+			}
+		}
+		LEA_CHECK(borderEdges == 4 * (Size - 1));
+	}
+
+	void TestSeams()
+	{
+		WavesClipmap clipmap(2);
+		clipmap.Init(LevelCount, Size, 1.0f, 0.03f, 3.25f, 0.4f);
+		CheckSeams(clipmap);
+
+		// Moves by odd and even amounts, small and past a whole level.
+		const float centers[][2] = {
+			{ 0.4f, 0.3f }, { 1.7f, -0.2f }, { 3.0f, 5.2f }, { -6.5f, 2.9f },
+			{ -7.0f, -11.3f }, { 40.0f, 9.0f }, { 41.2f, 8.1f }, { -150.0f, 75.0f },
+		};
+		std::srand(5);
+		for (const float* center : centers)
+		{
+			for (UINT step = 0; step < 20; ++step)
+			{
+				clipmap.Disturb(center[0] + float(std::rand() % 41 - 20), center[1] + float(std::rand() % 41 - 20), 0.5f);
+				clipmap.Update(0.03f);
+			}
+			CheckSeams(clipmap);
+
+			clipmap.SetCenter(center[0], center[1]);
+			CheckSeams(clipmap);
+		}
+	}
+}
+
+int main()
+{
+	TestSeams();
+	return lea::test::Result();
+}
@@ -0,0 +1,262 @@
+// Dirty rows and delta packets: TakeDirtyRows() must report every row that
+// moved by more than the tolerance, with its neighbors, and nothing far from
+// the waves; a viewer fed SerializeRows()/ApplyRows() packets, and a vertex
+// buffer fed partial emissions of the same rows, must end up with what a full
+// copy or a full emission gives; malformed packets must throw.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Rows = 71;
+	constexpr UINT Cols = 53;
+	constexpr UINT Stride = sizeof(Waves::DynamicVertex);
+
+	std::vector<float> Heights(const Waves& waves)
+	{
+		std::vector<float> heights;
+		for (UINT i = 0; i < Rows; ++i)
+			for (UINT j = 0; j < Cols; ++j)
+				heights.push_back(waves.Height(i, j));
+		return heights;
+	}
+
+	std::vector<uint8_t> Emit(const Waves& waves)
+	{
+		std::vector<uint8_t> vertices(waves.VertexCount() * Stride);
+		waves.EmitVertices(vertices.data(), Stride, Waves::EVertexLayout::Split);
+		return vertices;
+	}
+
+	bool Same(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+	}
+
+	bool Contains(const std::vector<Waves::RowRange>& ranges, UINT i)
+	{
+		for (const Waves::RowRange& range : ranges)
+			if (range.begin <= i && i < range.end)
+				return true;
+		return false;
+	}
+
+	void TestDirtyRows()
+	{
+		Waves waves;
+		waves.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+
+		// Without tracking every row is always dirty.
+		for (UINT k = 0; k < 2; ++k)
+		{
+			const std::vector<Waves::RowRange> rows = waves.TakeDirtyRows();
+			LEA_CHECK(rows.size() == 1 && rows[0].begin == 0 && rows[0].end == Rows);
+		}
+
+		// Nothing was taken while tracking was off, so the whole grid comes first.
+		waves.SetDirtyRowTracking(true, 0.0f);
+		std::vector<Waves::RowRange> rows = waves.TakeDirtyRows();
+		LEA_CHECK(rows.size() == 1 && rows[0].begin == 0 && rows[0].end == Rows);
+		LEA_CHECK(waves.TakeDirtyRows().empty());
+
+		// A drop touches rows 19 to 21 and brings their neighbors along; one on
+		// the top border row only reaches row 1.
+		waves.Disturb(20, 10, 0.5f);
+		waves.Disturb(0, 30, 0.5f);
+		rows = waves.TakeDirtyRows();
+		LEA_CHECK(rows.size() == 2);
+		LEA_CHECK(rows[0].begin == 0 && rows[0].end == 3);
+		LEA_CHECK(rows[1].begin == 18 && rows[1].end == 23);
+
+		// Each step spreads the drops by one row, the rest of the grid stays clean.
+		waves.Advance(3);
+		rows = waves.TakeDirtyRows();
+		LEA_CHECK(rows.size() == 2);
+		LEA_CHECK(rows[0].begin == 0 && rows[0].end <= 6);
+		LEA_CHECK(rows[1].begin >= 15 && rows[1].end <= 26);
+	}
+
+	// Steps a grid with dirty-row tracking and sends its dirty rows to a viewer
+	// grid and into a vertex buffer every frame.
+	void CheckDeltas(const std::function<void(Waves&)>& configure, UINT threads, float tolerance, UINT stepsPerFrame)
+	{
+		Waves sim;
+		sim.SetThreadCount(threads);
+		configure(sim);
+		sim.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+		sim.SetDirtyRowTracking(true, tolerance);
+
+		Waves viewer;
+		viewer.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+
+		std::vector<uint8_t> buffer(sim.VertexCount() * Stride);
+		std::vector<float> sent = Heights(sim);
+
+		std::mt19937 rng(9);
+		std::uniform_int_distribution<UINT> row(2, 25);
+		std::uniform_int_distribution<UINT> col(1, Cols - 2);
+		UINT partialFrames = 0;
+		for (UINT frame = 0; frame < 60; ++frame)
+		{
+			// Drops in the top rows only, so the bottom stays clean for a while.
+			if (frame % 5 == 0)
+				sim.Disturb(row(rng), col(rng), 0.6f);
+			sim.Advance(stepsPerFrame);
+
+			const std::vector<Waves::RowRange> rows = sim.TakeDirtyRows();
+			const std::vector<float> heights = Heights(sim);
+			for (UINT i = 0; i < Rows; ++i)
+			{
+				float moved = 0.0f;
+				for (UINT j = 0; j < Cols; ++j)
+					moved = std::max(moved, std::fabs(heights[i * Cols + j] - sent[i * Cols + j]));
+				if (moved > tolerance)
+				{
+					LEA_CHECK(Contains(rows, i));
+					LEA_CHECK(i == 0 || Contains(rows, i - 1));
+					LEA_CHECK(i + 1 == Rows || Contains(rows, i + 1));
+				}
+			}
+			for (size_t k = 0; k + 1 < rows.size(); ++k)
+				LEA_CHECK(rows[k].begin < rows[k].end && rows[k].end < rows[k + 1].begin);
+			for (const Waves::RowRange& range : rows)
+				std::copy(heights.begin() + range.begin * Cols, heights.begin() + range.end * Cols, sent.begin() + range.begin * Cols);
+			if (!rows.empty() && (rows.size() > 1 || rows[0].begin > 0 || rows[0].end < Rows))
+				++partialFrames;
+
+			std::vector<uint8_t> packet;
+			sim.SerializeRows(rows, packet);
+			viewer.ApplyRows(packet.data(), packet.size());
+			sim.EmitVertices(buffer.data(), Stride, Waves::EVertexLayout::Split, rows);
+
+			if (tolerance == 0.0f)
+			{
+				// Nothing is left out, so the viewer and the buffer are exact.
+				LEA_CHECK(Heights(viewer) == heights);
+				const std::vector<uint8_t> full = Emit(sim);
+				LEA_CHECK(Same(Emit(viewer), full));
+				LEA_CHECK(Same(buffer, full));
+			}
+			else
+			{
+				const std::vector<float> seen = Heights(viewer);
+				for (size_t k = 0; k < seen.size(); ++k)
+					LEA_CHECK(seen[k] == sent[k] && std::fabs(seen[k] - heights[k]) <= tolerance);
+			}
+		}
+		LEA_CHECK(partialFrames > 10);
+	}
+
+	void TestDeltas()
+	{
+		for (UINT threads : { 1u, 3u })
+		{
+			for (float tolerance : { 0.0f, 1e-3f })
+			{
+				CheckDeltas([](Waves&) {}, threads, tolerance, 1);
+				CheckDeltas([](Waves& waves) { waves.SetActiveTiles(true, 1e-3f); }, threads, tolerance, 1);
+				CheckDeltas([](Waves& waves) { waves.SetTemporalBlocking(4, 8); }, threads, tolerance, 5);
+			}
+		}
+	}
+
+	// A full packet copies the heights exactly, normals included.
+	void TestRoundTrip()
+	{
+		Waves sim;
+		sim.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+		for (UINT step = 0; step < 40; ++step)
+		{
+			sim.Disturb(5 + step, 7 + step / 2, 0.4f);
+			sim.Advance(1);
+		}
+
+		std::vector<uint8_t> packet;
+		sim.SerializeRows({ { 0, Rows } }, packet);
+		LEA_CHECK(packet.size() == 4 * sizeof(UINT) + size_t(Rows) * Cols * sizeof(float));
+
+		Waves viewer;
+		viewer.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+		viewer.ApplyRows(packet.data(), packet.size());
+		LEA_CHECK(Heights(viewer) == Heights(sim));
+		LEA_CHECK(Same(Emit(viewer), Emit(sim)));
+	}
+
+	bool Throws(Waves& waves, const std::vector<uint8_t>& packet, size_t size)
+	{
+		try
+		{
+			waves.ApplyRows(packet.data(), size);
+		}
+		catch (const std::runtime_error&)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	void TestMalformed()
+	{
+		Waves sim;
+		sim.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+		sim.Disturb(10, 10, 0.5f);
+
+		Waves viewer;
+		viewer.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+
+		std::vector<uint8_t> packet;
+		sim.SerializeRows({ { 3, 5 }, { 9, 12 } }, packet);
+
+		// Cut anywhere, even between two ranges.
+		for (size_t size = 0; size < packet.size(); ++size)
+			LEA_CHECK(Throws(viewer, packet, size));
+
+		// Another column count.
+		Waves narrow;
+		narrow.Init(Rows, Cols - 1, 0.8f, 0.03f, 3.25f, 0.4f);
+		LEA_CHECK(Throws(narrow, packet, packet.size()));
+
+		// Ranges past the last row or backwards.
+		auto withRange = [](std::vector<uint8_t> packet, UINT begin, UINT end)
+			{
+				std::memcpy(packet.data() + 2 * sizeof(UINT), &begin, sizeof(begin));
+				std::memcpy(packet.data() + 3 * sizeof(UINT), &end, sizeof(end));
+				return packet;
+			};
+		std::vector<uint8_t> bad = withRange(packet, Rows - 1, Rows + 1);
+		LEA_CHECK(Throws(viewer, bad, bad.size()));
+		bad = withRange(packet, 5, 3);
+		LEA_CHECK(Throws(viewer, bad, bad.size()));
+
+		// More ranges than the packet holds.
+		bad = packet;
+		UINT rangeCount = 3;
+		std::memcpy(bad.data() + sizeof(UINT), &rangeCount, sizeof(rangeCount));
+		LEA_CHECK(Throws(viewer, bad, bad.size()));
+
+		// The intact packet and an empty one apply.
+		LEA_CHECK(!Throws(viewer, packet, packet.size()));
+		std::vector<uint8_t> empty;
+		sim.SerializeRows({}, empty);
+		LEA_CHECK(!Throws(viewer, empty, empty.size()));
+	}
+}
+
+int main()
+{
+	TestDirtyRows();
+	TestDeltas();
+	TestRoundTrip();
+	TestMalformed();
+	return lea::test::Result();
+}
@@ -0,0 +1,177 @@
+// Emitted vertices must describe the grid Position and Normal read back:
+// the interleaved layout with positions, normals and texcoords, and the split
+// layout's static stream of x, z and texcoords plus its dynamic stream of
+// heights and SNORM normals, at any stride and for partial emissions too.
+// Columns are not a multiple of four, so the SIMD rows have tails.
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "lea_engine_utils.hpp"
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Rows = 61;
+	constexpr UINT Cols = 75;
+
+	template<typename T>
+	T Read(const std::vector<uint8_t>& buffer, size_t vertex, UINT stride)
+	{
+		T value;
+		std::memcpy(&value, buffer.data() + vertex * stride, sizeof(value));
+		return value;
+	}
+
+	// Byte b of an R8G8B8A8_SNORM value.
+	int8_t Snorm(uint32_t packed, UINT b)
+	{
+		return static_cast<int8_t>((packed >> (8 * b)) & 0xFF);
+	}
+
+	void CheckInterleaved(const Waves& waves, const std::vector<uint8_t>& buffer, UINT stride)
+	{
+		const float du = 1.0f / waves.Width();
+		const float dv = 1.0f / waves.Depth();
+		for (size_t k = 0; k < waves.VertexCount(); ++k)
+		{
+			const utils::Vertex3 v = Read<utils::Vertex3>(buffer, k, stride);
+			const XMFLOAT3 p = waves[k];
+			const XMFLOAT3 n = waves.Normal(k);
+			LEA_CHECK(v.pos.x == p.x && v.pos.y == p.y && v.pos.z == p.z);
+			LEA_CHECK(v.norm.x == n.x && v.norm.y == n.y && v.norm.z == n.z);
+			LEA_CHECK(v.tex.x == 0.5f + p.x * du && v.tex.y == 0.5f - p.z * dv);
+		}
+	}
+
+	void CheckStatic(const Waves& waves, const std::vector<uint8_t>& buffer, UINT stride)
+	{
+		const float du = 1.0f / waves.Width();
+		const float dv = 1.0f / waves.Depth();
+		for (size_t k = 0; k < waves.VertexCount(); ++k)
+		{
+			const Waves::StaticVertex v = Read<Waves::StaticVertex>(buffer, k, stride);
+			const XMFLOAT3 p = waves[k];
+			LEA_CHECK(v.x == p.x && v.z == p.z);
+			LEA_CHECK(v.u == 0.5f + p.x * du && v.v == 0.5f - p.z * dv);
+		}
+	}
+
+	void CheckDynamic(const Waves& waves, const std::vector<uint8_t>& buffer, UINT stride)
+	{
+		for (size_t k = 0; k < waves.VertexCount(); ++k)
+		{
+			const Waves::DynamicVertex v = Read<Waves::DynamicVertex>(buffer, k, stride);
+			LEA_CHECK(v.height == waves[k].y);
+
+			// Each component rounds to the nearest of the 255 SNORM steps, so it
+			// decodes to within half a step; w stays 0.
+			const XMFLOAT3 n = waves.Normal(k);
+			const float components[] = { n.x, n.y, n.z };
+			for (UINT b = 0; b < 3; ++b)
+			{
+				LEA_CHECK(Snorm(v.normal, b) == std::nearbyint(components[b] * 127.0f));
+				LEA_CHECK(std::fabs(Snorm(v.normal, b) / 127.0f - components[b]) <= 0.5f / 127.0f + 1e-6f);
+			}
+			LEA_CHECK(Snorm(v.normal, 3) == 0);
+		}
+	}
+
+	// Emits rows into a buffer that holds a marker everywhere else: the rows
+	// must match the full emission and nothing else may be written.
+	void CheckPartial(const Waves& waves, Waves::EVertexLayout layout, UINT stride,
+		const std::vector<uint8_t>& full, const std::vector<Waves::RowRange>& rows)
+	{
+		std::vector<uint8_t> partial(full.size(), 0xCD);
+		waves.EmitVertices(partial.data(), stride, layout, rows);
+
+		std::vector<bool> emitted(Rows, false);
+		for (const Waves::RowRange& range : rows)
+			for (UINT i = range.begin; i < range.end; ++i)
+				emitted[i] = true;
+
+		const size_t rowBytes = size_t(Cols) * stride;
+		for (UINT i = 0; i < Rows; ++i)
+		{
+			const uint8_t* row = partial.data() + i * rowBytes;
+			if (emitted[i])
+			{
+				// Only the vertices, not the padding after them.
+				const size_t vertexBytes = layout == Waves::EVertexLayout::Split ? sizeof(Waves::DynamicVertex) : sizeof(utils::Vertex3);
+				for (UINT j = 0; j < Cols; ++j)
+					LEA_CHECK(std::memcmp(row + j * stride, full.data() + i * rowBytes + j * stride, vertexBytes) == 0);
+			}
+			else
+			{
+				bool untouched = true;
+				for (size_t b = 0; b < rowBytes; ++b)
+					untouched = untouched && row[b] == 0xCD;
+				LEA_CHECK(untouched);
+			}
+		}
+	}
+
+	void CheckEmit(const std::function<void(Waves&)>& configure, UINT threads)
+	{
+		Waves waves;
+		waves.SetThreadCount(threads);
+		configure(waves);
+		waves.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+
+		std::mt19937 rng(8);
+		std::uniform_int_distribution<UINT> row(1, Rows - 2);
+		std::uniform_int_distribution<UINT> col(1, Cols - 2);
+		for (UINT step = 0; step < 60; ++step)
+		{
+			if (step % 3 == 0)
+				waves.Disturb(row(rng), col(rng), 0.8f);
+			waves.Advance(1);
+		}
+		waves.Shift(3, -5);
+		waves.Advance(2);
+
+		const std::vector<Waves::RowRange> rows = { { 0, 1 }, { 7, 19 }, { 33, 34 }, { Rows - 2, Rows } };
+		for (UINT stride : { UINT(sizeof(utils::Vertex3)), 44u })
+		{
+			std::vector<uint8_t> vertices(waves.VertexCount() * stride, 0xCD);
+			waves.EmitVertices(vertices.data(), stride, Waves::EVertexLayout::Interleaved);
+			CheckInterleaved(waves, vertices, stride);
+			CheckPartial(waves, Waves::EVertexLayout::Interleaved, stride, vertices, rows);
+		}
+		for (UINT stride : { UINT(sizeof(Waves::StaticVertex)), 20u })
+		{
+			std::vector<uint8_t> vertices(waves.VertexCount() * stride, 0xCD);
+			waves.EmitStaticVertices(vertices.data(), stride);
+			CheckStatic(waves, vertices, stride);
+		}
+		for (UINT stride : { UINT(sizeof(Waves::DynamicVertex)), 12u })
+		{
+			std::vector<uint8_t> vertices(waves.VertexCount() * stride, 0xCD);
+			waves.EmitVertices(vertices.data(), stride, Waves::EVertexLayout::Split);
+			CheckDynamic(waves, vertices, stride);
+			CheckPartial(waves, Waves::EVertexLayout::Split, stride, vertices, rows);
+		}
+	}
+
+	void TestEmit()
+	{
+		for (UINT threads : { 1u, 3u })
+		{
+			CheckEmit([](Waves&) {}, threads);
+			CheckEmit([](Waves& waves) { waves.SetLazyNormals(true); }, threads);
+			CheckEmit([](Waves& waves) { waves.SetStorage(Waves::EStorage::Int16); }, threads);
+			CheckEmit([](Waves& waves) { waves.SetScrolling(true); }, threads);
+		}
+	}
+}
+
+int main()
+{
+	TestEmit();
+	return lea::test::Result();
+}
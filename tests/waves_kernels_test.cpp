@@ -0,0 +1,259 @@
+// The scalar, SSE and AVX2 kernels of waves_kernels.hpp must produce
+// bit-identical results, and so must whole Waves runs with EKernel::Scalar and
+// EKernel::SIMD.
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+#include "waves_kernels.hpp"
+
+using namespace lea;
+using namespace lea::waves_kernels;
+
+namespace {
+	std::vector<float> RandomFloats(size_t count, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+		std::vector<float> v(count);
+		for (float& f : v)
+			f = dist(rng);
+		return v;
+	}
+
+	template<typename T>
+	bool SameBits(const std::vector<T>& a, const std::vector<T>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+	}
+
+	// Every kernel this build has, scalar first.
+	std::vector<StencilRowFn> StencilRows()
+	{
+		std::vector<StencilRowFn> fns = { &StencilRowScalar };
+#if defined(_XM_SSE_INTRINSICS_)
+		fns.push_back(&StencilRowSSE);
+#endif
+#if defined(LEA_WAVES_AVX2)
+		if (HasAVX2())
+			fns.push_back(&StencilRowAVX2);
+#endif
+		return fns;
+	}
+
+	std::vector<SplatRowFn> SplatRows()
+	{
+		std::vector<SplatRowFn> fns = { &SplatRowScalar };
+#if defined(_XM_SSE_INTRINSICS_)
+		fns.push_back(&SplatRowSSE);
+#endif
+#if defined(LEA_WAVES_AVX2)
+		if (HasAVX2())
+			fns.push_back(&SplatRowAVX2);
+#endif
+		return fns;
+	}
+
+	std::vector<TridiagonalColumnsFn> TridiagonalColumns()
+	{
+		std::vector<TridiagonalColumnsFn> fns = { &TridiagonalColumnsScalar };
+#if defined(_XM_SSE_INTRINSICS_)
+		fns.push_back(&TridiagonalColumnsSSE);
+#endif
+#if defined(LEA_WAVES_AVX2)
+		if (HasAVX2())
+			fns.push_back(&TridiagonalColumnsAVX2);
+#endif
+		return fns;
+	}
+
+	void TestStencilRows(std::mt19937& rng)
+	{
+		constexpr UINT Count = 75;
+		const auto fns = StencilRows();
+		const auto curr = RandomFloats(Count, rng);
+		const auto up = RandomFloats(Count, rng);
+		const auto down = RandomFloats(Count, rng);
+		const auto prev = RandomFloats(Count, rng);
+
+		// Every alignment and tail length of the vector loops.
+		for (UINT begin = 1; begin <= 9; ++begin)
+		{
+			for (UINT end = begin; end < Count - 1; end += 5)
+			{
+				std::vector<float> reference = prev;
+				fns[0](reference.data(), curr.data(), up.data(), down.data(), begin, end, 0.98f, 1.53f, 0.11f);
+				for (size_t f = 1; f < fns.size(); ++f)
+				{
+					std::vector<float> result = prev;
+					fns[f](result.data(), curr.data(), up.data(), down.data(), begin, end, 0.98f, 1.53f, 0.11f);
+					LEA_CHECK(SameBits(result, reference));
+				}
+			}
+		}
+	}
+
+	void TestInterleavedRows(std::mt19937& rng)
+	{
+		constexpr UINT Count = 40;
+		constexpr UINT L = InterleavedLanes;
+		const auto curr = RandomFloats(Count * L, rng);
+		const auto up = RandomFloats(Count * L, rng);
+		const auto down = RandomFloats(Count * L, rng);
+		const auto prev = RandomFloats(Count * L, rng);
+
+		std::vector<float> reference = prev;
+		StencilRowInterleavedScalar(reference.data(), curr.data(), up.data(), down.data(), 1, Count - 1, 0.98f, 1.53f, 0.11f);
+		std::vector<float> result = prev;
+		BestStencilRowInterleaved()(result.data(), curr.data(), up.data(), down.data(), 1, Count - 1, 0.98f, 1.53f, 0.11f);
+		LEA_CHECK(SameBits(result, reference));
+	}
+
+	void TestInt16Rows(std::mt19937& rng)
+	{
+		constexpr UINT Count = 67;
+		std::uniform_int_distribution<int> dist(-32768, 32767);
+		auto random = [&]()
+			{
+				std::vector<int16_t> v(Count);
+				for (int16_t& h : v)
+					h = int16_t(dist(rng));
+				return v;
+			};
+		const auto curr = random();
+		const auto up = random();
+		const auto down = random();
+		const auto prev = random();
+
+		for (UINT begin = 1; begin <= 9; ++begin)
+		{
+			std::vector<int16_t> reference = prev;
+			StencilRowInt16Scalar(reference.data(), curr.data(), up.data(), down.data(), begin, Count - 1, 0.98f, 1.53f, 0.11f);
+			std::vector<int16_t> result = prev;
+			BestStencilRowInt16()(result.data(), curr.data(), up.data(), down.data(), begin, Count - 1, 0.98f, 1.53f, 0.11f);
+			LEA_CHECK(SameBits(result, reference));
+		}
+	}
+
+	void TestNormalRows(std::mt19937& rng)
+	{
+		constexpr UINT Count = 53;
+		const auto row = RandomFloats(Count, rng);
+		const auto up = RandomFloats(Count, rng);
+		const auto down = RandomFloats(Count, rng);
+
+		for (UINT begin = 1; begin <= 5; ++begin)
+		{
+			std::vector<XMFLOAT3> normals(Count, XMFLOAT3(0.0f, 0.0f, 0.0f)), tangents = normals;
+			std::vector<XMFLOAT3> normalsRef = normals, tangentsRef = normals;
+			NormalRowScalar(normalsRef.data(), tangentsRef.data(), row.data(), up.data(), down.data(), begin, Count - 1, 0.5f);
+			BestNormalRow()(normals.data(), tangents.data(), row.data(), up.data(), down.data(), begin, Count - 1, 0.5f);
+			LEA_CHECK(SameBits(normals, normalsRef));
+			LEA_CHECK(SameBits(tangents, tangentsRef));
+		}
+	}
+
+	void TestSplatRows(std::mt19937& rng)
+	{
+		const auto fns = SplatRows();
+		const auto weights = RandomFloats(40, rng);
+		const auto dst = RandomFloats(40, rng);
+		for (UINT count = 0; count <= 40; ++count)
+		{
+			std::vector<float> reference = dst;
+			fns[0](reference.data(), weights.data(), 0.37f, count);
+			for (size_t f = 1; f < fns.size(); ++f)
+			{
+				std::vector<float> result = dst;
+				fns[f](result.data(), weights.data(), 0.37f, count);
+				LEA_CHECK(SameBits(result, reference));
+			}
+		}
+	}
+
+	void TestTridiagonalColumns(std::mt19937& rng)
+	{
+		constexpr UINT Rows = 33;
+		constexpr UINT Cols = 29;
+		const auto x = RandomFloats(size_t(Rows) * Cols, rng);
+		std::vector<float> mask(x.size(), 1.0f);
+		for (size_t k = 0; k < mask.size(); k += 7)
+			mask[k] = 0.0f;
+
+		const auto fns = TridiagonalColumns();
+		std::vector<float> scratch(Rows * TridiagonalMaxLanes);
+		for (UINT begin = 0; begin <= 3; ++begin)
+		{
+			std::vector<float> reference = x;
+			fns[0](reference.data(), mask.data(), Cols, Rows, begin, Cols, 2.5f, scratch.data());
+			for (size_t f = 1; f < fns.size(); ++f)
+			{
+				std::vector<float> result = x;
+				fns[f](result.data(), mask.data(), Cols, Rows, begin, Cols, 2.5f, scratch.data());
+				LEA_CHECK(SameBits(result, reference));
+			}
+		}
+	}
+
+	std::vector<float> RunWaves(Waves::EKernel kernel, Waves::ESolver solver, Waves::EStorage storage)
+	{
+		constexpr UINT Size = 61;
+		Waves waves;
+		waves.SetKernel(kernel);
+		waves.SetSolver(solver);
+		waves.SetStorage(storage);
+		waves.Init(Size, Size, 0.8f, solver == Waves::ESolver::ADI ? 0.1f : 0.03f, 3.25f, 0.4f);
+
+		std::mt19937 rng(7);
+		std::uniform_int_distribution<UINT> index(4, Size - 5);
+		for (UINT step = 0; step < 150; ++step)
+		{
+			if (step % 10 == 0)
+				waves.Disturb(index(rng), index(rng), 0.5f);
+			waves.QueueDisturbance(float(index(rng)) + 0.3f, float(index(rng)) + 0.6f, 0.2f, 1.5f);
+			waves.Advance(1);
+		}
+
+		std::vector<float> state;
+		for (UINT i = 0; i < Size; ++i)
+		{
+			for (UINT j = 0; j < Size; ++j)
+			{
+				state.push_back(waves.Height(i, j));
+				XMFLOAT3 n = waves.Normal(size_t(i) * Size + j);
+				state.insert(state.end(), { n.x, n.y, n.z });
+			}
+		}
+		return state;
+	}
+
+	void TestWaves()
+	{
+		for (auto solver : { Waves::ESolver::Explicit, Waves::ESolver::ADI })
+		{
+			for (auto storage : { Waves::EStorage::Float, Waves::EStorage::Int16 })
+			{
+				LEA_CHECK(SameBits(RunWaves(Waves::EKernel::Scalar, solver, storage),
+					RunWaves(Waves::EKernel::SIMD, solver, storage)));
+			}
+		}
+	}
+}
+
+int main()
+{
+	std::printf("AVX2 kernels %s\n", HasAVX2() ? "tested" : "not available on this CPU");
+
+	std::mt19937 rng(1);
+	TestStencilRows(rng);
+	TestInterleavedRows(rng);
+	TestInt16Rows(rng);
+	TestNormalRows(rng);
+	TestSplatRows(rng);
+	TestTridiagonalColumns(rng);
+	TestWaves();
+	return lea::test::Result();
+}
@@ -0,0 +1,184 @@
+// Large-grid mode: memory from AllocateLargePages() must be aligned, zeroed
+// and usable to its last byte, a grid on it must step exactly like one on
+// regular memory, and a grid of more than 2^32 / 8 points, where the byte
+// offsets of its 8-byte vertices no longer fit 32 bits, must step and emit
+// right at the far end of its planes.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "lea_large_pages.hpp"
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	void TestAllocate()
+	{
+		const size_t HugePage = size_t(2) << 20;
+		for (size_t bytes : { size_t(1), size_t(4095), HugePage - 64, HugePage, HugePage + 1, 5 * HugePage + 3 })
+		{
+			uint8_t* p = static_cast<uint8_t*>(AllocateLargePages(bytes));
+			LEA_CHECK(reinterpret_cast<uintptr_t>(p) % 64 == 0);
+
+			bool zeroed = true;
+			for (size_t b = 0; b < bytes; b += 4093)
+				zeroed = zeroed && p[b] == 0;
+			LEA_CHECK(zeroed && p[bytes - 1] == 0);
+
+			std::memset(p, 0xA5, bytes);
+			LEA_CHECK(p[0] == 0xA5 && p[bytes - 1] == 0xA5);
+			FreeLargePages(p);
+		}
+		FreeLargePages(nullptr);
+	}
+
+	std::vector<float> State(const Waves& waves)
+	{
+		std::vector<float> state;
+		for (UINT i = 0; i < waves.RowCount(); ++i)
+		{
+			for (UINT j = 0; j < waves.ColumnCount(); ++j)
+			{
+				XMFLOAT3 n = waves.Normal(size_t(i) * waves.ColumnCount() + j);
+				state.insert(state.end(), { waves.Height(i, j), waves.PreviousHeight(i, j), n.x, n.y, n.z });
+			}
+		}
+		return state;
+	}
+
+	// A grid of ordinary size on huge pages steps exactly like one without.
+	void TestSameAsRegular()
+	{
+		for (Waves::EStorage storage : { Waves::EStorage::Float, Waves::EStorage::Int16 })
+		{
+			for (UINT threads : { 1u, 3u })
+			{
+				Waves regular;
+				Waves large;
+				large.SetLargeGrid(true);
+				for (Waves* waves : { &regular, &large })
+				{
+					waves->SetThreadCount(threads);
+					waves->SetStorage(storage);
+					waves->Init(131, 97, 0.8f, 0.03f, 3.25f, 0.4f);
+				}
+
+				std::mt19937 rng(11);
+				std::uniform_int_distribution<UINT> row(1, 129);
+				std::uniform_int_distribution<UINT> col(1, 95);
+				for (UINT step = 0; step < 80; ++step)
+				{
+					UINT i = row(rng);
+					UINT j = col(rng);
+					for (Waves* waves : { &regular, &large })
+					{
+						waves->Disturb(i, j, 0.5f);
+						waves->Advance(1);
+					}
+				}
+				LEA_CHECK(State(large) == State(regular));
+			}
+		}
+	}
+
+	// A few steps of drops in the four corners of a grid, close enough to the
+	// corners that a much smaller grid sees the same.
+	void StepCorners(Waves& waves)
+	{
+		const UINT m = waves.RowCount();
+		const UINT n = waves.ColumnCount();
+		for (UINT step = 0; step < 4; ++step)
+		{
+			waves.Disturb(3, 4, 1.0f);
+			waves.Disturb(2, n - 5, -0.7f);
+			waves.Disturb(m - 4, 3, 0.9f);
+			waves.Disturb(m - 3, n - 4, 1.5f);
+			waves.Disturb(m - 1, n - 1, 2.0f);
+			waves.Advance(1);
+		}
+	}
+
+	// Int16 storage keeps the footprint at 4 bytes per point, 2.1 GB here.
+	void TestHugeGrid()
+	{
+		constexpr UINT Rows = 23200;
+		constexpr UINT Cols = 23168;
+		static_assert(uint64_t(Rows) * Cols > (uint64_t(1) << 32) / 8, "not past 2^32 / 8 points");
+
+		Waves huge;
+		huge.SetLargeGrid(true);
+		huge.SetStorage(Waves::EStorage::Int16);
+		try
+		{
+			huge.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+		}
+		catch (const std::bad_alloc&)
+		{
+			std::fprintf(stderr, "waves_large_grid_test: not enough memory for the %ux%u grid, skipped\n", Rows, Cols);
+			return;
+		}
+		StepCorners(huge);
+
+		// The corners of a small grid hold the same 12x12 blocks.
+		constexpr UINT Block = 12;
+		constexpr UINT Size = 40;
+		Waves small;
+		small.SetStorage(Waves::EStorage::Int16);
+		small.Init(Size, Size, 0.8f, 0.03f, 3.25f, 0.4f);
+		StepCorners(small);
+
+		LEA_CHECK(huge.VertexCount() == size_t(Rows) * Cols);
+		bool moved = false;
+		for (UINT i = 0; i < Block; ++i)
+		{
+			for (UINT j = 0; j < Block; ++j)
+			{
+				const UINT rows[][2] = { { i, i }, { Rows - Block + i, Size - Block + i } };
+				const UINT cols[][2] = { { j, j }, { Cols - Block + j, Size - Block + j } };
+				for (const auto& r : rows)
+				{
+					for (const auto& c : cols)
+					{
+						XMFLOAT3 hn = huge.Normal(size_t(r[0]) * Cols + c[0]);
+						XMFLOAT3 sn = small.Normal(size_t(r[1]) * Size + c[1]);
+						LEA_CHECK(huge.Height(r[0], c[0]) == small.Height(r[1], c[1]));
+						LEA_CHECK(huge.PreviousHeight(r[0], c[0]) == small.PreviousHeight(r[1], c[1]));
+						LEA_CHECK(hn.x == sn.x && hn.y == sn.y && hn.z == sn.z);
+						moved = moved || huge.Height(r[0], c[0]) != 0.0f;
+					}
+				}
+			}
+		}
+		LEA_CHECK(moved);
+
+		// The last rows of a split-layout emission, 4.3 GB of vertex buffer of
+		// which only those rows get touched.
+		constexpr UINT Stride = sizeof(Waves::DynamicVertex);
+		uint8_t* buffer = static_cast<uint8_t*>(AllocateLargePages(huge.VertexCount() * Stride));
+		huge.EmitVertices(buffer, Stride, Waves::EVertexLayout::Split, { { Rows - Block, Rows } });
+
+		std::vector<uint8_t> expected(size_t(Size) * Size * Stride);
+		small.EmitVertices(expected.data(), Stride, Waves::EVertexLayout::Split);
+		for (UINT i = 0; i < Block; ++i)
+		{
+			const uint8_t* row = buffer + (size_t(Rows - Block + i) * Cols + Cols - Block) * Stride;
+			const uint8_t* smallRow = expected.data() + (size_t(Size - Block + i) * Size + Size - Block) * Stride;
+			LEA_CHECK(std::memcmp(row, smallRow, size_t(Block) * Stride) == 0);
+		}
+		FreeLargePages(buffer);
+	}
+}
+
+int main()
+{
+	TestAllocate();
+	TestSameAsRegular();
+	TestHugeGrid();
+	return lea::test::Result();
+}
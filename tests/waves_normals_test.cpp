@@ -0,0 +1,107 @@
+// Lazy normals must be the normals the eager path computes with every step,
+// bit for bit, whether they are read after every step or only at the end,
+// also when active tiles leave parts of the grid asleep, with an absorbing
+// border and with the ADI solver.
+
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Rows = 101;
+	constexpr UINT Cols = 75;
+
+	// Normals and tangents of every point.
+	std::vector<float> Frames(const Waves& waves)
+	{
+		std::vector<float> frames;
+		for (size_t i = 0; i < waves.VertexCount(); ++i)
+		{
+			XMFLOAT3 n = waves.Normal(i);
+			XMFLOAT3 t = waves.TangentX(i);
+			frames.insert(frames.end(), { n.x, n.y, n.z, t.x, t.y, t.z });
+		}
+		return frames;
+	}
+
+	bool Same(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+	}
+
+	// Returns the number of steps with some tiles awake and others asleep.
+	UINT CheckLazy(const std::function<void(Waves&)>& configure, UINT threads)
+	{
+		Waves eager;
+		Waves lazyEveryStep;
+		Waves lazyAtEnd;
+		for (Waves* waves : { &eager, &lazyEveryStep, &lazyAtEnd })
+		{
+			waves->SetThreadCount(threads);
+			configure(*waves);
+			waves->Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+		}
+		lazyEveryStep.SetLazyNormals(true);
+		lazyAtEnd.SetLazyNormals(true);
+
+		std::mt19937 rng(4);
+		std::uniform_int_distribution<UINT> row(2, 30);
+		std::uniform_int_distribution<UINT> col(2, Cols - 3);
+		const UINT tiles = ((Rows + Waves::ActiveTileSize - 1) / Waves::ActiveTileSize) *
+			((Cols + Waves::ActiveTileSize - 1) / Waves::ActiveTileSize);
+		UINT sparseSteps = 0;
+		for (UINT step = 0; step < 150; ++step)
+		{
+			// Drops in the top third only, so with active tiles the rest sleeps
+			// until the waves get there.
+			if (step % 10 == 0)
+			{
+				UINT i = row(rng);
+				UINT j = col(rng);
+				for (Waves* waves : { &eager, &lazyEveryStep, &lazyAtEnd })
+					waves->Disturb(i, j, 0.6f);
+			}
+			for (Waves* waves : { &eager, &lazyEveryStep, &lazyAtEnd })
+				waves->Advance(1);
+
+			if (step % 7 == 0)
+				LEA_CHECK(Same(Frames(lazyEveryStep), Frames(eager)));
+			if (eager.ActiveTileCount() > 0 && eager.ActiveTileCount() < tiles)
+				++sparseSteps;
+		}
+
+		const std::vector<float> expected = Frames(eager);
+		LEA_CHECK(Same(Frames(lazyEveryStep), expected));
+		LEA_CHECK(Same(Frames(lazyAtEnd), expected));
+
+		// EnsureNormals() up front gives the same as computing on first read.
+		lazyAtEnd.Advance(1);
+		eager.Advance(1);
+		lazyAtEnd.EnsureNormals();
+		LEA_CHECK(Same(Frames(lazyAtEnd), Frames(eager)));
+		return sparseSteps;
+	}
+
+	void TestLazyNormals()
+	{
+		for (UINT threads : { 1u, 3u })
+		{
+			CheckLazy([](Waves&) {}, threads);
+			LEA_CHECK(CheckLazy([](Waves& waves) { waves.SetActiveTiles(true, 1e-3f); }, threads) > 50);
+			CheckLazy([](Waves& waves) { waves.SetAbsorbingBorder(8); }, threads);
+			CheckLazy([](Waves& waves) { waves.SetSolver(Waves::ESolver::ADI); }, threads);
+		}
+	}
+}
+
+int main()
+{
+	TestLazyNormals();
+	return lea::test::Result();
+}
@@ -0,0 +1,147 @@
+// Obstacle masks: land points must stay exactly flat whatever reaches them,
+// and a mask that is water everywhere, which steps through the wet spans,
+// must match the dense path bit for bit with every kernel and thread count.
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Rows = 83;
+	constexpr UINT Cols = 109;
+
+	std::vector<float> State(const Waves& waves)
+	{
+		std::vector<float> state;
+		for (UINT i = 0; i < Rows; ++i)
+		{
+			for (UINT j = 0; j < Cols; ++j)
+			{
+				XMFLOAT3 n = waves.Normal(size_t(i) * Cols + j);
+				state.insert(state.end(), { waves.Height(i, j), waves.PreviousHeight(i, j), n.x, n.y, n.z });
+			}
+		}
+		return state;
+	}
+
+	// Drops everywhere, land included, and queued Gaussians over the coast.
+	void Run(Waves& waves, UINT steps, const std::function<void(Waves&)>& check = nullptr)
+	{
+		std::mt19937 rng(6);
+		std::uniform_int_distribution<UINT> row(0, Rows - 1);
+		std::uniform_int_distribution<UINT> col(0, Cols - 1);
+		for (UINT step = 0; step < steps; ++step)
+		{
+			if (step % 3 == 0)
+			{
+				waves.Disturb(row(rng), col(rng), 0.7f);
+				waves.QueueDisturbance(float(row(rng)), float(col(rng)), 0.3f, 3.0f);
+			}
+			waves.Advance(1);
+			if (check)
+				check(waves);
+		}
+	}
+
+	// Two islands and a peninsula, and a shallow ridge that stays under water.
+	float Terrain(float x, float z)
+	{
+		float island = 8.0f - std::sqrt((x - 12.0f) * (x - 12.0f) + z * z);
+		float rock = 3.0f - std::sqrt((x + 20.0f) * (x + 20.0f) + (z - 10.0f) * (z - 10.0f));
+		float peninsula = z - 20.0f + 0.2f * x;
+		float ridge = -0.5f - 0.1f * std::fabs(x + 5.0f);
+		return std::max({ island, rock, peninsula, ridge });
+	}
+
+	void TestLandStaysFlat()
+	{
+		for (bool activeTiles : { false, true })
+		{
+			for (UINT threads : { 1u, 3u })
+			{
+				Waves waves;
+				waves.SetThreadCount(threads);
+				waves.SetActiveTiles(activeTiles, 1e-3f);
+				waves.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+				waves.SetObstacleMask(&Terrain, 0.0f);
+
+				UINT land = 0;
+				UINT movingWater = 0;
+				auto check = [&](Waves& w)
+					{
+						for (UINT i = 0; i < Rows; ++i)
+						{
+							for (UINT j = 0; j < Cols; ++j)
+							{
+								if (w.IsWet(i, j))
+								{
+									movingWater += w.Height(i, j) != 0.0f;
+									continue;
+								}
+								++land;
+								LEA_CHECK(w.Height(i, j) == 0.0f && w.PreviousHeight(i, j) == 0.0f);
+							}
+						}
+					};
+				Run(waves, 200, check);
+
+				// The mask actually has land on it, and the water around it moves.
+				LEA_CHECK(land > 200 * 500);
+				LEA_CHECK(movingWater > 200 * 500);
+
+				// Init() clears the mask.
+				waves.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+				bool allWet = true;
+				for (UINT i = 0; i < Rows; ++i)
+					for (UINT j = 0; j < Cols; ++j)
+						allWet = allWet && waves.IsWet(i, j);
+				LEA_CHECK(allWet);
+			}
+		}
+	}
+
+	void TestAllWetMatchesDense()
+	{
+		for (Waves::EKernel kernel : { Waves::EKernel::Scalar, Waves::EKernel::SIMD })
+		{
+			for (bool activeTiles : { false, true })
+			{
+				std::vector<float> dense;
+				for (UINT threads : { 1u, 2u, 5u })
+				{
+					for (bool masked : { false, true })
+					{
+						Waves waves;
+						waves.SetKernel(kernel);
+						waves.SetThreadCount(threads);
+						waves.SetActiveTiles(activeTiles, 1e-3f);
+						waves.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+						if (masked)
+							waves.SetObstacleMask([](float, float) { return -100.0f; }, 0.0f);
+						Run(waves, 120);
+
+						const std::vector<float> state = State(waves);
+						if (dense.empty())
+							dense = state;
+						else
+							LEA_CHECK(std::memcmp(state.data(), dense.data(), dense.size() * sizeof(float)) == 0);
+					}
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestLandStaysFlat();
+	TestAllWetMatchesDense();
+	return lea::test::Result();
+}
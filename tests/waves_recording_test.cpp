@@ -0,0 +1,160 @@
+// A snapshot plus the WavesRecording taken from it must repeat the original
+// run exactly: the grid is run with every kind of recorded call, then
+// restored from the snapshot, the recording replayed (also after a round
+// trip through a file and on another thread count) and the state compared
+// bit for bit.
+
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+#include "waves_recording.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Size = 65;
+
+	// Heights, previous heights and normals of every point.
+	std::vector<float> State(const Waves& waves)
+	{
+		std::vector<float> state;
+		for (UINT i = 0; i < waves.RowCount(); ++i)
+		{
+			for (UINT j = 0; j < waves.ColumnCount(); ++j)
+			{
+				XMFLOAT3 n = waves.Normal(size_t(i) * waves.ColumnCount() + j);
+				state.insert(state.end(), { waves.Height(i, j), waves.PreviousHeight(i, j), n.x, n.y, n.z });
+			}
+		}
+		return state;
+	}
+
+	bool SameState(const std::vector<float>& a, const std::vector<float>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+	}
+
+	// Every call WavesRecording logs, some of them many times, with frame
+	// times around the time step so Update() sometimes steps and sometimes not.
+	void Play(Waves& waves, std::mt19937& rng, bool shift)
+	{
+		std::uniform_int_distribution<UINT> index(2, Size - 3);
+		std::uniform_real_distribution<float> position(0.0f, float(Size - 1));
+		std::uniform_real_distribution<float> dt(0.01f, 0.05f);
+		for (UINT frame = 0; frame < 60; ++frame)
+		{
+			switch (rng() % 6)
+			{
+			case 0:
+				waves.Disturb(index(rng), index(rng), 0.4f);
+				break;
+			case 1:
+				waves.QueueDisturbance(position(rng), position(rng), 0.2f, 2.5f);
+				break;
+			case 2:
+				waves.SetHeight(index(rng), 0, 0.1f, 0.05f);
+				break;
+			case 3:
+				if (shift)
+					waves.Shift(int(rng() % 5) - 2, int(rng() % 5) - 2);
+				break;
+			case 4:
+				waves.Advance(1 + rng() % 3);
+				break;
+			}
+			waves.Update(dt(rng));
+		}
+	}
+
+	std::string TempPath(const char* name)
+	{
+		return (std::filesystem::temp_directory_path() / name).string();
+	}
+
+	void CheckReplay(const std::function<void(Waves&)>& configure, bool shift)
+	{
+		const std::string snapshot = TempPath("lea_waves_recording_test.snapshot");
+		const std::string log = TempPath("lea_waves_recording_test.recording");
+
+		WavesRecording recording;
+		std::vector<float> original;
+		{
+			Waves waves;
+			configure(waves);
+			waves.Init(Size, Size, 0.8f, 0.03f, 3.25f, 0.4f);
+			std::mt19937 rng(7);
+			// Some history before the snapshot, with disturbances still queued.
+			Play(waves, rng, shift);
+			waves.QueueDisturbance(20.0f, 30.0f, 0.3f, 1.5f);
+
+			waves.SaveSnapshot(snapshot.c_str());
+			waves.SetRecording(&recording);
+			Play(waves, rng, shift);
+			waves.SetRecording(nullptr);
+			original = State(waves);
+		}
+		LEA_CHECK(!recording.Events().empty());
+
+		recording.Save(log.c_str());
+		WavesRecording loaded;
+		loaded.Load(log.c_str());
+		LEA_CHECK(loaded.Events().size() == recording.Events().size());
+
+		for (UINT threads : { 1u, 3u })
+		{
+			Waves waves;
+			configure(waves);
+			waves.SetThreadCount(threads);
+			waves.LoadSnapshot(snapshot.c_str());
+			loaded.Replay(waves);
+			LEA_CHECK(SameState(State(waves), original));
+		}
+
+		std::filesystem::remove(snapshot);
+		std::filesystem::remove(log);
+	}
+
+	void TestReplay()
+	{
+		CheckReplay([](Waves&) {}, true);
+		CheckReplay([](Waves& waves) { waves.SetActiveTiles(true, 1e-3f); }, true);
+		CheckReplay([](Waves& waves) { waves.SetScrolling(true); }, true);
+		CheckReplay([](Waves& waves) { waves.SetSolver(Waves::ESolver::ADI); }, true);
+		CheckReplay([](Waves& waves) { waves.SetStorage(Waves::EStorage::Int16); }, true);
+		CheckReplay([](Waves& waves) { waves.SetAbsorbingBorder(8); }, false);
+	}
+
+	void TestReplayIntoItself()
+	{
+		WavesRecording recording;
+		Waves waves;
+		waves.Init(Size, Size, 0.8f, 0.03f, 3.25f, 0.4f);
+		waves.SetRecording(&recording);
+		waves.Advance(1);
+
+		bool threw = false;
+		try
+		{
+			recording.Replay(waves);
+		}
+		catch (const std::invalid_argument&)
+		{
+			threw = true;
+		}
+		LEA_CHECK(threw);
+	}
+}
+
+int main()
+{
+	TestReplay();
+	TestReplayIntoItself();
+	return lea::test::Result();
+}
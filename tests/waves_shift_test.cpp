@@ -0,0 +1,100 @@
+// Scrolling only moves the origin of the rings where a plain Shift() moves
+// every point, and must give the same results: two grids, one of each, take
+// the same steps, disturbances and shifts (small, negative, past the whole
+// grid) and are compared bit for bit after every shift, and again once
+// scrolling is turned off.
+
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Rows = 57;
+	constexpr UINT Cols = 71;
+
+	std::vector<float> State(const Waves& waves)
+	{
+		std::vector<float> state;
+		for (UINT i = 0; i < Rows; ++i)
+		{
+			for (UINT j = 0; j < Cols; ++j)
+			{
+				XMFLOAT3 n = waves.Normal(size_t(i) * Cols + j);
+				state.insert(state.end(), { waves.Height(i, j), waves.PreviousHeight(i, j), n.x, n.y, n.z });
+			}
+		}
+		return state;
+	}
+
+	bool SameState(const Waves& a, const Waves& b)
+	{
+		const std::vector<float> sa = State(a);
+		const std::vector<float> sb = State(b);
+		return std::memcmp(sa.data(), sb.data(), sa.size() * sizeof(float)) == 0;
+	}
+
+	void CheckScrolling(const std::function<void(Waves&)>& configure)
+	{
+		Waves plain;
+		Waves scrolling;
+		for (Waves* waves : { &plain, &scrolling })
+		{
+			configure(*waves);
+			waves->Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+		}
+		scrolling.SetScrolling(true);
+
+		const int shifts[][2] = {
+			{ 1, 0 }, { 0, -1 }, { 3, 5 }, { -7, 2 }, { 0, 0 }, { 20, -33 },
+			{ -1, -1 }, { int(Rows) + 4, 0 }, { 2, -int(Cols) - 9 }, { -5, 13 },
+		};
+		std::mt19937 rng(19);
+		std::uniform_int_distribution<UINT> row(2, Rows - 3);
+		std::uniform_int_distribution<UINT> col(2, Cols - 3);
+		for (const int* shift : shifts)
+		{
+			for (UINT step = 0; step < 15; ++step)
+			{
+				UINT i = row(rng);
+				UINT j = col(rng);
+				plain.Disturb(i, j, 0.5f);
+				scrolling.Disturb(i, j, 0.5f);
+				plain.Advance(1);
+				scrolling.Advance(1);
+			}
+			LEA_CHECK(SameState(plain, scrolling));
+
+			plain.Shift(shift[0], shift[1]);
+			scrolling.Shift(shift[0], shift[1]);
+			LEA_CHECK(SameState(plain, scrolling));
+		}
+
+		// Back in order, and stepping on from there.
+		scrolling.SetScrolling(false);
+		LEA_CHECK(SameState(plain, scrolling));
+		plain.Advance(5);
+		scrolling.Advance(5);
+		LEA_CHECK(SameState(plain, scrolling));
+	}
+
+	void TestScrolling()
+	{
+		CheckScrolling([](Waves&) {});
+		CheckScrolling([](Waves& waves) { waves.SetLazyNormals(true); });
+		CheckScrolling([](Waves& waves) { waves.SetThreadCount(3); });
+		CheckScrolling([](Waves& waves) { waves.SetStorage(Waves::EStorage::Int16); });
+		CheckScrolling([](Waves& waves) { waves.SetAbsorbingBorder(6); });
+	}
+}
+
+int main()
+{
+	TestScrolling();
+	return lea::test::Result();
+}
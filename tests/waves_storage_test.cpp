@@ -0,0 +1,97 @@
+// Int16 storage against the float path, side by side, with the WavesApp
+// constants and drop rates: at the default height range the crests must stay
+// inside the range and every point within the drift SetStorage() states.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	// Documented in Waves::SetStorage().
+	constexpr float DefaultRange = 32.0f;
+	constexpr float MaxDrift = 0.5f;
+
+	void CheckDrift(UINT size, UINT dropEvery, UINT seed)
+	{
+		Waves exact;
+		Waves quantized;
+		quantized.SetStorage(Waves::EStorage::Int16);
+		for (Waves* waves : { &exact, &quantized })
+			waves->Init(size, size, 0.8f, 0.03f, 3.25f, 0.4f);
+
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<UINT> index(5, size - 6);
+		std::uniform_real_distribution<float> magnitude(1.0f, 2.0f);
+		float peak = 0.0f;
+		float drift = 0.0f;
+		for (UINT step = 0; step < 3000; ++step)
+		{
+			if (step % dropEvery == 0)
+			{
+				UINT i = index(rng);
+				UINT j = index(rng);
+				float r = magnitude(rng);
+				exact.Disturb(i, j, r);
+				quantized.Disturb(i, j, r);
+			}
+			exact.Advance(1);
+			quantized.Advance(1);
+
+			if (step % 25 == 0)
+			{
+				for (UINT i = 0; i < size; ++i)
+				{
+					for (UINT j = 0; j < size; ++j)
+					{
+						peak = std::max(peak, std::fabs(exact.Height(i, j)));
+						drift = std::max(drift, std::fabs(quantized.Height(i, j) - exact.Height(i, j)));
+					}
+				}
+			}
+		}
+
+		// The drops pile up to crests well above their own size, but not to the
+		// range.
+		LEA_CHECK(peak > 10.0f && peak < DefaultRange);
+		LEA_CHECK(drift <= MaxDrift);
+	}
+
+	void TestDrift()
+	{
+		CheckDrift(200, 8, 1);
+		CheckDrift(200, 4, 2);
+		CheckDrift(100, 4, 3);
+		CheckDrift(100, 8, 4);
+	}
+
+	void TestRange()
+	{
+		for (float range : { 0.0f, -8.0f, std::nanf("") })
+		{
+			Waves waves;
+			bool threw = false;
+			try
+			{
+				waves.SetStorage(Waves::EStorage::Int16, range);
+			}
+			catch (const std::invalid_argument&)
+			{
+				threw = true;
+			}
+			LEA_CHECK(threw);
+		}
+	}
+}
+
+int main()
+{
+	TestDrift();
+	TestRange();
+	return lea::test::Result();
+}
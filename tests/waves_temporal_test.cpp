@@ -0,0 +1,98 @@
+// Temporal blocking promises the same results as stepping one sweep at a
+// time: every combination of depth, tile size and thread count, with and
+// without an obstacle mask and an absorbing border, must match the plain
+// serial run bit for bit.
+
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Rows = 97;
+	constexpr UINT Cols = 89;
+
+	// Settings applied around Init().
+	struct Setup
+	{
+		std::function<void(Waves&)> beforeInit;
+		std::function<void(Waves&)> afterInit;
+	};
+
+	// Heights, previous heights and normals of every point after 20 rounds of
+	// a few drops and 7 steps.
+	std::vector<float> Simulate(const Setup& setup, UINT depth, UINT tileRows, UINT threads)
+	{
+		Waves waves;
+		waves.SetThreadCount(threads);
+		waves.SetTemporalBlocking(depth, tileRows);
+		if (setup.beforeInit)
+			setup.beforeInit(waves);
+		waves.Init(Rows, Cols, 0.8f, 0.03f, 3.25f, 0.4f);
+		if (setup.afterInit)
+			setup.afterInit(waves);
+
+		std::mt19937 rng(3);
+		std::uniform_int_distribution<UINT> row(1, Rows - 2);
+		std::uniform_int_distribution<UINT> col(1, Cols - 2);
+		for (UINT round = 0; round < 20; ++round)
+		{
+			for (UINT drop = 0; drop < 3; ++drop)
+				waves.Disturb(row(rng), col(rng), 0.5f);
+			waves.Advance(7);
+		}
+
+		std::vector<float> state;
+		for (UINT i = 0; i < Rows; ++i)
+		{
+			for (UINT j = 0; j < Cols; ++j)
+			{
+				XMFLOAT3 n = waves.Normal(size_t(i) * Cols + j);
+				state.insert(state.end(), { waves.Height(i, j), waves.PreviousHeight(i, j), n.x, n.y, n.z });
+			}
+		}
+		return state;
+	}
+
+	void CheckBlocking(const Setup& setup)
+	{
+		const std::vector<float> plain = Simulate(setup, 1, 0, 1);
+		for (UINT depth : { 2u, 3u, 4u, 7u })
+		{
+			for (UINT tileRows : { 0u, 1u, 5u, 16u, Rows + 10 })
+			{
+				for (UINT threads : { 1u, 3u })
+				{
+					const std::vector<float> blocked = Simulate(setup, depth, tileRows, threads);
+					LEA_CHECK(std::memcmp(blocked.data(), plain.data(), plain.size() * sizeof(float)) == 0);
+				}
+			}
+		}
+	}
+
+	// An island in the middle of the grid.
+	float Island(float x, float z)
+	{
+		return 10.0f - std::sqrt(x * x + z * z);
+	}
+
+	void TestBlocking()
+	{
+		CheckBlocking({});
+		CheckBlocking({ [](Waves& waves) { waves.SetLazyNormals(true); }, nullptr });
+		CheckBlocking({ nullptr, [](Waves& waves) { waves.SetObstacleMask(&Island, 0.0f); } });
+		CheckBlocking({ [](Waves& waves) { waves.SetAbsorbingBorder(12); }, nullptr });
+	}
+}
+
+int main()
+{
+	TestBlocking();
+	return lea::test::Result();
+}
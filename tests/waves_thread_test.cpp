@@ -0,0 +1,224 @@
+// TripleBuffer must hand the consumer published values in order, skipping
+// only ones it didn't get to, and never a value the producer is still
+// writing.  WavesThread frames must differ from the frame before in exactly
+// their rows, so a reader that applies the rows of consecutive frames and
+// copies everything after a skip always holds the latest frame, and the
+// sequence must keep counting up across Stop() and Start().
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "lea_triple_buffer.hpp"
+#include "waves.hpp"
+#include "waves_thread.hpp"
+
+using namespace lea;
+
+namespace {
+	void TestTripleBufferOrder()
+	{
+		TripleBuffer<int> buffer;
+		buffer.Reset(0);
+		LEA_CHECK(!buffer.Acquire() && buffer.ReadBuffer() == 0);
+
+		buffer.WriteBuffer() = 1;
+		buffer.Publish();
+		LEA_CHECK(buffer.PublishedBuffer() == 1);
+		LEA_CHECK(buffer.Acquire() && buffer.ReadBuffer() == 1);
+		LEA_CHECK(!buffer.Acquire() && buffer.ReadBuffer() == 1);
+
+		// 2 is skipped, 3 is the latest.
+		for (int value : { 2, 3 })
+		{
+			buffer.WriteBuffer() = value;
+			buffer.Publish();
+		}
+		LEA_CHECK(buffer.Acquire() && buffer.ReadBuffer() == 3);
+
+		// The buffer being written is never the one being read or the latest,
+		// whether the consumer keeps up or not.
+		int read = 3;
+		for (int value = 4; value < 40; ++value)
+		{
+			LEA_CHECK(&buffer.WriteBuffer() != &buffer.ReadBuffer());
+			LEA_CHECK(&buffer.WriteBuffer() != &buffer.PublishedBuffer());
+			buffer.WriteBuffer() = value;
+			buffer.Publish();
+			LEA_CHECK(buffer.PublishedBuffer() == value && buffer.ReadBuffer() == read);
+			if (value % 3 != 0)
+			{
+				LEA_CHECK(buffer.Acquire() && buffer.ReadBuffer() == value);
+				read = value;
+			}
+		}
+	}
+
+	// Every element of a value holds its sequence number, so a torn read shows.
+	struct Payload
+	{
+		std::vector<uint64_t> words;
+	};
+
+	void TestTripleBufferThreads()
+	{
+		constexpr uint64_t Count = 200000;
+		TripleBuffer<Payload> buffer;
+		buffer.Reset({ std::vector<uint64_t>(64, 0) });
+
+		std::thread producer([&buffer]
+			{
+				for (uint64_t value = 1; value <= Count; ++value)
+				{
+					std::fill(buffer.WriteBuffer().words.begin(), buffer.WriteBuffer().words.end(), value);
+					buffer.Publish();
+				}
+			});
+
+		uint64_t last = 0;
+		uint64_t acquired = 0;
+		bool ordered = true;
+		bool whole = true;
+		while (last < Count)
+		{
+			if (!buffer.Acquire())
+				continue;
+			const std::vector<uint64_t>& words = buffer.ReadBuffer().words;
+			ordered = ordered && words[0] > last;
+			whole = whole && std::all_of(words.begin(), words.end(), [&words](uint64_t w) { return w == words[0]; });
+			last = words[0];
+			++acquired;
+		}
+		producer.join();
+
+		LEA_CHECK(ordered && whole);
+		LEA_CHECK(last == Count && acquired > 0);
+		LEA_CHECK(!buffer.Acquire());
+	}
+
+	bool Same(const std::vector<Waves::DynamicVertex>& a, const std::vector<Waves::DynamicVertex>& b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+			[](const Waves::DynamicVertex& x, const Waves::DynamicVertex& y)
+			{
+				return x.height == y.height && x.normal == y.normal;
+			});
+	}
+
+	// What a renderer does with the frames: applies the rows of the next frame,
+	// copies the whole grid after a skip.
+	struct Reader
+	{
+		std::vector<Waves::DynamicVertex> vertices;
+		uint64_t sequence = 0;
+		UINT partialFrames = 0;
+		UINT skips = 0;
+		bool ordered = true;
+		bool current = true;
+
+		void Read(WavesThread& thread, UINT n)
+		{
+			const WavesThread::Frame& frame = thread.LatestFrame();
+			if (frame.sequence == sequence)
+				return;
+
+			ordered = ordered && frame.sequence > sequence;
+			if (frame.sequence == sequence + 1)
+			{
+				size_t rows = 0;
+				for (const Waves::RowRange& range : frame.rows)
+				{
+					std::copy(frame.vertices.begin() + size_t(range.begin) * n, frame.vertices.begin() + size_t(range.end) * n,
+						vertices.begin() + size_t(range.begin) * n);
+					rows += range.end - range.begin;
+				}
+				partialFrames += rows < frame.vertices.size() / n;
+			}
+			else
+			{
+				vertices = frame.vertices;
+				++skips;
+			}
+			sequence = frame.sequence;
+
+			current = current && Same(vertices, frame.vertices);
+		}
+	};
+
+	std::vector<Waves::DynamicVertex> Emit(const Waves& waves)
+	{
+		std::vector<Waves::DynamicVertex> vertices(waves.VertexCount());
+		waves.EmitVertices(vertices.data(), sizeof(Waves::DynamicVertex), Waves::EVertexLayout::Split);
+		return vertices;
+	}
+
+	void TestWavesThread()
+	{
+		constexpr UINT Rows = 67;
+		constexpr UINT Cols = 45;
+		constexpr float Tolerance = 1e-2f;
+
+		// 2000 steps a second, so the reader below both keeps up and falls behind.
+		// Rows drop in and out of the frames around the tolerance, so the rows a
+		// frame didn't emit have to come from the frames before it.
+		Waves waves;
+		waves.Init(Rows, Cols, 0.8f, 0.0005f, 3.25f, 0.4f);
+		waves.SetDirtyRowTracking(true, Tolerance);
+
+		WavesThread thread(waves);
+		Reader reader;
+		reader.vertices.resize(waves.VertexCount());
+
+		std::mt19937 rng(12);
+		std::uniform_int_distribution<UINT> row(2, Rows - 3);
+		std::uniform_int_distribution<UINT> col(2, Cols - 3);
+		std::uniform_int_distribution<int> pause(0, 1500);
+		uint64_t lastBeforeStop = 0;
+		for (UINT run = 0; run < 3; ++run)
+		{
+			thread.Start();
+
+			// The first frame is the grid as Start() found it.
+			reader.Read(thread, Cols);
+			LEA_CHECK(reader.sequence > lastBeforeStop);
+
+			for (UINT read = 0; read < 300; ++read)
+			{
+				if (read % 20 == 0)
+					thread.Disturb(row(rng), col(rng), 0.5f);
+				std::this_thread::sleep_for(std::chrono::microseconds(pause(rng)));
+				reader.Read(thread, Cols);
+			}
+			thread.Stop();
+
+			// The latest frame is the state the thread left the grid in, up to the
+			// rows that moved less than the tolerance.
+			reader.Read(thread, Cols);
+			const std::vector<Waves::DynamicVertex> state = Emit(waves);
+			bool close = true;
+			for (size_t k = 0; k < state.size(); ++k)
+				close = close && std::fabs(reader.vertices[k].height - state[k].height) <= Tolerance;
+			LEA_CHECK(close);
+			lastBeforeStop = reader.sequence;
+
+			// The grid is free to touch while stopped; the next Start() hands out
+			// all of it.
+			waves.Disturb(row(rng), col(rng), 0.5f);
+		}
+
+		LEA_CHECK(reader.ordered && reader.current);
+		LEA_CHECK(reader.partialFrames > 0 && reader.skips > 3);
+	}
+}
+
+int main()
+{
+	TestTripleBufferOrder();
+	TestTripleBufferThreads();
+	TestWavesThread();
+	return lea::test::Result();
+}
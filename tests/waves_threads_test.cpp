@@ -0,0 +1,139 @@
+// Waves promises the same results at any thread count: every mode is run on
+// 1 to 8 threads and must match the serial run bit for bit.
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "lea_test.hpp"
+#include "waves.hpp"
+
+using namespace lea;
+
+namespace {
+	constexpr UINT Size = 97;
+	constexpr UINT ThreadCounts[] = { 2, 3, 4, 8 };
+
+	struct Run
+	{
+		// Settings applied before Init().
+		std::function<void(Waves&)> configure;
+		// Disturbances of one step.
+		std::function<void(Waves&, std::mt19937&)> disturb;
+		UINT steps = 120;
+	};
+
+	// Heights, previous heights and normals of every point after the run.
+	std::vector<float> Simulate(const Run& run, UINT threads)
+	{
+		Waves waves;
+		waves.SetThreadCount(threads);
+		if (run.configure)
+			run.configure(waves);
+		waves.Init(Size, Size, 0.8f, 0.03f, 3.25f, 0.4f);
+
+		std::mt19937 rng(11);
+		for (UINT step = 0; step < run.steps; ++step)
+		{
+			run.disturb(waves, rng);
+			waves.Advance(1);
+		}
+
+		std::vector<float> state;
+		for (UINT i = 0; i < Size; ++i)
+		{
+			for (UINT j = 0; j < Size; ++j)
+			{
+				XMFLOAT3 n = waves.Normal(size_t(i) * Size + j);
+				state.insert(state.end(), { waves.Height(i, j), waves.PreviousHeight(i, j), n.x, n.y, n.z });
+			}
+		}
+		return state;
+	}
+
+	void CheckThreadCounts(const Run& run)
+	{
+		const std::vector<float> serial = Simulate(run, 1);
+		for (UINT threads : ThreadCounts)
+		{
+			const std::vector<float> parallel = Simulate(run, threads);
+			LEA_CHECK(parallel.size() == serial.size() &&
+				std::memcmp(parallel.data(), serial.data(), serial.size() * sizeof(float)) == 0);
+		}
+	}
+
+	void DisturbRandomPoint(Waves& waves, std::mt19937& rng)
+	{
+		std::uniform_int_distribution<UINT> index(1, Size - 2);
+		if (rng() % 4 == 0)
+			waves.Disturb(index(rng), index(rng), 0.5f);
+	}
+
+	// Band-parallel steps, with eager and lazy normals.
+	void TestBands()
+	{
+		CheckThreadCounts({ nullptr, &DisturbRandomPoint });
+		CheckThreadCounts({ [](Waves& waves) { waves.SetLazyNormals(true); }, &DisturbRandomPoint });
+	}
+
+	// A few drops in one corner, so most tiles sleep through most of the run.
+	void DisturbCorner(Waves& waves, std::mt19937& rng)
+	{
+		std::uniform_int_distribution<UINT> index(2, 12);
+		if (rng() % 16 == 0)
+			waves.Disturb(index(rng), index(rng), 0.05f);
+	}
+
+	// Sparse stepping of the awake tiles.
+	void TestActiveTiles()
+	{
+		auto activeTiles = [](Waves& waves) { waves.SetActiveTiles(true, 1e-3f); };
+
+		// Make sure the run actually steps a part of the grid: some tiles awake,
+		// others asleep.
+		const UINT tiles = (Size + Waves::ActiveTileSize - 1) / Waves::ActiveTileSize;
+		Waves waves;
+		activeTiles(waves);
+		waves.Init(Size, Size, 0.8f, 0.03f, 3.25f, 0.4f);
+		std::mt19937 rng(11);
+		UINT sparseSteps = 0;
+		for (UINT step = 0; step < 120; ++step)
+		{
+			DisturbCorner(waves, rng);
+			waves.Advance(1);
+			if (waves.ActiveTileCount() > 0 && waves.ActiveTileCount() < tiles * tiles)
+				++sparseSteps;
+		}
+		LEA_CHECK(sparseSteps > 60);
+
+		CheckThreadCounts({ activeTiles, &DisturbCorner });
+		CheckThreadCounts({ activeTiles, &DisturbRandomPoint });
+	}
+
+	// Hundreds of queued impulses per step, point stencils and Gaussians,
+	// some of them reaching past the border.
+	void QueueRain(Waves& waves, std::mt19937& rng)
+	{
+		std::uniform_real_distribution<float> position(-4.0f, float(Size) + 4.0f);
+		std::uniform_real_distribution<float> radius(0.0f, 4.0f);
+		for (UINT k = 0; k < 300; ++k)
+			waves.QueueDisturbance(position(rng), position(rng), 0.01f, k % 3 == 0 ? 0.0f : radius(rng));
+	}
+
+	// The disturbance queue, applied in row bands.
+	void TestDisturbanceQueue()
+	{
+		CheckThreadCounts({ nullptr, &QueueRain, 40 });
+		CheckThreadCounts({ [](Waves& waves) { waves.SetActiveTiles(true, 1e-3f); }, &QueueRain, 40 });
+	}
+}
+
+int main()
+{
+	TestBands();
+	TestActiveTiles();
+	TestDisturbanceQueue();
+	return lea::test::Result();
+}